@@ -0,0 +1,1057 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <math.h>
+
+#include <common.h>
+#include <logger.h>
+
+#include "eviction.h"
+#include "file_system.h"
+#include "huge_pages.h"
+
+// Workload
+#define NUM_FILES       1024
+#define FILE_SIZE       256
+#define OPS_PER_WORKER  500000
+#define MAX_WORKERS     16
+
+// Eviction workloads
+#define CACHE_SLOTS     1000
+#define NUM_KEYS        (CACHE_SLOTS * 10)
+#define NUM_REQUESTS    1000000
+#define ZIPF_ALPHA      0.99
+#define SCAN_EVERY      10000
+#define SCAN_LENGTH     2000
+#define SIZED_CACHE_MB  64
+#define SIZED_MIN_KB    1
+#define SIZED_MAX_KB    4096
+#define SIZED_REQUESTS  200000
+
+// Append workload
+#define APPEND_CHUNK    512
+#define APPEND_READ_EVERY 64
+
+// Sample workload
+#define SAMPLE_N        32
+#define SAMPLE_CALLS    1000
+
+// Reclaim workload
+#define RECLAIM_ROUNDS  64
+
+// Range workload
+#define RANGE_FILE_MB   4
+#define RANGE_SIZE      4096
+#define RANGE_CALLS     2000
+
+// List workload
+#define LIST_DIRS       100
+#define LIST_CALLS      100
+
+// TTL workload
+#define TTL_ROUNDS      10000
+#define TTL_READS       4
+#define TTL_MS          50
+#define TTL_ROUND_US    200
+
+// Huge pages workload
+#define HUGE_FILES      (512 * 1024)
+#define HUGE_LOOKUPS    4000000
+#define HUGE_BIG_FILES  16
+#define HUGE_BIG_MB     4
+#define HUGE_COPIES     1000
+
+typedef struct {
+    int id;                 // Worker id (used as client id)
+    int ops;                // Operations to run
+    unsigned int seed;      // Private seed for rand_r
+} BenchWorkerArgs_t;
+
+// =============================================================================================
+
+FSFile_t makeFile(const char* name, int contentLen);
+FSFile_t makeFilledFile(const char* name, int contentLen, char fill);
+double elapsedSec(struct timespec, struct timespec);
+void runFileSystem(FSConfig_t, void* (*)(void*), int, double*);
+void stopFileSystem(NotifyChannel_t*);
+void* contentionWorker(void*);
+int benchContention();
+int benchAlloc();
+int benchEviction();
+int benchAdmission();
+int benchAppend();
+int benchSample();
+int benchReclaim();
+int benchRange();
+int benchList();
+int benchTtl();
+int benchHugePages();
+
+// =============================================================================================
+
+int main(int argc, char** argv) {
+    // Keep only errors
+    set_log_level(LOG_LEVEL_ERROR);
+
+    // Benchmark name must be the first parameter
+    const char* name = (argc > 1) ? argv[1] : "contention";
+    if (strcmp(name, "contention") == 0) return benchContention();
+    if (strcmp(name, "alloc")      == 0) return benchAlloc();
+    if (strcmp(name, "eviction")   == 0) return benchEviction();
+    if (strcmp(name, "admission")  == 0) return benchAdmission();
+    if (strcmp(name, "append")     == 0) return benchAppend();
+    if (strcmp(name, "sample")     == 0) return benchSample();
+    if (strcmp(name, "reclaim")    == 0) return benchReclaim();
+    if (strcmp(name, "range")      == 0) return benchRange();
+    if (strcmp(name, "list")       == 0) return benchList();
+    if (strcmp(name, "ttl")        == 0) return benchTtl();
+    if (strcmp(name, "hugepages")  == 0) return benchHugePages();
+
+    LOG_ERRO("Unknown benchmark: %s", name);
+    return EXIT_FAILURE;
+}
+
+// =============================================================================================
+
+FSFile_t makeFile(const char* name, int contentLen) {
+    return makeFilledFile(name, contentLen, 'x');
+}
+
+FSFile_t makeFilledFile(const char* name, int contentLen, char fill) {
+    // Name (fs takes ownership, null terminated for logging)
+    size_t nameLen = strlen(name) + 1;
+    char* nameBuf  = (char*) mem_malloc(nameLen * sizeof(char));
+    memcpy(nameBuf, name, nameLen);
+
+    // Content
+    char* bytes = (char*) mem_malloc(MAX(1, contentLen) * sizeof(char));
+    memset(bytes, fill, contentLen);
+    Content_t* content = createContent(bytes, contentLen);
+    free(bytes);
+
+    FSFile_t file = { .nameLen = nameLen, .name = nameBuf, .contentLen = contentLen, .content = content };
+    return file;
+}
+
+double elapsedSec(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**
+ * Initialize the "file_system", fill it with NUM_FILES files, run 'numWorkers' threads
+ * with 'worker' as routine and terminate it.
+ *
+ * \param configs   : file system configs
+ * \param worker    : routine run by every thread (receives BenchWorkerArgs_t*)
+ * \param numWorkers: threads count
+ * \param outSec    : time spent by the slowest worker
+ */
+void runFileSystem(FSConfig_t configs, void* (*worker)(void*), int numWorkers, double* outSec) {
+    // vars
+    pthread_t threads[MAX_WORKERS];
+    BenchWorkerArgs_t args[MAX_WORKERS];
+    NotifyChannel_t lockChannel;
+    struct timespec start, end;
+
+    initNotifyChannel(&lockChannel, 256);
+    initializeFileSystem(configs, &lockChannel);
+
+    // Fill
+    char name[64];
+    for (int i = 0; i < NUM_FILES; ++i) {
+        FSFile_t* outFiles = NULL;
+        int outFilesCount  = 0;
+        snprintf(name, sizeof(name), "/bench/file-%d", i);
+        fs_insert(0, makeFile(name, FILE_SIZE), 0, 0, &outFiles, &outFilesCount);
+        free(outFiles);
+    }
+
+    // Run
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < numWorkers; ++i) {
+        args[i].id   = i + 1;
+        args[i].ops  = OPS_PER_WORKER;
+        args[i].seed = (unsigned int) (i + 1) * 7919;
+        if (pthread_create(&threads[i], NULL, worker, &args[i]) != 0) {
+            LOG_ERRNO("Error creating worker #%d", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < numWorkers; ++i) pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *outSec = elapsedSec(start, end);
+
+    stopFileSystem(&lockChannel);
+}
+
+void stopFileSystem(NotifyChannel_t* lockChannel) {
+    // Terminate (hide summary table)
+    fflush(stdout);
+    int stdoutFd = dup(STDOUT_FILENO), nullFd = open("/dev/null", O_WRONLY);
+    dup2(nullFd, STDOUT_FILENO);
+    terminateFileSystem();
+    fflush(stdout);
+    dup2(stdoutFd, STDOUT_FILENO);
+    close(stdoutFd);
+    close(nullFd);
+
+    // Release channel
+    destroyNotifyChannel(lockChannel);
+}
+
+// =============================================================================================
+
+/*
+ * Mixed workload: 70% obtain, 20% exists, 10% create + remove of a private file.
+ * Every op targets a random file, so workers compete on the same structures.
+ */
+void* contentionWorker(void* args) {
+    BenchWorkerArgs_t* self = (BenchWorkerArgs_t*) args;
+    char name[64];
+
+    for (int i = 0; i < self->ops; ++i) {
+        int op = rand_r(&self->seed) % 10;
+        snprintf(name, sizeof(name), "/bench/file-%d", rand_r(&self->seed) % NUM_FILES);
+        FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+
+        if (op < 7) {
+            FSFile_t outFile;
+            if (fs_obtain(self->id, file, &outFile) == 0) {
+                releaseContent(outFile.content);
+                free((char*) outFile.name);
+            }
+        } else if (op < 9) {
+            fs_exists(self->id, file);
+        } else {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            snprintf(name, sizeof(name), "/bench/tmp-%d-%d", self->id, i);
+            file.nameLen = strlen(name) + 1;
+            if (fs_insert(self->id, makeFile(name, FILE_SIZE), 1, 0, &outFiles, &outFilesCount) == 0) {
+                fs_remove(self->id, file);
+            }
+            for (int j = 0; j < outFilesCount; ++j) {
+                releaseContent(outFiles[j].content);
+                free((char*) outFiles[j].name);
+            }
+            free(outFiles);
+        }
+    }
+    return NULL;
+}
+
+int benchContention() {
+    static const int workers[] = { 1, 2, 4, 8, 16 };
+    static const int shards[]  = { 1, 16 };
+
+    LOG_EMPTY("contention: %d files of %dB, %d ops per worker (70%% obtain, 20%% exists, 10%% insert+remove)\n", NUM_FILES, FILE_SIZE, OPS_PER_WORKER);
+    LOG_EMPTY("%8s %8s %12s %14s\n", "shards", "workers", "seconds", "ops/s");
+    for (int s = 0; s < 2; ++s) {
+        for (int w = 0; w < 5; ++w) {
+            FSConfig_t configs = {
+                .tableSize           = NUM_FILES,
+                .maxFileCapacitySlot = NUM_FILES * 4,
+                .maxFileCapacityMB   = 64,
+                .numShards           = shards[s],
+            };
+            double sec = 0;
+            runFileSystem(configs, contentionWorker, workers[w], &sec);
+            LOG_EMPTY("%8d %8d %12.3f %14.0f\n", shards[s], workers[w], sec, (double) workers[w] * OPS_PER_WORKER / sec);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Fill the file system with empty files, 1% of them with a client waiting on lock,
+ * and report the memory used by cache entries.
+ */
+int benchAlloc() {
+    static const int counts[] = { 1000, 10000, 100000, 1000000 };
+
+    LOG_EMPTY("alloc: empty files, 1%% of them with a client waiting on lock\n");
+    LOG_EMPTY("%10s %12s %14s %10s %12s %12s\n", "files", "allocations", "reserved (B)", "B/entry", "lock queues", "ns/insert");
+    for (int c = 0; c < 4; ++c) {
+        // vars
+        NotifyChannel_t lockChannel;
+        struct timespec start, end;
+        char name[64];
+
+        FSConfig_t configs = {
+            .tableSize           = counts[c],
+            .maxFileCapacitySlot = counts[c],
+            .maxFileCapacityMB   = 1024,
+            .numShards           = 16,
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        // Fill
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < counts[c]; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            snprintf(name, sizeof(name), "/bench/file-%d", i);
+            fs_insert(1, makeFile(name, 0), (i % 100 == 0), 0, &outFiles, &outFilesCount);
+            free(outFiles);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        // Contention on locked files
+        for (int i = 0; i < counts[c]; i += 100) {
+            snprintf(name, sizeof(name), "/bench/file-%d", i);
+            FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+            fs_trylock(2, file, 0, -1);
+        }
+
+        FSAllocInfo_t info = fs_get_alloc_infos();
+        LOG_EMPTY("%10d %12zu %14zu %10zu %12zu %12.0f\n", info.entriesCount, info.allocCount, info.bytesReserved,
+            info.bytesReserved / (size_t) (MAX(1, info.entriesCount)), info.lockQueuesAlive, elapsedSec(start, end) * 1e9 / counts[c]);
+
+        stopFileSystem(&lockChannel);
+    }
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Single client reading files with a zipfian popularity (inserting them on miss):
+ *  - zipf     : files of FILE_SIZE bytes, cache limited by slots
+ *  - zipf+scan: same, with periodic scans of files read only once
+ *  - sizes    : files of SIZED_MIN_KB ~> SIZED_MAX_KB (log-uniform), cache limited by bytes
+ * Reports object and byte hit ratio of each eviction policy.
+ */
+int benchEviction() {
+    static const char* workloads[] = { "zipf", "zipf+scan", "sizes" };
+
+    // Zipf cumulative distribution
+    double* cdf = (double*) mem_malloc(NUM_KEYS * sizeof(double));
+    double sum  = 0;
+    for (int i = 0; i < NUM_KEYS; ++i) cdf[i] = (sum += 1.0 / pow(i + 1, ZIPF_ALPHA));
+    for (int i = 0; i < NUM_KEYS; ++i) cdf[i] /= sum;
+
+    // Size of each file (sizes workload)
+    int* sizes = (int*) mem_malloc(NUM_KEYS * sizeof(int));
+    unsigned int sizeSeed = 104729;
+    for (int i = 0; i < NUM_KEYS; ++i)
+        sizes[i] = (int) (SIZED_MIN_KB * 1024 * pow((double) SIZED_MAX_KB / SIZED_MIN_KB, (double) rand_r(&sizeSeed) / RAND_MAX));
+
+    LOG_EMPTY("eviction: %d keys (zipf %.2f). zipf: %d slots, %d requests, scans of %d keys every %d requests. sizes: %dMB, %d requests\n",
+        NUM_KEYS, ZIPF_ALPHA, CACHE_SLOTS, NUM_REQUESTS, SCAN_LENGTH, SCAN_EVERY, SIZED_CACHE_MB, SIZED_REQUESTS);
+    LOG_EMPTY("%10s %10s %10s %10s %12s %10s\n", "workload", "policy", "hit ratio", "byte ratio", "cap. misses", "seconds");
+    for (int w = 0; w < 3; ++w) {
+        for (int p = 0; p < EVICTION_POLICIES; ++p) {
+            // vars
+            NotifyChannel_t lockChannel;
+            struct timespec start, end;
+            unsigned int seed = 7919;
+            long long hits = 0, scanned = 0, hitBytes = 0, reqBytes = 0;
+            int requests = (w == 2) ? SIZED_REQUESTS : NUM_REQUESTS;
+            char name[64];
+
+            FSConfig_t configs = {
+                .tableSize           = CACHE_SLOTS,
+                .maxFileCapacitySlot = (w == 2) ? NUM_KEYS : CACHE_SLOTS,
+                .maxFileCapacityMB   = (w == 2) ? SIZED_CACHE_MB : 64,
+                .numShards           = 1,
+                .evictionPolicy      = p,
+            };
+            initNotifyChannel(&lockChannel, 256);
+            initializeFileSystem(configs, &lockChannel);
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int i = 0; i < requests; ++i) {
+                int size = FILE_SIZE;
+                // Scans read keys never seen again
+                if (w == 1 && i % SCAN_EVERY < SCAN_LENGTH) {
+                    snprintf(name, sizeof(name), "/bench/scan-%lld", scanned++);
+                } else {
+                    double u = (double) rand_r(&seed) / RAND_MAX;
+                    int lo = 0, hi = NUM_KEYS - 1;
+                    while (lo < hi) {
+                        int mid = (lo + hi) / 2;
+                        if (cdf[mid] < u) lo = mid + 1;
+                        else hi = mid;
+                    }
+                    snprintf(name, sizeof(name), "/bench/file-%d", lo);
+                    if (w == 2) size = sizes[lo];
+                }
+                reqBytes += size;
+
+                // Read, insert on miss
+                FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+                FSFile_t outFile;
+                if (fs_obtain(1, file, &outFile) == 0) {
+                    releaseContent(outFile.content);
+                    free((char*) outFile.name);
+                    hits++;
+                    hitBytes += size;
+                } else {
+                    FSFile_t* outFiles = NULL;
+                    int outFilesCount  = 0;
+                    // Big contents are not filled (never read)
+                    FSFile_t newFile = makeFile(name, 0);
+                    newFile.content    = createContent(NULL, size);
+                    newFile.contentLen = size;
+                    fs_insert(1, newFile, 0, 0, &outFiles, &outFilesCount);
+                    for (int j = 0; j < outFilesCount; ++j) {
+                        releaseContent(outFiles[j].content);
+                        free((char*) outFiles[j].name);
+                    }
+                    free(outFiles);
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            FSInfo_t info = fs_get_infos();
+            LOG_EMPTY("%10s %10s %9.2f%% %9.2f%% %12d %10.3f\n", workloads[w], evictionPolicyName(p),
+                100.0 * hits / requests, 100.0 * hitBytes / reqBytes, info.capacityMissCount, elapsedSec(start, end));
+
+            stopFileSystem(&lockChannel);
+        }
+    }
+    free(sizes);
+    free(cdf);
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Same zipf workloads of benchEviction (slots limited), every policy run with and
+ * without the admission filter. Files of the scans are written once and never read again:
+ * admitted they flush the hot files, declined they are returned at once.
+ */
+int benchAdmission() {
+    static const char* workloads[]  = { "zipf", "zipf+scan" };
+    static const char* admissions[] = { "ALWAYS", "TINYLFU" };
+
+    // Zipf cumulative distribution
+    double* cdf = (double*) mem_malloc(NUM_KEYS * sizeof(double));
+    double sum  = 0;
+    for (int i = 0; i < NUM_KEYS; ++i) cdf[i] = (sum += 1.0 / pow(i + 1, ZIPF_ALPHA));
+    for (int i = 0; i < NUM_KEYS; ++i) cdf[i] /= sum;
+
+    LOG_EMPTY("admission: %d keys (zipf %.2f), %d slots, %d requests, scans of %d keys every %d requests\n",
+        NUM_KEYS, ZIPF_ALPHA, CACHE_SLOTS, NUM_REQUESTS, SCAN_LENGTH, SCAN_EVERY);
+    LOG_EMPTY("%10s %10s %10s %10s %12s %10s %10s\n", "workload", "policy", "admission", "hit ratio", "cap. misses", "declined", "seconds");
+    for (int w = 0; w < 2; ++w) {
+        for (int p = 0; p < EVICTION_POLICIES; ++p) {
+            for (int a = 0; a < 2; ++a) {
+                // vars
+                NotifyChannel_t lockChannel;
+                struct timespec start, end;
+                unsigned int seed = 7919;
+                long long hits = 0, scanned = 0;
+                char name[64];
+
+                FSConfig_t configs = {
+                    .tableSize           = CACHE_SLOTS,
+                    .maxFileCapacitySlot = CACHE_SLOTS,
+                    .maxFileCapacityMB   = 64,
+                    .numShards           = 1,
+                    .evictionPolicy      = p,
+                    .admission           = (a == 0) ? FS_ADMISSION_ALWAYS : FS_ADMISSION_TINYLFU,
+                };
+                initNotifyChannel(&lockChannel, 256);
+                initializeFileSystem(configs, &lockChannel);
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (int i = 0; i < NUM_REQUESTS; ++i) {
+                    // Scans write keys never seen again
+                    if (w == 1 && i % SCAN_EVERY < SCAN_LENGTH) {
+                        snprintf(name, sizeof(name), "/bench/scan-%lld", scanned++);
+                    } else {
+                        double u = (double) rand_r(&seed) / RAND_MAX;
+                        int lo = 0, hi = NUM_KEYS - 1;
+                        while (lo < hi) {
+                            int mid = (lo + hi) / 2;
+                            if (cdf[mid] < u) lo = mid + 1;
+                            else hi = mid;
+                        }
+                        snprintf(name, sizeof(name), "/bench/file-%d", lo);
+                    }
+
+                    // Read, insert on miss
+                    FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+                    FSFile_t outFile;
+                    if (fs_obtain(1, file, &outFile) == 0) {
+                        releaseContent(outFile.content);
+                        free((char*) outFile.name);
+                        hits++;
+                    } else {
+                        FSFile_t* outFiles = NULL;
+                        int outFilesCount  = 0;
+                        fs_insert(1, makeFile(name, FILE_SIZE), 0, 0, &outFiles, &outFilesCount);
+                        for (int j = 0; j < outFilesCount; ++j) {
+                            releaseContent(outFiles[j].content);
+                            free((char*) outFiles[j].name);
+                        }
+                        free(outFiles);
+                    }
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+
+                FSInfo_t info = fs_get_infos();
+                LOG_EMPTY("%10s %10s %10s %9.2f%% %12d %10d %10.3f\n", workloads[w], evictionPolicyName(p), admissions[a],
+                    100.0 * hits / NUM_REQUESTS, info.capacityMissCount, info.declinedCount, elapsedSec(start, end));
+
+                stopFileSystem(&lockChannel);
+            }
+        }
+    }
+    free(cdf);
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Single client growing a log file with APPEND_CHUNK bytes appends, reading it
+ * every APPEND_READ_EVERY appends. Every read keeps its reference until the next one
+ * (like a response still being sent while appends go on).
+ */
+int benchAppend() {
+    static const int sizesMB[] = { 1, 8, 32 };
+
+    LOG_EMPTY("append: chunks of %dB, a read every %d appends\n", APPEND_CHUNK, APPEND_READ_EVERY);
+    LOG_EMPTY("%10s %12s %10s %12s %12s\n", "size (MB)", "appends", "seconds", "MB/s", "ns/append");
+    for (int c = 0; c < 3; ++c) {
+        // vars
+        NotifyChannel_t lockChannel;
+        struct timespec start, end;
+        char chunk[APPEND_CHUNK];
+        char name[] = "/bench/log";
+        memset(chunk, 'x', APPEND_CHUNK);
+
+        FSConfig_t configs = {
+            .tableSize           = 16,
+            .maxFileCapacitySlot = 16,
+            .maxFileCapacityMB   = 2 * sizesMB[c],
+            .numShards           = 1,
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        FSFile_t* outFiles = NULL;
+        int outFilesCount  = 0;
+        fs_insert(1, makeFile(name, 0), 0, 0, &outFiles, &outFilesCount);
+        free(outFiles);
+
+        // Grow
+        int appends = sizesMB[c] * 1024 * 1024 / APPEND_CHUNK;
+        FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = APPEND_CHUNK, .content = NULL, .data = chunk };
+        FSFile_t reading = { .name = NULL, .content = NULL };
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < appends; ++i) {
+            fs_append(1, file, &outFiles, &outFilesCount);
+            free(outFiles);
+            if (i % APPEND_READ_EVERY == 0) {
+                releaseContent(reading.content);
+                free((char*) reading.name);
+                fs_obtain(1, file, &reading);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        releaseContent(reading.content);
+        free((char*) reading.name);
+
+        double sec = elapsedSec(start, end);
+        LOG_EMPTY("%10d %12d %10.3f %12.1f %12.0f\n", sizesMB[c], appends, sec, sizesMB[c] / sec, sec * 1e9 / appends);
+
+        stopFileSystem(&lockChannel);
+    }
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Fill the file system with empty files and time fs_obtain_n picking SAMPLE_N random
+ * files (every shard is locked meanwhile, so this is how long other requests wait).
+ */
+int benchSample() {
+    static const int counts[] = { 1000, 10000, 100000, 1000000 };
+
+    LOG_EMPTY("sample: %d random files out of N empty ones, %d calls\n", SAMPLE_N, SAMPLE_CALLS);
+    LOG_EMPTY("%10s %12s\n", "files", "us/call");
+    for (int c = 0; c < 4; ++c) {
+        // vars
+        NotifyChannel_t lockChannel;
+        struct timespec start, end;
+        char name[64];
+
+        FSConfig_t configs = {
+            .tableSize           = counts[c],
+            .maxFileCapacitySlot = counts[c],
+            .maxFileCapacityMB   = 1024,
+            .numShards           = 16,
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        // Fill
+        for (int i = 0; i < counts[c]; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            snprintf(name, sizeof(name), "/bench/file-%d", i);
+            fs_insert(1, makeFile(name, 0), 0, 0, &outFiles, &outFilesCount);
+            free(outFiles);
+        }
+
+        // Sample
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < SAMPLE_CALLS; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            fs_obtain_n(1, SAMPLE_N, &outFiles, &outFilesCount);
+            for (int j = 0; j < outFilesCount; ++j) {
+                releaseContent(outFiles[j].content);
+                free((char*) outFiles[j].name);
+            }
+            free(outFiles);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        LOG_EMPTY("%10d %12.2f\n", counts[c], elapsedSec(start, end) * 1e6 / SAMPLE_CALLS);
+
+        stopFileSystem(&lockChannel);
+    }
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * One shard, a big file inserted, replaced, doubled and removed RECLAIM_ROUNDS times
+ * (contents are created before calling the file system, all different so none is shared).
+ * Reports how long the shard lock was held exclusive: other requests on the shard wait that long.
+ */
+int benchReclaim() {
+    static const int sizesMB[] = { 1, 8, 32 };
+
+    LOG_EMPTY("reclaim: %d rounds of insert + modify + append + remove of a big file\n", RECLAIM_ROUNDS);
+    LOG_EMPTY("%10s %12s %14s %14s\n", "size (MB)", "lock held", "avg held (us)", "max held (us)");
+    for (int c = 0; c < 3; ++c) {
+        // vars
+        NotifyChannel_t lockChannel;
+        char name[] = "/bench/big";
+        FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+
+        // Appended bytes (as big as the file)
+        char* chunk = (char*) mem_malloc(sizesMB[c] * 1024 * 1024 * sizeof(char));
+        memset(chunk, 'z', sizesMB[c] * 1024 * 1024);
+        FSFile_t tail = { .nameLen = file.nameLen, .name = name, .contentLen = sizesMB[c] * 1024 * 1024, .content = NULL, .data = chunk };
+
+        FSConfig_t configs = {
+            .tableSize           = 16,
+            .maxFileCapacitySlot = 16,
+            .maxFileCapacityMB   = 4 * sizesMB[c],
+            .numShards           = 1,
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        for (int i = 0; i < RECLAIM_ROUNDS; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            FSFile_t first  = makeFilledFile(name, sizesMB[c] * 1024 * 1024, 'a' + (2 * i) % 26);
+            FSFile_t second = makeFilledFile(name, sizesMB[c] * 1024 * 1024, 'a' + (2 * i + 1) % 26);
+            fs_insert(1, first, 1, 0, &outFiles, &outFilesCount);
+            free(outFiles);
+            fs_modify(1, second, &outFiles, &outFilesCount);
+            free(outFiles);
+            fs_append(1, tail, &outFiles, &outFilesCount);
+            free(outFiles);
+            fs_remove(1, file);
+        }
+
+        FSInfo_t info = fs_get_infos();
+        LOG_EMPTY("%10d %12lld %14.2f %14.2f\n", sizesMB[c], info.lockHoldCount, info.lockHoldAvgUs, info.lockHoldMaxUs);
+
+        stopFileSystem(&lockChannel);
+        free(chunk);
+    }
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * A big file read and written RANGE_SIZE bytes at a time (random offsets), either
+ * moving the whole file (obtain + copy, new content + modify) or only the range.
+ * Copies made to build a response (or a request content) are included.
+ */
+int benchRange() {
+    // vars
+    NotifyChannel_t lockChannel;
+    struct timespec start, end;
+    char name[] = "/bench/range";
+    size_t fileLen = RANGE_FILE_MB * 1024 * 1024;
+    unsigned int seed = 7;
+    FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+
+    FSConfig_t configs = {
+        .tableSize           = 16,
+        .maxFileCapacitySlot = 16,
+        .maxFileCapacityMB   = 4 * RANGE_FILE_MB,
+        .numShards           = 1,
+    };
+    initNotifyChannel(&lockChannel, 256);
+    initializeFileSystem(configs, &lockChannel);
+
+    FSFile_t* outFiles = NULL;
+    int outFilesCount  = 0;
+    fs_insert(1, makeFile(name, fileLen), 1, 0, &outFiles, &outFilesCount);
+    free(outFiles);
+
+    char* buffer = (char*) mem_malloc(fileLen * sizeof(char));
+    char range[RANGE_SIZE];
+    memset(range, 'r', RANGE_SIZE);
+    double us[4];
+
+    LOG_EMPTY("range: %d calls on a %dMB file, %d bytes each\n", RANGE_CALLS, RANGE_FILE_MB, RANGE_SIZE);
+    LOG_EMPTY("%14s %12s\n", "operation", "us/call");
+
+    // Read whole file
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < RANGE_CALLS; ++i) {
+        FSFile_t outFile;
+        fs_obtain(1, file, &outFile);
+        copyContent(outFile.content, outFile.contentLen, buffer);
+        releaseContent(outFile.content);
+        free((char*) outFile.name);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    us[0] = elapsedSec(start, end) * 1e6 / RANGE_CALLS;
+
+    // Read range
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < RANGE_CALLS; ++i) {
+        FSFile_t outFile;
+        fs_read_range(1, file, rand_r(&seed) % (fileLen - RANGE_SIZE), RANGE_SIZE, &outFile);
+        copyContent(outFile.content, outFile.contentLen, buffer);
+        releaseContent(outFile.content);
+        free((char*) outFile.name);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    us[1] = elapsedSec(start, end) * 1e6 / RANGE_CALLS;
+
+    // Write whole file
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < RANGE_CALLS; ++i) {
+        size_t offset = rand_r(&seed) % (fileLen - RANGE_SIZE);
+        memcpy(buffer + offset, range, RANGE_SIZE);
+        FSFile_t whole = makeFilledFile(name, 0, 'x');
+        whole.content    = createContent(buffer, fileLen);
+        whole.contentLen = fileLen;
+        fs_modify(1, whole, &outFiles, &outFilesCount);
+        free(outFiles);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    us[2] = elapsedSec(start, end) * 1e6 / RANGE_CALLS;
+
+    // Write range
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < RANGE_CALLS; ++i) {
+        FSFile_t bytes = { .nameLen = file.nameLen, .name = name, .contentLen = RANGE_SIZE, .content = NULL, .data = range };
+        fs_write_range(1, bytes, rand_r(&seed) % (fileLen - RANGE_SIZE), &outFiles, &outFilesCount);
+        free(outFiles);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    us[3] = elapsedSec(start, end) * 1e6 / RANGE_CALLS;
+
+    LOG_EMPTY("%14s %12.2f\n", "read file", us[0]);
+    LOG_EMPTY("%14s %12.2f\n", "read range", us[1]);
+    LOG_EMPTY("%14s %12.2f\n", "write file", us[2]);
+    LOG_EMPTY("%14s %12.2f\n", "write range", us[3]);
+
+    free(buffer);
+    stopFileSystem(&lockChannel);
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * N files spread over LIST_DIRS directories, the files of one directory enumerated
+ * LIST_CALLS times: listed by prefix (pages of FS_LIST_MAX names) or taken all
+ * with fs_obtain_n and filtered by name (the only way without an index).
+ */
+int benchList() {
+    static const int counts[] = { 10000, 100000 };
+
+    LOG_EMPTY("list: files of 1 directory out of %d, %d calls\n", LIST_DIRS, LIST_CALLS);
+    LOG_EMPTY("%10s %12s %14s %14s\n", "files", "insert us", "list us/call", "obtain us/call");
+    for (int c = 0; c < 2; ++c) {
+        // vars
+        NotifyChannel_t lockChannel;
+        struct timespec start, end;
+        char name[64];
+        const char prefix[] = "/bench/dir-42/";
+        int listed = 0, filtered = 0;
+        double us[3];
+
+        FSConfig_t configs = {
+            .tableSize           = counts[c],
+            .maxFileCapacitySlot = counts[c],
+            .maxFileCapacityMB   = 1024,
+            .numShards           = 16,
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        // Fill
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < counts[c]; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            snprintf(name, sizeof(name), "/bench/dir-%d/file-%d", i % LIST_DIRS, i);
+            fs_insert(1, makeFile(name, FILE_SIZE), 0, 0, &outFiles, &outFilesCount);
+            free(outFiles);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        us[0] = elapsedSec(start, end) * 1e6 / counts[c];
+
+        // List by prefix
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < LIST_CALLS; ++i) {
+            char after[64] = "";
+            int more = 1;
+            listed = 0;
+            while (more) {
+                FSFile_t* outFiles = NULL;
+                int outFilesCount  = 0;
+                fs_list(1, prefix, strlen(prefix), (listed == 0) ? NULL : after, strlen(after) + 1, 0, &outFiles, &outFilesCount, &more);
+                if (outFilesCount > 0) strcpy(after, outFiles[outFilesCount - 1].name);
+                for (int j = 0; j < outFilesCount; ++j) free((char*) outFiles[j].name);
+                free(outFiles);
+                listed += outFilesCount;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        us[1] = elapsedSec(start, end) * 1e6 / LIST_CALLS;
+
+        // Obtain every file, keep the ones inside the directory
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < LIST_CALLS; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            fs_obtain_n(1, 0, &outFiles, &outFilesCount);
+            filtered = 0;
+            for (int j = 0; j < outFilesCount; ++j) {
+                if (strncmp(outFiles[j].name, prefix, strlen(prefix)) == 0) ++filtered;
+                releaseContent(outFiles[j].content);
+                free((char*) outFiles[j].name);
+            }
+            free(outFiles);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        us[2] = elapsedSec(start, end) * 1e6 / LIST_CALLS;
+
+        if (listed != filtered) LOG_EMPTY("listed %d files, expected %d\n", listed, filtered);
+        LOG_EMPTY("%10d %12.2f %14.2f %14.2f\n", counts[c], us[0], us[1], us[2]);
+
+        stopFileSystem(&lockChannel);
+    }
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Single client writing a temporary file every TTL_ROUND_US (never read again) and
+ * reading TTL_READS files with a zipfian popularity (inserting them on miss).
+ * Temporary files kept until ejected take the room of the files read, with a TTL
+ * they are removed in background once it elapses.
+ */
+int benchTtl() {
+    static const long ttls[] = { 0, TTL_MS };
+    const int keys = 2 * CACHE_SLOTS;
+
+    // Zipf cumulative distribution
+    double* cdf = (double*) mem_malloc(keys * sizeof(double));
+    double sum  = 0;
+    for (int i = 0; i < keys; ++i) cdf[i] = (sum += 1.0 / pow(i + 1, ZIPF_ALPHA));
+    for (int i = 0; i < keys; ++i) cdf[i] /= sum;
+
+    LOG_EMPTY("ttl: %d slots, %d keys (zipf %.2f), %d rounds of 1 temporary write + %d reads every %dus\n",
+        CACHE_SLOTS, keys, ZIPF_ALPHA, TTL_ROUNDS, TTL_READS, TTL_ROUND_US);
+    LOG_EMPTY("%10s %10s %12s %10s %10s\n", "ttl (ms)", "hit ratio", "cap. misses", "expired", "seconds");
+    for (int t = 0; t < 2; ++t) {
+        // vars
+        NotifyChannel_t lockChannel;
+        struct timespec start, end;
+        struct timespec pause = { .tv_sec = 0, .tv_nsec = TTL_ROUND_US * 1000L };
+        unsigned int seed = 7919;
+        long long hits = 0, reads = 0;
+        char name[64];
+
+        FSConfig_t configs = {
+            .tableSize           = CACHE_SLOTS,
+            .maxFileCapacitySlot = CACHE_SLOTS,
+            .maxFileCapacityMB   = 64,
+            .numShards           = 4,
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < TTL_ROUNDS; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+
+            // Temporary file
+            snprintf(name, sizeof(name), "/bench/tmp-%d", i);
+            fs_insert(1, makeFile(name, FILE_SIZE), 0, ttls[t], &outFiles, &outFilesCount);
+            for (int k = 0; k < outFilesCount; ++k) {
+                releaseContent(outFiles[k].content);
+                free((char*) outFiles[k].name);
+            }
+            free(outFiles);
+
+            // Read, insert on miss
+            for (int j = 0; j < TTL_READS; ++j, ++reads) {
+                double u = (double) rand_r(&seed) / RAND_MAX;
+                int lo = 0, hi = keys - 1;
+                while (lo < hi) {
+                    int mid = (lo + hi) / 2;
+                    if (cdf[mid] < u) lo = mid + 1;
+                    else hi = mid;
+                }
+                snprintf(name, sizeof(name), "/bench/file-%d", lo);
+
+                FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+                FSFile_t outFile;
+                if (fs_obtain(1, file, &outFile) == 0) {
+                    releaseContent(outFile.content);
+                    free((char*) outFile.name);
+                    hits++;
+                } else {
+                    outFiles      = NULL;
+                    outFilesCount = 0;
+                    fs_insert(1, makeFile(name, FILE_SIZE), 0, 0, &outFiles, &outFilesCount);
+                    for (int k = 0; k < outFilesCount; ++k) {
+                        releaseContent(outFiles[k].content);
+                        free((char*) outFiles[k].name);
+                    }
+                    free(outFiles);
+                }
+            }
+            nanosleep(&pause, NULL);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        FSInfo_t info = fs_get_infos();
+        LOG_EMPTY("%10ld %9.2f%% %12d %10d %10.3f\n", ttls[t], 100.0 * hits / reads, info.capacityMissCount, info.expiredCount, elapsedSec(start, end));
+
+        stopFileSystem(&lockChannel);
+    }
+    free(cdf);
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================================
+
+/*
+ * Random lookups over HUGE_FILES small files (the hashmap buckets alone span some MB),
+ * copies of random big files and creations of big contents (each one replacing a file),
+ * with the blocks backed by 4KB pages or huge pages.
+ */
+int benchHugePages() {
+    static const int modes[] = { HUGE_PAGES_NONE, HUGE_PAGES_TRANSPARENT, HUGE_PAGES_EXPLICIT };
+    const int bigLen = HUGE_BIG_MB * 1024 * 1024;
+
+    // Names looked up (built once, out of the measures)
+    char (*names)[32] = mem_malloc(HUGE_FILES * sizeof(*names));
+    for (int i = 0; i < HUGE_FILES; ++i) snprintf(names[i], sizeof(names[i]), "/bench/file-%d", i);
+    char* buffer = (char*) mem_malloc(bigLen * sizeof(char));
+    memset(buffer, 'x', bigLen);
+
+    LOG_EMPTY("huge pages: %d lookups over %d files, %d copies and creations of %dMB files (%d files)\n",
+        HUGE_LOOKUPS, HUGE_FILES, HUGE_COPIES, HUGE_BIG_MB, HUGE_BIG_FILES);
+    LOG_EMPTY("%12s %12s %12s %14s %32s\n", "pages", "lookup (ns)", "copy (GB/s)", "create (GB/s)", "blocks (expl/transp/4KB/reused)");
+    for (int m = 0; m < 3; ++m) {
+        // vars
+        NotifyChannel_t lockChannel;
+        struct timespec start, end;
+        unsigned int seed = 7919;
+        double sec[3];
+        char name[64];
+
+        FSConfig_t configs = {
+            .tableSize           = (size_t) HUGE_FILES * 2,
+            .maxFileCapacitySlot = HUGE_FILES + HUGE_BIG_FILES,
+            .maxFileCapacityMB   = 512,
+            .numShards           = 1,
+            .hugePages           = modes[m],
+        };
+        initNotifyChannel(&lockChannel, 256);
+        initializeFileSystem(configs, &lockChannel);
+
+        // Fill (big files with different bytes, so that they are not shared)
+        for (int i = 0; i < HUGE_FILES + HUGE_BIG_FILES; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            snprintf(name, sizeof(name), "/bench/big-%d", i - HUGE_FILES);
+            FSFile_t file = (i < HUGE_FILES) ? makeFile(names[i], FILE_SIZE) : makeFilledFile(name, bigLen, 'a' + i - HUGE_FILES);
+            fs_insert(1, file, 0, 0, &outFiles, &outFilesCount);
+            free(outFiles);
+        }
+
+        // Lookups
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < HUGE_LOOKUPS; ++i) {
+            const char* key = names[rand_r(&seed) % HUGE_FILES];
+            FSFile_t file   = { .nameLen = strlen(key) + 1, .name = key, .contentLen = 0, .content = NULL };
+            fs_exists(1, file);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sec[0] = elapsedSec(start, end);
+
+        // Copies
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < HUGE_COPIES; ++i) {
+            snprintf(name, sizeof(name), "/bench/big-%d", rand_r(&seed) % HUGE_BIG_FILES);
+            FSFile_t file = { .nameLen = strlen(name) + 1, .name = name, .contentLen = 0, .content = NULL };
+            FSFile_t outFile;
+            if (fs_obtain(1, file, &outFile) == 0) {
+                copyContent(outFile.content, outFile.contentLen, buffer);
+                releaseContent(outFile.content);
+                free((char*) outFile.name);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sec[1] = elapsedSec(start, end);
+
+        // Creations (the replaced content is released)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < HUGE_COPIES; ++i) {
+            FSFile_t* outFiles = NULL;
+            int outFilesCount  = 0;
+            memcpy(buffer, &i, sizeof(int));
+            snprintf(name, sizeof(name), "/bench/big-%d", rand_r(&seed) % HUGE_BIG_FILES);
+            FSFile_t whole   = makeFilledFile(name, 0, 'x');
+            whole.content    = createContent(buffer, bigLen);
+            whole.contentLen = bigLen;
+            fs_modify(1, whole, &outFiles, &outFilesCount);
+            free(outFiles);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sec[2] = elapsedSec(start, end);
+
+        HugePagesInfo_t info = hugePagesInfo();
+        double gb = (double) HUGE_COPIES * bigLen / (1024.0 * 1024.0 * 1024.0);
+        LOG_EMPTY("%12s %12.1f %12.2f %14.2f %10lld / %5lld / %5lld / %5lld\n", hugePagesName(modes[m]), sec[0] * 1e9 / HUGE_LOOKUPS,
+            gb / sec[1], gb / sec[2], info.explicitCount, info.transparentCount, info.plainCount, info.reusedCount);
+
+        stopFileSystem(&lockChannel);
+    }
+    free(buffer);
+    free(names);
+    return EXIT_SUCCESS;
+}
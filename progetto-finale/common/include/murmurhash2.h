@@ -6,10 +6,14 @@
 #define DEFAULT_MM2_HASH_SEED 0
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 typedef unsigned int HashValue;
 static_assert(sizeof(int) == 4, "Must be 4 bytes");
 
+typedef uint64_t HashValue64;
+
 // code based on
 // https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp
 
@@ -47,4 +51,44 @@ static inline HashValue hash_string(const char * string, int len)
     return h;
 }
 
+// 64-bit hash for 64-bit platforms (MurmurHash64A)
+static inline HashValue64 hash_string_64(const char * string, int len)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = DEFAULT_MM2_HASH_SEED ^ (len * m);
+
+    while(len >= 8) {
+        uint64_t k;
+        memcpy(&k, string, sizeof(k));
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+
+        string += 8;
+        len -= 8;
+    }
+
+    switch(len) {
+        case 7: h ^= (uint64_t) (unsigned char) string[6] << 48;
+        case 6: h ^= (uint64_t) (unsigned char) string[5] << 40;
+        case 5: h ^= (uint64_t) (unsigned char) string[4] << 32;
+        case 4: h ^= (uint64_t) (unsigned char) string[3] << 24;
+        case 3: h ^= (uint64_t) (unsigned char) string[2] << 16;
+        case 2: h ^= (uint64_t) (unsigned char) string[1] << 8;
+        case 1: h ^= (uint64_t) (unsigned char) string[0];
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
 #endif // MURMUR_HASH_2_H
@@ -5,12 +5,17 @@
 
 #include "uuid.h"
 #include <stdlib.h>
+#include <sys/uio.h>
 
 #define DEFAULT_SOCK_FILE "../cs_sock"
 
 #define FLAG_EMPTY  0x00 // Empty
 #define FLAG_CREATE 0x01 // Request creation
 #define FLAG_LOCK   0x02 // Request lock
+#define FLAG_TTL    0x04 // Request expiry (with FLAG_CREATE, the TTL follows the file)
+#define FLAG_DEFER  0x08 // Files ejected by a write are queued to the session (read with MSG_REQ_READ_EJECTED)
+#define FLAG_TIMEOUT 0x10 // Request lock acquisition timeout (lock requests, open included without FLAG_CREATE)
+#define FLAG_LOCK_SHARED 0x20 // Request a shared lock (lock requests, open with FLAG_LOCK and without FLAG_CREATE)
 
 /**
  * To be able to send ptr's via socket, they needs to be converted
@@ -32,8 +37,13 @@ typedef enum {
     MSG_REQ_READ_N_FILES   =  9, // Request to read n files
     MSG_REQ_WRITE_FILE     = 10, // Request to write file
     MSG_REQ_APPEND_TO_FILE = 11, // Request to append to file
+    MSG_REQ_READ_RANGE     = 12, // Request to read bytes of a file
+    MSG_REQ_WRITE_RANGE    = 13, // Request to write bytes of a file
+    MSG_REQ_LIST           = 14, // Request to list files by name prefix
+    MSG_REQ_READ_EJECTED   = 15, // Request to read the files ejected by deferred writes
     MSG_RESP_SIMPLE        = 20, // Basic response
     MSG_RESP_WITH_FILES    = 21, // Response with files attached
+    MSG_RESP_LIST          = 22, // Response with names and sizes (no content)
 } SockMessageType_t;
 
 // Message's response status type
@@ -44,6 +54,7 @@ typedef enum {
     RESP_STATUS_NOT_PERMITTED = 3, // Failure: EPERM
     RESP_STATUS_INVALID_ARG   = 4, // Failure: EINVAL
     RESP_STATUS_NOT_FOUND     = 5, // Failure: ENOENT
+    RESP_STATUS_TIMED_OUT     = 6, // Failure: ETIMEDOUT
 } RespStatus_t;
 
 /**
@@ -59,9 +70,11 @@ typedef struct {
 } ResourcePath_t;
 
 typedef struct {
-    ResourcePath_t filename; // Filename
-    size_t contentLen;       // Length of content
-    MsgPtr_t content;        // Content
+    ResourcePath_t filename;      // Filename
+    size_t contentLen;            // Length of content
+    MsgPtr_t content;             // Content
+    const struct iovec* segments; // Content split in segments, used in place of 'content' when not NULL (write only)
+    int numSegments;              // Segments count
 } MsgFile_t;
 
 /**
@@ -99,10 +112,13 @@ typedef struct {
             RespStatus_t status; // Status
             int numFiles;        // Attached files count
             MsgFile_t *files;    // Files
+            int more;            // Other files follow the last one (list response only)
         } response;              // Response data
         struct {
             int flags;           // Flags
             MsgFile_t file;      // File
+            size_t offset;       // First byte (range requests only)
+            size_t length;       // Bytes count (read range only, written bytes are the content), files count (list only), TTL in ms (FLAG_TTL only), lock timeout in ms (FLAG_TIMEOUT only)
         } request;               // Request data
     };
     char* raw_content;           // Raw bytes
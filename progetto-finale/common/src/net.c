@@ -94,6 +94,7 @@ size_t readMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
         }
 
         case MSG_REQ_READ_N_FILES:
+        case MSG_REQ_READ_EJECTED:
         {
             // Flags
             readFromBuffer(&buffer, &msg->request.flags, sizeof(int));
@@ -108,6 +109,9 @@ size_t readMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
         case MSG_REQ_REMOVE_FILE:
         case MSG_REQ_WRITE_FILE:
         case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
+        case MSG_REQ_LIST:
         {
             // Flags
             readFromBuffer(&buffer, &msg->request.flags, sizeof(int));
@@ -118,7 +122,17 @@ size_t readMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
             readFromBuffer(&buffer, &file.filename.abs.i, sizeof(size_t));
             readFromBuffer(&buffer, &file.contentLen    , sizeof(size_t));
             readFromBuffer(&buffer, &file.content.i     , sizeof(size_t));
+            file.segments    = NULL;
+            file.numSegments = 0;
             msg->request.file = file;
+
+            // Range (TTL or lock timeout of requests in length)
+            msg->request.offset = 0;
+            msg->request.length = 0;
+            if (msg->type == MSG_REQ_READ_RANGE || msg->type == MSG_REQ_WRITE_RANGE || msg->type == MSG_REQ_LIST || (msg->request.flags & (FLAG_TTL | FLAG_TIMEOUT))) {
+                readFromBuffer(&buffer, &msg->request.offset, sizeof(size_t));
+                readFromBuffer(&buffer, &msg->request.length, sizeof(size_t));
+            }
             break;
         }
 
@@ -153,6 +167,30 @@ size_t readMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
             break;
         }
 
+        case MSG_RESP_LIST:
+        {
+            // Status
+            readFromBuffer(&buffer, &msg->response.status, sizeof(RespStatus_t));
+
+            // Num files, more
+            readFromBuffer(&buffer, &msg->response.numFiles, sizeof(int));
+            readFromBuffer(&buffer, &msg->response.more, sizeof(int));
+
+            // Files (names only, sizes in place of contents)
+            const int numFiles = msg->response.numFiles;
+            MsgFile_t* files = NULL;
+            if (numFiles > 0) {
+                files = (MsgFile_t*) mem_calloc(numFiles, sizeof(MsgFile_t));
+                for (int i = 0; i < numFiles; ++i) {
+                    readFromBuffer(&buffer, &files[i].filename.len  , sizeof(size_t));
+                    readFromBuffer(&buffer, &files[i].filename.abs.i, sizeof(size_t));
+                    readFromBuffer(&buffer, &files[i].contentLen    , sizeof(size_t));
+                }
+            }
+            msg->response.files = files;
+            break;
+        }
+
         default:
             break;
     }
@@ -188,6 +226,9 @@ size_t readMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
         case MSG_REQ_REMOVE_FILE:
         case MSG_REQ_WRITE_FILE:
         case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
+        case MSG_REQ_LIST:
         {
             convertOffsetToPtr(msg->raw_content, &msg->request.file.filename.abs, msg->request.file.filename.len);
             convertOffsetToPtr(msg->raw_content, &msg->request.file.content, msg->request.file.contentLen);
@@ -202,10 +243,20 @@ size_t readMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
             }
             break;
         }
+
+        case MSG_RESP_LIST:
+        {
+            for (int i = 0; i < msg->response.numFiles; ++i) {
+                convertOffsetToPtr(msg->raw_content, &msg->response.files[i].filename.abs, msg->response.files[i].filename.len);
+                msg->response.files[i].content.ptr = NULL;
+            }
+            break;
+        }
     
         case MSG_REQ_OPEN_SESSION:
         case MSG_REQ_CLOSE_SESSION:
         case MSG_REQ_READ_N_FILES:
+        case MSG_REQ_READ_EJECTED:
         case MSG_RESP_SIMPLE:
         default:
             break;
@@ -265,6 +316,7 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
         }
 
         case MSG_REQ_READ_N_FILES:
+        case MSG_REQ_READ_EJECTED:
         {
             // Flags
             writeToBuffer(&buffer, &msg->request.flags, sizeof(int));
@@ -279,6 +331,9 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
         case MSG_REQ_REMOVE_FILE:
         case MSG_REQ_WRITE_FILE:
         case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
+        case MSG_REQ_LIST:
         {
             // Flags
             writeToBuffer(&buffer, &msg->request.flags, sizeof(int));
@@ -291,6 +346,12 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
             writeToBuffer(&buffer, &file.contentLen  , sizeof(size_t)); // Content length
             writeToBuffer(&buffer, &rawBufferIndex   , sizeof(size_t)); // Content ptr offset
             rawBufferIndex += file.contentLen;
+
+            // Range (TTL or lock timeout of requests in length)
+            if (msg->type == MSG_REQ_READ_RANGE || msg->type == MSG_REQ_WRITE_RANGE || msg->type == MSG_REQ_LIST || (msg->request.flags & (FLAG_TTL | FLAG_TIMEOUT))) {
+                writeToBuffer(&buffer, &msg->request.offset, sizeof(size_t));
+                writeToBuffer(&buffer, &msg->request.length, sizeof(size_t));
+            }
             break;
         }
 
@@ -323,6 +384,26 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
             break;
         }
 
+        case MSG_RESP_LIST:
+        {
+            // Status
+            writeToBuffer(&buffer, &msg->response.status, sizeof(RespStatus_t));
+
+            // Num files, more
+            writeToBuffer(&buffer, &msg->response.numFiles, sizeof(int));
+            writeToBuffer(&buffer, &msg->response.more, sizeof(int));
+
+            // Files (names only, sizes in place of contents)
+            MsgFile_t* files = msg->response.files;
+            for (int i = 0; i < msg->response.numFiles; ++i) {
+                writeToBuffer(&buffer, &files[i].filename.len, sizeof(size_t)); // Filename length
+                writeToBuffer(&buffer, &rawBufferIndex       , sizeof(size_t)); // Filename ptr offset of abs path
+                rawBufferIndex += files[i].filename.len;
+                writeToBuffer(&buffer, &files[i].contentLen  , sizeof(size_t)); // File size
+            }
+            break;
+        }
+
         default:
             break;
     }
@@ -347,6 +428,9 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
         case MSG_REQ_REMOVE_FILE:
         case MSG_REQ_WRITE_FILE:
         case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
+        case MSG_REQ_LIST:
         {
             MsgFile_t file = msg->request.file;
             writeToBuffer(&rawbuffer, file.filename.abs.ptr, file.filename.len * sizeof(char)); // Filename path
@@ -359,14 +443,28 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
             MsgFile_t* files = msg->response.files;
             for (int i = 0; i < msg->response.numFiles; ++i) {
                 writeToBuffer(&rawbuffer, files[i].filename.abs.ptr, files[i].filename.len * sizeof(char)); // Filename path
-                writeToBuffer(&rawbuffer, files[i].content.ptr     , files[i].contentLen * sizeof(char));   // Content
+                if (files[i].segments == NULL) {
+                    writeToBuffer(&rawbuffer, files[i].content.ptr, files[i].contentLen * sizeof(char));    // Content
+                } else {
+                    for (int j = 0; j < files[i].numSegments; ++j)                                         // Content (scattered)
+                        writeToBuffer(&rawbuffer, files[i].segments[j].iov_base, files[i].segments[j].iov_len);
+                }
             }
             break;
         }
 
+        case MSG_RESP_LIST:
+        {
+            MsgFile_t* files = msg->response.files;
+            for (int i = 0; i < msg->response.numFiles; ++i)
+                writeToBuffer(&rawbuffer, files[i].filename.abs.ptr, files[i].filename.len * sizeof(char)); // Filename path
+            break;
+        }
+
         case MSG_REQ_OPEN_SESSION:
         case MSG_REQ_CLOSE_SESSION:
         case MSG_REQ_READ_N_FILES:
+        case MSG_REQ_READ_EJECTED:
         case MSG_RESP_SIMPLE:
         default:
             break;
@@ -401,7 +499,7 @@ size_t writeMessage(long socketfd, char** buf, size_t* size, SockMessage_t* msg)
 
 void freeMessageContent(SockMessage_t* msg, int deep) {
     // Release memory for allocated array
-    if (msg->type == MSG_RESP_WITH_FILES) {
+    if (msg->type == MSG_RESP_WITH_FILES || msg->type == MSG_RESP_LIST) {
         if (deep) {
             for (int i = 0; i < msg->response.numFiles; ++i) {
                 MsgFile_t file = msg->response.files[i];
@@ -526,6 +624,7 @@ size_t calcMsgSize(SockMessage_t* msg) {
     switch (msg->type)
     {
         case MSG_REQ_READ_N_FILES:
+        case MSG_REQ_READ_EJECTED:
             totalSize += sizeof(int);
             break;
 
@@ -541,6 +640,16 @@ size_t calcMsgSize(SockMessage_t* msg) {
             totalSize += 4 * sizeof(size_t);
             totalSize += msg->request.file.filename.len;
             totalSize += msg->request.file.contentLen;
+            if (msg->request.flags & (FLAG_TTL | FLAG_TIMEOUT)) totalSize += 2 * sizeof(size_t);
+            break;
+
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
+        case MSG_REQ_LIST:
+            totalSize += sizeof(int);
+            totalSize += 6 * sizeof(size_t);
+            totalSize += msg->request.file.filename.len;
+            totalSize += msg->request.file.contentLen;
             break;
 
         case MSG_RESP_SIMPLE:
@@ -557,6 +666,14 @@ size_t calcMsgSize(SockMessage_t* msg) {
             }
             break;
 
+        case MSG_RESP_LIST:
+            totalSize += sizeof(RespStatus_t);
+            totalSize += 2 * sizeof(int);
+            totalSize += msg->response.numFiles * 3 * sizeof(size_t);
+            for (int i = 0; i < msg->response.numFiles; ++i)
+                totalSize += msg->response.files[i].filename.len;
+            break;
+
         case MSG_REQ_OPEN_SESSION:
         case MSG_REQ_CLOSE_SESSION:
         default:
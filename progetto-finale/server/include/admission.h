@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include <common.h>
+
+#include "sketch.h"
+
+/**
+ * Frequency filter deciding if a new file is worth the one it would eject (TinyLFU).
+ * The first occurrence of a key only sets its bits in the doorkeeper (a Bloom
+ * filter), the next ones are counted by a count-min sketch: keys seen once never
+ * reach the sketch, so it is not filled by them.
+ * Every 'sampleSize' records the doorkeeper is cleared (the sketch halves its
+ * counters on its own), so old popularity fades away.
+ * Its thread-safe (atomics only).
+ */
+typedef struct {
+    FreqSketch_t sketch;              // Occurrences after the first one
+    atomic_ullong* doorkeeper;        // Keys seen (bits)
+    size_t doorkeeperWords;           // 64 bits words
+    int doorkeeperBits;               // log2(bits count)
+    atomic_size_t records;            // Records since last clear
+    size_t sampleSize;                // Records before clearing the doorkeeper
+} AdmissionFilter_t;
+
+/**
+ * Initialize an empty filter.
+ * Terminate process on failure.
+ *
+ * \param filter  : the filter itself
+ * \param capacity: expected distinct keys count (files kept)
+ */
+void initAdmissionFilter(AdmissionFilter_t* filter, size_t capacity);
+
+/**
+ * Release filter memory.
+ *
+ * \param filter: the filter itself
+ */
+void destroyAdmissionFilter(AdmissionFilter_t* filter);
+
+/**
+ * Record an access to the key (call it outside any lock: it may clear the
+ * doorkeeper or halve the sketch).
+ *
+ * \param filter: the filter itself
+ * \param hash  : key's hash
+ */
+void admissionRecord(AdmissionFilter_t* filter, HashValue64 hash);
+
+/**
+ * Estimate accesses to the key.
+ *
+ * \param filter: the filter itself
+ * \param hash  : key's hash
+ *
+ * \retval n: the estimate (0 ~> SKETCH_MAX_COUNT + 1)
+ */
+int admissionEstimate(AdmissionFilter_t* filter, HashValue64 hash);
+
+/**
+ * Check if a key should replace another one (ties keep the one already cached).
+ *
+ * \param filter   : the filter itself
+ * \param candidate: hash of the key to admit
+ * \param victim   : hash of the key it would eject
+ *
+ * \retval 1: if the candidate is accessed more often
+ * \retval 0: otherwise
+ */
+int admissionAdmit(AdmissionFilter_t* filter, HashValue64 candidate, HashValue64 victim);
+
+#endif // ADMISSION_H
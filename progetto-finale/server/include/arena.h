@@ -0,0 +1,178 @@
+#pragma once
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Free lists (one for each power of 2 of the extents size)
+#define ARENA_CLASSES 48
+
+// Where a block was (saved by snapshots, checked when attaching it again)
+typedef struct {
+    uint64_t offset; // Extent offset inside the arena file
+    uint64_t stamp;  // Extent stamp (changes on every allocation)
+} ArenaRef_t;
+
+/**
+ * Memory mapped file where blocks are allocated (extents).
+ * Each extent starts with a header (size, state, stamp) and the extents are
+ * contiguous: freeing one merges it with its free neighbours.
+ * Free extents are linked into size classes (links are inside the extents).
+ * Cold pages are written back to the file by the kernel instead of using RAM.
+ *
+ * The file is kept across restarts: extents saved by a snapshot can be attached
+ * again (see arenaReserve), everything else is freed by arenaRebuild.
+ * Allocations are not allowed before arenaRebuild.
+ * Reserved extents are pinned (their bytes are never reused) until arenaUnpin,
+ * to be called when no snapshot refers to them anymore.
+ * Its thread-safe.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    int fd;                             // Arena file
+    char* base;                         // Mapping
+    size_t size;                        // Mapping (and file) size
+    int ready;                          // Allocator rebuilt
+    int sealed;                         // Frees are ignored (extents kept for next startup)
+    uint64_t freeHeads[ARENA_CLASSES];  // Free extents (offsets, 0 if empty)
+    uint64_t freeClasses;               // Bitmap of the non empty classes
+    uint64_t nextStamp;
+    uint64_t* reserved;                 // Extents pinned (sorted by arenaRebuild)
+    size_t reservedCount, reservedCap;
+    uint64_t* released;                 // Extents pinned freed meanwhile
+    size_t releasedCount, releasedCap;
+    size_t extentsUsed, bytesUsed;
+    size_t extentsFree, bytesFree;
+    size_t extentsReserved, bytesReserved;
+} Arena_t;
+
+// Arena state
+typedef struct {
+    size_t size;                          // File size
+    size_t extentsUsed, bytesUsed;        // Allocated (headers included)
+    size_t extentsFree, bytesFree;        // Free
+    size_t extentsReserved, bytesReserved; // Attached again at startup
+} ArenaInfo_t;
+
+/**
+ * Map the arena file (created if missing, grown if smaller than 'size').
+ * Previous extents are kept until arenaRebuild.
+ *
+ * \param arena   : the arena itself
+ * \param filename: arena file path
+ * \param size    : arena size (bytes)
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int initArena(Arena_t* arena, const char* filename, size_t size);
+
+/**
+ * Unmap the arena file. Blocks MUST NOT be used anymore.
+ *
+ * \param arena: the arena itself
+ */
+void destroyArena(Arena_t* arena);
+
+/**
+ * Allocate a block.
+ *
+ * \param arena: the arena itself
+ * \param size : bytes count
+ *
+ * \retval ptr : the block (aligned to max_align_t)
+ * \retval NULL: if there is no free extent big enough (or before arenaRebuild)
+ */
+void* arenaAlloc(Arena_t* arena, size_t size);
+
+/**
+ * Free a block (ignored after arenaSeal).
+ *
+ * \param arena: the arena itself
+ * \param ptr  : the block (MUST be inside the arena)
+ */
+void arenaFree(Arena_t* arena, void* ptr);
+
+/**
+ * Check if a block is inside the arena.
+ *
+ * \param arena: the arena itself (can be NULL)
+ * \param ptr  : the block
+ *
+ * \retval 1: if inside
+ * \retval 0: otherwise
+ */
+int arenaContains(const Arena_t* arena, const void* ptr);
+
+/**
+ * Get the reference to a block.
+ *
+ * \param arena: the arena itself
+ * \param ptr  : the block (MUST be inside the arena)
+ *
+ * \retval struct: the reference
+ */
+ArenaRef_t arenaRef(Arena_t* arena, const void* ptr);
+
+/**
+ * Keep an extent of the previous run (before arenaRebuild).
+ *
+ * \param arena: the arena itself
+ * \param ref  : its reference
+ *
+ * \retval 1: if the extent is still there
+ * \retval 0: otherwise (reused, or another file)
+ */
+int arenaReserve(Arena_t* arena, ArenaRef_t ref);
+
+/**
+ * Get the block of an extent kept by arenaReserve.
+ *
+ * \param arena: the arena itself
+ * \param ref  : its reference
+ * \param size : where to store the block size
+ * \param first: where to store if it is the first time the block is attached
+ *
+ * \retval ptr : the block
+ * \retval NULL: if the extent was not reserved
+ */
+void* arenaAttach(Arena_t* arena, ArenaRef_t ref, size_t* size, int* first);
+
+/**
+ * Free every extent not reserved, then allow allocations.
+ *
+ * \param arena: the arena itself
+ */
+void arenaRebuild(Arena_t* arena);
+
+/**
+ * Unpin the reserved extents (the ones freed meanwhile are freed now).
+ *
+ * \param arena: the arena itself
+ */
+void arenaUnpin(Arena_t* arena);
+
+/**
+ * Stop freeing blocks and write the mapping back to the file
+ * (blocks alive right now can be attached by the next startup).
+ *
+ * \param arena: the arena itself
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int arenaSeal(Arena_t* arena);
+
+/**
+ * Get the arena state.
+ *
+ * \param arena: the arena itself
+ *
+ * \retval struct: the state
+ */
+ArenaInfo_t arenaInfo(Arena_t* arena);
+
+#endif // ARENA_H
@@ -0,0 +1,235 @@
+#pragma once
+
+#ifndef CONTENT_H
+#define CONTENT_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "arena.h"
+
+// Capacity of the segments added by appends (bytes)
+#define CONTENT_SEGMENT_SIZE (64 * 1024)
+
+/**
+ * Reference counted file content, stored as a list of segments (a rope).
+ * The first segment holds the bytes the content was created with, every append
+ * fills the last one and adds CONTENT_SEGMENT_SIZE segments when it is full.
+ * Bytes are never moved: a reader that knows the content length at a given time
+ * (its 'len') keeps seeing exactly those bytes while appends go on.
+ * It MUST be released with releaseContent (never with free).
+ *
+ * A content can be stored compressed (see compressContent): its bytes are decoded
+ * by copyContent / createContentView, and appends make a raw copy of it.
+ *
+ * Contents (and their segments) are allocated inside the arena set by useContentArena,
+ * falling back to the heap when it is full (big ones on huge pages, see useHugePages).
+ */
+typedef struct Content_t Content_t;
+
+/**
+ * Create a content with 1 reference, made by a single segment.
+ * Terminate process on failure.
+ *
+ * \param data: bytes to copy inside (NULL to leave it uninitialized)
+ * \param len : bytes count
+ *
+ * \retval ptr : the content
+ * \retval NULL: if len is 0
+ */
+Content_t* createContent(const char* data, size_t len);
+
+/**
+ * Add a reference to the content.
+ *
+ * \param content: the content (can be NULL)
+ *
+ * \retval ptr: the same content
+ */
+Content_t* acquireContent(Content_t* content);
+
+/**
+ * Remove a reference from the content, releasing it when it was the last one.
+ *
+ * \param content: the content (can be NULL)
+ */
+void releaseContent(Content_t* content);
+
+/**
+ * Check if someone else is holding a reference to the content.
+ *
+ * \param content: the content (can be NULL)
+ *
+ * \retval 1: if refs > 1
+ * \retval 0: otherwise
+ */
+int isContentShared(const Content_t* content);
+
+/**
+ * Compress the content (Huffman coding) if it saves at least 'minSaving' % of its bytes.
+ * Only contents made by a single segment (never appended) are compressed.
+ * The reference passed is moved to the result.
+ * Terminate process on failure.
+ *
+ * \param content  : the content (can be NULL)
+ * \param len      : content length
+ * \param minSaving: 0 ~> 99 (%)
+ *
+ * \retval ptr: the compressed content, or the same one if the saving is too low
+ */
+Content_t* compressContent(Content_t* content, size_t len, int minSaving);
+
+/**
+ * Get the bytes used to store the first 'len' bytes of the content.
+ *
+ * \param content: the content (can be NULL)
+ * \param len    : bytes count
+ *
+ * \retval n: compressed bytes for compressed contents, len otherwise
+ */
+size_t getContentSize(const Content_t* content, size_t len);
+
+/**
+ * Get the stored bytes of a content made by a single segment (never appended).
+ *
+ * \param content: the content (can be NULL)
+ * \param len    : content length
+ * \param size   : where to store the bytes count (compressed bytes for compressed contents)
+ *
+ * \retval ptr : the bytes
+ * \retval NULL: if content is NULL or made by more segments
+ */
+const char* getContentBytes(const Content_t* content, size_t len, size_t* size);
+
+/**
+ * Check if the content is stored compressed.
+ *
+ * \param content: the content (can be NULL)
+ *
+ * \retval 1: if compressed
+ * \retval 0: otherwise
+ */
+int isContentCompressed(const Content_t* content);
+
+/**
+ * Append bytes to a content, writing only inside its last segment(s).
+ * Readers holding a reference keep seeing the first 'len' bytes.
+ * If the content already grew past 'len' (someone else appended to it) a copy is made
+ * and the reference to the old content is passed to the new one.
+ * Terminate process on failure.
+ *
+ * \param content: the content (can be NULL)
+ * \param len    : current content length
+ * \param data   : bytes to append
+ * \param dataLen: bytes to append count
+ *
+ * \retval ptr: the resulting content
+ */
+Content_t* appendToContent(Content_t* content, size_t len, const char* data, size_t dataLen);
+
+/**
+ * Overwrite bytes of a content from 'offset' on (it grows if they go past 'len').
+ * Bytes are written in place only if nobody else holds a reference (and it is not compressed),
+ * otherwise a copy is made and the reference to the old content is passed to the new one.
+ * Terminate process on failure.
+ *
+ * \param content: the content (can be NULL if len is 0)
+ * \param len    : current content length
+ * \param offset : first byte to write (MUST be <= len)
+ * \param data   : bytes to write
+ * \param dataLen: bytes to write count
+ *
+ * \retval ptr: the resulting content
+ */
+Content_t* writeToContent(Content_t* content, size_t len, size_t offset, const char* data, size_t dataLen);
+
+/**
+ * Copy the first 'len' bytes of the content.
+ *
+ * \param content: the content (can be NULL if len is 0)
+ * \param len    : bytes count
+ * \param dst    : where to copy them
+ */
+void copyContent(const Content_t* content, size_t len, char* dst);
+
+/**
+ * Copy 'len' bytes of the content, from 'offset' on.
+ * Compressed contents are decoded entirely.
+ *
+ * \param content: the content (can be NULL if len is 0)
+ * \param offset : first byte to copy
+ * \param len    : bytes count (offset + len MUST be <= content length)
+ * \param dst    : where to copy them
+ */
+void copyContentRange(const Content_t* content, size_t offset, size_t len, char* dst);
+
+/**
+ * Create a view over the first 'len' bytes of the content: one entry for each segment,
+ * ready to be scattered into a message (see MsgFile_t.segments).
+ * The view takes the reference passed with the content.
+ * It MUST be released with releaseContentView.
+ * Terminate process on failure.
+ *
+ * \param content: the content (can be NULL)
+ * \param len    : bytes count
+ * \param count  : where to store the segments count
+ *
+ * \retval ptr : the segments
+ * \retval NULL: if content is NULL or len is 0
+ */
+const struct iovec* createContentView(Content_t* content, size_t len, int* count);
+
+/**
+ * Release the view and its reference to the content.
+ *
+ * \param view: the view (can be NULL)
+ */
+void releaseContentView(const struct iovec* view);
+
+/**
+ * Allocate the following contents inside an arena.
+ * MUST BE called before creating any content (and with no content left when changing it).
+ *
+ * \param arena: the arena (NULL to use the heap)
+ */
+void useContentArena(Arena_t* arena);
+
+/**
+ * Get how many blocks were allocated on the heap because the arena was full.
+ *
+ * \retval n: blocks count
+ */
+long long contentsOutsideArena();
+
+/**
+ * Get the reference of a content made by a single segment inside the arena.
+ *
+ * \param content: the content (can be NULL)
+ * \param ref    : where to store the reference
+ *
+ * \retval 1: if stored
+ * \retval 0: if the content is on the heap or made by more segments
+ */
+int getContentArenaRef(const Content_t* content, ArenaRef_t* ref);
+
+/**
+ * Keep the content of a previous run inside the arena (see arenaReserve).
+ *
+ * \param ref: content reference
+ *
+ * \retval 1: if still there
+ * \retval 0: otherwise
+ */
+int reserveContent(ArenaRef_t ref);
+
+/**
+ * Get a content kept by reserveContent, with 1 more reference.
+ *
+ * \param ref: content reference
+ *
+ * \retval ptr : the content
+ * \retval NULL: if not reserved (or not a content)
+ */
+Content_t* attachContent(ArenaRef_t ref);
+
+#endif // CONTENT_H
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include <common.h>
+
+#include "content.h"
+#include "hash_table.h"
+#include "slab.h"
+
+// Independently locked partitions (by content hash)
+#define DEDUP_STRIPES 16
+
+typedef struct {
+    pthread_mutex_t mutex;
+    HashTable_t table;   // Hashmap (bytes -> entry)
+    int filesCount;      // Files referencing an entry
+    int contentsCount;   // Entries (unique contents)
+    size_t bytesLogical; // Bytes of the files referencing an entry
+    size_t bytesUnique;  // Bytes of the entries
+} DedupStripe_t;
+
+/**
+ * Index of the contents stored by the file system, by their bytes.
+ * Files with identical contents share a single one: each of them holds a reference
+ * to an entry, the entry holds a reference to the content.
+ * Contents are compared on their stored bytes (compressed ones included), the hash
+ * only selects the candidates.
+ * Its thread-safe.
+ */
+typedef struct {
+    DedupStripe_t stripes[DEDUP_STRIPES];
+    Slab_t entries; // Entries pool
+} DedupIndex_t;
+
+// Index state
+typedef struct {
+    int filesCount;      // Files referencing an entry
+    int contentsCount;   // Entries (unique contents)
+    size_t bytesLogical; // Bytes of the files referencing an entry
+    size_t bytesUnique;  // Bytes of the entries
+} DedupInfo_t;
+
+typedef struct DedupEntry_t DedupEntry_t;
+
+/**
+ * Initialize an empty index.
+ * Terminate process on failure.
+ *
+ * \param index   : the index itself
+ * \param capacity: expected contents count
+ */
+void initDedupIndex(DedupIndex_t* index, size_t capacity);
+
+/**
+ * Release every entry (and their references to the contents).
+ *
+ * \param index: the index itself
+ */
+void destroyDedupIndex(DedupIndex_t* index);
+
+/**
+ * Hash a content (call it outside any lock).
+ *
+ * \param content: the content (can be NULL)
+ * \param len    : content length
+ *
+ * \retval hash: the hash
+ */
+HashValue64 dedupHash(const Content_t* content, size_t len);
+
+/**
+ * Add a file to the entry of its content, creating it if missing.
+ * When an equal content is already indexed, the file's one is released and
+ * replaced with it.
+ *
+ * \param index  : the index itself
+ * \param content: IN: file's content (its reference is moved). OUT: content to store
+ * \param len    : content length
+ * \param hash   : content hash (see dedupHash)
+ * \param bytes  : where to store the unique bytes added (content size if new, 0 otherwise)
+ *
+ * \retval ptr : the entry
+ * \retval NULL: if the content cannot be indexed (empty or appended)
+ */
+DedupEntry_t* dedupAcquire(DedupIndex_t* index, Content_t** content, size_t len, HashValue64 hash, long long* bytes);
+
+/**
+ * Remove a file from its entry, releasing it when it was the last one.
+ *
+ * \param index: the index itself
+ * \param entry: the entry (can be NULL)
+ *
+ * \retval bytes: unique bytes removed (content size if released, 0 otherwise) as a negative value
+ */
+long long dedupRelease(DedupIndex_t* index, DedupEntry_t* entry);
+
+/**
+ * Get the index state.
+ *
+ * \param index: the index itself
+ *
+ * \retval struct: the state (summed over the stripes)
+ */
+DedupInfo_t dedupInfo(DedupIndex_t* index);
+
+#endif // DEDUP_H
@@ -0,0 +1,148 @@
+#pragma once
+
+#ifndef EVICTION_H
+#define EVICTION_H
+
+#include <stdatomic.h>
+
+#include <common.h>
+
+// Policies
+#define EVICTION_LRU       0
+#define EVICTION_CLOCK     1
+#define EVICTION_S3FIFO    2
+#define EVICTION_ARC       3
+#define EVICTION_WTINYLFU  4
+#define EVICTION_GDSF      5
+#define EVICTION_POLICIES  6
+
+// Max queues used by a single policy
+#define EVICTION_MAX_QUEUES 3
+
+/**
+ * Node to embed inside the cached items.
+ * Must be filled with the item's hash before insertion, and with its
+ * size before insertion and before every evictionTouch (size-aware policies).
+ */
+typedef struct EvictionNode_t {
+    struct EvictionNode_t* pre; // Older node in the same queue
+    struct EvictionNode_t* nex; // Newer node in the same queue
+    HashValue64 hash;           // Key's hash (used by ghosts and frequency estimates)
+    atomic_int referenced;      // Accessed since policy's last visit
+    atomic_int freq;            // Accesses count (saturating, policy specific)
+    int queue;                  // Queue holding the node (policy specific)
+    size_t size;                // Item's size in bytes
+    double priority;            // GDSF: eviction priority (lowest goes first)
+    int priorityFreq;           // GDSF: 'freq' used to compute 'priority'
+    int index;                  // GDSF: position inside the heap
+} EvictionNode_t;
+
+typedef struct EvictionPolicy_t EvictionPolicy_t;
+
+/**
+ * Create a policy for a cache of 'capacity' items.
+ * Terminate process on failure.
+ *
+ * \param type    : one of EVICTION_*
+ * \param capacity: max items count
+ *
+ * \retval ptr: the policy
+ */
+EvictionPolicy_t* createEvictionPolicy(int type, int capacity);
+
+/**
+ * Release the policy (tracked nodes are NOT released).
+ *
+ * \param policy: the policy itself
+ */
+void destroyEvictionPolicy(EvictionPolicy_t* policy);
+
+/**
+ * Start tracking a new item.
+ * NOT thread-safe.
+ *
+ * \param policy: the policy itself
+ * \param node  : item's node (with hash set)
+ */
+void evictionInsert(EvictionPolicy_t* policy, EvictionNode_t* node);
+
+/**
+ * Record an access that modifies the item.
+ * NOT thread-safe.
+ *
+ * \param policy: the policy itself
+ * \param node  : item's node
+ */
+void evictionTouch(EvictionPolicy_t* policy, EvictionNode_t* node);
+
+/**
+ * Record a read-only access.
+ * Thread-safe: only atomics are used, so it can run while holding a shared lock.
+ *
+ * \param policy: the policy itself
+ * \param node  : item's node
+ */
+void evictionRead(EvictionPolicy_t* policy, EvictionNode_t* node);
+
+/**
+ * Stop tracking an item.
+ * NOT thread-safe.
+ *
+ * \param policy : the policy itself
+ * \param node   : item's node
+ * \param evicted: 1 if item is being evicted (policy may remember it), 0 if removed
+ */
+void evictionRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted);
+
+/**
+ * Choose the item to evict. Tracking of it does NOT stop (see evictionRemove).
+ * NOT thread-safe.
+ *
+ * \param policy : the policy itself
+ * \param protect: item that cannot be chosen (can be NULL)
+ *
+ * \retval ptr : victim's node
+ * \retval NULL: if no item can be evicted
+ */
+EvictionNode_t* evictionVictim(EvictionPolicy_t* policy, EvictionNode_t* protect);
+
+/**
+ * Get evictions count of each queue.
+ *
+ * \param policy: the policy itself
+ * \param counts: where to add the counts (EVICTION_MAX_QUEUES items)
+ *
+ * \retval n: queues count
+ */
+int evictionStats(EvictionPolicy_t* policy, long long* counts);
+
+/**
+ * Get the name of a policy.
+ *
+ * \param type: one of EVICTION_*
+ *
+ * \retval str: the name (as accepted by parseEvictionPolicy)
+ */
+const char* evictionPolicyName(int type);
+
+/**
+ * Get the name of a policy's queue.
+ *
+ * \param type : one of EVICTION_*
+ * \param queue: queue index
+ *
+ * \retval str: the name
+ */
+const char* evictionQueueName(int type, int queue);
+
+/**
+ * Parse a policy name.
+ *
+ * \param str: policy name (LRU, CLOCK, S3-FIFO, ARC, W-TINYLFU, GDSF)
+ *
+ * \retval type: one of EVICTION_*
+ * \retval -1  : if unknown
+ */
+int parseEvictionPolicy(const char* str);
+
+#endif // EVICTION_H
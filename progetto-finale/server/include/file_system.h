@@ -8,25 +8,56 @@
 #define FS_CLIENT_NOT_ALLOWED     103
 #define FS_CLIENT_WAITING_ON_LOCK 104
 #define FS_FILE_TOO_BIG           105
+#define FS_INVALID_RANGE          106
+#define FS_LOCK_TIMED_OUT         107
+
+// Files listed at most by a single fs_list call
+#define FS_LIST_MAX 1024
+
+// Contents compression at rest
+#define FS_COMPRESSION_NONE    0
+#define FS_COMPRESSION_HUFFMAN 1
+
+// Admission of new files when the cache is full
+#define FS_ADMISSION_ALWAYS  0
+#define FS_ADMISSION_TINYLFU 1
 
 #include <pthread.h>
 
-#include "circ_queue.h"
+#include "content.h"
+#include "notify_channel.h"
 #include "session.h"
 
-// To communicate file's data, in/out from the "file_system"
+// To communicate file's data, in/out from the "file_system".
+// Contents passed to fs_insert / fs_modify MUST be created with createContent (identical ones are shared).
+// Contents returned (obtained or ejected files) are shared: release them with releaseContent.
+// Bytes passed to fs_append / fs_write_range are raw ('data'), they are copied into the stored content.
 typedef struct {
     size_t nameLen;
     const char* name;
     size_t contentLen;
-    const char* content;
+    Content_t* content;
+    const char* data;
 } FSFile_t;
 
 // Configs to pass at initialization
 typedef struct {
-    size_t tableSize;           // 2^8 (very small) -> 2^30 (very big)
+    size_t tableSize;           // Initial hashmap size (it grows incrementally)
     int maxFileCapacitySlot; // 1 ~> 1'000'000
     int maxFileCapacityMB;   // 1MB ~> 512MB
+    int numShards;           // 1 ~> 256 (independently locked partitions)
+    int evictionPolicy;      // EVICTION_* (see eviction.h)
+    int compression;          // FS_COMPRESSION_*
+    int compressionMinSaving; // 1 ~> 99 (%): saving required to store a content compressed
+    int admission;            // FS_ADMISSION_*
+    const char* spillFilename; // Disk tier segment file (NULL to drop ejected files)
+    int spillMaxSizeMB;        // 1MB ~> 64GB: disk tier size
+    const char* persistDir;    // Snapshots & write-ahead logs directory (NULL to start empty)
+    int snapshotInterval;      // 1s ~> 1 day: time between snapshots
+    const char* arenaFilename; // Contents arena file (NULL to store contents on the heap)
+    int arenaMaxSizeMB;        // 1MB ~> 1TB: arena size
+    int hugePages;             // HUGE_PAGES_* (see huge_pages.h): pages backing big contents and hashmaps
+    int lockLeaseMs;           // 1ms ~> 1 day: time a client can hold a lock (0 to hold it until released)
 } FSConfig_t;
 
 // State
@@ -34,26 +65,57 @@ typedef struct {
     size_t bytesUsedCount;
     int slotsUsedCount;
     int capacityMissCount;
+    size_t bytesCapacityMissCount; // Bytes of the files ejected
+    int declinedCount;             // Files ejected right away by the admission filter (counted as capacity misses too)
+    int expiredCount;              // Files removed once their TTL elapsed
+    size_t bytesExpiredCount;      // Bytes of the files expired
+    int readCount;                 // fs_obtain / fs_read_range calls
+    int readHitCount;              // Calls that found the file
+    size_t bytesReadCount;         // Content bytes returned by them
+    size_t bytesReadMissCount;     // Content bytes of the files ejected lately they did not find
+    int compressedCount;           // Contents stored compressed
+    size_t bytesCompressedRawCount; // Bytes of the contents stored compressed (before compression)
+    size_t bytesCompressedCount;   // Bytes of the contents stored compressed (after compression)
+    size_t bytesLogicalCount;      // Bytes used counting shared contents once per file
+    float dedupRatio;              // bytesLogicalCount / bytesUsedCount
+    int spilledCount;              // Files on the disk tier
+    size_t bytesSpilledCount;      // Bytes used on the disk tier
+    int promotedCount;             // Files read back from the disk tier
+    size_t restoredCount;          // Files restored at startup (snapshot + log)
+    float restoreMs;               // Time spent restoring them
+    long long lockHoldCount;       // Times a shard lock was held exclusive by a request
+    float lockHoldAvgUs;           // Average time it was held
+    float lockHoldMaxUs;           // Longest time it was held
 } FSInfo_t;
 
-typedef struct { int fd; int status; } FSLockNotification_t;
+// Memory used by cache entries
+typedef struct {
+    int entriesCount;       // Entries in use
+    size_t allocCount;      // Allocations made (entries pools + lock queues and their readers)
+    size_t bytesReserved;   // Bytes reserved (entries pools + lock queues alive and their readers)
+    size_t lockQueuesAlive; // Lock queues alive (files with clients waiting on lock, or leased)
+} FSAllocInfo_t;
+
+typedef Notification_t FSLockNotification_t;
 
 /**
  * Initialize the "file_system".
  * MUST BE called ONCE before any other call.
+ * With a persistence directory, the files saved there (snapshot + log) are restored.
  * 
- * \param configs  : Configs parameters
- * \param lockQueue: Queue where to insert successfully locked client (only as sideeffect from an unlock)
- * \param lockCond : Where to signal for item inserted in the lock queue
- * \param lockMutex: 
+ * \param configs    : Configs parameters
+ * \param lockChannel: Where to publish successfully locked clients (only as sideeffect from an unlock
+ *                     or an expired lease), clients whose file was removed while waiting and clients
+ *                     whose timeout elapsed. Published after releasing the file lock
  * 
  * \retval 0: on success
  */
-int initializeFileSystem(FSConfig_t configs, CircQueue_t* lockQueue, pthread_cond_t* lockCond, pthread_mutex_t* lockMutex);
+int initializeFileSystem(FSConfig_t configs, NotifyChannel_t* lockChannel);
 
 /**
  * Terminate the "file_system".
  * MUST BE called ONCE after any other call.
+ * With a persistence directory, a last snapshot is taken.
  * 
  * \retval 0: on success
  */
@@ -62,17 +124,21 @@ int terminateFileSystem();
 /**
  * Insert a file inside the filesystem.
  * If aquireLock is set, during the creation it also aquire lock on it.
+ * With a TTL the file is removed once it elapses (by a background thread, clients
+ * waiting on its lock are notified). The TTL deadline is kept while the file is on the
+ * disk tier and inside persisted files: files found expired there are dropped.
  * 
  * \param client       : client requesting the action
  * \param file         : destination file
  * \param acquireLock  : should it acquire lock too ?
+ * \param ttlMs        : time to live (ms), 0 to keep it until removed or ejected
  * \param outFiles     : ejected files to make room to the inserted file
  * \param outFilesCount: ejected files count
  * 
  * \retval  0: on success
  * \retval >0: on error. possible values [ FS_FILE_ALREADY_EXISTS ]
  */
-int fs_insert(int client, FSFile_t file, int aquireLock, FSFile_t** outFiles, int* outFilesCount);
+int fs_insert(int client, FSFile_t file, int aquireLock, long ttlMs, FSFile_t** outFiles, int* outFilesCount);
 
 /**
  * Remove a file from the filesystem.
@@ -87,6 +153,9 @@ int fs_remove(int client, FSFile_t file);
 
 /**
  * Retrieve a file from the filesystem.
+ * Files on the disk tier are moved back in memory (same for every operation on a file but
+ * unlock): they still exist there. Their lock is kept in memory meanwhile, together with the
+ * clients waiting for it.
  * 
  * \param client : client requesting the action
  * \param file   : file to retrieve
@@ -111,11 +180,32 @@ int fs_obtain(int client, FSFile_t file, FSFile_t* outFile);
  */
 int fs_obtain_n(int client, int n, FSFile_t** outFiles, int* outFilesCount);
 
+/**
+ * List the files whose name starts with a prefix, in name order (names and sizes only).
+ * Listed files have a copy of the name, 'contentLen' set to their size and no content.
+ * Passing the name of the last file listed as cursor continues a previous listing.
+ * Files moved to the disk tier are not listed.
+ * 
+ * \param client       : client requesting the action
+ * \param prefix       : names prefix (can be empty)
+ * \param prefixLen    : prefix length
+ * \param after        : only names greater than this one (NULL to start from the first)
+ * \param afterLen     : cursor length (terminator included)
+ * \param max          : files to list at most (0 or more than FS_LIST_MAX means FS_LIST_MAX)
+ * \param outFiles     : listed files
+ * \param outFilesCount: listed files count
+ * \param more         : where to store if other files follow the last one
+ * 
+ * \retval  0: on success
+ * \retval >0: on error. possible values [ ]
+ */
+int fs_list(int client, const char* prefix, size_t prefixLen, const char* after, size_t afterLen, int max, FSFile_t** outFiles, int* outFilesCount, int* more);
+
 /**
  * Modify a file from the filesystem.
  * 
  * \param client       : client requesting the action
- * \param file         : file to update (with its new content inside)
+ * \param file         : file to update (with its new content inside, released on error)
  * \param outFiles     : ejected files to make room to the inserted file
  * \param outFilesCount: ejected files count
  * 
@@ -128,7 +218,7 @@ int fs_modify(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount
  * Append data to a file in the filesystem.
  * 
  * \param client       : client requesting the action
- * \param file         : file to update (with the content to add inside)
+ * \param file         : file to update (with the bytes to add inside 'data')
  * \param outFiles     : ejected files to make room to the modified file
  * \param outFilesCount: ejected files count
  * 
@@ -137,6 +227,35 @@ int fs_modify(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount
  */
 int fs_append(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount);
 
+/**
+ * Retrieve bytes of a file from the filesystem (only those bytes are copied out).
+ * The range is cut at the end of the file.
+ * 
+ * \param client : client requesting the action
+ * \param file   : file to read
+ * \param offset : first byte to read
+ * \param length : bytes to read
+ * \param outFile: retrieved bytes (as a file with the same name)
+ * 
+ * \retval  0: on success
+ * \retval >0: on error. possible values [ FS_FILE_NOT_EXISTS ]
+ */
+int fs_read_range(int client, FSFile_t file, size_t offset, size_t length, FSFile_t* outFile);
+
+/**
+ * Write bytes of a file in the filesystem, from 'offset' on (the file grows if they go past its end).
+ * 
+ * \param client       : client requesting the action
+ * \param file         : file to update (with the bytes to write inside 'data')
+ * \param offset       : first byte to write (up to the file length)
+ * \param outFiles     : ejected files to make room to the modified file
+ * \param outFilesCount: ejected files count
+ * 
+ * \retval  0: on success
+ * \retval >0: on error. possible values [ FS_CLIENT_NOT_ALLOWED, FS_FILE_NOT_EXISTS, FS_FILE_TOO_BIG, FS_INVALID_RANGE ]
+ */
+int fs_write_range(int client, FSFile_t file, size_t offset, FSFile_t** outFiles, int* outFilesCount);
+
 /**
  * Check if file exist inside the filesystem.
  * 
@@ -150,17 +269,26 @@ int fs_exists(int client, FSFile_t file);
 
 /**
  * Try taking ownership of the file.
+ * When someone else owns it, the client is queued (FIFO) and notified through the lock
+ * channel once it gets the lock, the file is removed or the timeout elapsed (FS_LOCK_TIMED_OUT).
+ * A client waits for a single lock at a time.
+ * With a lease (lockLeaseMs) the lock is taken back once it elapsed: owners renew it locking again.
+ * Shared locks are held by many readers at once (nobody modifies the file meanwhile), until
+ * someone waits for the lock: the following ones wait behind. The only reader can take the
+ * lock exclusive, owners asking for a shared lock keep the exclusive one.
  * 
- * \param client: client requesting the action
- * \param file  : file to 'lock'
+ * \param client   : client requesting the action
+ * \param file     : file to 'lock'
+ * \param shared   : 1 for a shared lock, 0 for an exclusive one
+ * \param timeoutMs: time to wait at most (ms), 0 to never wait, <0 to wait until it gets the lock
  * 
  * \retval  0: on success
- * \retval >0: on error. possible values [ FS_CLIENT_NOT_ALLOWED, FS_FILE_NOT_EXISTS, FS_CLIENT_WAITING_ON_LOCK ]
+ * \retval >0: on error. possible values [ FS_CLIENT_NOT_ALLOWED, FS_FILE_NOT_EXISTS, FS_CLIENT_WAITING_ON_LOCK, FS_LOCK_TIMED_OUT ]
  */
-int fs_trylock(int client, FSFile_t file);
+int fs_trylock(int client, FSFile_t file, int shared, long timeoutMs);
 
 /**
- * Release ownership of the file.
+ * Release ownership of the file (or leave its readers).
  * 
  * \param client: client requesting the action
  * \param file  : file to 'unlock'
@@ -170,8 +298,19 @@ int fs_trylock(int client, FSFile_t file);
  */
 int fs_unlock(int client, FSFile_t file);
 
+/**
+ * Stop waiting on lock (O(1)).
+ * 
+ * \param client: client waiting
+ * 
+ * \retval 1: if the client was waiting (no notification follows)
+ * \retval 0: if it was not (one may be on its way: lock granted or wait ended meanwhile)
+ */
+int fs_cancel_wait(int client);
+
 /**
  * Clean the user data left using its session.
+ * The client stops waiting on lock (fs_cancel_wait) and the locks of its files are released.
  * 
  * \param client : destination client
  * \param session: session data
@@ -188,4 +327,11 @@ int fs_clean(int client, ClientSession_t* session);
  */
 FSInfo_t fs_get_infos();
 
+/**
+ * Get memory used by cache entries (names and contents excluded).
+ * 
+ * \retval struct: containing allocations count and bytes reserved
+ */
+FSAllocInfo_t fs_get_alloc_infos();
+
 #endif // FILE_SYSTEM_H
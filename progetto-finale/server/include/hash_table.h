@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <stddef.h>
+
+#include <common.h>
+
+/**
+ * Node to embed inside the stored items (intrusive chaining).
+ * Must be filled with the item's hash before insertion.
+ */
+typedef struct HashTableNode_t {
+    struct HashTableNode_t* next; // Next node in the same bucket
+    HashValue64 hash;             // Full hash of the key
+} HashTableNode_t;
+
+/**
+ * Key comparison between a stored node and a key.
+ *
+ * \retval 1: if node's key is equal to key
+ * \retval 0: otherwise
+ */
+typedef int (*HashTableKeyEq_t)(const HashTableNode_t* node, const void* key, size_t keyLen);
+
+/**
+ * Chained hash table, resized incrementally.
+ * When growing, the old bucket array is kept and its buckets are moved into the
+ * new one a few at a time, during insertions and removals.
+ * Lookups never modify the table (safe to use concurrently with other lookups).
+ * Big bucket arrays are on huge pages (see useHugePages).
+ * NOT thread-safe otherwise.
+ */
+typedef struct {
+    HashTableNode_t** buckets;    // Current buckets
+    size_t capacity;              // Current buckets count (power of 2)
+    HashTableNode_t** oldBuckets; // Buckets being migrated (NULL if not resizing)
+    size_t oldCapacity;           // Buckets being migrated count
+    size_t migrateIndex;          // Next old bucket to migrate
+    size_t size;                  // Nodes count
+    HashTableKeyEq_t keyEq;       // Key comparison
+} HashTable_t;
+
+// Iteration state (zero initialize before the first call)
+typedef struct {
+    int pass;              // 0: current buckets, 1: old buckets
+    size_t bucket;         // Next bucket to visit
+    HashTableNode_t* next; // Next node in the current bucket
+} HashTableIter_t;
+
+/**
+ * Initialize an empty table.
+ * Terminate process on failure.
+ *
+ * \param table   : the table itself
+ * \param capacity: initial buckets count hint (rounded to a power of 2)
+ * \param keyEq   : key comparison
+ */
+void initHashTable(HashTable_t* table, size_t capacity, HashTableKeyEq_t keyEq);
+
+/**
+ * Release table memory (nodes are NOT released).
+ *
+ * \param table: the table itself
+ */
+void destroyHashTable(HashTable_t* table);
+
+/**
+ * Search for a node.
+ *
+ * \param table : the table itself
+ * \param hash  : key's hash
+ * \param key   : key to compare (NULL to match on hash only)
+ * \param keyLen: key's length
+ *
+ * \retval ptr : the node found
+ * \retval NULL: if not found
+ */
+HashTableNode_t* hashTableFind(const HashTable_t* table, HashValue64 hash, const void* key, size_t keyLen);
+
+/**
+ * Insert a node. Its key MUST NOT be already inside the table.
+ * Terminate process on failure.
+ *
+ * \param table: the table itself
+ * \param node : node to insert (with hash set)
+ */
+void hashTableInsert(HashTable_t* table, HashTableNode_t* node);
+
+/**
+ * Remove a node.
+ *
+ * \param table: the table itself
+ * \param node : node to remove
+ *
+ * \retval 1: if node was removed
+ * \retval 0: if node was not inside the table
+ */
+int hashTableRemove(HashTable_t* table, HashTableNode_t* node);
+
+/**
+ * Get the next node of the table (in no particular order).
+ * The returned node can be released before the next call, but the
+ * table MUST NOT be modified during the iteration.
+ *
+ * \param table: the table itself
+ * \param iter : iteration state
+ *
+ * \retval ptr : the next node
+ * \retval NULL: if there are no more nodes
+ */
+HashTableNode_t* hashTableIterate(const HashTable_t* table, HashTableIter_t* iter);
+
+#endif // HASH_TABLE_H
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <stddef.h>
+
+// Pages backing the big blocks
+#define HUGE_PAGES_NONE        0 // Heap (4KB pages)
+#define HUGE_PAGES_TRANSPARENT 1 // Mappings advised for transparent huge pages (madvise)
+#define HUGE_PAGES_EXPLICIT    2 // Huge pages reserved by the system (MAP_HUGETLB), transparent ones when missing
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Blocks smaller than this are always on the heap (a huge page would be mostly wasted)
+#define HUGE_PAGES_MIN_BLOCK HUGE_PAGE_SIZE
+
+// Mappings released kept for the next blocks of the same size (count and bytes at most),
+// so that replacing a content does not fault and zero its pages again
+#define HUGE_PAGES_CACHED       8
+#define HUGE_PAGES_CACHED_BYTES (64 * 1024 * 1024)
+
+// Blocks mapped since the mode was set
+typedef struct {
+    long long explicitCount;    // On reserved huge pages
+    long long transparentCount; // Advised for transparent huge pages (explicit ones missing included)
+    long long plainCount;       // On 4KB pages (the kernel rejected the advice)
+    long long reusedCount;      // Mappings released and reused (not counted above)
+    size_t bytesMapped;         // Bytes mapped now (kept ones included)
+    size_t bytesMappedPeak;     // Most bytes mapped at the same time
+} HugePagesInfo_t;
+
+/**
+ * Choose the pages backing the following big blocks (hugeAlloc).
+ * Mappings kept for reuse are released.
+ * MUST BE called with no block allocated by hugeAlloc left.
+ *
+ * \param mode: HUGE_PAGES_*
+ */
+void useHugePages(int mode);
+
+/**
+ * Allocate a block: blocks of at least HUGE_PAGES_MIN_BLOCK bytes get their own mapping
+ * aligned to HUGE_PAGE_SIZE (unless the mode is HUGE_PAGES_NONE), the others are on the heap.
+ * It MUST be released with hugeFree.
+ * Terminate process on failure.
+ *
+ * \param size  : bytes count
+ * \param zeroed: 1 to get the bytes set to 0
+ *
+ * \retval ptr: the block
+ */
+void* hugeAlloc(size_t size, int zeroed);
+
+/**
+ * Release a block allocated by hugeAlloc (with the same mode).
+ *
+ * \param block: the block (can be NULL)
+ * \param size : bytes count it was allocated with
+ */
+void hugeFree(void* block, size_t size);
+
+/**
+ * Counters since the mode was set.
+ *
+ * \retval struct: the counters
+ */
+HugePagesInfo_t hugePagesInfo();
+
+/**
+ * Get the name of a mode.
+ *
+ * \param mode: HUGE_PAGES_*
+ *
+ * \retval str: its name
+ */
+const char* hugePagesName(int mode);
+
+#endif // HUGE_PAGES_H
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef LATCH_H
+#define LATCH_H
+
+#include <stdatomic.h>
+
+/**
+ * Ticket latch: who takes a ticket is served in the same order.
+ * A ticket can be taken holding other locks (it never blocks), then waited
+ * for after releasing them: the order is the one of the locks,
+ * the wait is not spent holding them.
+ * Waiters sleep on a small shared set of cond vars (the latch itself is 8 bytes).
+ * A thread MUST NOT wait for a ticket while holding another one not served yet.
+ * Its thread-safe.
+ */
+typedef struct {
+    atomic_uint next;    // Next ticket to hand out
+    atomic_uint serving; // Ticket allowed to proceed
+} Latch_t;
+
+/**
+ * Initialize a free latch.
+ *
+ * \param latch: the latch itself
+ */
+void initLatch(Latch_t* latch);
+
+/**
+ * Take a ticket (never blocks).
+ *
+ * \param latch: the latch itself
+ *
+ * \retval ticket: to be passed to latchWait
+ */
+unsigned latchTicket(Latch_t* latch);
+
+/**
+ * Wait for the ticket to be served. MUST be followed by latchRelease.
+ *
+ * \param latch : the latch itself
+ * \param ticket: taken with latchTicket
+ */
+void latchWait(Latch_t* latch, unsigned ticket);
+
+/**
+ * Take a ticket and wait for it.
+ *
+ * \param latch: the latch itself
+ */
+void latchAcquire(Latch_t* latch);
+
+/**
+ * Serve the next ticket.
+ *
+ * \param latch: the latch itself
+ */
+void latchRelease(Latch_t* latch);
+
+#endif // LATCH_H
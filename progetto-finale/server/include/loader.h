@@ -7,13 +7,14 @@
 #include <stdlib.h>
 
 #include "server.h"
+#include "eviction.h"
+#include "huge_pages.h"
 #include <common.h>
 #include <logger.h>
 
 // #define DEBUG_LOG
 
 #define MAX_FILE_PATH_LEN 256
-#define BASE_HASHTABLE_SIZE 1024*1024
 
 /**
  * Read configs from file.
@@ -31,17 +32,44 @@ static ServerConfig_t readConfigs(const char* filename) {
     static const char* const OPT_LOGFILE      = "logFile";
     static const char* const OPT_NUMWORKERS   = "numWorkers";
     static const char* const OPT_MAXCLIENTS   = "maxClients";
+    static const char* const OPT_EJECTEDQUEUE = "ejectedQueueMB";
+    static const char* const OPT_LOCKTIMEOUT  = "lockTimeoutMs";
     static const char* const OPT_MAXSIZEMB    = "maxSizeMB";
     static const char* const OPT_MAXSLOTCOUNT = "maxSizeSlot";
     static const char* const OPT_TABLESIZE    = "tableSize";
+    static const char* const OPT_NUMSHARDS    = "numShards";
+    static const char* const OPT_EVICTION     = "evictionPolicy";
+    static const char* const OPT_ADMISSION    = "admission";
+    static const char* const OPT_COMPRESSION  = "compression";
+    static const char* const OPT_COMPSAVING   = "compressionMinSaving";
+    static const char* const OPT_SPILLFILE    = "spillFile";
+    static const char* const OPT_SPILLSIZEMB  = "spillSizeMB";
+    static const char* const OPT_PERSISTDIR   = "persistDir";
+    static const char* const OPT_SNAPINTERVAL = "snapshotInterval";
+    static const char* const OPT_ARENAFILE    = "arenaFile";
+    static const char* const OPT_ARENASIZEMB  = "arenaSizeMB";
+    static const char* const OPT_HUGEPAGES    = "hugePages";
+    static const char* const OPT_LOCKLEASE    = "lockLeaseMs";
 
     // Table size ratio
     static const int tableRatio[]       = { 0, 2, 3, 4, 6, 8 };
     static const char* tableSizeValue[] = { "SMALLEST", "SMALL", "MEDIUM", "BIG", "BIGGEST" };
 
+    // Admission (index is FS_ADMISSION_*)
+    static const char* admissionValue[] = { "ALWAYS", "TINYLFU" };
+
+    // Compression (index is FS_COMPRESSION_*)
+    static const char* compressionValue[] = { "NONE", "HUFFMAN" };
+
+    // Huge pages (index is HUGE_PAGES_*)
+    static const char* hugePagesValue[] = { "NONE", "TRANSPARENT", "EXPLICIT" };
+
     // 0. vars
     static char socketFilenameBuf[MAX_FILE_PATH_LEN];
     static char logFilenameBuf[MAX_FILE_PATH_LEN];
+    static char spillFilenameBuf[MAX_FILE_PATH_LEN];
+    static char persistDirBuf[MAX_FILE_PATH_LEN];
+    static char arenaFilenameBuf[MAX_FILE_PATH_LEN];
     FILE* stream   = NULL;
     char* line     = NULL;
     size_t lineLen = 0;
@@ -116,6 +144,26 @@ static ServerConfig_t readConfigs(const char* filename) {
                 continue;
             }
         }
+        // Ejected files queue MB
+        else if (strcmp(key, OPT_EJECTEDQUEUE) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num <= 4096) {
+                configs.ejectedQueueMB = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 4096", value, OPT_EJECTEDQUEUE);
+                continue;
+            }
+        }
+        // Lock acquisition timeout (ms)
+        else if (strcmp(key, OPT_LOCKTIMEOUT) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num <= 24 * 60 * 60 * 1000) {
+                configs.lockTimeoutMs = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 86400000", value, OPT_LOCKTIMEOUT);
+                continue;
+            }
+        }
         // Max size MB
         else if (strcmp(key, OPT_MAXSIZEMB) == 0) {
             int num = parse_positive_integer(value);
@@ -149,6 +197,130 @@ static ServerConfig_t readConfigs(const char* filename) {
                 continue;
             }
         }
+        // Num shards
+        else if (strcmp(key, OPT_NUMSHARDS) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0) {
+                configs.fsConfigs.numShards = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer > 0", value, OPT_NUMSHARDS);
+                continue;
+            }
+        }
+        // Eviction policy
+        else if (strcmp(key, OPT_EVICTION) == 0) {
+            int policy = parseEvictionPolicy(value);
+            if (policy >= 0) {
+                configs.fsConfigs.evictionPolicy = policy + 1; // Save index temporary
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be one of [ LRU, CLOCK, S3-FIFO, ARC, W-TINYLFU, GDSF ]", value, OPT_EVICTION);
+                continue;
+            }
+        }
+        // Admission
+        else if (strcmp(key, OPT_ADMISSION) == 0) {
+            for (int i = 0; i < 2; ++i) {
+                if (strcmp(value, admissionValue[i]) == 0) {
+                    configs.fsConfigs.admission = i + 1; // Save index temporary
+                    break;
+                }
+            }
+            if (configs.fsConfigs.admission == 0) {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be one of [ ALWAYS, TINYLFU ]", value, OPT_ADMISSION);
+                continue;
+            }
+        }
+        // Compression
+        else if (strcmp(key, OPT_COMPRESSION) == 0) {
+            for (int i = 0; i < 2; ++i) {
+                if (strcmp(value, compressionValue[i]) == 0) {
+                    configs.fsConfigs.compression = i + 1; // Save index temporary
+                    break;
+                }
+            }
+            if (configs.fsConfigs.compression == 0) {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be one of [ NONE, HUFFMAN ]", value, OPT_COMPRESSION);
+                continue;
+            }
+        }
+        // Compression min saving
+        else if (strcmp(key, OPT_COMPSAVING) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num < 100) {
+                configs.fsConfigs.compressionMinSaving = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 99", value, OPT_COMPSAVING);
+                continue;
+            }
+        }
+        // Disk tier filename
+        else if (strcmp(key, OPT_SPILLFILE) == 0) {
+            strncpy(spillFilenameBuf, value, MAX_FILE_PATH_LEN);
+            configs.fsConfigs.spillFilename = spillFilenameBuf;
+        }
+        // Disk tier size MB
+        else if (strcmp(key, OPT_SPILLSIZEMB) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num <= 64 * 1024) {
+                configs.fsConfigs.spillMaxSizeMB = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 65536", value, OPT_SPILLSIZEMB);
+                continue;
+            }
+        }
+        // Persistence directory
+        else if (strcmp(key, OPT_PERSISTDIR) == 0) {
+            strncpy(persistDirBuf, value, MAX_FILE_PATH_LEN);
+            configs.fsConfigs.persistDir = persistDirBuf;
+        }
+        // Snapshot interval
+        else if (strcmp(key, OPT_SNAPINTERVAL) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num <= 24 * 60 * 60) {
+                configs.fsConfigs.snapshotInterval = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 86400", value, OPT_SNAPINTERVAL);
+                continue;
+            }
+        }
+        // Contents arena filename
+        else if (strcmp(key, OPT_ARENAFILE) == 0) {
+            strncpy(arenaFilenameBuf, value, MAX_FILE_PATH_LEN);
+            configs.fsConfigs.arenaFilename = arenaFilenameBuf;
+        }
+        // Contents arena size MB
+        else if (strcmp(key, OPT_ARENASIZEMB) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num <= 1024 * 1024) {
+                configs.fsConfigs.arenaMaxSizeMB = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 1048576", value, OPT_ARENASIZEMB);
+                continue;
+            }
+        }
+        // Huge pages
+        else if (strcmp(key, OPT_HUGEPAGES) == 0) {
+            for (int i = 0; i < 3; ++i) {
+                if (strcmp(value, hugePagesValue[i]) == 0) {
+                    configs.fsConfigs.hugePages = i + 1; // Save index temporary
+                    break;
+                }
+            }
+            if (configs.fsConfigs.hugePages == 0) {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be one of [ NONE, TRANSPARENT, EXPLICIT ]", value, OPT_HUGEPAGES);
+                continue;
+            }
+        }
+        // Lock lease (ms)
+        else if (strcmp(key, OPT_LOCKLEASE) == 0) {
+            int num = parse_positive_integer(value);
+            if (num > 0 && num <= 24 * 60 * 60 * 1000) {
+                configs.fsConfigs.lockLeaseMs = num;
+            } else {
+                LOG_ERRO("Invalid value (%s) for option: %s. Must be an integer between 1 and 86400000", value, OPT_LOCKLEASE);
+                continue;
+            }
+        }
         // Error
         else {
             LOG_ERRO("Unsupported config named: %s", key);
@@ -185,6 +357,17 @@ static ServerConfig_t readConfigs(const char* filename) {
             configs.maxClients = 8;
         }
 
+        // Ejected files queue (MB)
+        if (configs.ejectedQueueMB == 0) {
+            LOG_WARN("Using default value (16) for ejected files queue (MB)");
+            configs.ejectedQueueMB = 16;
+        }
+
+        // Lock acquisition timeout
+        if (configs.lockTimeoutMs == 0) {
+            LOG_WARN("Using default value (none) for lock acquisition timeout: clients wait until they get the lock");
+        }
+
         // Num workers
         if (configs.numWorkers == 0) {
             LOG_WARN("Using default value (2) for thread workers count");
@@ -208,11 +391,82 @@ static ServerConfig_t readConfigs(const char* filename) {
             LOG_WARN("Using default value (32) for filesystem max capacity (Slot)");
             configs.fsConfigs.maxFileCapacitySlot = 32;
         }
+
+        // Num shards
+        if (configs.fsConfigs.numShards == 0) {
+            LOG_WARN("Using default value (16) for filesystem shards count");
+            configs.fsConfigs.numShards = 16;
+        }
+
+        // Eviction policy
+        if (configs.fsConfigs.evictionPolicy == 0) {
+            LOG_WARN("Using default value (LRU) for filesystem eviction policy");
+            configs.fsConfigs.evictionPolicy = EVICTION_LRU + 1;
+        }
+
+        // Admission
+        if (configs.fsConfigs.admission == 0) {
+            LOG_WARN("Using default value (ALWAYS) for filesystem admission");
+            configs.fsConfigs.admission = FS_ADMISSION_ALWAYS + 1;
+        }
+
+        // Compression
+        if (configs.fsConfigs.compression == 0) {
+            LOG_WARN("Using default value (NONE) for filesystem contents compression");
+            configs.fsConfigs.compression = FS_COMPRESSION_NONE + 1;
+        }
+
+        // Compression min saving
+        if (configs.fsConfigs.compressionMinSaving == 0) {
+            LOG_WARN("Using default value (10) for filesystem compression min saving (%%)");
+            configs.fsConfigs.compressionMinSaving = 10;
+        }
+
+        // Disk tier
+        if (configs.fsConfigs.spillFilename == NULL) {
+            LOG_WARN("Using default value (none) for filesystem disk tier: ejected files are dropped");
+        } else if (configs.fsConfigs.spillMaxSizeMB == 0) {
+            LOG_WARN("Using default value (256) for filesystem disk tier size (MB)");
+            configs.fsConfigs.spillMaxSizeMB = 256;
+        }
+
+        // Persistence
+        if (configs.fsConfigs.persistDir == NULL) {
+            LOG_WARN("Using default value (none) for filesystem persistence: files are lost on restart");
+        } else if (configs.fsConfigs.snapshotInterval == 0) {
+            LOG_WARN("Using default value (60) for filesystem snapshot interval (s)");
+            configs.fsConfigs.snapshotInterval = 60;
+        }
+
+        // Contents arena
+        if (configs.fsConfigs.arenaFilename == NULL) {
+            LOG_WARN("Using default value (none) for filesystem contents arena: contents are stored on the heap");
+        } else if (configs.fsConfigs.arenaMaxSizeMB == 0) {
+            LOG_WARN("Using default value (1024) for filesystem contents arena size (MB)");
+            configs.fsConfigs.arenaMaxSizeMB = 1024;
+        }
+
+        // Huge pages
+        if (configs.fsConfigs.hugePages == 0) {
+            LOG_WARN("Using default value (NONE) for filesystem huge pages");
+            configs.fsConfigs.hugePages = HUGE_PAGES_NONE + 1;
+        }
+
+        // Lock lease
+        if (configs.fsConfigs.lockLeaseMs == 0) {
+            LOG_WARN("Using default value (none) for filesystem lock lease: locks are held until released");
+        }
     }
     
     // Table size must be processed after all config file is read
-    // size = numSlot * ratio + BASE_HASHTABLE_SIZE.
-    configs.fsConfigs.tableSize = BASE_HASHTABLE_SIZE + (configs.fsConfigs.maxFileCapacitySlot * tableRatio[configs.fsConfigs.tableSize - 1]);
+    // size = numSlot * ratio. (Initial size only, the hashmap grows when needed)
+    configs.fsConfigs.tableSize = (size_t) configs.fsConfigs.maxFileCapacitySlot * tableRatio[configs.fsConfigs.tableSize - 1];
+
+    // Restore eviction policy, admission, compression & huge pages index
+    configs.fsConfigs.evictionPolicy -= 1;
+    configs.fsConfigs.admission      -= 1;
+    configs.fsConfigs.compression    -= 1;
+    configs.fsConfigs.hugePages      -= 1;
 
     // Returns configs
     return configs;
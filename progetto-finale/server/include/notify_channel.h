@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef NOTIFY_CHANNEL_H
+#define NOTIFY_CHANNEL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// Cache line (producers and consumer indexes are kept apart)
+#define NOTIFY_CACHE_LINE 64
+
+// Client waiting on a lock and the outcome of the wait
+typedef struct { int fd; int status; } Notification_t;
+
+// Ring slot: 'seq' tells who owns it (producer when == position, consumer when == position + 1)
+typedef struct {
+    atomic_size_t seq;
+    Notification_t value;
+} NotifySlot_t;
+
+/**
+ * Bounded channel from many producers to a single consumer.
+ * Notifications are copied into a preallocated ring (no allocation when publishing)
+ * and producers never take a lock, unless the consumer is asleep (one wakeup per batch).
+ * Publishing blocks (sleeping until the consumer frees some slots) only while the ring is full,
+ * so it MUST NOT be done while holding locks the consumer could need.
+ * Its thread-safe (one consumer only).
+ */
+typedef struct {
+    NotifySlot_t* slots;
+    size_t mask;                                           // Slots count - 1 (power of 2)
+    _Alignas(NOTIFY_CACHE_LINE) atomic_size_t head;        // Next position to claim (producers)
+    _Alignas(NOTIFY_CACHE_LINE) size_t tail;               // Next position to read (consumer)
+    atomic_int sleeping;                                   // Consumer waiting on cond
+    atomic_int producersWaiting;                           // Producers waiting on notFull
+    atomic_int closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_cond_t notFull;
+    atomic_long publishedCount;                            // Notifications published
+    atomic_long wakeupsCount;                              // Times the consumer was signaled
+    atomic_long fullCount;                                 // Times a producer found the ring full
+} NotifyChannel_t;
+
+// Channel state
+typedef struct {
+    size_t capacity;
+    long publishedCount;
+    long wakeupsCount;
+    long fullCount;
+} NotifyInfo_t;
+
+/**
+ * Initialize an empty channel.
+ * Terminate process on failure.
+ *
+ * \param channel : the channel itself
+ * \param capacity: slots count (rounded up to a power of 2)
+ */
+void initNotifyChannel(NotifyChannel_t* channel, size_t capacity);
+
+/**
+ * Release channel memory. Nobody MUST use it anymore.
+ *
+ * \param channel: the channel itself
+ */
+void destroyNotifyChannel(NotifyChannel_t* channel);
+
+/**
+ * Publish notifications, waking up the consumer once if it is asleep.
+ * Waits for free slots while the ring is full (notifications are dropped once closed).
+ *
+ * \param channel: the channel itself
+ * \param items  : notifications to copy
+ * \param count  : notifications count
+ */
+void notifyPublish(NotifyChannel_t* channel, const Notification_t* items, int count);
+
+/**
+ * Take the published notifications (consumer only), waiting for at least one.
+ *
+ * \param channel: the channel itself
+ * \param items  : where to copy them
+ * \param max    : 'items' size
+ *
+ * \retval n: notifications taken (0 if the channel was closed meanwhile)
+ */
+int notifyWait(NotifyChannel_t* channel, Notification_t* items, int max);
+
+/**
+ * Wake up the consumer and the blocked producers. Next waits return immediately.
+ *
+ * \param channel: the channel itself
+ */
+void notifyClose(NotifyChannel_t* channel);
+
+/**
+ * Get the channel state.
+ *
+ * \param channel: the channel itself
+ *
+ * \retval struct: the state
+ */
+NotifyInfo_t notifyInfo(NotifyChannel_t* channel);
+
+#endif // NOTIFY_CHANNEL_H
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <pthread.h>
+
+#include "file_system.h"
+#include "session.h"
+
+/**
+ * Files ejected by the writes of a client, waiting to be read by it.
+ * Writes asking for deferred delivery are acknowledged at once, the client
+ * reads the files later (MSG_REQ_READ_EJECTED).
+ * Each client can keep queued a limited amount of bytes: the files that
+ * do not fit are returned inline (the writer pays for them, as usual).
+ */
+typedef struct {
+    pthread_mutex_t mutex;  // Ensure only 1 worker at time
+    FSFile_t* files;        // Queued files (ring, oldest first)
+    int head, count, capacity;
+    size_t bytes;           // Bytes queued (names + contents)
+} Outbox_t;
+
+typedef struct {
+    long deferredCount;     // Files queued
+    long inlineCount;       // Files returned inline because the queue was full
+    long deliveredCount;    // Files read back by the clients
+    long droppedCount;      // Files released with the session (never read)
+    size_t bytesMaxQueued;  // Most bytes queued by a single client
+} OutboxInfo_t;
+
+/**
+ * Initialize outbox system.
+ *
+ * \param maxBytes: bytes a client can keep queued
+ */
+void initOutboxSystem(size_t maxBytes);
+
+/**
+ * Terminate outbox system (files still queued are released).
+ */
+void terminateOutboxSystem();
+
+/**
+ * Queue files for a client, in order, until one does not fit.
+ * Files queued are owned by the outbox, the others are left where they were
+ * (moved to the first positions of the array).
+ *
+ * \param client: destination client
+ * \param files : files to queue
+ * \param count : files count
+ *
+ * \retval n: files queued (0 ~> count)
+ */
+int outboxPush(int client, FSFile_t* files, int count);
+
+/**
+ * Take the oldest files queued for a client.
+ *
+ * \param client: files owner
+ * \param max   : files to take at most (0 to take all)
+ * \param files : where to store the files (NULL if none, release it with free)
+ * \param count : where to store the files count
+ */
+void outboxPop(int client, int max, FSFile_t** files, int* count);
+
+/**
+ * Release the files queued for a client (session closed).
+ *
+ * \param client: files owner
+ */
+void outboxClear(int client);
+
+/**
+ * Counters since initialization.
+ *
+ * \retval struct: the counters
+ */
+OutboxInfo_t outboxInfo();
+
+#endif // OUTBOX_H
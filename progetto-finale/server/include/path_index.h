@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef PATH_INDEX_H
+#define PATH_INDEX_H
+
+#include <stddef.h>
+
+typedef struct PathIndexNode_t {
+    char* label;                        // Edge bytes (from the parent)
+    size_t labelLen;
+    void* value;                        // Item whose key ends here (NULL if none)
+    struct PathIndexNode_t** children;  // Sorted by their first label byte
+    int childCount, childCap;
+} PathIndexNode_t;
+
+/**
+ * Radix tree over byte strings (file names), kept sorted.
+ * Edges are labeled with the bytes shared by every key below them, so a path
+ * like '/dir/sub/file' costs one node per branching point, not per byte.
+ * Items are listed in bytes order: the keys starting with a prefix are a single
+ * subtree, reached walking the prefix once.
+ * NOT thread-safe.
+ */
+typedef struct {
+    PathIndexNode_t root; // Empty key
+    size_t size;          // Items count
+    size_t nodesCount;    // Nodes count (root excluded)
+} PathIndex_t;
+
+/**
+ * Initialize an empty index.
+ *
+ * \param index: the index itself
+ */
+void initPathIndex(PathIndex_t* index);
+
+/**
+ * Release index memory (items are NOT released).
+ *
+ * \param index: the index itself
+ */
+void destroyPathIndex(PathIndex_t* index);
+
+/**
+ * Insert an item. Its key MUST NOT be already inside the index.
+ * Terminate process on failure.
+ *
+ * \param index : the index itself
+ * \param key   : item's key
+ * \param keyLen: key's length
+ * \param value : the item (not NULL)
+ */
+void pathIndexInsert(PathIndex_t* index, const char* key, size_t keyLen, void* value);
+
+/**
+ * Remove an item.
+ *
+ * \param index : the index itself
+ * \param key   : item's key
+ * \param keyLen: key's length
+ *
+ * \retval ptr : the item removed
+ * \retval NULL: if the key was not inside the index
+ */
+void* pathIndexRemove(PathIndex_t* index, const char* key, size_t keyLen);
+
+/**
+ * Get the items whose key starts with a prefix, in bytes order.
+ * A cursor (the key of the last item got) continues a previous listing.
+ *
+ * \param index    : the index itself
+ * \param prefix   : keys prefix (can be empty)
+ * \param prefixLen: prefix length
+ * \param after    : only keys greater than this one (NULL to start from the first)
+ * \param afterLen : cursor length
+ * \param items    : where to store the items
+ * \param max      : items to get at most
+ *
+ * \retval count: items stored
+ */
+int pathIndexList(const PathIndex_t* index, const char* prefix, size_t prefixLen, const char* after, size_t afterLen, void** items, int max);
+
+#endif // PATH_INDEX_H
@@ -0,0 +1,190 @@
+#pragma once
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stddef.h>
+
+#include "file_system.h"
+
+// Logged operations
+#define PERSIST_OP_INSERT 1
+#define PERSIST_OP_MODIFY 2
+#define PERSIST_OP_APPEND 3
+#define PERSIST_OP_REMOVE 4
+#define PERSIST_OP_WRITE_RANGE 6
+
+/**
+ * Write-ahead log of a shard, split in generations: a snapshot of generation G
+ * holds the shard state right before the first operation of the log G.
+ * Files inside 'dir':
+ *   snapshot-<shard>.bin    : last snapshot
+ *   wal-<shard>-<gen>.log   : operations made after the snapshot of generation <gen>
+ * The log is not synced on each operation: it survives a server restart (or crash),
+ * not a power loss. Snapshots are synced before replacing the old ones.
+ * Snapshots can refer to contents left inside the arena instead of holding their bytes.
+ * Not thread-safe: appends and rotations MUST be serialized by the caller.
+ */
+typedef struct {
+    int fd;             // Current log file (-1 if closed)
+    unsigned long gen;  // Current generation
+    int shard;          // Shard index
+    int numShards;      // Shards count (saved to detect layout changes)
+    const char* dir;    // Directory
+} PersistLog_t;
+
+/**
+ * Called for each operation found while replaying.
+ * Name and content of INSERT / MODIFY files are passed to the callee (to release),
+ * APPEND / WRITE_RANGE bytes ('data') and REMOVE names are valid only during the call.
+ * 'offset' is the first byte written by WRITE_RANGE (0 otherwise).
+ * 'expiresAt' is the TTL deadline of INSERT files (wall-clock ms, 0 if none or otherwise).
+ */
+typedef void (*PersistReplayFun_t)(void* arg, int op, FSFile_t file, size_t offset, long long expiresAt);
+
+// Replay result of a shard
+typedef struct {
+    int found;               // Snapshot or log found
+    int layoutChanged;       // Written with a different shards count
+    unsigned long firstGen;  // First log generation replayed
+    unsigned long lastGen;   // Last log generation replayed
+    size_t filesCount;       // Files inside the snapshot
+    size_t opsCount;         // Operations inside the logs
+} PersistReplay_t;
+
+/**
+ * Initialize a closed log.
+ *
+ * \param log: the log itself
+ */
+void initPersistLog(PersistLog_t* log);
+
+/**
+ * Open (or create) the log of a shard, appending to it.
+ *
+ * \param log      : the log itself
+ * \param dir      : directory
+ * \param shard    : shard index
+ * \param numShards: shards count
+ * \param gen      : generation
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int openPersistLog(PersistLog_t* log, const char* dir, int shard, int numShards, unsigned long gen);
+
+/**
+ * Close the log (if opened).
+ *
+ * \param log: the log itself
+ */
+void closePersistLog(PersistLog_t* log);
+
+/**
+ * Append an operation to the log.
+ *
+ * \param log    : the log itself
+ * \param op     : PERSIST_OP_* (but INSERT and WRITE_RANGE)
+ * \param name   : file name
+ * \param nameLen: name length
+ * \param data   : content (MODIFY) or bytes appended (APPEND)
+ * \param dataLen: data length
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int persistLogAppend(PersistLog_t* log, int op, const char* name, size_t nameLen, const char* data, size_t dataLen);
+
+/**
+ * Append an INSERT operation to the log (its data starts with the TTL deadline).
+ *
+ * \param log      : the log itself
+ * \param name     : file name
+ * \param nameLen  : name length
+ * \param expiresAt: TTL deadline (wall-clock ms, 0 if none)
+ * \param data     : content
+ * \param dataLen  : data length
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int persistLogAppendInsert(PersistLog_t* log, const char* name, size_t nameLen, long long expiresAt, const char* data, size_t dataLen);
+
+/**
+ * Append a WRITE_RANGE operation to the log (its data starts with the offset).
+ *
+ * \param log    : the log itself
+ * \param name   : file name
+ * \param nameLen: name length
+ * \param offset : first byte written
+ * \param data   : bytes written
+ * \param dataLen: data length
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int persistLogAppendRange(PersistLog_t* log, const char* name, size_t nameLen, size_t offset, const char* data, size_t dataLen);
+
+/**
+ * Switch to the next generation (following operations go into a new file).
+ *
+ * \param log: the log itself
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set, the old generation is kept)
+ */
+int rotatePersistLog(PersistLog_t* log);
+
+/**
+ * Write the snapshot of a shard, then remove its logs older than 'gen'.
+ *
+ * \param dir       : directory
+ * \param shard     : shard index
+ * \param numShards : shards count
+ * \param gen       : first log generation not included
+ * \param files     : files of the shard
+ * \param expiresAt : TTL deadline of each file (wall-clock ms, 0 if none)
+ * \param count     : files count
+ * \param references: refer to the contents inside the arena (they MUST be kept there)
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set, the old snapshot is kept)
+ */
+int writePersistSnapshot(const char* dir, int shard, int numShards, unsigned long gen, const FSFile_t* files, const long long* expiresAt, int count, int references);
+
+/**
+ * Reserve the contents the snapshot of a shard refers to (see reserveContent).
+ * MUST BE called (for every shard) before replaying them.
+ *
+ * \param dir      : directory
+ * \param shard    : shard index
+ * \param numShards: shards count
+ *
+ * \retval n: contents still inside the arena
+ */
+size_t reservePersistShard(const char* dir, int shard, int numShards);
+
+/**
+ * Replay the snapshot and then the logs of a shard (oldest first).
+ * A log truncated in the middle of an operation (crash) is cut there.
+ *
+ * \param dir      : directory
+ * \param shard    : shard index
+ * \param numShards: shards count
+ * \param fun      : called for each operation
+ * \param arg      : passed to fun
+ *
+ * \retval struct: what was replayed
+ */
+PersistReplay_t replayPersistShard(const char* dir, int shard, int numShards, PersistReplayFun_t fun, void* arg);
+
+/**
+ * Remove every file of a shard.
+ *
+ * \param dir    : directory
+ * \param shard  : shard index
+ * \param lastGen: last log generation
+ */
+void removePersistShard(const char* dir, int shard, unsigned long lastGen);
+
+#endif // PERSIST_H
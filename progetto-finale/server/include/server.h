@@ -13,6 +13,8 @@ typedef struct {
     const char* logFilename;
     int numWorkers;
     int maxClients;
+    int ejectedQueueMB;
+    int lockTimeoutMs;   // Time a client waits on lock at most, unless it asks otherwise (0 to wait until it gets it)
     FSConfig_t fsConfigs;
 } ServerConfig_t;
 
@@ -26,7 +26,7 @@ typedef struct {
     int isValid;                                    // Is session valid ?
     timestamp_t creation_time, last_operation_time; // Timestamp for creation date and last operation
     int numFileOpened;                              // Num files opened
-    HashValue filenames[MAX_CLIENT_OPENED_FILES];   // Filename         of file i
+    HashValue64 filenames[MAX_CLIENT_OPENED_FILES]; // Filename (hash)  of file i
     int flags[MAX_CLIENT_OPENED_FILES];             // Flags at opening of file i
 } ClientSession_t;
 
@@ -0,0 +1,70 @@
+#pragma once
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include <common.h>
+
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX_COUNT 15
+
+/**
+ * Count-min sketch estimating how often a key has been seen.
+ * Counters saturate at SKETCH_MAX_COUNT and are halved every 'sampleSize'
+ * additions, so old popularity fades away.
+ * Increments and estimates are thread-safe (atomics only).
+ */
+typedef struct {
+    atomic_uchar* counters;   // SKETCH_DEPTH rows of 'width' counters
+    size_t width;             // Counters per row (power of 2)
+    int widthBits;            // log2(width)
+    atomic_size_t additions;  // Additions since last halving
+    size_t sampleSize;        // Additions before halving
+} FreqSketch_t;
+
+/**
+ * Initialize an empty sketch.
+ * Terminate process on failure.
+ *
+ * \param sketch  : the sketch itself
+ * \param capacity: expected distinct keys count
+ */
+void initSketch(FreqSketch_t* sketch, size_t capacity);
+
+/**
+ * Release sketch memory.
+ *
+ * \param sketch: the sketch itself
+ */
+void destroySketch(FreqSketch_t* sketch);
+
+/**
+ * Record an occurrence of the key.
+ *
+ * \param sketch: the sketch itself
+ * \param hash  : key's hash
+ */
+void sketchIncrement(FreqSketch_t* sketch, HashValue64 hash);
+
+/**
+ * Estimate occurrences of the key (never lower than the real value, before halving).
+ *
+ * \param sketch: the sketch itself
+ * \param hash  : key's hash
+ *
+ * \retval n: the estimate (0 ~> SKETCH_MAX_COUNT)
+ */
+int sketchEstimate(FreqSketch_t* sketch, HashValue64 hash);
+
+/**
+ * Halve every counter if 'sampleSize' additions were made.
+ * Concurrent increments may get lost while halving (that's acceptable for an estimate).
+ *
+ * \param sketch: the sketch itself
+ */
+void sketchAge(FreqSketch_t* sketch);
+
+#endif // SKETCH_H
@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Pool of fixed size objects.
+ * Objects are carved out of big chunks (one malloc for many objects) and
+ * recycled through a free list. Chunks are released only on destroy.
+ * Its thread-safe.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    size_t objSize;       // Object size (aligned)
+    int objsPerChunk;     // Objects inside each chunk
+    void* freeList;       // Free objects (linked through their first bytes)
+    void* chunks;         // Allocated chunks (linked through their first bytes)
+    size_t allocCount;    // Chunks allocated (malloc calls)
+    size_t bytesReserved; // Bytes allocated for chunks
+    size_t inUse;         // Objects currently in use
+} Slab_t;
+
+/**
+ * Initialize an empty pool.
+ * Terminate process on failure.
+ *
+ * \param slab        : the pool itself
+ * \param objSize     : size of the objects
+ * \param objsPerChunk: objects to allocate at once
+ */
+void initSlab(Slab_t* slab, size_t objSize, int objsPerChunk);
+
+/**
+ * Release every chunk (objects still in use included).
+ *
+ * \param slab: the pool itself
+ */
+void destroySlab(Slab_t* slab);
+
+/**
+ * Get an object from the pool (uninitialized).
+ * Terminate process on failure.
+ *
+ * \param slab: the pool itself
+ *
+ * \retval ptr: the object
+ */
+void* slabAlloc(Slab_t* slab);
+
+/**
+ * Give an object back to the pool.
+ *
+ * \param slab: the pool itself
+ * \param obj : object obtained from the same pool (can be NULL)
+ */
+void slabFree(Slab_t* slab, void* obj);
+
+#endif // SLAB_H
@@ -0,0 +1,126 @@
+#pragma once
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <common.h>
+
+#include "content.h"
+#include "hash_table.h"
+#include "slab.h"
+
+typedef struct SpillEntry_t SpillEntry_t;
+
+/**
+ * Second level (on disk) tier for the files ejected from memory.
+ * Files are appended to a single segment file, used as a circular log: when it
+ * is full the oldest records are overwritten (and their files dropped).
+ * An in-memory index (name -> record) tells where each file is.
+ * Records hold raw contents (never compressed).
+ * Its thread-safe: disk I/O is done holding no lock (the record's region is reserved
+ * holding the mutex, the ones being written or read are waited for before reusing them).
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;       // Records no longer busy
+    int fd;                    // Segment file
+    HashTable_t index;         // Hashmap (name -> entry)
+    Slab_t entries;            // Entries pool
+    SpillEntry_t* oldest;      // Records in write order (oldest first)
+    SpillEntry_t* newest;
+    off_t tail, maxSize;       // Next write offset, segment file size
+    int filesCount;            // Files on disk
+    size_t bytesUsed;          // Bytes of the records on disk
+    long long demotedCount, bytesDemotedCount;
+    long long promotedCount, bytesPromotedCount;
+    long long droppedCount, bytesDroppedCount;
+} SpillTier_t;
+
+// Tier state
+typedef struct {
+    int filesCount;
+    size_t bytesUsed;
+    long long demotedCount, bytesDemotedCount;   // Files written
+    long long promotedCount, bytesPromotedCount; // Files read back
+    long long droppedCount, bytesDroppedCount;   // Files overwritten (lost)
+} SpillInfo_t;
+
+/**
+ * Initialize an empty tier, creating (or truncating) its segment file.
+ *
+ * \param tier    : the tier itself
+ * \param filename: segment file path
+ * \param maxSize : segment file size (bytes)
+ * \param capacity: expected files count
+ *
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int initSpillTier(SpillTier_t* tier, const char* filename, size_t maxSize, size_t capacity);
+
+/**
+ * Release the index and close the segment file.
+ *
+ * \param tier: the tier itself
+ */
+void destroySpillTier(SpillTier_t* tier);
+
+/**
+ * Write a file into the tier (replacing any older copy).
+ *
+ * \param tier      : the tier itself
+ * \param hash      : name hash
+ * \param name      : file name
+ * \param nameLen   : name length
+ * \param content   : file content (can be NULL if contentLen is 0)
+ * \param contentLen: content length
+ * \param expiresAt : TTL deadline (kept in memory and given back by spillTake, 0 if none)
+ *
+ * \retval 1: if written
+ * \retval 0: if it does not fit or on I/O error
+ */
+int spillPut(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen, Content_t* content, size_t contentLen, long long expiresAt);
+
+/**
+ * Read a file back from the tier, removing it.
+ *
+ * \param tier      : the tier itself
+ * \param hash      : name hash
+ * \param name      : file name
+ * \param nameLen   : name length
+ * \param content   : where to store the content read (NULL if empty)
+ * \param contentLen: where to store the content length
+ * \param expiresAt : where to store the TTL deadline given to spillPut
+ *
+ * \retval 1: if found
+ * \retval 0: otherwise
+ */
+int spillTake(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen, Content_t** content, size_t* contentLen, long long* expiresAt);
+
+/**
+ * Check if the tier holds a file.
+ *
+ * \param tier   : the tier itself
+ * \param hash   : name hash
+ * \param name   : file name
+ * \param nameLen: name length
+ *
+ * \retval 1: if found
+ * \retval 0: otherwise
+ */
+int spillContains(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen);
+
+/**
+ * Get the tier state.
+ *
+ * \param tier: the tier itself
+ *
+ * \retval struct: the state
+ */
+SpillInfo_t spillInfo(SpillTier_t* tier);
+
+#endif // SPILL_H
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Levels of the wheel and slots for each level (bits of the tick they cover)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SLOTS  (1 << TIMER_WHEEL_BITS)
+
+typedef unsigned long long TimerTick_t;
+
+// No deadline pending
+#define TIMER_TICK_NEVER (~(TimerTick_t) 0)
+
+typedef struct TimerNode_t {
+    struct TimerNode_t* prev;   // Slot list (NULL when not armed)
+    struct TimerNode_t* next;   // Slot list (next expired one, once expired)
+    TimerTick_t deadline;       // Tick it expires at
+} TimerNode_t;
+
+/**
+ * Hierarchical timer wheel: arming and cancelling a timer are O(1).
+ * Level 0 has a slot for each of the next TIMER_WHEEL_SLOTS ticks, every next
+ * level has a slot for TIMER_WHEEL_SLOTS slots of the previous one. When level 0
+ * wraps around, the slot of the next level is spread over the lower ones.
+ * Deadlines beyond the last level wait inside it (spread again when it wraps).
+ * NOT thread-safe ('count' and 'next' can be read without locks).
+ */
+typedef struct {
+    TimerNode_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // Slot lists (circular, heads only)
+    TimerTick_t now;                                          // Next tick to process
+    atomic_size_t count;                                      // Timers armed
+    atomic_ullong next;                                       // Nothing expires before it (TIMER_TICK_NEVER if empty)
+} TimerWheel_t;
+
+/**
+ * Initialize an empty wheel.
+ *
+ * \param wheel: the wheel itself
+ * \param now  : current tick
+ */
+void initTimerWheel(TimerWheel_t* wheel, TimerTick_t now);
+
+/**
+ * Arm a timer. It MUST NOT be already armed.
+ * Deadlines already passed expire with the next tick processed.
+ *
+ * \param wheel   : the wheel itself
+ * \param node    : timer's node
+ * \param now     : current tick
+ * \param deadline: tick it expires at
+ */
+void timerWheelAdd(TimerWheel_t* wheel, TimerNode_t* node, TimerTick_t now, TimerTick_t deadline);
+
+/**
+ * Disarm a timer (nothing is done if it was not armed).
+ *
+ * \param wheel: the wheel itself
+ * \param node : timer's node
+ */
+void timerWheelCancel(TimerWheel_t* wheel, TimerNode_t* node);
+
+/**
+ * Process the ticks up to 'now' (included).
+ * 'next' becomes the first tick a timer can expire at (timers cancelled meanwhile
+ * can leave it earlier: it is only a lower bound until the next call).
+ *
+ * \param wheel: the wheel itself
+ * \param now  : current tick
+ *
+ * \retval list: timers expired (disarmed, linked through 'next')
+ * \retval NULL: if none expired
+ */
+TimerNode_t* timerWheelAdvance(TimerWheel_t* wheel, TimerTick_t now);
+
+/**
+ * Initialize a timer's node (not armed).
+ *
+ * \param node: timer's node
+ */
+void initTimerNode(TimerNode_t* node);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,79 @@
+#include "admission.h"
+
+#include <stdlib.h>
+
+// Doorkeeper bits for each key expected (2 bits set by each key)
+#define DOORKEEPER_BITS_PER_KEY 8
+
+// =============================================================================================
+
+size_t doorkeeperBit(AdmissionFilter_t*, int, HashValue64);
+int doorkeeperContains(AdmissionFilter_t*, HashValue64);
+
+// =============================================================================================
+
+void initAdmissionFilter(AdmissionFilter_t* filter, size_t capacity) {
+    initSketch(&filter->sketch, capacity);
+
+    // Bits: power of 2 (one word at least)
+    int bits = 6;
+    while (((size_t) 1 << bits) < capacity * DOORKEEPER_BITS_PER_KEY) bits++;
+
+    filter->doorkeeperBits  = bits;
+    filter->doorkeeperWords = ((size_t) 1 << bits) / 64;
+    filter->doorkeeper      = (atomic_ullong*) mem_calloc(filter->doorkeeperWords, sizeof(atomic_ullong));
+    filter->sampleSize      = filter->sketch.sampleSize;
+    atomic_init(&filter->records, 0);
+}
+
+void destroyAdmissionFilter(AdmissionFilter_t* filter) {
+    destroySketch(&filter->sketch);
+    free(filter->doorkeeper);
+    filter->doorkeeper = NULL;
+}
+
+void admissionRecord(AdmissionFilter_t* filter, HashValue64 hash) {
+    // Set both bits: the key was already seen if they were set
+    int seen = 1;
+    for (int i = 0; i < 2; ++i) {
+        size_t bit = doorkeeperBit(filter, i, hash);
+        unsigned long long mask = 1ULL << (bit % 64);
+        unsigned long long old  = atomic_fetch_or_explicit(&filter->doorkeeper[bit / 64], mask, memory_order_relaxed);
+        if ((old & mask) == 0) seen = 0;
+    }
+    if (seen) {
+        sketchIncrement(&filter->sketch, hash);
+        sketchAge(&filter->sketch);
+    }
+
+    // Forget the keys seen once (concurrent records may clear it twice, that's harmless)
+    if (atomic_fetch_add_explicit(&filter->records, 1, memory_order_relaxed) + 1 >= filter->sampleSize) {
+        atomic_store_explicit(&filter->records, 0, memory_order_relaxed);
+        for (size_t i = 0; i < filter->doorkeeperWords; ++i)
+            atomic_store_explicit(&filter->doorkeeper[i], 0, memory_order_relaxed);
+    }
+}
+
+int admissionEstimate(AdmissionFilter_t* filter, HashValue64 hash) {
+    return sketchEstimate(&filter->sketch, hash) + doorkeeperContains(filter, hash);
+}
+
+int admissionAdmit(AdmissionFilter_t* filter, HashValue64 candidate, HashValue64 victim) {
+    return admissionEstimate(filter, candidate) > admissionEstimate(filter, victim);
+}
+
+// =============================================================================================
+
+size_t doorkeeperBit(AdmissionFilter_t* filter, int i, HashValue64 hash) {
+    // Two bits from independent mixes of the hash (high bits are the best mixed ones)
+    HashValue64 h = (i == 0) ? hash * 0x9e3779b97f4a7c15ULL : (hash ^ (hash >> 31)) * 0xbf58476d1ce4e5b9ULL;
+    return (size_t) (h >> (64 - filter->doorkeeperBits));
+}
+
+int doorkeeperContains(AdmissionFilter_t* filter, HashValue64 hash) {
+    for (int i = 0; i < 2; ++i) {
+        size_t bit = doorkeeperBit(filter, i, hash);
+        if ((atomic_load_explicit(&filter->doorkeeper[bit / 64], memory_order_relaxed) & (1ULL << (bit % 64))) == 0) return 0;
+    }
+    return 1;
+}
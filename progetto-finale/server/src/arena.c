@@ -0,0 +1,411 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <common.h>
+#include <logger.h>
+
+#define ARENA_MAGIC       "FSARENA"
+#define ARENA_HEADER_SIZE 4096  // First extent offset
+#define ARENA_UNIT        64    // Extents size (and offset) granularity
+
+#define EXTENT_MAGIC    0x31545845u
+#define EXTENT_USED     1u
+#define EXTENT_PINNED   2u  // Reserved at startup (kept until arenaUnpin)
+#define EXTENT_ATTACHED 4u  // Reserved and already attached
+
+// At the beginning of the file
+typedef struct {
+    char magic[8];
+    uint64_t size;
+} ArenaFileHeader_t;
+
+// At the beginning of each extent (the block follows it)
+typedef struct {
+    uint32_t magic;
+    uint32_t flags;
+    uint64_t size;      // Extent bytes (header included)
+    uint64_t prevSize;  // Previous extent bytes (0 for the first one)
+    uint64_t stamp;     // Set on allocation
+} ArenaExtent_t;
+
+// Right after the header of free extents
+typedef struct {
+    uint64_t prev, next;
+} ArenaFreeLinks_t;
+
+_Static_assert(sizeof(ArenaExtent_t) % 16 == 0, "Blocks must stay aligned");
+
+#define EXTENT_AT(arena, offset) ((ArenaExtent_t*) ((arena)->base + (offset)))
+#define OFFSET_OF(arena, extent) ((uint64_t) ((char*) (extent) - (arena)->base))
+#define LINKS_OF(extent)         ((ArenaFreeLinks_t*) ((extent) + 1))
+
+// =============================================================================================
+
+int openArenaFile(const char*, size_t*);
+int classOf(uint64_t);
+void pushFree(Arena_t*, uint64_t);
+void popFree(Arena_t*, uint64_t);
+void makeFreeExtent(Arena_t*, uint64_t, uint64_t, uint64_t);
+uint64_t findFree(Arena_t*, uint64_t);
+void freeExtent(Arena_t*, uint64_t);
+void updateNextPrevSize(Arena_t*, uint64_t);
+int isValidRef(Arena_t*, ArenaRef_t);
+void appendOffset(uint64_t**, size_t*, size_t*, uint64_t);
+int compareOffsets(const void*, const void*);
+
+// =============================================================================================
+
+int initArena(Arena_t* arena, const char* filename, size_t size) {
+    size = (MAX(size, 2 * ARENA_HEADER_SIZE)) / ARENA_HEADER_SIZE * ARENA_HEADER_SIZE;
+    if ((arena->fd = openArenaFile(filename, &size)) == -1) return -1;
+
+    int err = 0;
+    arena->base = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, arena->fd, 0);
+    if (arena->base == MAP_FAILED) {
+        err = errno;
+        close(arena->fd);
+        errno = err;
+        return -1;
+    }
+    if ((err = pthread_mutex_init(&arena->mutex, NULL)) != 0) {
+        munmap(arena->base, size);
+        close(arena->fd);
+        errno = err;
+        return -1;
+    }
+
+    // Stamps of this run follow the ones of the previous runs (time based)
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    arena->nextStamp = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+
+    arena->size   = size;
+    arena->ready  = 0;
+    arena->sealed = 0;
+    memset(arena->freeHeads, 0, sizeof(arena->freeHeads));
+    arena->freeClasses   = 0;
+    arena->reserved      = NULL;
+    arena->reservedCount = 0;
+    arena->reservedCap   = 0;
+    arena->released      = NULL;
+    arena->releasedCount = 0;
+    arena->releasedCap   = 0;
+    arena->extentsUsed     = 0; arena->bytesUsed     = 0;
+    arena->extentsFree     = 0; arena->bytesFree     = 0;
+    arena->extentsReserved = 0; arena->bytesReserved = 0;
+    return 0;
+}
+
+void destroyArena(Arena_t* arena) {
+    munmap(arena->base, arena->size);
+    close(arena->fd);
+    free(arena->reserved);
+    free(arena->released);
+    pthread_mutex_destroy(&arena->mutex);
+}
+
+void* arenaAlloc(Arena_t* arena, size_t size) {
+    uint64_t need = (size + sizeof(ArenaExtent_t) + ARENA_UNIT - 1) / ARENA_UNIT * ARENA_UNIT;
+
+    lock_mutex(&arena->mutex);
+
+    uint64_t offset = 0;
+    if (!arena->ready || arena->sealed || (offset = findFree(arena, need)) == 0) {
+        unlock_mutex(&arena->mutex);
+        return NULL;
+    }
+    popFree(arena, offset);
+
+    // Split (the rest stays free)
+    ArenaExtent_t* extent = EXTENT_AT(arena, offset);
+    if (extent->size - need >= ARENA_UNIT) {
+        makeFreeExtent(arena, offset + need, extent->size - need, need);
+        extent->size = need;
+    }
+    extent->flags = EXTENT_USED;
+    extent->stamp = arena->nextStamp++;
+
+    arena->extentsUsed += 1;
+    arena->bytesUsed   += extent->size;
+
+    unlock_mutex(&arena->mutex);
+    return extent + 1;
+}
+
+void arenaFree(Arena_t* arena, void* ptr) {
+    ArenaExtent_t* extent = ((ArenaExtent_t*) ptr) - 1;
+
+    lock_mutex(&arena->mutex);
+    if (!arena->sealed) {
+        // A snapshot can still refer to its bytes
+        if (extent->flags & EXTENT_PINNED) appendOffset(&arena->released, &arena->releasedCount, &arena->releasedCap, OFFSET_OF(arena, extent));
+        else freeExtent(arena, OFFSET_OF(arena, extent));
+    }
+    unlock_mutex(&arena->mutex);
+}
+
+int arenaContains(const Arena_t* arena, const void* ptr) {
+    return arena && (const char*) ptr >= arena->base && (const char*) ptr < arena->base + arena->size;
+}
+
+ArenaRef_t arenaRef(Arena_t* arena, const void* ptr) {
+    const ArenaExtent_t* extent = ((const ArenaExtent_t*) ptr) - 1;
+    ArenaRef_t ref = { OFFSET_OF(arena, extent), extent->stamp };
+    return ref;
+}
+
+int arenaReserve(Arena_t* arena, ArenaRef_t ref) {
+    lock_mutex(&arena->mutex);
+
+    int res = !arena->ready && isValidRef(arena, ref);
+    if (res) {
+        EXTENT_AT(arena, ref.offset)->flags = EXTENT_USED | EXTENT_PINNED;
+        appendOffset(&arena->reserved, &arena->reservedCount, &arena->reservedCap, ref.offset);
+    }
+
+    unlock_mutex(&arena->mutex);
+    return res;
+}
+
+void* arenaAttach(Arena_t* arena, ArenaRef_t ref, size_t* size, int* first) {
+    lock_mutex(&arena->mutex);
+
+    // Only reserved extents (offsets are sorted by arenaRebuild)
+    void* res = NULL;
+    if (arena->ready && bsearch(&ref.offset, arena->reserved, arena->reservedCount, sizeof(uint64_t), compareOffsets) && isValidRef(arena, ref)) {
+        ArenaExtent_t* extent = EXTENT_AT(arena, ref.offset);
+        *first = !(extent->flags & EXTENT_ATTACHED);
+        *size  = extent->size - sizeof(ArenaExtent_t);
+        extent->flags |= EXTENT_ATTACHED;
+        res = extent + 1;
+    }
+
+    unlock_mutex(&arena->mutex);
+    return res;
+}
+
+void arenaRebuild(Arena_t* arena) {
+    lock_mutex(&arena->mutex);
+
+    // Reserved extents in order (the same one can be referenced by more files)
+    qsort(arena->reserved, arena->reservedCount, sizeof(uint64_t), compareOffsets);
+    size_t count = 0;
+    for (size_t i = 0; i < arena->reservedCount; ++i)
+        if (count == 0 || arena->reserved[count - 1] != arena->reserved[i]) arena->reserved[count++] = arena->reserved[i];
+    arena->reservedCount = count;
+
+    // Holes between them become free extents
+    uint64_t cursor = ARENA_HEADER_SIZE, prevSize = 0;
+    for (size_t i = 0; i < arena->reservedCount; ++i) {
+        ArenaExtent_t* extent = EXTENT_AT(arena, arena->reserved[i]);
+        if (arena->reserved[i] > cursor) {
+            makeFreeExtent(arena, cursor, arena->reserved[i] - cursor, prevSize);
+            prevSize = arena->reserved[i] - cursor;
+        }
+        extent->prevSize = prevSize;
+        prevSize = extent->size;
+        cursor   = arena->reserved[i] + extent->size;
+
+        arena->extentsUsed     += 1;
+        arena->bytesUsed       += extent->size;
+        arena->extentsReserved += 1;
+        arena->bytesReserved   += extent->size;
+    }
+    if (cursor < arena->size) makeFreeExtent(arena, cursor, arena->size - cursor, prevSize);
+    arena->ready = 1;
+
+    unlock_mutex(&arena->mutex);
+}
+
+void arenaUnpin(Arena_t* arena) {
+    lock_mutex(&arena->mutex);
+
+    for (size_t i = 0; i < arena->reservedCount; ++i) EXTENT_AT(arena, arena->reserved[i])->flags &= ~(EXTENT_PINNED | EXTENT_ATTACHED);
+    for (size_t i = 0; i < arena->releasedCount && !arena->sealed; ++i) freeExtent(arena, arena->released[i]);
+    free(arena->reserved);
+    free(arena->released);
+    arena->reserved      = NULL;
+    arena->reservedCount = 0;
+    arena->reservedCap   = 0;
+    arena->released      = NULL;
+    arena->releasedCount = 0;
+    arena->releasedCap   = 0;
+
+    unlock_mutex(&arena->mutex);
+}
+
+int arenaSeal(Arena_t* arena) {
+    lock_mutex(&arena->mutex);
+    arena->sealed = 1;
+    unlock_mutex(&arena->mutex);
+
+    return msync(arena->base, arena->size, MS_SYNC);
+}
+
+ArenaInfo_t arenaInfo(Arena_t* arena) {
+    lock_mutex(&arena->mutex);
+    ArenaInfo_t result = {
+        .size            = arena->size,
+        .extentsUsed     = arena->extentsUsed,
+        .bytesUsed       = arena->bytesUsed,
+        .extentsFree     = arena->extentsFree,
+        .bytesFree       = arena->bytesFree,
+        .extentsReserved = arena->extentsReserved,
+        .bytesReserved   = arena->bytesReserved
+    };
+    unlock_mutex(&arena->mutex);
+    return result;
+}
+
+// =============================================================================================
+
+int openArenaFile(const char* filename, size_t* size) {
+    int fd = open(filename, O_RDWR | O_CREAT, 0600);
+    if (fd == -1) return -1;
+
+    // Previous arena (never shrunk: extents to keep could be after the end)
+    struct stat st;
+    ArenaFileHeader_t header;
+    int reuse = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && memcmp(header.magic, ARENA_MAGIC, sizeof(header.magic)) == 0 && header.size == (uint64_t) st.st_size;
+    if (reuse && (size_t) st.st_size > *size) {
+        LOG_WARN("[#AR] Arena file '%s' is bigger (%lld bytes) than requested: using its size", filename, (long long) st.st_size);
+        *size = st.st_size;
+    }
+
+    // New (or grown) file: unused bytes are holes
+    if (!reuse || (size_t) st.st_size < *size) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, ARENA_MAGIC, sizeof(header.magic));
+        header.size = *size;
+        if ((!reuse && ftruncate(fd, 0) == -1) || ftruncate(fd, *size) == -1 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            int err = errno;
+            close(fd);
+            errno = err;
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int classOf(uint64_t size) {
+    int res = 63 - __builtin_clzll(size / ARENA_UNIT);
+    return (MIN(res, ARENA_CLASSES - 1));
+}
+
+// Must be called holding arena's mutex
+void pushFree(Arena_t* arena, uint64_t offset) {
+    ArenaExtent_t* extent = EXTENT_AT(arena, offset);
+    int c = classOf(extent->size);
+
+    LINKS_OF(extent)->prev = 0;
+    LINKS_OF(extent)->next = arena->freeHeads[c];
+    if (arena->freeHeads[c]) LINKS_OF(EXTENT_AT(arena, arena->freeHeads[c]))->prev = offset;
+    arena->freeHeads[c]  = offset;
+    arena->freeClasses  |= 1ull << c;
+
+    arena->extentsFree += 1;
+    arena->bytesFree   += extent->size;
+}
+
+// Must be called holding arena's mutex
+void popFree(Arena_t* arena, uint64_t offset) {
+    ArenaExtent_t* extent  = EXTENT_AT(arena, offset);
+    ArenaFreeLinks_t* links = LINKS_OF(extent);
+    int c = classOf(extent->size);
+
+    if (links->prev) LINKS_OF(EXTENT_AT(arena, links->prev))->next = links->next;
+    else arena->freeHeads[c] = links->next;
+    if (links->next) LINKS_OF(EXTENT_AT(arena, links->next))->prev = links->prev;
+    if (arena->freeHeads[c] == 0) arena->freeClasses &= ~(1ull << c);
+
+    arena->extentsFree -= 1;
+    arena->bytesFree   -= extent->size;
+}
+
+// Must be called holding arena's mutex
+void makeFreeExtent(Arena_t* arena, uint64_t offset, uint64_t size, uint64_t prevSize) {
+    ArenaExtent_t* extent = EXTENT_AT(arena, offset);
+    extent->magic    = EXTENT_MAGIC;
+    extent->flags    = 0;
+    extent->size     = size;
+    extent->prevSize = prevSize;
+    extent->stamp    = 0;
+    updateNextPrevSize(arena, offset);
+    pushFree(arena, offset);
+}
+
+// Must be called holding arena's mutex
+uint64_t findFree(Arena_t* arena, uint64_t size) {
+    // First fit inside the class of the size
+    int c = classOf(size);
+    for (uint64_t offset = arena->freeHeads[c]; offset; offset = LINKS_OF(EXTENT_AT(arena, offset))->next)
+        if (EXTENT_AT(arena, offset)->size >= size) return offset;
+
+    // Any extent of a bigger class fits
+    uint64_t bigger = (c + 1 < ARENA_CLASSES) ? arena->freeClasses & ~((2ull << c) - 1) : 0;
+    return bigger ? arena->freeHeads[__builtin_ctzll(bigger)] : 0;
+}
+
+// Must be called holding arena's mutex
+void freeExtent(Arena_t* arena, uint64_t offset) {
+    ArenaExtent_t* extent = EXTENT_AT(arena, offset);
+    arena->extentsUsed -= 1;
+    arena->bytesUsed   -= extent->size;
+    extent->flags = 0;
+    extent->stamp = 0;
+
+    // Merge with the following one
+    uint64_t next = offset + extent->size;
+    if (next < arena->size && !(EXTENT_AT(arena, next)->flags & EXTENT_USED)) {
+        popFree(arena, next);
+        extent->size += EXTENT_AT(arena, next)->size;
+    }
+
+    // Merge with the previous one
+    if (extent->prevSize > 0 && !(EXTENT_AT(arena, offset - extent->prevSize)->flags & EXTENT_USED)) {
+        uint64_t prev = offset - extent->prevSize;
+        popFree(arena, prev);
+        EXTENT_AT(arena, prev)->size += extent->size;
+        offset = prev;
+    }
+
+    updateNextPrevSize(arena, offset);
+    pushFree(arena, offset);
+}
+
+// Must be called holding arena's mutex
+void updateNextPrevSize(Arena_t* arena, uint64_t offset) {
+    uint64_t size = EXTENT_AT(arena, offset)->size;
+    if (offset + size < arena->size) EXTENT_AT(arena, offset + size)->prevSize = size;
+}
+
+// Must be called holding arena's mutex
+int isValidRef(Arena_t* arena, ArenaRef_t ref) {
+    if (ref.offset < ARENA_HEADER_SIZE || ref.offset % ARENA_UNIT != 0 || ref.offset + ARENA_UNIT > arena->size) return 0;
+
+    const ArenaExtent_t* extent = EXTENT_AT(arena, ref.offset);
+    return extent->magic == EXTENT_MAGIC && (extent->flags & EXTENT_USED) && extent->stamp == ref.stamp
+        && extent->size >= ARENA_UNIT && extent->size % ARENA_UNIT == 0 && extent->size <= arena->size - ref.offset;
+}
+
+void appendOffset(uint64_t** offsets, size_t* count, size_t* capacity, uint64_t offset) {
+    if (*count == *capacity) {
+        *capacity = (MAX(64, *capacity * 2));
+        *offsets  = (uint64_t*) mem_realloc(*offsets, *capacity * sizeof(uint64_t));
+    }
+    (*offsets)[(*count)++] = offset;
+}
+
+int compareOffsets(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,375 @@
+#include "content.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <common.h>
+#include <huffman_encoding.h>
+
+#include "huge_pages.h"
+
+typedef struct ContentSegment_t {
+    struct ContentSegment_t* next; // Following segment (set before the content grows past this one)
+    atomic_size_t len;             // Bytes used (only the last segment grows)
+    size_t cap;                    // Bytes available
+    char data[];                   // Bytes
+} ContentSegment_t;
+
+struct Content_t {
+    alignas(max_align_t) atomic_int refs; // References count
+    atomic_size_t len;                    // Bytes count (claimed by appends)
+    ContentSegment_t* head;               // First segment (allocated right after the content)
+    ContentSegment_t* tail;               // Last segment (only the appender uses it)
+    int compressed;                       // First (and only) segment holds Huffman coded bytes
+};
+
+typedef struct {
+    alignas(max_align_t) Content_t* content; // Content referenced by the view
+    char* decompressed;                      // Bytes of a compressed content (owned by the view)
+} ContentViewHeader_t;
+
+#define VIEW_HEADER(view) (((ContentViewHeader_t*) (view)) - 1)
+
+// Where contents are allocated (NULL: heap)
+static Arena_t* gArena = NULL;
+static pthread_mutex_t gAttachMutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_llong gOutsideArena   = 0;
+
+// =============================================================================================
+
+ContentSegment_t* createSegment(size_t);
+void writeToSegments(Content_t*, const char*, size_t);
+void overwriteSegments(Content_t*, size_t, const char*, size_t);
+void* allocBlock(size_t);
+void freeBlock(void*, size_t);
+
+// =============================================================================================
+
+Content_t* createContent(const char* data, size_t len) {
+    if (len == 0) return NULL;
+
+    // Header + first segment + bytes
+    Content_t* content = (Content_t*) allocBlock(sizeof(Content_t) + sizeof(ContentSegment_t) + len);
+    atomic_init(&content->refs, 1);
+    atomic_init(&content->len, len);
+    content->head       = (ContentSegment_t*) (content + 1);
+    content->tail       = content->head;
+    content->head->next = NULL;
+    content->head->cap  = len;
+    content->compressed = 0;
+    atomic_init(&content->head->len, len);
+
+    if (data) memcpy(content->head->data, data, len);
+    return content;
+}
+
+Content_t* acquireContent(Content_t* content) {
+    if (content) atomic_fetch_add_explicit(&content->refs, 1, memory_order_relaxed);
+    return content;
+}
+
+void releaseContent(Content_t* content) {
+    if (content == NULL) return;
+
+    // Last reference releases memory
+    if (atomic_fetch_sub_explicit(&content->refs, 1, memory_order_acq_rel) == 1) {
+        ContentSegment_t* segment = content->head->next;
+        while (segment) {
+            ContentSegment_t* next = segment->next;
+            freeBlock(segment, sizeof(ContentSegment_t) + segment->cap);
+            segment = next;
+        }
+        freeBlock(content, sizeof(Content_t) + sizeof(ContentSegment_t) + content->head->cap);
+    }
+}
+
+int isContentShared(const Content_t* content) {
+    return content && atomic_load_explicit(&content->refs, memory_order_acquire) > 1;
+}
+
+Content_t* compressContent(Content_t* content, size_t len, int minSaving) {
+    // Only fresh contents (made by a single segment)
+    if (content == NULL || content->compressed || content->head != content->tail) return content;
+
+    // Keep raw bytes if the saving is too low (incompressible data included)
+    HuffCodingResult_t result = compress_data(content->head->data, len);
+    if (result.size > len - len * minSaving / 100) {
+        free(result.data);
+        return content;
+    }
+
+    // Store coded bytes (appends are not allowed in place: len is never claimable again)
+    Content_t* compressed = createContent(result.data, result.size);
+    compressed->compressed = 1;
+    atomic_store_explicit(&compressed->len, SIZE_MAX, memory_order_relaxed);
+    free(result.data);
+    releaseContent(content);
+    return compressed;
+}
+
+size_t getContentSize(const Content_t* content, size_t len) {
+    if (content && content->compressed) return content->head->cap;
+    return len;
+}
+
+const char* getContentBytes(const Content_t* content, size_t len, size_t* size) {
+    *size = 0;
+    if (content == NULL || content->head != content->tail) return NULL;
+
+    *size = getContentSize(content, len);
+    return content->head->data;
+}
+
+int isContentCompressed(const Content_t* content) {
+    return content && content->compressed;
+}
+
+Content_t* appendToContent(Content_t* content, size_t len, const char* data, size_t dataLen) {
+    // Nothing to keep
+    if (content == NULL) return createContent(data, dataLen);
+    if (dataLen == 0) return content;
+
+    // Claim the bytes after 'len' (fails only if someone else already appended)
+    size_t expected = len;
+    if (!atomic_compare_exchange_strong_explicit(&content->len, &expected, len + dataLen, memory_order_relaxed, memory_order_relaxed)) {
+        // Copy the first 'len' bytes into a new content
+        Content_t* result = createContent(NULL, len + dataLen);
+        copyContent(content, len, result->head->data);
+        memcpy(result->head->data + len, data, dataLen);
+        releaseContent(content);
+        return result;
+    }
+
+    // Only the tail is touched
+    writeToSegments(content, data, dataLen);
+    return content;
+}
+
+Content_t* writeToContent(Content_t* content, size_t len, size_t offset, const char* data, size_t dataLen) {
+    // Nothing to keep
+    if (content == NULL) return createContent(data, dataLen);
+    if (dataLen == 0) return content;
+
+    // Someone else sees these bytes (or they are coded): write into a copy
+    if (content->compressed || isContentShared(content)) {
+        Content_t* result = createContent(NULL, (MAX(len, offset + dataLen)));
+        copyContent(content, len, result->head->data);
+        memcpy(result->head->data + offset, data, dataLen);
+        releaseContent(content);
+        return result;
+    }
+
+    // Overwrite in place, the bytes past the end are appended
+    size_t inside = (offset < len) ? (MIN(dataLen, len - offset)) : 0;
+    overwriteSegments(content, offset, data, inside);
+    return appendToContent(content, len, data + inside, dataLen - inside);
+}
+
+void copyContent(const Content_t* content, size_t len, char* dst) {
+    copyContentRange(content, 0, len, dst);
+}
+
+void copyContentRange(const Content_t* content, size_t offset, size_t len, char* dst) {
+    if (content && content->compressed) {
+        HuffCodingResult_t result = decompress_data(content->head->data, content->head->cap);
+        if (offset < result.size) memcpy(dst, result.data + offset, (MIN(len, result.size - offset)));
+        free(result.data);
+        return;
+    }
+
+    const ContentSegment_t* segment = content ? content->head : NULL;
+    while (len > 0) {
+        // Skip the segments before 'offset'
+        size_t used = atomic_load_explicit(&segment->len, memory_order_relaxed);
+        if (offset >= used) {
+            offset -= used;
+            segment = segment->next;
+            continue;
+        }
+
+        size_t n = (MIN(len, used - offset));
+        memcpy(dst, segment->data + offset, n);
+        dst   += n;
+        len   -= n;
+        offset = 0;
+        // Segments before the last one read are complete
+        if (len > 0) segment = segment->next;
+    }
+}
+
+const struct iovec* createContentView(Content_t* content, size_t len, int* count) {
+    *count = 0;
+    if (content == NULL || len == 0) {
+        releaseContent(content);
+        return NULL;
+    }
+
+    // Compressed: a single segment with the decoded bytes
+    if (content->compressed) {
+        ContentViewHeader_t* header = (ContentViewHeader_t*) mem_malloc(sizeof(ContentViewHeader_t) + sizeof(struct iovec));
+        HuffCodingResult_t result   = decompress_data(content->head->data, content->head->cap);
+        header->content      = content;
+        header->decompressed = result.data;
+
+        struct iovec* view = (struct iovec*) (header + 1);
+        view[0].iov_base   = result.data;
+        view[0].iov_len    = (MIN(len, result.size));
+        *count = 1;
+        return view;
+    }
+
+    // Count segments
+    int n = 0;
+    size_t remaining = len;
+    const ContentSegment_t* segment = content->head;
+    while (remaining > 0) {
+        remaining -= (MIN(remaining, atomic_load_explicit(&segment->len, memory_order_relaxed)));
+        n++;
+        if (remaining > 0) segment = segment->next;
+    }
+
+    // Header + segments
+    ContentViewHeader_t* header = (ContentViewHeader_t*) mem_malloc(sizeof(ContentViewHeader_t) + n * sizeof(struct iovec));
+    header->content      = content;
+    header->decompressed = NULL;
+
+    struct iovec* view = (struct iovec*) (header + 1);
+    remaining = len;
+    segment   = content->head;
+    for (int i = 0; i < n; ++i) {
+        size_t used = (MIN(remaining, atomic_load_explicit(&segment->len, memory_order_relaxed)));
+        view[i].iov_base = (void*) segment->data;
+        view[i].iov_len  = used;
+        remaining       -= used;
+        if (remaining > 0) segment = segment->next;
+    }
+
+    *count = n;
+    return view;
+}
+
+void releaseContentView(const struct iovec* view) {
+    if (view == NULL) return;
+
+    ContentViewHeader_t* header = VIEW_HEADER(view);
+    releaseContent(header->content);
+    free(header->decompressed);
+    free(header);
+}
+
+void useContentArena(Arena_t* arena) {
+    gArena = arena;
+    atomic_store(&gOutsideArena, 0);
+}
+
+long long contentsOutsideArena() {
+    return atomic_load(&gOutsideArena);
+}
+
+int getContentArenaRef(const Content_t* content, ArenaRef_t* ref) {
+    if (content == NULL || content->head != content->tail || !arenaContains(gArena, content)) return 0;
+
+    *ref = arenaRef(gArena, content);
+    return 1;
+}
+
+int reserveContent(ArenaRef_t ref) {
+    return gArena && arenaReserve(gArena, ref);
+}
+
+Content_t* attachContent(ArenaRef_t ref) {
+    if (gArena == NULL) return NULL;
+
+    // Files sharing the content attach it more times: only the first one sets it up
+    lock_mutex(&gAttachMutex);
+    size_t size   = 0;
+    int first     = 0;
+    Content_t* content = (Content_t*) arenaAttach(gArena, ref, &size, &first);
+    if (content && first) {
+        // Pointers of the previous run are meaningless, lengths are still there
+        ContentSegment_t* head = (ContentSegment_t*) (content + 1);
+        if (size < sizeof(Content_t) + sizeof(ContentSegment_t) || head->cap > size - sizeof(Content_t) - sizeof(ContentSegment_t)) {
+            content = NULL;
+        } else {
+            atomic_init(&content->refs, 1);
+            atomic_init(&content->len, content->compressed ? SIZE_MAX : head->cap);
+            atomic_init(&head->len, head->cap);
+            content->head = head;
+            content->tail = head;
+            head->next    = NULL;
+        }
+    } else if (content) {
+        acquireContent(content);
+    }
+    unlock_mutex(&gAttachMutex);
+    return content;
+}
+
+// =============================================================================================
+
+ContentSegment_t* createSegment(size_t cap) {
+    ContentSegment_t* segment = (ContentSegment_t*) allocBlock(sizeof(ContentSegment_t) + cap);
+    segment->next = NULL;
+    segment->cap  = cap;
+    atomic_init(&segment->len, 0);
+    return segment;
+}
+
+void writeToSegments(Content_t* content, const char* data, size_t dataLen) {
+    while (dataLen > 0) {
+        ContentSegment_t* tail = content->tail;
+        size_t used = atomic_load_explicit(&tail->len, memory_order_relaxed);
+
+        // Tail is full: link a new one (big appends get a single segment)
+        if (used == tail->cap) {
+            tail->next    = createSegment((MAX(dataLen, CONTENT_SEGMENT_SIZE)));
+            content->tail = tail->next;
+            continue;
+        }
+
+        // Fill tail
+        size_t n = (MIN(dataLen, tail->cap - used));
+        memcpy(tail->data + used, data, n);
+        atomic_store_explicit(&tail->len, used + n, memory_order_relaxed);
+        data    += n;
+        dataLen -= n;
+    }
+}
+
+void overwriteSegments(Content_t* content, size_t offset, const char* data, size_t dataLen) {
+    ContentSegment_t* segment = content->head;
+    while (dataLen > 0) {
+        // Skip the segments before 'offset'
+        size_t used = atomic_load_explicit(&segment->len, memory_order_relaxed);
+        if (offset >= used) {
+            offset -= used;
+            segment = segment->next;
+            continue;
+        }
+
+        size_t n = (MIN(dataLen, used - offset));
+        memcpy(segment->data + offset, data, n);
+        data    += n;
+        dataLen -= n;
+        offset   = 0;
+        segment  = segment->next;
+    }
+}
+
+void* allocBlock(size_t size) {
+    void* block = gArena ? arenaAlloc(gArena, size) : NULL;
+    if (block) return block;
+
+    // Arena full (or disabled): heap (big blocks on huge pages)
+    if (gArena) atomic_fetch_add_explicit(&gOutsideArena, 1, memory_order_relaxed);
+    return hugeAlloc(size, 0);
+}
+
+void freeBlock(void* block, size_t size) {
+    if (arenaContains(gArena, block)) arenaFree(gArena, block);
+    else hugeFree(block, size);
+}
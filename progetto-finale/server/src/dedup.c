@@ -0,0 +1,166 @@
+#include "dedup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <logger.h>
+
+#define ENTRIES_PER_SLAB 256
+
+struct DedupEntry_t {
+    HashTableNode_t node; // Hashmap node (MUST be the first field)
+    Content_t* content;   // Shared content (1 reference)
+    const char* bytes;    // Content's stored bytes
+    size_t size;          // Stored bytes count
+    size_t len;           // Content length
+    int compressed;       // Bytes are compressed
+    int files;            // Files referencing the entry
+};
+
+// Key used to look for an entry
+typedef struct {
+    const char* bytes;
+    size_t size;
+    size_t len;
+    int compressed;
+} DedupKey_t;
+
+// =============================================================================================
+
+DedupStripe_t* getStripe(DedupIndex_t*, HashValue64);
+int entryHasBytes(const HashTableNode_t*, const void*, size_t);
+
+// =============================================================================================
+
+void initDedupIndex(DedupIndex_t* index, size_t capacity) {
+    for (int i = 0; i < DEDUP_STRIPES; ++i) {
+        DedupStripe_t* stripe = &index->stripes[i];
+        if (pthread_mutex_init(&stripe->mutex, NULL) != 0) {
+            LOG_ERRNO("Error creating dedup index mutex");
+            exit(EXIT_FAILURE);
+        }
+        initHashTable(&stripe->table, capacity / DEDUP_STRIPES, entryHasBytes);
+        stripe->filesCount    = 0;
+        stripe->contentsCount = 0;
+        stripe->bytesLogical  = 0;
+        stripe->bytesUnique   = 0;
+    }
+    initSlab(&index->entries, sizeof(DedupEntry_t), ENTRIES_PER_SLAB);
+}
+
+void destroyDedupIndex(DedupIndex_t* index) {
+    for (int i = 0; i < DEDUP_STRIPES; ++i) {
+        DedupStripe_t* stripe = &index->stripes[i];
+
+        // Release contents (entries memory is released with the pool)
+        HashTableIter_t iter = { 0 };
+        HashTableNode_t* node = NULL;
+        while ((node = hashTableIterate(&stripe->table, &iter)) != NULL)
+            releaseContent(((DedupEntry_t*) node)->content);
+
+        destroyHashTable(&stripe->table);
+        pthread_mutex_destroy(&stripe->mutex);
+    }
+    destroySlab(&index->entries);
+}
+
+HashValue64 dedupHash(const Content_t* content, size_t len) {
+    size_t size = 0;
+    const char* bytes = getContentBytes(content, len, &size);
+    if (bytes == NULL) return 0;
+
+    // Same bytes, different meaning when compressed
+    return hash_string_64(bytes, (int) size) ^ (HashValue64) isContentCompressed(content);
+}
+
+DedupEntry_t* dedupAcquire(DedupIndex_t* index, Content_t** content, size_t len, HashValue64 hash, long long* bytes) {
+    *bytes = 0;
+
+    // Only contents made by a single segment
+    DedupKey_t key = { NULL, 0, len, isContentCompressed(*content) };
+    if ((key.bytes = getContentBytes(*content, len, &key.size)) == NULL) return NULL;
+
+    DedupStripe_t* stripe = getStripe(index, hash);
+    lock_mutex(&stripe->mutex);
+    DedupEntry_t* entry = (DedupEntry_t*) hashTableFind(&stripe->table, hash, &key, sizeof(DedupKey_t));
+    if (entry != NULL) {
+        // Share the indexed content
+        releaseContent(*content);
+        *content = acquireContent(entry->content);
+    } else {
+        // Index the new content
+        entry = (DedupEntry_t*) slabAlloc(&index->entries);
+        entry->node.next  = NULL;
+        entry->node.hash  = hash;
+        entry->content    = acquireContent(*content);
+        entry->bytes      = key.bytes;
+        entry->size       = key.size;
+        entry->len        = len;
+        entry->compressed = key.compressed;
+        entry->files      = 0;
+        hashTableInsert(&stripe->table, &entry->node);
+
+        stripe->contentsCount += 1;
+        stripe->bytesUnique   += entry->size;
+        *bytes = entry->size;
+    }
+    entry->files         += 1;
+    stripe->filesCount   += 1;
+    stripe->bytesLogical += entry->size;
+    unlock_mutex(&stripe->mutex);
+
+    // Returns the entry
+    return entry;
+}
+
+long long dedupRelease(DedupIndex_t* index, DedupEntry_t* entry) {
+    if (entry == NULL) return 0;
+
+    long long bytes = 0;
+    DedupStripe_t* stripe = getStripe(index, entry->node.hash);
+    lock_mutex(&stripe->mutex);
+    entry->files         -= 1;
+    stripe->filesCount   -= 1;
+    stripe->bytesLogical -= entry->size;
+    if (entry->files == 0) {
+        // Last file: drop the content
+        hashTableRemove(&stripe->table, &entry->node);
+        stripe->contentsCount -= 1;
+        stripe->bytesUnique   -= entry->size;
+        bytes = -(long long) entry->size;
+        releaseContent(entry->content);
+        slabFree(&index->entries, entry);
+    }
+    unlock_mutex(&stripe->mutex);
+
+    // Returns bytes released
+    return bytes;
+}
+
+DedupInfo_t dedupInfo(DedupIndex_t* index) {
+    DedupInfo_t result = { 0, 0, 0, 0 };
+    for (int i = 0; i < DEDUP_STRIPES; ++i) {
+        DedupStripe_t* stripe = &index->stripes[i];
+        lock_mutex(&stripe->mutex);
+        result.filesCount    += stripe->filesCount;
+        result.contentsCount += stripe->contentsCount;
+        result.bytesLogical  += stripe->bytesLogical;
+        result.bytesUnique   += stripe->bytesUnique;
+        unlock_mutex(&stripe->mutex);
+    }
+    return result;
+}
+
+// =============================================================================================
+
+DedupStripe_t* getStripe(DedupIndex_t* index, HashValue64 hash) {
+    // High bits (buckets are chosen with the low ones)
+    return &index->stripes[hash >> 60];
+}
+
+int entryHasBytes(const HashTableNode_t* node, const void* key, size_t keyLen) {
+    const DedupEntry_t* entry = (const DedupEntry_t*) node;
+    const DedupKey_t* other   = (const DedupKey_t*) key;
+    return entry->len == other->len && entry->size == other->size && entry->compressed == other->compressed
+        && memcmp(entry->bytes, other->bytes, entry->size) == 0;
+}
@@ -0,0 +1,727 @@
+#include "eviction.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <logger.h>
+
+#include "hash_table.h"
+#include "sketch.h"
+#include "slab.h"
+
+#define GHOSTS_PER_SLAB 256
+
+// S3-FIFO: max accesses remembered
+#define S3FIFO_MAX_FREQ 3
+
+// GDSF: max accesses remembered, cost of a miss (same for every item: maximize object hits)
+#define GDSF_MAX_FREQ (1 << 24)
+#define GDSF_COST 1.0
+
+// Items queue (head: newest, tail: oldest)
+typedef struct {
+    EvictionNode_t* head;
+    EvictionNode_t* tail;
+    int size;
+} EvictionQueue_t;
+
+// Evicted key, remembered by hash only
+typedef struct GhostNode_t {
+    HashTableNode_t node;     // MUST be the first field
+    struct GhostNode_t* pre;  // Older ghost
+    struct GhostNode_t* nex;  // Newer ghost
+} GhostNode_t;
+
+// FIFO of evicted keys
+typedef struct {
+    HashTable_t table;
+    Slab_t pool;
+    GhostNode_t* head;
+    GhostNode_t* tail;
+    int size;
+} Ghost_t;
+
+// Policy implementation
+typedef struct {
+    const char* name;
+    int queues;
+    const char* queueNames[EVICTION_MAX_QUEUES];
+    int ghosts;
+    void (*init)(EvictionPolicy_t*);
+    void (*insert)(EvictionPolicy_t*, EvictionNode_t*);
+    void (*touch)(EvictionPolicy_t*, EvictionNode_t*);
+    void (*read)(EvictionPolicy_t*, EvictionNode_t*);
+    void (*remove)(EvictionPolicy_t*, EvictionNode_t*, int);
+    EvictionNode_t* (*victim)(EvictionPolicy_t*, EvictionNode_t*);
+} EvictionOps_t;
+
+struct EvictionPolicy_t {
+    int type;
+    const EvictionOps_t* ops;
+    int capacity;                                // Max items count
+    EvictionQueue_t queues[EVICTION_MAX_QUEUES]; // Items queues
+    long long evictions[EVICTION_MAX_QUEUES];    // Evictions count for each queue
+    Ghost_t ghosts[2];                           // S3-FIFO: G. ARC: B1, B2
+    EvictionNode_t* hand;                        // CLOCK: next node to visit
+    int smallTarget;                             // S3-FIFO: small queue max size
+    int p;                                       // ARC: T1 target size
+    int windowTarget;                            // W-TinyLFU: window max size
+    int protectedTarget;                         // W-TinyLFU: protected segment max size
+    FreqSketch_t sketch;                         // W-TinyLFU: access frequencies
+    EvictionNode_t** heap;                       // GDSF: min heap on priority
+    int heapSize, heapCapacity;                  // GDSF: heap items count, heap array size
+    double inflation;                            // GDSF: priority of the last victim (L)
+};
+
+// =============================================================================================
+
+void queuePush(EvictionQueue_t*, EvictionNode_t*);
+void queueInsertBefore(EvictionQueue_t*, EvictionNode_t*, EvictionNode_t*);
+void queueUnlink(EvictionQueue_t*, EvictionNode_t*);
+void queueMove(EvictionPolicy_t*, EvictionNode_t*, int);
+int totalSize(EvictionPolicy_t*);
+void setReferenced(EvictionNode_t*);
+int takeReferenced(EvictionNode_t*);
+void defaultRemove(EvictionPolicy_t*, EvictionNode_t*, int);
+
+void initGhost(Ghost_t*, int);
+void destroyGhost(Ghost_t*);
+void ghostPush(Ghost_t*, HashValue64);
+void ghostUnlink(Ghost_t*, GhostNode_t*);
+void ghostDropOldest(Ghost_t*);
+int ghostTake(Ghost_t*, HashValue64);
+
+void lruInsert(EvictionPolicy_t*, EvictionNode_t*);
+void lruTouch(EvictionPolicy_t*, EvictionNode_t*);
+void lruRead(EvictionPolicy_t*, EvictionNode_t*);
+EvictionNode_t* lruVictim(EvictionPolicy_t*, EvictionNode_t*);
+
+EvictionNode_t* clockNext(EvictionPolicy_t*, EvictionNode_t*);
+void clockInsert(EvictionPolicy_t*, EvictionNode_t*);
+void clockRemove(EvictionPolicy_t*, EvictionNode_t*, int);
+EvictionNode_t* clockVictim(EvictionPolicy_t*, EvictionNode_t*);
+
+void s3fifoInit(EvictionPolicy_t*);
+void s3fifoInsert(EvictionPolicy_t*, EvictionNode_t*);
+void s3fifoRead(EvictionPolicy_t*, EvictionNode_t*);
+void s3fifoRemove(EvictionPolicy_t*, EvictionNode_t*, int);
+EvictionNode_t* s3fifoVictim(EvictionPolicy_t*, EvictionNode_t*);
+
+void arcInsert(EvictionPolicy_t*, EvictionNode_t*);
+void arcRemove(EvictionPolicy_t*, EvictionNode_t*, int);
+void arcTrimGhosts(EvictionPolicy_t*);
+EvictionNode_t* arcVictim(EvictionPolicy_t*, EvictionNode_t*);
+
+void tinyLfuInit(EvictionPolicy_t*);
+void tinyLfuInsert(EvictionPolicy_t*, EvictionNode_t*);
+void tinyLfuRead(EvictionPolicy_t*, EvictionNode_t*);
+EvictionNode_t* tinyLfuMainVictim(EvictionPolicy_t*, EvictionNode_t*, int*);
+EvictionNode_t* tinyLfuVictim(EvictionPolicy_t*, EvictionNode_t*);
+
+void gdsfPriority(EvictionPolicy_t*, EvictionNode_t*);
+void heapSet(EvictionPolicy_t*, int, EvictionNode_t*);
+void heapFix(EvictionPolicy_t*, int);
+void gdsfInsert(EvictionPolicy_t*, EvictionNode_t*);
+void gdsfTouch(EvictionPolicy_t*, EvictionNode_t*);
+void gdsfRead(EvictionPolicy_t*, EvictionNode_t*);
+void gdsfRemove(EvictionPolicy_t*, EvictionNode_t*, int);
+EvictionNode_t* gdsfVictim(EvictionPolicy_t*, EvictionNode_t*);
+
+// =============================================================================================
+
+// Indexed by EVICTION_*
+static const EvictionOps_t gPolicies[EVICTION_POLICIES] = {
+    { "LRU",       1, { "lru" },                             0, NULL,        lruInsert,     lruTouch,      lruRead,     defaultRemove, lruVictim     },
+    { "CLOCK",     1, { "clock" },                           0, NULL,        clockInsert,   lruRead,       lruRead,     clockRemove,   clockVictim   },
+    { "S3-FIFO",   2, { "small", "main" },                   1, s3fifoInit,  s3fifoInsert,  s3fifoRead,    s3fifoRead,  s3fifoRemove,  s3fifoVictim  },
+    { "ARC",       2, { "recency (T1)", "frequency (T2)" },  2, NULL,        arcInsert,     lruRead,       lruRead,     arcRemove,     arcVictim     },
+    { "W-TINYLFU", 3, { "window", "probation", "protected" }, 0, tinyLfuInit, tinyLfuInsert, tinyLfuRead,   tinyLfuRead, defaultRemove, tinyLfuVictim },
+    { "GDSF",      1, { "heap" },                            0, NULL,        gdsfInsert,    gdsfTouch,     gdsfRead,    gdsfRemove,    gdsfVictim    },
+};
+
+// =============================================================================================
+
+EvictionPolicy_t* createEvictionPolicy(int type, int capacity) {
+    EvictionPolicy_t* policy = (EvictionPolicy_t*) mem_calloc(1, sizeof(EvictionPolicy_t));
+    policy->type     = (type >= 0 && type < EVICTION_POLICIES) ? type : EVICTION_LRU;
+    policy->ops      = &gPolicies[policy->type];
+    policy->capacity = MAX(1, capacity);
+    for (int i = 0; i < policy->ops->ghosts; ++i)
+        initGhost(&policy->ghosts[i], policy->capacity);
+    if (policy->ops->init != NULL) policy->ops->init(policy);
+    return policy;
+}
+
+void destroyEvictionPolicy(EvictionPolicy_t* policy) {
+    if (policy == NULL) return;
+    for (int i = 0; i < policy->ops->ghosts; ++i)
+        destroyGhost(&policy->ghosts[i]);
+    if (policy->type == EVICTION_WTINYLFU) destroySketch(&policy->sketch);
+    free(policy->heap);
+    free(policy);
+}
+
+void evictionInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    node->pre = node->nex = NULL;
+    node->queue = 0;
+    atomic_store_explicit(&node->referenced, 0, memory_order_relaxed);
+    atomic_store_explicit(&node->freq, 0, memory_order_relaxed);
+    policy->ops->insert(policy, node);
+}
+
+void evictionTouch(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    policy->ops->touch(policy, node);
+}
+
+void evictionRead(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    policy->ops->read(policy, node);
+}
+
+void evictionRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted) {
+    if (evicted) policy->evictions[node->queue]++;
+    policy->ops->remove(policy, node, evicted);
+}
+
+EvictionNode_t* evictionVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    return policy->ops->victim(policy, protect);
+}
+
+int evictionStats(EvictionPolicy_t* policy, long long* counts) {
+    for (int i = 0; i < policy->ops->queues; ++i)
+        counts[i] += policy->evictions[i];
+    return policy->ops->queues;
+}
+
+const char* evictionPolicyName(int type) {
+    if (type < 0 || type >= EVICTION_POLICIES) return "UNKNOWN";
+    return gPolicies[type].name;
+}
+
+const char* evictionQueueName(int type, int queue) {
+    if (type < 0 || type >= EVICTION_POLICIES || queue < 0 || queue >= gPolicies[type].queues) return "UNKNOWN";
+    return gPolicies[type].queueNames[queue];
+}
+
+int parseEvictionPolicy(const char* str) {
+    for (int i = 0; i < EVICTION_POLICIES; ++i)
+        if (strcmp(str, gPolicies[i].name) == 0)
+            return i;
+    return -1;
+}
+
+// =============================================================================================
+// Queues
+
+void queuePush(EvictionQueue_t* queue, EvictionNode_t* node) {
+    node->pre = queue->head;
+    node->nex = NULL;
+    if (queue->head != NULL) queue->head->nex = node;
+    else queue->tail = node;
+    queue->head = node;
+    queue->size++;
+}
+
+void queueInsertBefore(EvictionQueue_t* queue, EvictionNode_t* node, EvictionNode_t* at) {
+    node->nex = at;
+    node->pre = at->pre;
+    if (at->pre != NULL) at->pre->nex = node;
+    else queue->tail = node;
+    at->pre = node;
+    queue->size++;
+}
+
+void queueUnlink(EvictionQueue_t* queue, EvictionNode_t* node) {
+    if (node->pre != NULL) node->pre->nex = node->nex;
+    else queue->tail = node->nex;
+    if (node->nex != NULL) node->nex->pre = node->pre;
+    else queue->head = node->pre;
+    node->pre = node->nex = NULL;
+    queue->size--;
+}
+
+void queueMove(EvictionPolicy_t* policy, EvictionNode_t* node, int to) {
+    queueUnlink(&policy->queues[node->queue], node);
+    queuePush(&policy->queues[to], node);
+    node->queue = to;
+}
+
+int totalSize(EvictionPolicy_t* policy) {
+    int size = 0;
+    for (int i = 0; i < policy->ops->queues; ++i)
+        size += policy->queues[i].size;
+    return size;
+}
+
+void setReferenced(EvictionNode_t* node) {
+    // Avoid writing the cache line when already set
+    if (!atomic_load_explicit(&node->referenced, memory_order_relaxed))
+        atomic_store_explicit(&node->referenced, 1, memory_order_relaxed);
+}
+
+int takeReferenced(EvictionNode_t* node) {
+    return atomic_exchange_explicit(&node->referenced, 0, memory_order_relaxed);
+}
+
+void defaultRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted) {
+    queueUnlink(&policy->queues[node->queue], node);
+}
+
+// =============================================================================================
+// Ghosts
+
+void initGhost(Ghost_t* ghost, int capacity) {
+    // Lookups are made by hash only
+    initHashTable(&ghost->table, capacity, NULL);
+    initSlab(&ghost->pool, sizeof(GhostNode_t), GHOSTS_PER_SLAB);
+    ghost->head = ghost->tail = NULL;
+    ghost->size = 0;
+}
+
+void destroyGhost(Ghost_t* ghost) {
+    destroyHashTable(&ghost->table);
+    destroySlab(&ghost->pool);
+}
+
+void ghostPush(Ghost_t* ghost, HashValue64 hash) {
+    // Already remembered (hash collision)
+    if (hashTableFind(&ghost->table, hash, NULL, 0) != NULL) return;
+
+    GhostNode_t* node = (GhostNode_t*) slabAlloc(&ghost->pool);
+    node->node.hash = hash;
+    node->pre       = ghost->head;
+    node->nex       = NULL;
+    if (ghost->head != NULL) ghost->head->nex = node;
+    else ghost->tail = node;
+    ghost->head = node;
+    ghost->size++;
+    hashTableInsert(&ghost->table, &node->node);
+}
+
+void ghostUnlink(Ghost_t* ghost, GhostNode_t* node) {
+    if (node->pre != NULL) node->pre->nex = node->nex;
+    else ghost->tail = node->nex;
+    if (node->nex != NULL) node->nex->pre = node->pre;
+    else ghost->head = node->pre;
+    ghost->size--;
+    hashTableRemove(&ghost->table, &node->node);
+    slabFree(&ghost->pool, node);
+}
+
+void ghostDropOldest(Ghost_t* ghost) {
+    if (ghost->tail != NULL) ghostUnlink(ghost, ghost->tail);
+}
+
+int ghostTake(Ghost_t* ghost, HashValue64 hash) {
+    GhostNode_t* node = (GhostNode_t*) hashTableFind(&ghost->table, hash, NULL, 0);
+    if (node == NULL) return 0;
+    ghostUnlink(ghost, node);
+    return 1;
+}
+
+// =============================================================================================
+// LRU (with lazy second chance for read-only accesses)
+
+void lruInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    queuePush(&policy->queues[0], node);
+}
+
+void lruTouch(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    queueUnlink(&policy->queues[0], node);
+    queuePush(&policy->queues[0], node);
+    atomic_store_explicit(&node->referenced, 0, memory_order_relaxed);
+}
+
+void lruRead(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    setReferenced(node);
+}
+
+EvictionNode_t* lruVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    EvictionQueue_t* queue = &policy->queues[0];
+    EvictionNode_t* node   = queue->tail;
+    while (node != NULL) {
+        if (node == protect) {
+            node = node->nex;
+            continue;
+        }
+        // Read since last visit: move to top (moved nodes are visited again, unreferenced)
+        if (node != queue->head && takeReferenced(node)) {
+            EvictionNode_t* next = node->nex;
+            queueUnlink(queue, node);
+            queuePush(queue, node);
+            node = next;
+            continue;
+        }
+        return node;
+    }
+    return NULL;
+}
+
+// =============================================================================================
+// CLOCK (the hand visits from oldest to newest, then wraps)
+
+EvictionNode_t* clockNext(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    return (node->nex != NULL) ? node->nex : policy->queues[0].tail;
+}
+
+void clockInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    // Right behind the hand: it will be the last one visited
+    if (policy->hand == NULL) {
+        queuePush(&policy->queues[0], node);
+        policy->hand = node;
+    }
+    else queueInsertBefore(&policy->queues[0], node, policy->hand);
+}
+
+void clockRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted) {
+    if (policy->hand == node) {
+        policy->hand = clockNext(policy, node);
+        if (policy->hand == node) policy->hand = NULL;
+    }
+    queueUnlink(&policy->queues[0], node);
+}
+
+EvictionNode_t* clockVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    // Two full turns at most
+    int visits = 2 * policy->queues[0].size + 1;
+    while (policy->hand != NULL && visits-- > 0) {
+        EvictionNode_t* node = policy->hand;
+        policy->hand = clockNext(policy, node);
+        if (node == protect || takeReferenced(node)) continue;
+        return node;
+    }
+    return NULL;
+}
+
+// =============================================================================================
+// S3-FIFO (small FIFO filtering one-hit wonders, main FIFO with reinsertion, ghost FIFO)
+
+void s3fifoInit(EvictionPolicy_t* policy) {
+    policy->smallTarget = MAX(1, policy->capacity / 10);
+}
+
+void s3fifoInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    // Recently evicted from small queue: straight to main
+    int queue = ghostTake(&policy->ghosts[0], node->hash) ? 1 : 0;
+    queuePush(&policy->queues[queue], node);
+    node->queue = queue;
+}
+
+void s3fifoRead(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    int freq = atomic_load_explicit(&node->freq, memory_order_relaxed);
+    // A failed exchange means someone else incremented it
+    if (freq < S3FIFO_MAX_FREQ)
+        atomic_compare_exchange_weak_explicit(&node->freq, &freq, freq + 1, memory_order_relaxed, memory_order_relaxed);
+}
+
+void s3fifoRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted) {
+    queueUnlink(&policy->queues[node->queue], node);
+
+    // Remember keys evicted from small queue (as many as main queue can hold)
+    if (evicted && node->queue == 0) {
+        ghostPush(&policy->ghosts[0], node->hash);
+        while (policy->ghosts[0].size > (MAX(1, policy->capacity - policy->smallTarget)))
+            ghostDropOldest(&policy->ghosts[0]);
+    }
+}
+
+EvictionNode_t* s3fifoVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    EvictionQueue_t* small = &policy->queues[0];
+    EvictionQueue_t* large = &policy->queues[1];
+
+    // Each node can be moved (S3FIFO_MAX_FREQ + 1) times at most
+    int moves = (S3FIFO_MAX_FREQ + 1) * totalSize(policy) + 1;
+    while (moves-- > 0) {
+        // Protected entry alone in main cannot be chosen, use small queue
+        int largeEvictable = large->size - (large->tail == protect);
+        if (small->size > 0 && (small->size > policy->smallTarget || largeEvictable == 0)) {
+            EvictionNode_t* node = small->tail;
+            int freq = atomic_exchange_explicit(&node->freq, 0, memory_order_relaxed);
+            // Accessed while in small queue: promote
+            if (node == protect || freq > 0) {
+                queueMove(policy, node, 1);
+                continue;
+            }
+            return node;
+        }
+        if (large->size > 0) {
+            EvictionNode_t* node = large->tail;
+            int freq = atomic_load_explicit(&node->freq, memory_order_relaxed);
+            // Accessed: reinsert with one access less
+            if (node == protect || freq > 0) {
+                if (freq > 0) atomic_store_explicit(&node->freq, freq - 1, memory_order_relaxed);
+                queueMove(policy, node, 1);
+                continue;
+            }
+            return node;
+        }
+        break;
+    }
+    return NULL;
+}
+
+// =============================================================================================
+// ARC (CAR variant: hits only set the reference bit, so they work under a shared lock)
+
+void arcInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    Ghost_t* b1 = &policy->ghosts[0];
+    Ghost_t* b2 = &policy->ghosts[1];
+
+    // Ghost hit: adapt T1's target, the key has been seen twice
+    int queue = 0;
+    if (b1->size > 0 && hashTableFind(&b1->table, node->hash, NULL, 0) != NULL) {
+        policy->p = MIN(policy->capacity, policy->p + (MAX(1, b2->size / b1->size)));
+        ghostTake(b1, node->hash);
+        queue = 1;
+    }
+    else if (b2->size > 0 && hashTableFind(&b2->table, node->hash, NULL, 0) != NULL) {
+        policy->p = MAX(0, policy->p - (MAX(1, b1->size / b2->size)));
+        ghostTake(b2, node->hash);
+        queue = 1;
+    }
+    queuePush(&policy->queues[queue], node);
+    node->queue = queue;
+    arcTrimGhosts(policy);
+}
+
+void arcRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted) {
+    queueUnlink(&policy->queues[node->queue], node);
+    if (evicted) {
+        ghostPush(&policy->ghosts[node->queue], node->hash);
+        arcTrimGhosts(policy);
+    }
+}
+
+void arcTrimGhosts(EvictionPolicy_t* policy) {
+    Ghost_t* b1 = &policy->ghosts[0];
+    Ghost_t* b2 = &policy->ghosts[1];
+    int t1 = policy->queues[0].size;
+    int t2 = policy->queues[1].size;
+
+    // |T1| + |B1| <= c, |T1| + |T2| + |B1| + |B2| <= 2c
+    while (b1->size > 0 && t1 + b1->size > policy->capacity)
+        ghostDropOldest(b1);
+    while (b2->size > 0 && t1 + t2 + b1->size + b2->size > 2 * policy->capacity)
+        ghostDropOldest(b2);
+}
+
+EvictionNode_t* arcVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    EvictionQueue_t* t1 = &policy->queues[0];
+    EvictionQueue_t* t2 = &policy->queues[1];
+
+    // Each node can be moved twice at most
+    int moves = 2 * totalSize(policy) + 1;
+    while (moves-- > 0) {
+        // Protected entry alone in a list cannot be chosen, use the other one
+        int t1Evictable = t1->size - (t1->tail == protect);
+        int t2Evictable = t2->size - (t2->tail == protect);
+        if (t1Evictable > 0 && (t1->size >= (MAX(1, policy->p)) || t2Evictable == 0)) {
+            EvictionNode_t* node = t1->tail;
+            if (node == protect) {
+                queueMove(policy, node, 0);
+                continue;
+            }
+            // Referenced again: frequent
+            if (takeReferenced(node)) {
+                queueMove(policy, node, 1);
+                continue;
+            }
+            return node;
+        }
+        if (t2->size > 0) {
+            EvictionNode_t* node = t2->tail;
+            if (node == protect || takeReferenced(node)) {
+                queueMove(policy, node, 1);
+                continue;
+            }
+            return node;
+        }
+        break;
+    }
+    return NULL;
+}
+
+// =============================================================================================
+// W-TinyLFU (window LRU, segmented LRU main, frequency based admission from window to main)
+
+void tinyLfuInit(EvictionPolicy_t* policy) {
+    policy->windowTarget    = MAX(1, policy->capacity / 100);
+    policy->protectedTarget = MAX(1, (policy->capacity - policy->windowTarget) * 8 / 10);
+    initSketch(&policy->sketch, policy->capacity);
+}
+
+void tinyLfuInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    queuePush(&policy->queues[0], node);
+    sketchIncrement(&policy->sketch, node->hash);
+}
+
+void tinyLfuRead(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    setReferenced(node);
+    sketchIncrement(&policy->sketch, node->hash);
+}
+
+EvictionNode_t* tinyLfuMainVictim(EvictionPolicy_t* policy, EvictionNode_t* protect, int* moves) {
+    EvictionQueue_t* probation = &policy->queues[1];
+    EvictionQueue_t* protected = &policy->queues[2];
+
+    while ((*moves)-- > 0) {
+        if (probation->size > 0) {
+            EvictionNode_t* node = probation->tail;
+            if (node == protect) {
+                queueMove(policy, node, 1);
+                continue;
+            }
+            // Accessed while on probation: protect it (demoting protected's oldest)
+            if (takeReferenced(node)) {
+                queueMove(policy, node, 2);
+                if (protected->size > policy->protectedTarget)
+                    queueMove(policy, protected->tail, 1);
+                continue;
+            }
+            return node;
+        }
+        if (protected->size > 0) {
+            EvictionNode_t* node = protected->tail;
+            if (node == protect || takeReferenced(node)) {
+                queueMove(policy, node, 2);
+                continue;
+            }
+            return node;
+        }
+        break;
+    }
+    return NULL;
+}
+
+EvictionNode_t* tinyLfuVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    EvictionQueue_t* window = &policy->queues[0];
+    sketchAge(&policy->sketch);
+
+    // Each node can be moved three times at most
+    int moves = 3 * totalSize(policy) + 1;
+    while (moves-- > 0) {
+        int windowFull = window->size > policy->windowTarget;
+        if (!windowFull) {
+            EvictionNode_t* node = tinyLfuMainVictim(policy, protect, &moves);
+            if (node != NULL) return node;
+            // Main is empty (or protected): fall back to window
+            if (window->size == 0) break;
+        }
+
+        EvictionNode_t* candidate = window->tail;
+        if (candidate == protect || takeReferenced(candidate)) {
+            queueMove(policy, candidate, 0);
+            continue;
+        }
+        if (!windowFull) return candidate;
+
+        // Window overflow while main has room: just move it
+        if (policy->queues[1].size + policy->queues[2].size < policy->capacity - policy->windowTarget) {
+            queueMove(policy, candidate, 1);
+            continue;
+        }
+
+        // Window overflow: admit candidate into main only if it's more popular than main's victim
+        EvictionNode_t* node = tinyLfuMainVictim(policy, protect, &moves);
+        if (node == NULL) return candidate;
+        if (sketchEstimate(&policy->sketch, candidate->hash) > sketchEstimate(&policy->sketch, node->hash)) {
+            queueMove(policy, candidate, 1);
+            return node;
+        }
+        return candidate;
+    }
+    return NULL;
+}
+
+// =============================================================================================
+// GDSF (Greedy Dual Size Frequency: priority = L + freq * cost / size, evict the lowest).
+// Reads only count accesses: priorities are refreshed lazily, when a node reaches the top
+
+void gdsfPriority(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    node->priorityFreq = atomic_load_explicit(&node->freq, memory_order_relaxed);
+    node->priority     = policy->inflation + node->priorityFreq * GDSF_COST / (double) (MAX(1, node->size));
+}
+
+void heapSet(EvictionPolicy_t* policy, int index, EvictionNode_t* node) {
+    policy->heap[index] = node;
+    node->index         = index;
+}
+
+void heapFix(EvictionPolicy_t* policy, int index) {
+    EvictionNode_t* node = policy->heap[index];
+
+    // Up
+    while (index > 0 && policy->heap[(index - 1) / 2]->priority > node->priority) {
+        heapSet(policy, index, policy->heap[(index - 1) / 2]);
+        index = (index - 1) / 2;
+    }
+
+    // Down
+    while (2 * index + 1 < policy->heapSize) {
+        int child = 2 * index + 1;
+        if (child + 1 < policy->heapSize && policy->heap[child + 1]->priority < policy->heap[child]->priority) child++;
+        if (policy->heap[child]->priority >= node->priority) break;
+        heapSet(policy, index, policy->heap[child]);
+        index = child;
+    }
+    heapSet(policy, index, node);
+}
+
+void gdsfInsert(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    if (policy->heapSize == policy->heapCapacity) {
+        policy->heapCapacity = MAX(policy->capacity, policy->heapCapacity * 2);
+        policy->heap         = (EvictionNode_t**) mem_realloc(policy->heap, policy->heapCapacity * sizeof(EvictionNode_t*));
+    }
+    atomic_store_explicit(&node->freq, 1, memory_order_relaxed);
+    gdsfPriority(policy, node);
+    heapSet(policy, policy->heapSize++, node);
+    heapFix(policy, node->index);
+}
+
+void gdsfTouch(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    // Size may have changed too
+    gdsfRead(policy, node);
+    gdsfPriority(policy, node);
+    heapFix(policy, node->index);
+}
+
+void gdsfRead(EvictionPolicy_t* policy, EvictionNode_t* node) {
+    if (atomic_load_explicit(&node->freq, memory_order_relaxed) < GDSF_MAX_FREQ)
+        atomic_fetch_add_explicit(&node->freq, 1, memory_order_relaxed);
+}
+
+void gdsfRemove(EvictionPolicy_t* policy, EvictionNode_t* node, int evicted) {
+    // Age everything else (newer priorities start from the victim's one)
+    if (evicted && node->priority > policy->inflation) policy->inflation = node->priority;
+
+    // Replace with the last one
+    int index = node->index;
+    EvictionNode_t* last = policy->heap[--policy->heapSize];
+    if (last != node) {
+        heapSet(policy, index, last);
+        heapFix(policy, index);
+    }
+}
+
+EvictionNode_t* gdsfVictim(EvictionPolicy_t* policy, EvictionNode_t* protect) {
+    // Each node can be refreshed once at most
+    int refreshes = policy->heapSize + 1;
+    while (policy->heapSize > 0) {
+        // Protected entry on top: the lowest child goes instead
+        int index = 0;
+        if (policy->heap[0] == protect) {
+            index = 1;
+            if (index >= policy->heapSize) return NULL;
+            if (index + 1 < policy->heapSize && policy->heap[index + 1]->priority < policy->heap[index]->priority) index++;
+        }
+
+        // Accessed since its priority was computed: refresh it and look again
+        EvictionNode_t* node = policy->heap[index];
+        if (refreshes-- > 0 && atomic_load_explicit(&node->freq, memory_order_relaxed) != node->priorityFreq) {
+            gdsfPriority(policy, node);
+            heapFix(policy, index);
+            continue;
+        }
+        return node;
+    }
+    return NULL;
+}
@@ -1,67 +1,355 @@
 #include "file_system.h"
+#include "admission.h"
+#include "arena.h"
+#include "dedup.h"
+#include "eviction.h"
+#include "hash_table.h"
+#include "huge_pages.h"
+#include "latch.h"
+#include "path_index.h"
+#include "persist.h"
+#include "slab.h"
+#include "spill.h"
+#include "timer_wheel.h"
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
 
 #include <logger.h>
 #include <common.h>
 
 #define EMPTY_OWNER -1
+#define SHARED_OWNER -2 // Locked by readers (see the lock queue)
+
+// Entry states: placeholders stand for files moving from or to the disk tier
+#define ENTRY_RESIDENT 0  // File in memory
+#define ENTRY_DEMOTING 1  // Being written to the disk tier
+#define ENTRY_SPILLED 2   // On the disk tier (kept while its lock is held or waited)
+#define ENTRY_PROMOTING 3 // Being read back from the disk tier
 
 #define DEBUG_LOG
 
 // To ensure the server break at certain point when using while
 #define DEPTH_LIMIT 1024*1024
 #define MAX_EJECTED_FILES_AT_SAME_TIME 1024*1024
-#define MAX_CLIENT_WAITING_ON_LOCK 32
+#define MAX_SHARDS_COUNT 256
+#define ENTRIES_PER_SLAB 256
+#define EJECTED_INLINE_COUNT 16
+#define PENDING_INLINE_COUNT 32
+#define READERS_WORDS (MAX_CLIENT_COUNT / 64)
+#define TTL_TICK_MS 10
 
 // Just for summary uses
 #define TIMES(n, x) for (int i = 0; i < n; ++i) { x; }
 
+/**
+ * Client waiting on a file's lock. A client waits for a single lock at a time
+ * (its request is answered once the wait ends), so each client has its own node:
+ * the wait is found by client and removed in O(1) when its session ends.
+ * Everything but 'shard' is protected by the lock of the shard of the file waited.
+ */
+typedef struct FSLockWaiter_t {
+    struct FSLockWaiter_t* pre;       // File's wait list
+    struct FSLockWaiter_t* nex;
+    struct FSCacheEntry_t* entry;     // File waited
+    _Atomic(struct FSShard_t*) shard; // Shard of the file waited (NULL when not waiting)
+    TimerNode_t timer;                // Acquisition timeout (armed only with a timeout)
+    int shared;                       // Waiting for a shared lock
+} FSLockWaiter_t;
+
+/**
+ * Clients waiting on a file's lock (FIFO, unbounded), its readers and its holders' lease.
+ * Readers share the lock until someone waits for it: the ones coming next queue
+ * behind (writers are not starved), then the lock goes to the first client waiting
+ * together with the readers following it.
+ */
+typedef struct {
+    FSLockWaiter_t* head;
+    FSLockWaiter_t* tail;
+    int count;
+    uint64_t* readers;                // Clients holding the lock shared (bits by client, created on first shared lock)
+    int readersCount;
+    TimerNode_t lease;                // Holders' lease (armed only with a lease, renewed by any of them)
+    struct FSCacheEntry_t* entry;     // File it belongs to
+} FSLockQueue_t;
+
 typedef struct FSCacheEntry_t {
-    int owner;                   // owner of the lock (if locked, otherwise -1)
+    HashTableNode_t node;             // Hashmap node (MUST be the first field)
+    int owner;                   // owner of the lock (if locked, SHARED_OWNER if locked by readers, otherwise -1)
     FSFile_t file;                    // Data
-    CircQueue_t* waitingLockQueue;    // Queue of clients waiting on lock
-    struct FSCacheEntry_t* pre, *nex; // Ptr to previous and next entry in list
+    FSLockQueue_t* lockQueue;         // Clients waiting on lock & lease (created on first contention or lease)
+    EvictionNode_t evict;             // Eviction policy node
+    DedupEntry_t* dedup;              // Content shared with identical files (NULL if not indexed)
+    int denseIndex;                   // Position inside the shard's dense array
+    size_t length;                    // Content length once the pending operations are done
+    Latch_t latch;                    // Content latch (file's content and contentLen)
+    TimerNode_t timer;                // Expiry (armed only for files with a TTL)
+    atomic_int refs;                  // Hashmap (while linked) and operations still using the entry
+    int state;                        // ENTRY_* (placeholders are linked in the hashmap only, without content)
 } FSCacheEntry_t;
 
+#define ENTRY_OF(evictNode) ((FSCacheEntry_t*) ((char*) (evictNode) - offsetof(FSCacheEntry_t, evict)))
+
+// Shared contents are counted once in 'bytesUsed' (shards count them for each file)
 typedef struct {
     int slotUsed, slotMax;         // Total slots managment
     long long bytesUsed, bytesMax; // Total bytes managment
-    FSCacheEntry_t* head;          // Ptr to newest entry used
-    FSCacheEntry_t* tail;          // Ptr to oldest entry used (LRU)
 } FSCache_t;
 
+// Size of a file ejected lately (direct mapped by hash: newer ejections overwrite older ones)
+typedef struct {
+    HashValue64 hash;
+    size_t size;
+} FSEjectedSize_t;
+
+/**
+ * Independently locked partition of the cache.
+ * Files are assigned to a shard using their name's hash.
+ * 
+ * 'lock' protects the hashmap and the eviction policy. Reads (obtain, exists)
+ * take it shared and only record the access with atomics: the policy applies
+ * it lazily, under the exclusive lock, when looking for a victim.
+ * Usage counters are written holding both 'lock' (exclusive) and gUsageMutex,
+ * so they can be read holding either of them.
+ *
+ * Contents are not copied or replaced holding 'lock': an operation takes a
+ * ticket of the entry's latch (and pins the entry) holding it, then uses the
+ * content once it is released. Tickets keep the order of the shard lock, so
+ * contents change in the same order of the log. Names never change while
+ * an entry is linked, 'length' and 'evict.size' are the sizes once the
+ * operations holding a ticket are done (the ones to account for).
+ */
+typedef struct FSShard_t {
+    pthread_rwlock_t lock;         // Shard lock
+    HashTable_t hashmap;           // Hashmap (name -> entry)
+    PathIndex_t paths;             // Entries of the hashmap, by name (prefix listing)
+    FSCacheEntry_t** dense;        // Entries of the hashmap, by position (random sampling)
+    int denseCount, denseCap;
+    Slab_t entries;                // Cache entries pool
+    int slotUsed, slotMax;         // Shard slots managment (budget share)
+    long long bytesUsed, bytesMax; // Shard bytes managment (budget share)
+    EvictionPolicy_t* policy;      // Chooses the entries to eject
+    TimerWheel_t timers;           // Expiry of the entries with a TTL
+    TimerWheel_t waitTimers;       // Lock acquisition timeouts (of the clients waiting)
+    TimerWheel_t leaseTimers;      // Lock leases (of the owners)
+    atomic_int queryCount;         // Queries served by the shard
+    PersistLog_t log;              // Write-ahead log (appended holding 'lock' exclusive)
+    atomic_llong holdCount;        // Times 'lock' was held exclusive by a request
+    atomic_llong holdNs, holdMaxNs; // Time it was held (total and longest)
+    FSEjectedSize_t* ejectedSizes; // Files ejected lately, by hash (written holding 'lock' exclusive)
+    size_t ejectedMask;            // 'ejectedSizes' slots count - 1 (power of 2)
+} FSShard_t;
+
+// Entries ejected to make room, collected before releasing them.
+// The first ones are stored inline: most ejections allocate nothing holding the shard lock
+typedef struct {
+    FSCacheEntry_t** entries;
+    int size, capacity;
+    FSCacheEntry_t* inlineEntries[EJECTED_INLINE_COUNT];
+} FSEjectedBuf_t;
+
+// Clients to notify, collected holding a shard lock and published once it is released.
+// The first ones are stored inline, like the ejected entries
+typedef struct {
+    FSLockNotification_t* items;
+    int count, capacity;
+    FSLockNotification_t inlineItems[PENDING_INLINE_COUNT];
+} FSPendingNotifications_t;
+
+// Shards replayed at startup (files of an older layout included)
+typedef struct {
+    atomic_int next;
+    PersistReplay_t results[MAX_SHARDS_COUNT];
+} FSReplayJob_t;
+
 // =============================================================================================
 
+// Random numbers for sampling (xorshift64*, seeded on first use)
+_Thread_local static uint64_t tRandomState = 0;
+
 static FSConfig_t gConfigs;
-static FSCacheEntry_t** gHashmap   = NULL;
-static pthread_mutex_t gFSMutex    = PTHREAD_MUTEX_INITIALIZER;
+static FSShard_t* gShards          = NULL;
+static int gNumShards              = 0;
+static pthread_mutex_t gUsageMutex = PTHREAD_MUTEX_INITIALIZER;
 static FSCache_t gCache;
-static CircQueue_t* gLockQueue     = NULL;
-static pthread_cond_t* gLockCond   = NULL;
-static pthread_mutex_t* gLockMutex = NULL;
-
-// SUMMARY Data
+static DedupIndex_t gDedup;
+static SpillTier_t gSpill;
+static int gSpillEnabled           = 0;
+static pthread_mutex_t gTransitMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gTransitCond   = PTHREAD_COND_INITIALIZER;
+static atomic_ulong gTransitSeq      = 0; // Moves from or to the disk tier ended (changed holding gTransitMutex)
+static int gPersistEnabled         = 0;
+static Arena_t gArena;
+static int gArenaEnabled           = 0;
+static AdmissionFilter_t gAdmission;
+static int gAdmissionEnabled       = 0;
+
+// Snapshot thread
+static pthread_t gSnapshotThread;
+static pthread_mutex_t gSnapshotMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gSnapshotCond   = PTHREAD_COND_INITIALIZER;
+static int gSnapshotStop              = 0;
+
+// Expiry thread (ticks are counted from 'gTtlEpoch')
+static pthread_t gExpiryThread;
+static pthread_mutex_t gExpiryMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gExpiryCond   = PTHREAD_COND_INITIALIZER;
+static int gExpiryStop              = 0;
+static struct timespec gTtlEpoch;
+
+// Clients who got the lock (or lost the file) are notified through here
+static NotifyChannel_t* gLockChannel = NULL;
+
+// Lock queues created (entries waiting on lock or leased)
+static atomic_long gLockQueuesCreated = 0;
+static atomic_long gLockQueuesAlive   = 0;
+static atomic_long gReaderSetsCreated = 0;
+static atomic_long gReaderSetsAlive   = 0;
+
+// Clients waiting on lock (by client)
+static FSLockWaiter_t gLockWaiters[MAX_CLIENT_COUNT];
+
+// SUMMARY Data (protected by gUsageMutex)
 static int gMaxSlotUsed        = 0;
 static long long gMaxBytesUsed = 0;
 static int gCapacityMisses     = 0;
 static int gCapacityMissesMax  = 0;
-static int gQueryCount         = 0;
-
-#define INCREASE_QUERY_COUNT (++gQueryCount)
+static long long gCapacityMissesBytes    = 0;
+static long long gCapacityMissesBytesMax = 0;
+
+// SUMMARY Data (updated under shared locks)
+static atomic_int gReadCount        = 0;
+static atomic_int gReadHitCount     = 0;
+static atomic_llong gReadHitBytes   = 0;
+static atomic_llong gReadMissBytes  = 0;
+static atomic_int gDeclinedCount    = 0;
+static atomic_int gExpiredCount     = 0;
+static atomic_llong gExpiredBytes   = 0;
+static atomic_long gLockWaitCount   = 0;
+static atomic_int gLockWaitMax      = 0;
+static atomic_long gLockTimeoutCount = 0;
+static atomic_long gLockCancelCount = 0;
+static atomic_long gLeaseExpiredCount = 0;
+static atomic_long gSharedLockCount = 0;
+static atomic_int gSharedLockMax    = 0;
+
+// SUMMARY Data (persistence, written by the snapshot thread only)
+static size_t gRestoredFiles     = 0;
+static size_t gRestoredOps       = 0;
+static double gRestoreMs         = 0;
+static int gRestoreThreads       = 0;
+static int gSnapshotsCount       = 0;
+static size_t gSnapshotFiles     = 0;
+static double gSnapshotMs        = 0;
+static double gSnapshotMaxLockMs = 0;
+
+// SUMMARY Data (updated without locks)
+static atomic_int gCompressTried         = 0;
+static atomic_int gCompressStored        = 0;
+static atomic_llong gCompressRawBytes    = 0;
+static atomic_llong gCompressStoredBytes = 0;
+
+#define INCREASE_QUERY_COUNT(shard) atomic_fetch_add_explicit(&(shard)->queryCount, 1, memory_order_relaxed)
 
 // =============================================================================================
 
-HashValue getKey(FSFile_t);
-FSCacheEntry_t* getValueFromKey(HashValue);
-void setValueForKey(HashValue, FSCacheEntry_t*);
-FSCacheEntry_t* createEmptyCacheEntry(FSFile_t);
+FSShard_t* getShard(HashValue64);
+FSCacheEntry_t* getValueFromKey(FSShard_t*, HashValue64, const char*, size_t);
+FSCacheEntry_t* getEntry(FSShard_t*, HashValue64, const char*, size_t);
+int entryHasName(const HashTableNode_t*, const void*, size_t);
+FSCacheEntry_t* createEmptyCacheEntry(FSShard_t*, FSFile_t);
+void addEntry(FSShard_t*, FSCacheEntry_t*);
+void attachEntry(FSShard_t*, FSCacheEntry_t*);
+void removeEntry(FSShard_t*, FSCacheEntry_t*);
+void detachEntry(FSShard_t*, FSCacheEntry_t*);
+size_t ejectedSize(FSShard_t*, HashValue64);
 void freeCacheEntry(FSCacheEntry_t*);
-void moveToTop(FSCacheEntry_t*);
-void updateCacheSize(FSFile_t*, FSFile_t*, FSFile_t**, int*);
-void deepCopyFile(FSFile_t, FSFile_t*);
+void recycleCacheEntry(FSCacheEntry_t*);
+void pinEntry(FSCacheEntry_t*);
+void unpinEntry(FSCacheEntry_t*);
+FSLockQueue_t* getLockQueue(FSCacheEntry_t*);
+void pushWaiter(FSShard_t*, FSCacheEntry_t*, int, int, long);
+void unlinkWaiter(FSShard_t*, FSLockWaiter_t*);
+int isReader(FSCacheEntry_t*, int);
+void addReader(FSCacheEntry_t*, int);
+void removeReader(FSCacheEntry_t*, int);
+int mustWait(FSCacheEntry_t*, int, int);
+void grantLock(FSShard_t*, FSCacheEntry_t*, int, int);
+void releaseLock(FSShard_t*, FSCacheEntry_t*, FSPendingNotifications_t*);
+int isOverCapacity();
+int isOverShare(FSShard_t*);
+void updateUsage(FSShard_t*, long long, long long, int);
+void unlinkEntry(FSShard_t*, FSCacheEntry_t*, int);
+void releaseEntrySpace(FSShard_t*, FSCacheEntry_t*, int);
+void pushEjected(FSEjectedBuf_t*, FSCacheEntry_t*);
+void ejectEntry(FSShard_t*, FSCacheEntry_t*, FSEjectedBuf_t*);
+int ejectTail(FSShard_t*, FSCacheEntry_t*, FSEjectedBuf_t*);
+void updateCacheSize(FSShard_t*, FSFile_t*, FSFile_t*, long long, FSCacheEntry_t*, FSEjectedBuf_t*);
+void makeRoom(FSShard_t*, FSCacheEntry_t*, FSEjectedBuf_t*);
+void recordAccess(HashValue64);
+int isDeclined(FSShard_t*, FSCacheEntry_t*, FSCacheEntry_t**);
+void admitEntry(FSShard_t*, FSCacheEntry_t*, FSCacheEntry_t*, FSEjectedBuf_t*);
+void enforceGlobalCapacity(FSCacheEntry_t*, FSEjectedBuf_t*);
+void releaseEjected(FSEjectedBuf_t*, FSFile_t**, int*);
+int collectWaitingClient(FSShard_t*, FSCacheEntry_t*, int, FSPendingNotifications_t*);
+void collectWaitingClients(FSShard_t*, FSCacheEntry_t*, int, FSPendingNotifications_t*);
+void notifyWaitingClients(FSCacheEntry_t*);
+void pushNotification(FSPendingNotifications_t*, int, int);
+void publishNotifications(FSPendingNotifications_t*);
+void shareFile(FSFile_t, FSFile_t*);
+void copyName(FSFile_t, FSFile_t*);
+void compressFile(FSFile_t*);
+size_t storedSize(const FSFile_t*);
+long long uniqueSize(const FSFile_t*, const DedupEntry_t*);
+long long entryUniqueSize(const FSCacheEntry_t*);
+int isSpilled(HashValue64, FSFile_t);
+int _inner_remove(int, FSFile_t);
+int _inner_modify(int, FSFile_t*, Content_t*, HashValue64, FSFile_t**, int*);
+int promoteFile(int, FSFile_t);
+void endDemotion(FSCacheEntry_t*, int);
+void dropUnusedStub(FSShard_t*, FSCacheEntry_t*);
+unsigned long transitSeq();
+void endTransit();
+void waitTransit(unsigned long);
+void releaseFiles(FSFile_t*, int);
+int compareNames(const char*, size_t, const char*, size_t);
+int mergeListed(FSFile_t*, int, FSFile_t*, int, FSFile_t*, int);
+const char* rawBytes(Content_t*, size_t);
+void logOperation(FSShard_t*, int, const FSFile_t*, const char*, size_t);
+void logRange(FSShard_t*, const FSFile_t*, size_t);
+void logInsert(FSShard_t*, const FSFile_t*, const char*, size_t, long long);
+void restoreFileSystem();
+void* replayThreadFun(void*);
+void replayOperation(void*, int, FSFile_t, size_t, long long);
+int snapshotShard(FSShard_t*, int, size_t*, double*);
+void snapshotFileSystem(int);
+void* snapshotThreadFun(void*);
+long long ttlClockMs();
+TimerTick_t currentTick();
+TimerTick_t ticksFor(long);
+long long wallClockMs();
+long long tickExpiry(TimerTick_t);
+long long entryExpiry(const FSCacheEntry_t*);
+void armExpiry(FSShard_t*, FSCacheEntry_t*, long long);
+void expireShard(FSShard_t*);
+void expireLocks(FSShard_t*);
+void releaseExpired(FSEjectedBuf_t*);
+void* expiryThreadFun(void*);
+double elapsedMs(struct timespec);
+struct timespec lockShard(FSShard_t*);
+void unlockShard(FSShard_t*, struct timespec);
+
+uint64_t nextRandom();
+int* samplePositions(int, int);
+int insertPosition(int*, int, int);
 
 void log_cache_entirely();
 void summary();
@@ -69,36 +357,237 @@ void summary();
 // =============================================================================================
 
 FSInfo_t fs_get_infos() {
+    // Bytes counting shared contents for each file
+    long long bytesLogical = 0;
+
+    // Disk tier
+    SpillInfo_t spill = { 0 };
+    if (gSpillEnabled) spill = spillInfo(&gSpill);
+
+    // Exclusive lock hold times
+    long long holdCount = 0, holdNs = 0, holdMaxNs = 0;
+    for (int i = 0; i < gNumShards; ++i) {
+        holdCount += atomic_load(&gShards[i].holdCount);
+        holdNs    += atomic_load(&gShards[i].holdNs);
+        holdMaxNs  = MAX(holdMaxNs, atomic_load(&gShards[i].holdMaxNs));
+    }
+
     // Atomic read
-    lock_mutex(&gFSMutex);
+    lock_mutex(&gUsageMutex);
+    for (int i = 0; i < gNumShards; ++i) bytesLogical += gShards[i].bytesUsed;
     FSInfo_t result = {
         .bytesUsedCount = gCache.bytesUsed,
         .slotsUsedCount = gCache.slotUsed,
-        .capacityMissCount = gCapacityMisses
+        .capacityMissCount = gCapacityMisses,
+        .declinedCount = atomic_load(&gDeclinedCount),
+        .expiredCount = atomic_load(&gExpiredCount),
+        .bytesExpiredCount = atomic_load(&gExpiredBytes),
+        .bytesCapacityMissCount = gCapacityMissesBytes,
+        .readCount = atomic_load(&gReadCount),
+        .readHitCount = atomic_load(&gReadHitCount),
+        .bytesReadCount = atomic_load(&gReadHitBytes),
+        .bytesReadMissCount = atomic_load(&gReadMissBytes),
+        .compressedCount = atomic_load(&gCompressStored),
+        .bytesCompressedRawCount = atomic_load(&gCompressRawBytes),
+        .bytesCompressedCount = atomic_load(&gCompressStoredBytes),
+        .bytesLogicalCount = bytesLogical,
+        .dedupRatio = (gCache.bytesUsed == 0) ? 1.0f : (float) bytesLogical / gCache.bytesUsed,
+        .spilledCount = spill.filesCount,
+        .bytesSpilledCount = spill.bytesUsed,
+        .promotedCount = spill.promotedCount,
+        .restoredCount = gRestoredFiles,
+        .restoreMs = gRestoreMs,
+        .lockHoldCount = holdCount,
+        .lockHoldAvgUs = (holdCount == 0) ? 0 : holdNs / 1e3f / holdCount,
+        .lockHoldMaxUs = holdMaxNs / 1e3f
     };
-    unlock_mutex(&gFSMutex);
+    unlock_mutex(&gUsageMutex);
     return result;
 }
 
-int initializeFileSystem(FSConfig_t configs, CircQueue_t* lockQueue, pthread_cond_t* lockCond, pthread_mutex_t* lockMutex) {
+FSAllocInfo_t fs_get_alloc_infos() {
+    FSAllocInfo_t result = { 0, 0, 0, 0 };
+
+    // Entries pools
+    for (int i = 0; i < gNumShards; ++i) {
+        Slab_t* slab = &gShards[i].entries;
+        lock_mutex(&slab->mutex);
+        result.entriesCount  += slab->inUse;
+        result.allocCount    += slab->allocCount;
+        result.bytesReserved += slab->bytesReserved;
+        unlock_mutex(&slab->mutex);
+    }
+
+    // Lock queues and their readers (waiters are preallocated, one for each client)
+    result.lockQueuesAlive  = atomic_load(&gLockQueuesAlive);
+    result.allocCount      += atomic_load(&gLockQueuesCreated) + atomic_load(&gReaderSetsCreated);
+    result.bytesReserved   += result.lockQueuesAlive * sizeof(FSLockQueue_t);
+    result.bytesReserved   += atomic_load(&gReaderSetsAlive) * READERS_WORDS * sizeof(uint64_t);
+    return result;
+}
+
+int initializeFileSystem(FSConfig_t configs, NotifyChannel_t* lockChannel) {
     LOG_VERB("[#FS] Initializing file system ...");
     gConfigs = configs;
 
     // Cache
-    gCache.bytesMax  = gConfigs.maxFileCapacityMB * 1024 * 1024;
+    gCache.bytesMax  = (long long) gConfigs.maxFileCapacityMB * 1024 * 1024;
     gCache.slotMax   = gConfigs.maxFileCapacitySlot;
     gCache.bytesUsed = 0;
     gCache.slotUsed  = 0;
-    gCache.head      = NULL;
-    gCache.tail      = NULL;
 
-    // Hashmap
-    gHashmap = (FSCacheEntry_t**) mem_calloc(gConfigs.tableSize, sizeof(FSCacheEntry_t*));
+    // Summary data
+    gMaxSlotUsed       = 0;
+    gMaxBytesUsed      = 0;
+    gCapacityMisses    = 0;
+    gCapacityMissesMax = 0;
+    gCapacityMissesBytes    = 0;
+    gCapacityMissesBytesMax = 0;
+    atomic_store(&gReadCount, 0);
+    atomic_store(&gReadHitCount, 0);
+    atomic_store(&gReadHitBytes, 0);
+    atomic_store(&gReadMissBytes, 0);
+    atomic_store(&gDeclinedCount, 0);
+    atomic_store(&gExpiredCount, 0);
+    atomic_store(&gExpiredBytes, 0);
+    atomic_store(&gLockWaitCount, 0);
+    atomic_store(&gLockWaitMax, 0);
+    atomic_store(&gLockTimeoutCount, 0);
+    atomic_store(&gLockCancelCount, 0);
+    atomic_store(&gLeaseExpiredCount, 0);
+    atomic_store(&gSharedLockCount, 0);
+    atomic_store(&gSharedLockMax, 0);
+    atomic_store(&gCompressTried, 0);
+    atomic_store(&gCompressStored, 0);
+    atomic_store(&gCompressRawBytes, 0);
+    atomic_store(&gCompressStoredBytes, 0);
+
+    // TTL ticks
+    clock_gettime(CLOCK_MONOTONIC, &gTtlEpoch);
+
+    // No client is waiting on lock
+    for (int i = 0; i < MAX_CLIENT_COUNT; ++i) {
+        gLockWaiters[i].pre   = NULL;
+        gLockWaiters[i].nex   = NULL;
+        gLockWaiters[i].entry = NULL;
+        atomic_init(&gLockWaiters[i].shard, NULL);
+        initTimerNode(&gLockWaiters[i].timer);
+    }
+
+    // Pages backing big blocks (before any hashmap or content)
+    useHugePages(gConfigs.hugePages);
+
+    // Shards (no more shards than slots, otherwise some of them would have an empty budget)
+    gNumShards = MAX(1, MIN(MIN(gConfigs.numShards, gCache.slotMax), MAX_SHARDS_COUNT));
+    gShards    = (FSShard_t*) mem_calloc(gNumShards, sizeof(FSShard_t));
+    for (int i = 0; i < gNumShards; ++i) {
+        FSShard_t* shard = &gShards[i];
+        // Prefer writers, otherwise a read-heavy load would starve them
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        int err = pthread_rwlock_init(&shard->lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+        if (err != 0) {
+            errno = err;
+            LOG_ERRNO("[#FS] Error creating lock for shard #%d", i);
+            return -1;
+        }
+
+        // Budget share (remainder goes to the first shards)
+        shard->slotMax  = gCache.slotMax  / gNumShards + (i < gCache.slotMax  % gNumShards);
+        shard->bytesMax = gCache.bytesMax / gNumShards + (i < gCache.bytesMax % gNumShards);
+
+        // Hashmap (initial size only, it grows with the shard)
+        initHashTable(&shard->hashmap, gConfigs.tableSize / gNumShards, entryHasName);
+        initPathIndex(&shard->paths);
+        shard->dense      = NULL;
+        shard->denseCount = 0;
+        shard->denseCap   = 0;
+
+        // Entries pool
+        initSlab(&shard->entries, sizeof(FSCacheEntry_t), ENTRIES_PER_SLAB);
+
+        // Eviction policy
+        shard->policy = createEvictionPolicy(gConfigs.evictionPolicy, shard->slotMax);
+
+        // Sizes of the files ejected lately (as many as the files it holds)
+        size_t ejectedSlots = 2;
+        while (ejectedSlots < (size_t) shard->slotMax) ejectedSlots <<= 1;
+        shard->ejectedSizes = (FSEjectedSize_t*) mem_calloc(ejectedSlots, sizeof(FSEjectedSize_t));
+        shard->ejectedMask  = ejectedSlots - 1;
+        initTimerWheel(&shard->timers, 0);
+        initTimerWheel(&shard->waitTimers, 0);
+        initTimerWheel(&shard->leaseTimers, 0);
+
+        // Write-ahead log (opened after restoring files)
+        initPersistLog(&shard->log);
+    }
+
+    // Shared contents
+    initDedupIndex(&gDedup, gCache.slotMax);
+
+    // Admission filter (enabled once files are restored: the log is replayed as it is)
+    if (gConfigs.admission == FS_ADMISSION_TINYLFU) initAdmissionFilter(&gAdmission, gCache.slotMax);
+
+    // Disk tier
+    gSpillEnabled = gConfigs.spillFilename != NULL;
+    if (gSpillEnabled) {
+        if (initSpillTier(&gSpill, gConfigs.spillFilename, (size_t) gConfigs.spillMaxSizeMB * 1024 * 1024, gCache.slotMax) != 0) {
+            LOG_ERRNO("[#FS] Error creating disk tier (%s)", gConfigs.spillFilename);
+            return -1;
+        }
+        LOG_VERB("[#FS] Ejected files moved to disk tier (%s, %d MB)", gConfigs.spillFilename, gConfigs.spillMaxSizeMB);
+    }
+
+    // Contents arena (its extents are kept until the restore tells which ones are still used)
+    gArenaEnabled = gConfigs.arenaFilename != NULL;
+    if (gArenaEnabled) {
+        if (initArena(&gArena, gConfigs.arenaFilename, (size_t) gConfigs.arenaMaxSizeMB * 1024 * 1024) != 0) {
+            LOG_ERRNO("[#FS] Error mapping contents arena (%s)", gConfigs.arenaFilename);
+            return -1;
+        }
+        useContentArena(&gArena);
+        LOG_VERB("[#FS] Contents stored inside arena (%s, %zu MB)", gConfigs.arenaFilename, arenaInfo(&gArena).size / (1024 * 1024));
+    }
+    LOG_VERB("[#FS] Using %d shards (%s eviction)", gNumShards, evictionPolicyName(gConfigs.evictionPolicy));
+    if (gConfigs.hugePages != HUGE_PAGES_NONE)
+        LOG_VERB("[#FS] Big contents and hashmaps on huge pages (%s)", hugePagesName(gConfigs.hugePages));
+    if (gConfigs.compression == FS_COMPRESSION_HUFFMAN)
+        LOG_VERB("[#FS] Contents compressed when saving at least %d%% of bytes", gConfigs.compressionMinSaving);
+
+    // Lock notifications
+    gLockChannel = lockChannel;
+
+    // Persistence (restore files, then log operations and take snapshots periodically)
+    gPersistEnabled = gConfigs.persistDir != NULL;
+    if (gPersistEnabled && mkdir(gConfigs.persistDir, 0700) == -1 && errno != EEXIST) {
+        LOG_ERRNO("[#FS] Error creating persistence directory (%s)", gConfigs.persistDir);
+        gPersistEnabled = 0;
+    }
+    if (gPersistEnabled) {
+        restoreFileSystem();
+        gSnapshotStop = 0;
+        if (pthread_create(&gSnapshotThread, NULL, snapshotThreadFun, NULL) != 0) {
+            LOG_ERRNO("[#FS] Error creating snapshot thread");
+            return -1;
+        }
+        LOG_VERB("[#FS] Snapshot every %d s (%s)", gConfigs.snapshotInterval, gConfigs.persistDir);
+    }
+
+    // Nothing to keep from the previous run
+    if (gArenaEnabled && !gPersistEnabled) arenaRebuild(&gArena);
 
-    // Lock queue & cond
-    gLockCond  = lockCond;
-    gLockQueue = lockQueue;
-    gLockMutex = lockMutex;
+    // New contents compete with the ones they would eject
+    gAdmissionEnabled = gConfigs.admission == FS_ADMISSION_TINYLFU;
+    if (gAdmissionEnabled) LOG_VERB("[#FS] New contents admitted when accessed more often than the files they would eject");
+
+    // Files with a TTL are removed in background
+    gExpiryStop = 0;
+    if (pthread_create(&gExpiryThread, NULL, expiryThreadFun, NULL) != 0) {
+        LOG_ERRNO("[#FS] Error creating expiry thread");
+        return -1;
+    }
 
     // Returns success
     return 0;
@@ -107,466 +596,872 @@ int initializeFileSystem(FSConfig_t configs, CircQueue_t* lockQueue, pthread_con
 int terminateFileSystem() {
     LOG_VERB("[#FS] Terminating file system ...");
 
+    // No more expiries
+    lock_mutex(&gExpiryMutex);
+    gExpiryStop = 1;
+    notify_one(&gExpiryCond);
+    unlock_mutex(&gExpiryMutex);
+    if (pthread_join(gExpiryThread, NULL) != 0) LOG_ERRNO("[#FS] Error joining expiry thread");
+
+    // Last snapshot (next startup replays no log)
+    if (gPersistEnabled) {
+        lock_mutex(&gSnapshotMutex);
+        gSnapshotStop = 1;
+        notify_one(&gSnapshotCond);
+        unlock_mutex(&gSnapshotMutex);
+        if (pthread_join(gSnapshotThread, NULL) != 0) LOG_ERRNO("[#FS] Error joining snapshot thread");
+
+        // Contents inside the arena are kept there (the snapshot only refers to them)
+        int references = 0;
+        if (gArenaEnabled) {
+            references = arenaSeal(&gArena) == 0;
+            if (!references) LOG_ERRNO("[#FS] Error syncing contents arena");
+        }
+        snapshotFileSystem(references);
+    }
+
     summary();
 
-    // Cache
-    lock_mutex(&gFSMutex);
-    int depth = 0;
-    FSCacheEntry_t* item = gCache.head;
-    while (item != NULL && depth < DEPTH_LIMIT) {
-        FSCacheEntry_t* tmp = item->pre;
-        // Release memory
-        freeCacheEntry(item);
-        item = tmp;
-        depth++;
+    for (int i = 0; i < gNumShards; ++i) {
+        FSShard_t* shard = &gShards[i];
+
+        // Cache
+        lock_rw_mutex_write(&shard->lock);
+        HashTableIter_t iter = { 0 };
+        HashTableNode_t* node = NULL;
+        while ((node = hashTableIterate(&shard->hashmap, &iter)) != NULL) {
+            // Release memory
+            freeCacheEntry((FSCacheEntry_t*) node);
+        }
+        unlock_rw_mutex(&shard->lock);
+
+        // Hashmap, eviction policy, log & entries pool
+        closePersistLog(&shard->log);
+        destroyHashTable(&shard->hashmap);
+        destroyPathIndex(&shard->paths);
+        free(shard->dense);
+        free(shard->ejectedSizes);
+        destroyEvictionPolicy(shard->policy);
+        destroySlab(&shard->entries);
+        pthread_rwlock_destroy(&shard->lock);
     }
-    unlock_mutex(&gFSMutex);
+    free(gShards);
+    gShards = NULL;
 
-    // Hashmap
-    free(gHashmap);
+    // Shared contents (after the entries referencing them)
+    destroyDedupIndex(&gDedup);
+
+    // Admission filter
+    if (gConfigs.admission == FS_ADMISSION_TINYLFU) destroyAdmissionFilter(&gAdmission);
+    gAdmissionEnabled = 0;
+
+    // Disk tier
+    if (gSpillEnabled) destroySpillTier(&gSpill);
+
+    // Contents arena (after every content)
+    if (gArenaEnabled) {
+        useContentArena(NULL);
+        destroyArena(&gArena);
+    }
+
+    // Huge pages (after every hashmap and content)
+    useHugePages(HUGE_PAGES_NONE);
 
     // Returns success
     return 0;
 }
 
-int fs_insert(int client, FSFile_t file, int aquireLock, FSFile_t** outFiles, int* outFilesCount) {
+int fs_insert(int client, FSFile_t file, int aquireLock, long ttlMs, FSFile_t** outFiles, int* outFilesCount) {
     // vars
     int res = 0;
+    FSEjectedBuf_t ejected = { NULL, 0, 0 };
+
+    // Compress and hash content (outside locks, raw bytes are kept to log them)
+    Content_t* raw = (gPersistEnabled) ? acquireContent(file.content) : NULL;
+    compressFile(&file);
+    HashValue64 contentHash = dedupHash(file.content, file.contentLen);
 
     // Get key
-    HashValue key            = getKey(file);
-    FSCacheEntry_t* newEntry = createEmptyCacheEntry(file);
-    newEntry->owner          = (aquireLock) ? client : EMPTY_OWNER;
+    HashValue64 hash         = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard         = getShard(hash);
+    FSCacheEntry_t* newEntry = createEmptyCacheEntry(shard, file);
+    recordAccess(hash);
+    newEntry->node.hash      = hash;
+    newEntry->evict.hash     = hash;
+    newEntry->evict.size     = storedSize(&file);
 
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
+
+    // Check if file exist (files on the disk tier or moving too)
+    FSCacheEntry_t* oldEntry = getEntry(shard, hash, file.name, file.nameLen);
+    if (oldEntry == NULL && !isSpilled(hash, file)) {
+        // Share content with identical files
+        long long dedupBytes = 0;
+        newEntry->dedup = dedupAcquire(&gDedup, &newEntry->file.content, file.contentLen, contentHash, &dedupBytes);
 
-    // Check if file exist
-    FSCacheEntry_t* oldEntry = getValueFromKey(key);
-    if (oldEntry == NULL) {
         // Update hashmap
-        setValueForKey(key, newEntry);
+        addEntry(shard, newEntry);
+
+        // 'Lock' file (its lease begins)
+        if (aquireLock) grantLock(shard, newEntry, client, 0);
+
+        // Expiry
+        if (ttlMs > 0) {
+            TimerTick_t now = currentTick();
+            timerWheelAdd(&shard->timers, &newEntry->timer, now, now + ticksFor(ttlMs));
+        }
+
+        // Log (before the ejections it causes)
+        logInsert(shard, &file, rawBytes(raw, file.contentLen), file.contentLen, entryExpiry(newEntry));
 
         // Update cache
-        moveToTop(newEntry);
-        updateCacheSize(&file, NULL, outFiles, outFilesCount);
+        evictionInsert(shard->policy, &newEntry->evict);
+        updateCacheSize(shard, &newEntry->file, NULL, uniqueSize(&newEntry->file, newEntry->dedup) + dedupBytes, newEntry, NULL);
+        FSCacheEntry_t* victim = NULL;
+        if (isDeclined(shard, newEntry, &victim)) ejectEntry(shard, newEntry, &ejected);
+        else admitEntry(shard, newEntry, victim, &ejected);
     } else {
-        // Hash collision
-        LOG_WARN("[#FS] File exists or Hash collision");
+        LOG_WARN("[#FS] File exists");
         res = FS_FILE_ALREADY_EXISTS;
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("insert");
+    log_cache_entirely(shard, "insert");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlockShard(shard, lockedAt);
+    releaseContent(raw);
 
     // Check if any error occurred
     if (res != 0) freeCacheEntry(newEntry);
+    else {
+        // Make room inside other shards (if needed)
+        enforceGlobalCapacity(newEntry, &ejected);
+        releaseEjected(&ejected, outFiles, outFilesCount);
+    }
     
     // Returns the result
     return res;
 }
 
-int fs_remove(int client, FSFile_t file) {
+int _inner_remove(int client, FSFile_t file) {
     // vars
     int res = 0;
+    FSPendingNotifications_t pending = { .count = 0 };
+    FSCacheEntry_t* removed = NULL;
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
 
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
 
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
     if (entry != NULL) {
         // Check if its owned by someone else
         if (entry->owner != client) {
             res = FS_CLIENT_NOT_ALLOWED;
         } else {
             // Update hashmap
-            setValueForKey(key, NULL);
-
-            // Link pre and nex toghether
-            FSCacheEntry_t* tmp1 = entry->pre;
-            FSCacheEntry_t* tmp2 = entry->nex;
-            if (tmp1 != NULL) entry->pre->nex = tmp2;
-            if (tmp2 != NULL) entry->nex->pre = tmp1;
+            removeEntry(shard, entry);
 
             // Update cache
-            if (gCache.head == entry) gCache.head = entry->pre;
-            if (gCache.tail == entry) gCache.tail = entry->nex;
-
-            // Notify all clients waiting for lock
-            CircQueueItemPtr_t item;
-            while (tryPop(entry->waitingLockQueue, &item) == 1) {
-                // Create notification to send
-                FSLockNotification_t* notification = (FSLockNotification_t*) mem_malloc(sizeof(FSLockNotification_t));
-                notification->fd     = (intptr_t) item;
-                notification->status = FS_FILE_NOT_EXISTS; // File has been removed
-                // Push into lock queue
-                while (tryPush(gLockQueue, notification) != 1) {
-                    // Try again fastest possible.
-                    // It blocks the entire server and needs to be done fast
-                }
-                LOG_VERB("[#FS] Removed %d from lock req queue", notification->fd);
-                // Signal queue
-                lock_mutex(gLockMutex);
-                notify_one(gLockCond);
-                unlock_mutex(gLockMutex);
-            }
+            evictionRemove(shard->policy, &entry->evict, 0);
+
+            // Notify all clients waiting for lock (once the lock is released)
+            collectWaitingClients(shard, entry, FS_FILE_NOT_EXISTS, &pending);
+
+            // Log
+            logOperation(shard, PERSIST_OP_REMOVE, &entry->file, NULL, 0);
 
             // Update cache
-            updateCacheSize(NULL, &entry->file, NULL, NULL);
+            long long uniqueBytes = -entryUniqueSize(entry);
+            uniqueBytes += dedupRelease(&gDedup, entry->dedup);
+            entry->dedup = NULL;
+            updateUsage(shard, -(long long) entry->evict.size, uniqueBytes, -1);
 
-            // Release memory
-            freeCacheEntry(entry);
+            // Release memory (once the lock is released and the pending operations are done)
+            removed = entry;
         }
     } else {
         res = FS_FILE_NOT_EXISTS;
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("remove");
+    log_cache_entirely(shard, "remove");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlockShard(shard, lockedAt);
+
+    // Notify waiting clients
+    publishNotifications(&pending);
+    if (removed != NULL) unpinEntry(removed);
 
     // Returns the result
     return res;
 }
 
-int fs_obtain(int client, FSFile_t file, FSFile_t* outFile) {
+int fs_remove(int client, FSFile_t file) {
+    // Promote on miss (its owner, if any, still owns it)
+    int res = _inner_remove(client, file);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_remove(client, file);
+    return res;
+}
+
+int _inner_obtain(int client, FSFile_t file, FSFile_t* outFile) {
     // vars
     int res = 0;
+    unsigned ticket = 0;
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
+    recordAccess(hash);
 
-    // Acquire lock
-    lock_mutex(&gFSMutex);
+    // Acquire lock (shared)
+    lock_rw_mutex_read(&shard->lock);
 
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
     if (entry != NULL) {
-        // Deep copy file out
-        deepCopyFile(entry->file, outFile);
-
-        // Update cache
-        moveToTop(entry);
+        // Content is taken once the lock is released
+        ticket = latchTicket(&entry->latch);
+        pinEntry(entry);
+        atomic_fetch_add_explicit(&gReadHitCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gReadHitBytes, entry->length, memory_order_relaxed);
+
+        // Update cache (lazily)
+        evictionRead(shard->policy, &entry->evict);
     } else {
         res = FS_FILE_NOT_EXISTS;
+        atomic_fetch_add_explicit(&gReadMissBytes, ejectedSize(shard, hash), memory_order_relaxed);
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("obtain");
+    log_cache_entirely(shard, "obtain");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlock_rw_mutex(&shard->lock);
+
+    if (res == 0) {
+        // Share content out (not copied, same name that was found)
+        latchWait(&entry->latch, ticket);
+        outFile->content    = acquireContent(entry->file.content);
+        outFile->contentLen = entry->file.contentLen;
+        latchRelease(&entry->latch);
+        unpinEntry(entry);
+        copyName(file, outFile);
+    }
 
     // Returns the result
     return res;
 }
 
-int __inn_sort_int_func(const void * a, const void * b) { return (*(int*)a - *(int*)b); }
+int fs_obtain(int client, FSFile_t file, FSFile_t* outFile) {
+    atomic_fetch_add_explicit(&gReadCount, 1, memory_order_relaxed);
+
+    // Promote on miss
+    int res = _inner_obtain(client, file, outFile);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_obtain(client, file, outFile);
+    return res;
+}
 
 int fs_obtain_n(int client, int n, FSFile_t** outFiles, int* outFilesCount) {
-    // Acquire lock
-    lock_mutex(&gFSMutex);
-
-    // Cap n
-    if (n != 0) n = MIN(MIN(n, gCache.slotUsed), MAX_EJECTED_FILES_AT_SAME_TIME);
+    // Acquire every shard lock shared (always in the same order, nobody else holds more than one)
+    for (int i = 0; i < gNumShards; ++i) lock_rw_mutex_read(&gShards[i].lock);
+
+    // Count files (counters cannot change while holding every shard lock)
+    int slotUsed = 0, firstPosition[MAX_SHARDS_COUNT + 1];
+    for (int i = 0; i < gNumShards; ++i) {
+        firstPosition[i] = slotUsed;
+        slotUsed += gShards[i].denseCount;
+    }
+    firstPosition[gNumShards] = slotUsed;
 
-    // Allocate files array
-    FSFile_t* files = NULL;
-    int filesIndex  = 0;
+    // Cap n (0 means every file)
+    n = (n == 0) ? slotUsed : n;
+    n = MIN(MIN(n, slotUsed), MAX_EJECTED_FILES_AT_SAME_TIME);
 
-    if (n == 0) {
-        // Compute min between cache size and define for max files
-        n     = MIN(gCache.slotUsed, MAX_EJECTED_FILES_AT_SAME_TIME);
-        files = (FSFile_t*) mem_malloc(n * sizeof(FSFile_t));
+    // Pin the entries (contents are shared once the locks are released)
+    FSCacheEntry_t** entries = (FSCacheEntry_t**) mem_malloc((MAX(1, n)) * sizeof(FSCacheEntry_t*));
+    int entriesCount = 0;
 
+    if (n == slotUsed) {
         // Take all
-        FSCacheEntry_t* item = gCache.head;
-        while (item != NULL && filesIndex < n) {
-            deepCopyFile(item->file, &files[filesIndex++]);
-            item = item->pre;
-        }
+        for (int i = 0; i < gNumShards; ++i)
+            for (int j = 0; j < gShards[i].denseCount; ++j) entries[entriesCount++] = gShards[i].dense[j];
     } else {
-        files = (FSFile_t*) mem_malloc(n * sizeof(FSFile_t));
-
-        // Calculate n random index between 0 and cache size
-        static int indexes[MAX_EJECTED_FILES_AT_SAME_TIME];
-        int indexesIndex = 0;
-
-        // RESERVOIR METHOD
-        // th. source:
-        //    https://en.wikipedia.org/wiki/Reservoir_sampling#:~:text=Reservoir%20sampling%20is%20a%20family,to%20fit%20into%20main%20memory.
-        for (int i = 0; i < n; ++i) indexes[i] = i;
-        for (int i = n; i < gCache.slotUsed && i < MAX_EJECTED_FILES_AT_SAME_TIME; ++i) {
-            int m = rand() % (i + 1);
-            if (m < n) indexes[m] = i;
+        // n distinct positions (shards are laid one after the other), then the entry at each one
+        int* positions = samplePositions(n, slotUsed);
+        for (int k = 0; k < n; ++k) {
+            int lo = 0, hi = gNumShards - 1;
+            while (lo < hi) {
+                int mid = (lo + hi + 1) / 2;
+                if (firstPosition[mid] <= positions[k]) lo = mid;
+                else hi = mid - 1;
+            }
+            entries[entriesCount++] = gShards[lo].dense[positions[k] - firstPosition[lo]];
         }
+        free(positions);
+    }
+    for (int i = 0; i < entriesCount; ++i) pinEntry(entries[i]);
 
-        // Sort (just for easy of use)
-        qsort(indexes, n, sizeof(int), __inn_sort_int_func);
+    INCREASE_QUERY_COUNT(&gShards[0]);
 
-        // Take only indexes from the array
-        int cacheIndex = 0;
-        FSCacheEntry_t* item = gCache.tail;
-        while (item != NULL && filesIndex < n) {
-            if (cacheIndex == indexes[indexesIndex]) {
-                deepCopyFile(item->file, &files[filesIndex++]);
-                ++indexesIndex;
-            }
-            item = item->nex;
-            ++cacheIndex;
-        }
+    // Release locks
+    for (int i = gNumShards - 1; i >= 0; --i) unlock_rw_mutex(&gShards[i].lock);
+
+    // Share contents (one latch at a time, files ejected meanwhile are skipped)
+    FSFile_t* files = (FSFile_t*) mem_malloc((MAX(1, n)) * sizeof(FSFile_t));
+    int filesIndex  = 0;
+    for (int i = 0; i < entriesCount; ++i) {
+        latchAcquire(&entries[i]->latch);
+        if (entries[i]->file.name != NULL) shareFile(entries[i]->file, &files[filesIndex++]);
+        latchRelease(&entries[i]->latch);
+        unpinEntry(entries[i]);
     }
+    free(entries);
 
     // Pass values
     *outFiles      = files;
     *outFilesCount = filesIndex;
 
-    INCREASE_QUERY_COUNT;
+    // Returns success
+    return 0;
+}
+
+int fs_list(int client, const char* prefix, size_t prefixLen, const char* after, size_t afterLen, int max, FSFile_t** outFiles, int* outFilesCount, int* more) {
+    // One more than asked, to know if other files follow
+    max = (max <= 0 || max > FS_LIST_MAX) ? FS_LIST_MAX : max;
+    const int want = max + 1;
+
+    // Sorted files so far, files of a shard, both merged
+    FSFile_t* files  = (FSFile_t*) mem_malloc(want * sizeof(FSFile_t));
+    FSFile_t* listed = (FSFile_t*) mem_malloc(want * sizeof(FSFile_t));
+    FSFile_t* merged = (FSFile_t*) mem_malloc(want * sizeof(FSFile_t));
+    void** entries   = (void**) mem_malloc(want * sizeof(void*));
+    int filesCount   = 0;
+
+    // Each shard lists its first names (one shard lock at a time)
+    for (int i = 0; i < gNumShards; ++i) {
+        FSShard_t* shard = &gShards[i];
+        lock_rw_mutex_read(&shard->lock);
+        int count = pathIndexList(&shard->paths, prefix, prefixLen, after, afterLen, entries, want);
+        for (int j = 0; j < count; ++j) {
+            FSCacheEntry_t* entry = (FSCacheEntry_t*) entries[j];
+            listed[j] = (FSFile_t) { .content = NULL, .contentLen = entry->length };
+            copyName(entry->file, &listed[j]);
+        }
+        INCREASE_QUERY_COUNT(shard);
+        unlock_rw_mutex(&shard->lock);
+
+        // Keep the lowest names
+        filesCount = mergeListed(files, filesCount, listed, count, merged, want);
+        FSFile_t* tmp = files;
+        files  = merged;
+        merged = tmp;
+    }
+
+    // Drop the extra one
+    *more = (filesCount > max);
+    if (*more) {
+        free((char*) files[max].name);
+        filesCount = max;
+    }
+
+    free(listed);
+    free(merged);
+    free(entries);
 
-    // Release lock
-    unlock_mutex(&gFSMutex);
+    // Pass values
+    *outFiles      = files;
+    *outFilesCount = filesCount;
 
     // Returns success
     return 0;
 }
 
-int fs_modify(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount) {
+// Inner implementation of the modify, to try it again once promoted. On success the file takes
+// the content replaced, otherwise it is left as it is ('raw' and 'contentHash' are the ones of its content)
+int _inner_modify(int client, FSFile_t* file, Content_t* raw, HashValue64 contentHash, FSFile_t** outFiles, int* outFilesCount) {
     // vars
     int res = 0;
+    FSEjectedBuf_t ejected = { NULL, 0, 0 };
+    unsigned ticket = 0;
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file->name, file->nameLen);
+    FSShard_t* shard = getShard(hash);
+    recordAccess(hash);
 
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
 
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file->name, file->nameLen);
     if (entry != NULL) {
         // Check if file is owned by someone else
         if (entry->owner != client) {
             res = FS_CLIENT_NOT_ALLOWED;
-        } else if (file.contentLen + file.nameLen > gCache.bytesMax) {
+        } else if (storedSize(file) > gCache.bytesMax) {
             res = FS_FILE_TOO_BIG;
         } else {
-            // Release memory
-            if (entry->file.content) free((char*) entry->file.content);
-            if (entry->file.name)    free((char*) entry->file.name);
+            // Share content with identical files (old one is left)
+            long long dedupBytes = 0;
+            DedupEntry_t* dedup  = dedupAcquire(&gDedup, &file->content, file->contentLen, contentHash, &dedupBytes);
+            long long uniqueBytes = uniqueSize(file, dedup) + dedupBytes - entryUniqueSize(entry);
+            uniqueBytes += dedupRelease(&gDedup, entry->dedup);
+
+            // Log
+            logOperation(shard, PERSIST_OP_MODIFY, file, rawBytes(raw, file->contentLen), file->contentLen);
+
+            // Make dummy file to update size correctly (content is replaced once the lock is released)
+            FSFile_t oldFile = { .nameLen = 0, .contentLen = entry->evict.size };
 
             // Update file
-            FSFile_t oldFile = entry->file;
-            entry->file      = file;
+            entry->dedup      = dedup;
+            entry->length     = file->contentLen;
+            entry->evict.size = storedSize(file);
+            ticket = latchTicket(&entry->latch);
+            pinEntry(entry);
+
+            // Update cache (cached already: admission is not asked again)
+            evictionTouch(shard->policy, &entry->evict);
+            updateCacheSize(shard, file, &oldFile, uniqueBytes, entry, &ejected);
+        }
+    } else {
+        res = FS_FILE_NOT_EXISTS;
+    }
+
+#ifdef DEBUG_LOG
+    log_cache_entirely(shard, "modify");
+#endif
+
+    INCREASE_QUERY_COUNT(shard);
+
+    // Release lock
+    unlockShard(shard, lockedAt);
+
+    // Replace content (entry keeps its name)
+    if (res == 0) {
+        latchWait(&entry->latch, ticket);
+        Content_t* oldContent  = entry->file.content;
+        entry->file.content    = file->content;
+        entry->file.contentLen = file->contentLen;
+        latchRelease(&entry->latch);
+        unpinEntry(entry);
+        file->content = oldContent;
+    }
+
+    // Make room inside other shards (if needed)
+    if (res == 0) {
+        enforceGlobalCapacity(entry, &ejected);
+        releaseEjected(&ejected, outFiles, outFilesCount);
+    }
+
+    // Returns the result
+    return res;
+}
+
+int fs_modify(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount) {
+    // Compress and hash content once (outside locks, raw bytes are kept to log them)
+    Content_t* raw = (gPersistEnabled) ? acquireContent(file.content) : NULL;
+    compressFile(&file);
+    HashValue64 contentHash = dedupHash(file.content, file.contentLen);
+
+    // Promote on miss (its owner, if any, still owns it)
+    int res = _inner_modify(client, &file, raw, contentHash, outFiles, outFilesCount);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_modify(client, &file, raw, contentHash, outFiles, outFilesCount);
+    releaseContent(raw);
+
+    // Release replaced content (may still be used by in-flight responses)
+    // File is owned by the file system even on error
+    releaseContent(file.content);
+    free((char*) file.name);
+
+    // Returns the result
+    return res;
+}
+
+int _inner_append(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount) {
+    // vars
+    int res = 0;
+    FSEjectedBuf_t ejected = { NULL, 0, 0 };
+    unsigned ticket = 0;
+
+    // Get key
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
+    recordAccess(hash);
+
+    // Acquire lock
+    struct timespec lockedAt = lockShard(shard);
+
+    // Check if file exist
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
+    if (entry != NULL) {
+        // Check if file is owned by someone else
+        if (entry->owner != client && entry->owner != EMPTY_OWNER) {
+            res = FS_CLIENT_NOT_ALLOWED;
+        } else if (file.contentLen + file.nameLen + entry->length > gCache.bytesMax) {
+            res = FS_FILE_TOO_BIG;
+        } else {
+            // Log
+            logOperation(shard, PERSIST_OP_APPEND, &file, file.data, file.contentLen);
+
+            // Content is appended once the lock is released (compressed contents are copied raw)
+            size_t oldSize        = entry->evict.size;
+            long long uniqueBytes = -entryUniqueSize(entry);
+            uniqueBytes          += dedupRelease(&gDedup, entry->dedup);
+            entry->dedup          = NULL;
+            entry->length        += file.contentLen;
+            entry->evict.size     = entry->file.nameLen + entry->length;
+            uniqueBytes          += entry->evict.size;
+            ticket = latchTicket(&entry->latch);
+            pinEntry(entry);
+
+            // Make dummy files to update size correctly (only content grows)
+            FSFile_t addedFile = { .nameLen = 0, .contentLen = entry->evict.size - oldSize };
+            FSFile_t emptyFile = { .nameLen = 0, .contentLen = 0 };
 
             // Update cache
-            moveToTop(entry);
-            updateCacheSize(&file, &oldFile, outFiles, outFilesCount);
+            evictionTouch(shard->policy, &entry->evict);
+            updateCacheSize(shard, &addedFile, &emptyFile, uniqueBytes, entry, &ejected);
         }
     } else {
         res = FS_FILE_NOT_EXISTS;
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("modify");
+    log_cache_entirely(shard, "append");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlockShard(shard, lockedAt);
+
+    // Append content (only its tail segment is written, in-flight responses keep their length)
+    // Compressed contents are copied raw. Shared contents are left (other files keep their length)
+    if (res == 0) {
+        latchWait(&entry->latch, ticket);
+        entry->file.content     = appendToContent(entry->file.content, entry->file.contentLen, file.data, file.contentLen);
+        entry->file.contentLen += file.contentLen;
+        latchRelease(&entry->latch);
+        unpinEntry(entry);
+    }
+
+    // Make room inside other shards (if needed)
+    if (res == 0) {
+        enforceGlobalCapacity(entry, &ejected);
+        releaseEjected(&ejected, outFiles, outFilesCount);
+    }
 
     // Returns the result
     return res;
 }
 
 int fs_append(int client, FSFile_t file, FSFile_t** outFiles, int* outFilesCount) {
+    // Promote on miss
+    int res = _inner_append(client, file, outFiles, outFilesCount);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_append(client, file, outFiles, outFilesCount);
+    return res;
+}
+
+int _inner_read_range(int client, FSFile_t file, size_t offset, size_t length, FSFile_t* outFile) {
+    // vars
+    int res = 0;
+    unsigned ticket = 0;
+
+    // Get key
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
+    recordAccess(hash);
+
+    // Acquire lock (shared)
+    lock_rw_mutex_read(&shard->lock);
+
+    // Check if file exist
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
+    if (entry != NULL) {
+        // Bytes are copied once the lock is released
+        ticket = latchTicket(&entry->latch);
+        pinEntry(entry);
+        atomic_fetch_add_explicit(&gReadHitCount, 1, memory_order_relaxed);
+
+        // Update cache (lazily)
+        evictionRead(shard->policy, &entry->evict);
+    } else {
+        res = FS_FILE_NOT_EXISTS;
+        size_t missed = ejectedSize(shard, hash);
+        if (offset < missed) atomic_fetch_add_explicit(&gReadMissBytes, MIN(length, missed - offset), memory_order_relaxed);
+    }
+
+#ifdef DEBUG_LOG
+    log_cache_entirely(shard, "range-r");
+#endif
+
+    INCREASE_QUERY_COUNT(shard);
+
+    // Release lock
+    unlock_rw_mutex(&shard->lock);
+
+    if (res == 0) {
+        // Take the content (writes coming next copy it, appends leave its first 'len' bytes)
+        latchWait(&entry->latch, ticket);
+        Content_t* source = acquireContent(entry->file.content);
+        size_t len        = entry->file.contentLen;
+        latchRelease(&entry->latch);
+        unpinEntry(entry);
+
+        // Copy the range out (cut at the end of the file, decoded holding no latch)
+        size_t count = (offset < len) ? (MIN(length, len - offset)) : 0;
+        size_t size  = 0;
+        Content_t* content = createContent(NULL, count);
+        if (content != NULL) copyContentRange(source, offset, count, (char*) getContentBytes(content, count, &size));
+        releaseContent(source);
+
+        outFile->content    = content;
+        outFile->contentLen = count;
+        copyName(file, outFile);
+        atomic_fetch_add_explicit(&gReadHitBytes, count, memory_order_relaxed);
+    }
+
+    // Returns the result
+    return res;
+}
+
+int fs_read_range(int client, FSFile_t file, size_t offset, size_t length, FSFile_t* outFile) {
+    atomic_fetch_add_explicit(&gReadCount, 1, memory_order_relaxed);
+
+    // Promote on miss
+    int res = _inner_read_range(client, file, offset, length, outFile);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_read_range(client, file, offset, length, outFile);
+    return res;
+}
+
+int _inner_write_range(int client, FSFile_t file, size_t offset, FSFile_t** outFiles, int* outFilesCount) {
     // vars
     int res = 0;
+    FSEjectedBuf_t ejected = { NULL, 0, 0 };
+    unsigned ticket = 0;
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
+    recordAccess(hash);
 
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
 
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
     if (entry != NULL) {
+        // Bytes past the end grow the file
+        size_t end = (MAX(entry->length, offset + file.contentLen));
+
         // Check if file is owned by someone else
         if (entry->owner != client && entry->owner != EMPTY_OWNER) {
             res = FS_CLIENT_NOT_ALLOWED;
-        } else if (file.contentLen + file.nameLen + entry->file.contentLen > gCache.bytesMax) {
+        } else if (offset > entry->length) {
+            res = FS_INVALID_RANGE;
+        } else if (file.nameLen + end > gCache.bytesMax) {
             res = FS_FILE_TOO_BIG;
         } else {
-            // Resize file content buffer to be large enough
-            int newContentLen      = file.contentLen + entry->file.contentLen;
-            entry->file.content    = mem_realloc((void*) entry->file.content, newContentLen * sizeof(char));
-
-            // Append content
-            memcpy((void*) &entry->file.content[entry->file.contentLen], file.content, file.contentLen);
-            entry->file.contentLen = newContentLen;
-
-            // Make dummy file to update size correctly
-            FSFile_t tmpFile = entry->file;
-            tmpFile.nameLen  = 0;
+            // Log
+            logRange(shard, &file, offset);
+
+            // Content is written once the lock is released (compressed contents are copied raw)
+            FSFile_t oldFile      = { .nameLen = 0, .contentLen = entry->evict.size };
+            long long uniqueBytes = -entryUniqueSize(entry);
+            uniqueBytes          += dedupRelease(&gDedup, entry->dedup);
+            entry->dedup          = NULL;
+            entry->length         = end;
+            entry->evict.size     = entry->file.nameLen + end;
+            uniqueBytes          += entry->evict.size;
+            ticket = latchTicket(&entry->latch);
+            pinEntry(entry);
+
+            // Make dummy file to update size correctly (name is left)
+            FSFile_t newFile = { .nameLen = 0, .contentLen = entry->evict.size };
 
             // Update cache
-            moveToTop(entry);
-            updateCacheSize(&file, &tmpFile, outFiles, outFilesCount);
+            evictionTouch(shard->policy, &entry->evict);
+            updateCacheSize(shard, &newFile, &oldFile, uniqueBytes, entry, &ejected);
         }
     } else {
         res = FS_FILE_NOT_EXISTS;
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("append");
+    log_cache_entirely(shard, "range-w");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlockShard(shard, lockedAt);
+
+    // Write bytes (in place when no in-flight response holds the content)
+    if (res == 0) {
+        latchWait(&entry->latch, ticket);
+        entry->file.content    = writeToContent(entry->file.content, entry->file.contentLen, offset, file.data, file.contentLen);
+        entry->file.contentLen = (MAX(entry->file.contentLen, offset + file.contentLen));
+        latchRelease(&entry->latch);
+        unpinEntry(entry);
+    }
+
+    // Make room inside other shards (if needed)
+    if (res == 0) {
+        enforceGlobalCapacity(entry, &ejected);
+        releaseEjected(&ejected, outFiles, outFilesCount);
+    }
 
     // Returns the result
     return res;
 }
 
-int fs_trylock(int client, FSFile_t file) {
+int fs_write_range(int client, FSFile_t file, size_t offset, FSFile_t** outFiles, int* outFilesCount) {
+    // Promote on miss
+    int res = _inner_write_range(client, file, offset, outFiles, outFilesCount);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_write_range(client, file, offset, outFiles, outFilesCount);
+    return res;
+}
+
+int _inner_trylock(int client, FSFile_t file, int shared, long timeoutMs) {
     // vars
     int res = 0;
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
 
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
 
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
     if (entry != NULL) {
         // Check if file is owned by someone
-        if (entry->owner != EMPTY_OWNER && entry->owner != client) {
-            // Try push into relative queue
-            if (tryPush(entry->waitingLockQueue, (void*) (intptr_t) client) == 1) {
-                // Successfully pushed into queue
+        if (!shared && isReader(entry, client) && entry->lockQueue->readersCount > 1) {
+            // Readers cannot wait for the others to leave (they could be waiting for it too)
+            res = FS_CLIENT_NOT_ALLOWED;
+        } else if (mustWait(entry, client, shared)) {
+            if (atomic_load(&gLockWaiters[client].shard) != NULL) {
+                // Already waiting for another lock
+                res = FS_CLIENT_NOT_ALLOWED;
+            } else if (timeoutMs == 0) {
+                // Not willing to wait
+                res = FS_LOCK_TIMED_OUT;
+            } else {
+                // Wait for it (last of the queue)
+                pushWaiter(shard, entry, client, shared, timeoutMs);
                 res = FS_CLIENT_WAITING_ON_LOCK;
                 LOG_VERB("[#FS] Added %d to lock req queue", client);
             }
-            else {
-                // Queue may be full
-                res = FS_CLIENT_NOT_ALLOWED;
-            }
         } else {
-            // 'Lock' file
-            entry->owner = client;
+            // 'Lock' file (holders renew their lease)
+            grantLock(shard, entry, client, shared && entry->owner != client);
 
             // Update cache
-            moveToTop(entry);
+            evictionTouch(shard->policy, &entry->evict);
         }
     } else {
         res = FS_FILE_NOT_EXISTS;
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("lock");
+    log_cache_entirely(shard, "lock");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlockShard(shard, lockedAt);
 
     // Returns the result
     return res;
 }
 
-int fs_exists(int client, FSFile_t file) {
+int fs_trylock(int client, FSFile_t file, int shared, long timeoutMs) {
+    // Promote on miss
+    int res = _inner_trylock(client, file, shared, timeoutMs);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_trylock(client, file, shared, timeoutMs);
+    return res;
+}
+
+int _inner_exists(int client, FSFile_t file) {
     // vars
     int res = 0;
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
 
-    // Acquire lock
-    lock_mutex(&gFSMutex);
+    // Acquire lock (shared)
+    lock_rw_mutex_read(&shard->lock);
 
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
+    FSCacheEntry_t* entry = getValueFromKey(shard, hash, file.name, file.nameLen);
     if (entry != NULL) {
-        // Update cache
-        moveToTop(entry);
+        // Update cache (lazily)
+        evictionRead(shard->policy, &entry->evict);
     } else {
         res = FS_FILE_NOT_EXISTS;
     }
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("exists");
+    log_cache_entirely(shard, "exists");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlock_rw_mutex(&shard->lock);
 
     // Returns the result
     return res;
 }
 
-// Inner implementation of the lock to use inside clean too
-int _inner_unlock(int client, HashValue key) {
+int fs_exists(int client, FSFile_t file) {
+    // Promote on miss
+    int res = _inner_exists(client, file);
+    if (res == FS_FILE_NOT_EXISTS && promoteFile(client, file)) res = _inner_exists(client, file);
+    return res;
+}
+
+// Inner implementation of the lock to use inside clean too (shard lock must be held).
+// The clients who get the lock are added to 'pending' (to be published after releasing the shard lock)
+int _inner_unlock(int client, FSShard_t* shard, FSCacheEntry_t* entry, FSPendingNotifications_t* pending) {
     // Check if file exist
-    FSCacheEntry_t* entry = getValueFromKey(key);
     if (entry != NULL) {
         // Check if file is owned by someone
-        if (entry->owner != client) {
+        if (isReader(entry, client)) {
+            // Leave the readers (once the last left, first client waiting on lock, if any, gets it)
+            removeReader(entry, client);
+            if (entry->owner == EMPTY_OWNER) releaseLock(shard, entry, pending);
+        } else if (entry->owner != client) {
             return FS_CLIENT_NOT_ALLOWED;
         } else {
-            // 'Unlock' file
-            entry->owner = EMPTY_OWNER;
-
-            // Get first client waiting on lock (if any)
-            CircQueueItemPtr_t item;
-            if (tryPop(entry->waitingLockQueue, &item) == 1) {
-                // Create notification to send
-                FSLockNotification_t* notification = (FSLockNotification_t*) mem_malloc(sizeof(FSLockNotification_t));
-                notification->fd     = (intptr_t) item;
-                notification->status = 0; // OK
-                // 'lock' file
-                entry->owner = notification->fd;
-                // Push into lock queue
-                while (tryPush(gLockQueue, notification) != 1) {
-                    // Try again fastest possible.
-                    // It blocks the entire server and needs to be done fast
-                }
-                LOG_VERB("[#FS] Removed %d from lock req queue", notification->fd);
-                // Signal queue
-                lock_mutex(gLockMutex);
-                notify_one(gLockCond);
-                unlock_mutex(gLockMutex);
-            } else {
-                LOG_VERB("[#FS] No client found in lock req queue");
-            }
+            // 'Unlock' file (first client waiting on lock, if any, gets it)
+            releaseLock(shard, entry, pending);
 
             // Update cache
-            moveToTop(entry);
+            if (entry->state == ENTRY_RESIDENT) evictionTouch(shard->policy, &entry->evict);
         }
+        dropUnusedStub(shard, entry);
     } else {
         return FS_FILE_NOT_EXISTS;
     }
@@ -576,86 +1471,152 @@ int _inner_unlock(int client, HashValue key) {
 int fs_unlock(int client, FSFile_t file) {
     // vars
     int res = 0;
+    FSPendingNotifications_t pending = { .count = 0 };
 
     // Get key
-    HashValue key = getKey(file);
+    HashValue64 hash = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard = getShard(hash);
 
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
 
-    res = _inner_unlock(client, key);
+    // Files on the disk tier keep their lock in a placeholder (nobody owns the other ones)
+    FSCacheEntry_t* entry = getEntry(shard, hash, file.name, file.nameLen);
+    res = _inner_unlock(client, shard, entry, &pending);
+    if (res == FS_FILE_NOT_EXISTS && isSpilled(hash, file)) res = FS_CLIENT_NOT_ALLOWED;
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("unlock");
+    log_cache_entirely(shard, "unlock");
 #endif
 
-    INCREASE_QUERY_COUNT;
+    INCREASE_QUERY_COUNT(shard);
 
     // Release lock
-    unlock_mutex(&gFSMutex);
+    unlockShard(shard, lockedAt);
+
+    // Notify the client who got the lock
+    publishNotifications(&pending);
 
     // Returns the result
     return res;
 }
 
-int fs_clean(int client, ClientSession_t* session) {
+int fs_cancel_wait(int client) {
+    // Only the client itself starts a wait: it can only end meanwhile
+    FSLockWaiter_t* waiter = &gLockWaiters[client];
+    FSShard_t* shard = atomic_load(&waiter->shard);
+    if (shard == NULL) return 0;
+
     // Acquire lock
-    lock_mutex(&gFSMutex);
+    struct timespec lockedAt = lockShard(shard);
+
+    // Ended meanwhile: the client is being notified
+    int cancelled = atomic_load(&waiter->shard) == shard;
+    if (cancelled) {
+        LOG_VERB("[#FS] Removed %d from lock req queue (cancelled)", client);
+        FSCacheEntry_t* entry = waiter->entry;
+        unlinkWaiter(shard, waiter);
+        dropUnusedStub(shard, entry);
+        atomic_fetch_add_explicit(&gLockCancelCount, 1, memory_order_relaxed);
+    }
+
+    // Release lock
+    unlockShard(shard, lockedAt);
+    return cancelled;
+}
+
+int fs_clean(int client, ClientSession_t* session) {
+    FSPendingNotifications_t pending = { .count = 0 };
+
+    // Stop waiting (a lock granted meanwhile is released below, with the files opened)
+    fs_cancel_wait(client);
 
     // Cycle through the files left opened by the client
     for (int i = 0; i < session->numFileOpened; ++i) {
-        HashValue key = session->filenames[i] % gConfigs.tableSize;
-        _inner_unlock(client, key);
-    }
+        FSShard_t* shard = getShard(session->filenames[i]);
+
+        // Acquire lock
+        struct timespec lockedAt = lockShard(shard);
+
+        // Only the hash is known (owner is checked anyway, placeholders included)
+        FSCacheEntry_t* entry = getEntry(shard, session->filenames[i], NULL, 0);
+        _inner_unlock(client, shard, entry, &pending);
 
 #ifdef DEBUG_LOG
-    log_cache_entirely("clean");
+        log_cache_entirely(shard, "clean");
 #endif
 
-    INCREASE_QUERY_COUNT;
+        INCREASE_QUERY_COUNT(shard);
 
-    // Release lock
-    unlock_mutex(&gFSMutex);
+        // Release lock
+        unlockShard(shard, lockedAt);
+    }
+
+    // Notify the clients who got the locks
+    publishNotifications(&pending);
     return 0;
 }
 
-void log_cache_entirely(const char* const after) {
+void log_cache_entirely(FSShard_t* shard, const char* const after) {
+    // Avoid walking the entire cache when nothing would be logged
+    if (get_log_level() < LOG_LEVEL_VERBOSE) return;
+
     LOG_VERB("========= FS after: %7s =========", after);
-    LOG_VERB("Cache slot in use: %d, slot max: %d, B in use: %lld, B max: %lld", gCache.slotUsed, gCache.slotMax, gCache.bytesUsed, gCache.bytesMax);
-    LOG_VERB("Cache head: %p, tail: %p", gCache.head, gCache.tail);
+    LOG_VERB("Shard #%ld slot in use: %d, slot max: %d, B in use: %lld, B max: %lld", shard - gShards, shard->slotUsed, shard->slotMax, shard->bytesUsed, shard->bytesMax);
     LOG_VERB("================================");
-    int depth = 0;
-    FSCacheEntry_t* item = gCache.head;
-    while (item != NULL && depth < DEPTH_LIMIT) {
-        LOG_VERB("Ptr: %p. Owner: %+.3d Name: '%16s'. Content Size: %dB. N: %p. P: %p", item, item->owner, item->file.name, item->file.contentLen, item->nex, item->pre);
-        item = item->pre;
-        depth++;
+    HashTableIter_t iter = { 0 };
+    HashTableNode_t* node = NULL;
+    while ((node = hashTableIterate(&shard->hashmap, &iter)) != NULL) {
+        FSCacheEntry_t* item = (FSCacheEntry_t*) node;
+        LOG_VERB("Ptr: %p. Owner: %+.3d Name: '%16s'. Content Size: %dB. Queue: %d", item, item->owner, item->file.name, item->length, item->evict.queue);
     }
     LOG_VERB("================================");
 }
 
 // =============================================================================================
 
-HashValue getKey(FSFile_t file) {
-    return hash_string(file.name, file.nameLen) % gConfigs.tableSize;
+FSShard_t* getShard(HashValue64 hash) {
+    // High bits select the shard, low ones are used inside its hashmap
+    return &gShards[(hash >> 32) % gNumShards];
+}
+
+// Files in memory only: placeholders of the ones on the disk tier miss (see promoteFile)
+FSCacheEntry_t* getValueFromKey(FSShard_t* shard, HashValue64 hash, const char* name, size_t nameLen) {
+    FSCacheEntry_t* entry = getEntry(shard, hash, name, nameLen);
+    return (entry != NULL && entry->state == ENTRY_RESIDENT) ? entry : NULL;
 }
 
-FSCacheEntry_t* getValueFromKey(HashValue key) {
-    return gHashmap[key];
+// Files in memory and placeholders
+FSCacheEntry_t* getEntry(FSShard_t* shard, HashValue64 hash, const char* name, size_t nameLen) {
+    // Node is the first field of the entry
+    return (FSCacheEntry_t*) hashTableFind(&shard->hashmap, hash, name, nameLen);
 }
 
-void setValueForKey(HashValue key, FSCacheEntry_t* value) {
-    gHashmap[key] = value;
+int entryHasName(const HashTableNode_t* node, const void* name, size_t nameLen) {
+    const FSCacheEntry_t* entry = (const FSCacheEntry_t*) node;
+    return entry->file.nameLen == nameLen && memcmp(entry->file.name, name, nameLen) == 0;
 }
 
-FSCacheEntry_t* createEmptyCacheEntry(FSFile_t file) {
+FSCacheEntry_t* createEmptyCacheEntry(FSShard_t* shard, FSFile_t file) {
     // Create empty entry
-    FSCacheEntry_t* entry   = (FSCacheEntry_t*) mem_malloc(sizeof(FSCacheEntry_t));
+    FSCacheEntry_t* entry   = (FSCacheEntry_t*) slabAlloc(&shard->entries);
+    entry->node.next        = NULL;
+    entry->node.hash        = 0;
     entry->file             = file;
-    entry->nex              = NULL;
-    entry->pre              = NULL;
     entry->owner            = EMPTY_OWNER;
-    entry->waitingLockQueue = createQueue(MAX_CLIENT_WAITING_ON_LOCK);
+    entry->lockQueue        = NULL;
+    entry->evict.pre        = NULL;
+    entry->evict.nex        = NULL;
+    entry->evict.hash       = 0;
+    entry->evict.size       = 0;
+    entry->dedup            = NULL;
+    entry->length           = file.contentLen;
+    entry->state            = ENTRY_RESIDENT;
+    initLatch(&entry->latch);
+    initTimerNode(&entry->timer);
+    atomic_init(&entry->refs, 1);
+    atomic_init(&entry->evict.referenced, 0);
+    atomic_init(&entry->evict.freq, 0);
 
 #ifdef DEBUG_LOG
     LOG_VERB("NEW ENTRY %p FOR CACHE: %d %s", entry, entry->file.nameLen, entry->file.name);
@@ -665,165 +1626,1209 @@ FSCacheEntry_t* createEmptyCacheEntry(FSFile_t file) {
     return entry;
 }
 
-void freeCacheEntry(FSCacheEntry_t* entry) {
-    if (entry->file.content) free((char*) entry->file.content);
-    free((char*) entry->file.name);
-    free(entry->waitingLockQueue->data);
-    free(entry->waitingLockQueue);
-    free(entry);
+// Must be called holding shard's lock (exclusive)
+void addEntry(FSShard_t* shard, FSCacheEntry_t* entry) {
+    hashTableInsert(&shard->hashmap, &entry->node);
+    attachEntry(shard, entry);
 }
 
-void moveToTop(FSCacheEntry_t* entry) {
-    if (gCache.head != entry) {
-        // Update tail
-        if (gCache.tail == NULL)       gCache.tail = entry;
-        else if (gCache.tail == entry) gCache.tail = entry->nex;
-        
-        // Link pre and nex toghether
-        FSCacheEntry_t* tmp1 = entry->pre;
-        FSCacheEntry_t* tmp2 = entry->nex;
-        if (tmp1 != NULL) entry->pre->nex = tmp2;
-        if (tmp2 != NULL) entry->nex->pre = tmp1;
+// Must be called holding shard's lock (exclusive). Links the entry everywhere but the hashmap
+void attachEntry(FSShard_t* shard, FSCacheEntry_t* entry) {
+    // Back in the cache: no longer missing
+    FSEjectedSize_t* ejected = &shard->ejectedSizes[entry->evict.hash & shard->ejectedMask];
+    if (ejected->hash == entry->evict.hash) *ejected = (FSEjectedSize_t) { 0 };
 
-        // Update entry
-        entry->pre = gCache.head;
-        entry->nex = NULL;
+    pathIndexInsert(&shard->paths, entry->file.name, entry->file.nameLen, entry);
 
-        // Update cache head (if needed)
-        if (gCache.head != NULL) gCache.head->nex = entry;
-        gCache.head = entry;
+    if (shard->denseCount == shard->denseCap) {
+        shard->denseCap = MAX(64, shard->denseCap * 2);
+        shard->dense    = (FSCacheEntry_t**) mem_realloc(shard->dense, shard->denseCap * sizeof(FSCacheEntry_t*));
     }
+    entry->denseIndex = shard->denseCount;
+    shard->dense[shard->denseCount++] = entry;
 }
 
-void updateCacheSize(FSFile_t* newFile, FSFile_t* oldFile, FSFile_t** ejectedFiles, int* ejectedFilesCount) {
-    // Update current size (MB)
-    if (newFile != NULL) gCache.bytesUsed += +(newFile->contentLen + newFile->nameLen);
-    if (oldFile != NULL) gCache.bytesUsed += -(oldFile->contentLen + oldFile->nameLen);
-
-    // Update current size (Slot)
-    if (newFile == NULL) gCache.slotUsed--;
-    if (oldFile == NULL) gCache.slotUsed++;
-
-    gMaxSlotUsed  = MAX(gMaxSlotUsed,  gCache.slotUsed);
-    gMaxBytesUsed = MAX(gMaxBytesUsed, gCache.bytesUsed);
+// Must be called holding shard's lock (exclusive)
+void removeEntry(FSShard_t* shard, FSCacheEntry_t* entry) {
+    hashTableRemove(&shard->hashmap, &entry->node);
+    if (entry->lockQueue != NULL) timerWheelCancel(&shard->leaseTimers, &entry->lockQueue->lease);
+    detachEntry(shard, entry);
+}
 
-    // Tmp array
-    static FSCacheEntry_t* ejectedFilesBuf[MAX_EJECTED_FILES_AT_SAME_TIME];
-    int ejectedFilesBufIndex = 0;
-
-    // Check for size limits (MB)
-    if (gCache.bytesUsed > gCache.bytesMax) {
-        // Eject file until reaching a correct size
-        int depth = 0;
-        FSCacheEntry_t* item = gCache.tail;
-        while (gCache.bytesUsed > gCache.bytesMax && item != NULL && depth < DEPTH_LIMIT) {
-            FSCacheEntry_t* tmp = item->nex;
-            // Remove item from cache
-            {
-                // Update hashmap
-                HashValue key = getKey(item->file);
-                setValueForKey(key, NULL);
-
-                // Update cache
-                if (item->nex) item->nex->pre = NULL;
-                if (gCache.head == item) gCache.head = NULL;
-                
-                // Add to ejected
-                ejectedFilesBuf[ejectedFilesBufIndex++] = item;
-
-                // Remove from cache sizes
-                gCache.bytesUsed -= (item->file.nameLen + item->file.contentLen);
-                --gCache.slotUsed;
-            }
-            // 
-            item = tmp;
-            depth++;
-        }
-        // Save new tail
-        gCache.tail = item;
-    }
+// Must be called holding shard's lock (exclusive). Unlinks the entry from everywhere but
+// the hashmap (its lock is kept)
+void detachEntry(FSShard_t* shard, FSCacheEntry_t* entry) {
+    pathIndexRemove(&shard->paths, entry->file.name, entry->file.nameLen);
+    timerWheelCancel(&shard->timers, &entry->timer);
 
-    // Check for size limits (Slot)
-    if (gCache.slotUsed > gCache.slotMax) {
-        // Eject 1 file
-        FSCacheEntry_t* item = gCache.tail;
+    // Last entry takes its place
+    FSCacheEntry_t* last = shard->dense[--shard->denseCount];
+    shard->dense[entry->denseIndex] = last;
+    last->denseIndex = entry->denseIndex;
+}
 
-        // Update hashmap
-        HashValue key = getKey(item->file);
-        setValueForKey(key, NULL);
+// Must be called holding shard's lock. Returns 0 if the file was not ejected lately
+size_t ejectedSize(FSShard_t* shard, HashValue64 hash) {
+    FSEjectedSize_t* ejected = &shard->ejectedSizes[hash & shard->ejectedMask];
+    return (ejected->hash == hash) ? ejected->size : 0;
+}
 
-        // Update cache
-        if (item->nex) item->nex->pre = NULL;
-        if (gCache.head == item) gCache.head = NULL;
+void freeCacheEntry(FSCacheEntry_t* entry) {
+    releaseContent(entry->file.content);
+    free((char*) entry->file.name);
+    recycleCacheEntry(entry);
+}
 
-        // Save new tail
-        gCache.tail = item->nex;
+// Operations using the entry once the shard lock is released (called holding it)
+void pinEntry(FSCacheEntry_t* entry) {
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+}
 
-        ejectedFilesBufIndex = 1;
-        ejectedFilesBuf[0] = item;
+// Last one releases the entry (unlinked from the hashmap)
+void unpinEntry(FSCacheEntry_t* entry) {
+    if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) freeCacheEntry(entry);
+}
 
-        // Remove from cache sizes
-        gCache.bytesUsed -= (item->file.nameLen + item->file.contentLen);
-        --gCache.slotUsed;
+// Release the entry but not its file (entry's hash selects the pool)
+void recycleCacheEntry(FSCacheEntry_t* entry) {
+    if (entry->lockQueue != NULL) {
+        if (entry->lockQueue->readers != NULL) {
+            free(entry->lockQueue->readers);
+            atomic_fetch_sub(&gReaderSetsAlive, 1);
+        }
+        free(entry->lockQueue);
+        atomic_fetch_sub(&gLockQueuesAlive, 1);
+    }
+    slabFree(&getShard(entry->node.hash)->entries, entry);
+}
+
+// Must be called holding shard's lock (exclusive)
+FSLockQueue_t* getLockQueue(FSCacheEntry_t* entry) {
+    // Most files never have clients waiting on lock
+    if (entry->lockQueue == NULL) {
+        FSLockQueue_t* queue = (FSLockQueue_t*) mem_malloc(sizeof(FSLockQueue_t));
+        queue->head  = NULL;
+        queue->tail  = NULL;
+        queue->count = 0;
+        queue->readers      = NULL;
+        queue->readersCount = 0;
+        queue->entry = entry;
+        initTimerNode(&queue->lease);
+        entry->lockQueue = queue;
+        atomic_fetch_add(&gLockQueuesCreated, 1);
+        atomic_fetch_add(&gLockQueuesAlive, 1);
+    }
+    return entry->lockQueue;
+}
+
+// Must be called holding shard's lock (exclusive)
+void pushWaiter(FSShard_t* shard, FSCacheEntry_t* entry, int client, int shared, long timeoutMs) {
+    FSLockQueue_t* queue   = getLockQueue(entry);
+    FSLockWaiter_t* waiter = &gLockWaiters[client];
+
+    // Last of the queue
+    waiter->entry  = entry;
+    waiter->shared = shared;
+    waiter->pre   = queue->tail;
+    waiter->nex   = NULL;
+    if (queue->tail != NULL) queue->tail->nex = waiter;
+    else queue->head = waiter;
+    queue->tail = waiter;
+    queue->count++;
+
+    // Gives up once the timeout elapsed (if any)
+    if (timeoutMs > 0) {
+        TimerTick_t now = currentTick();
+        timerWheelAdd(&shard->waitTimers, &waiter->timer, now, now + ticksFor(timeoutMs));
+    }
+    atomic_store(&waiter->shard, shard);
+
+    // Update counters
+    int longest = atomic_load_explicit(&gLockWaitMax, memory_order_relaxed);
+    while (queue->count > longest && !atomic_compare_exchange_weak(&gLockWaitMax, &longest, queue->count)) { }
+    atomic_fetch_add_explicit(&gLockWaitCount, 1, memory_order_relaxed);
+}
+
+// Must be called holding shard's lock (exclusive)
+void unlinkWaiter(FSShard_t* shard, FSLockWaiter_t* waiter) {
+    FSLockQueue_t* queue = waiter->entry->lockQueue;
+    if (waiter->pre != NULL) waiter->pre->nex = waiter->nex;
+    else queue->head = waiter->nex;
+    if (waiter->nex != NULL) waiter->nex->pre = waiter->pre;
+    else queue->tail = waiter->pre;
+    queue->count--;
+
+    timerWheelCancel(&shard->waitTimers, &waiter->timer);
+    waiter->pre   = NULL;
+    waiter->nex   = NULL;
+    waiter->entry = NULL;
+    atomic_store(&waiter->shard, NULL);
+}
+
+// Must be called holding shard's lock
+int isReader(FSCacheEntry_t* entry, int client) {
+    return entry->owner == SHARED_OWNER && ((entry->lockQueue->readers[client / 64] >> (client % 64)) & 1);
+}
+
+// Must be called holding shard's lock (exclusive)
+void addReader(FSCacheEntry_t* entry, int client) {
+    FSLockQueue_t* queue = getLockQueue(entry);
+    if (queue->readers == NULL) {
+        queue->readers = (uint64_t*) mem_calloc(READERS_WORDS, sizeof(uint64_t));
+        atomic_fetch_add(&gReaderSetsCreated, 1);
+        atomic_fetch_add(&gReaderSetsAlive, 1);
+    }
+
+    // Readers renewing the lock are already counted
+    if (isReader(entry, client)) return;
+    queue->readers[client / 64] |= (uint64_t) 1 << (client % 64);
+    queue->readersCount++;
+    entry->owner = SHARED_OWNER;
+
+    // Update counters
+    int most = atomic_load_explicit(&gSharedLockMax, memory_order_relaxed);
+    while (queue->readersCount > most && !atomic_compare_exchange_weak(&gSharedLockMax, &most, queue->readersCount)) { }
+    atomic_fetch_add_explicit(&gSharedLockCount, 1, memory_order_relaxed);
+}
+
+// Must be called holding shard's lock (exclusive).
+// The last reader leaves the file unlocked
+void removeReader(FSCacheEntry_t* entry, int client) {
+    FSLockQueue_t* queue = entry->lockQueue;
+    queue->readers[client / 64] &= ~((uint64_t) 1 << (client % 64));
+    if (--queue->readersCount == 0) entry->owner = EMPTY_OWNER;
+}
+
+// Must be called holding shard's lock
+int mustWait(FSCacheEntry_t* entry, int client, int shared) {
+    // Free or already owned (owners asking for a shared lock keep the exclusive one)
+    if (entry->owner == EMPTY_OWNER || entry->owner == client) return 0;
+    if (entry->owner != SHARED_OWNER) return 1;
+
+    // Readers renew it, the others join them unless someone waits already
+    if (shared) return !isReader(entry, client) && entry->lockQueue->head != NULL;
+
+    // The only reader upgrades it
+    return !(isReader(entry, client) && entry->lockQueue->readersCount == 1);
+}
+
+// Must be called holding shard's lock (exclusive)
+void grantLock(FSShard_t* shard, FSCacheEntry_t* entry, int client, int shared) {
+    if (shared) {
+        addReader(entry, client);
+    } else {
+        // The only reader upgrading leaves the readers
+        if (isReader(entry, client)) removeReader(entry, client);
+        entry->owner = client;
+    }
+
+    // Lease (re)starts
+    if (gConfigs.lockLeaseMs > 0) {
+        FSLockQueue_t* queue = getLockQueue(entry);
+        TimerTick_t now = currentTick();
+        timerWheelCancel(&shard->leaseTimers, &queue->lease);
+        timerWheelAdd(&shard->leaseTimers, &queue->lease, now, now + ticksFor(gConfigs.lockLeaseMs));
+    }
+}
+
+// Must be called holding shard's lock (exclusive).
+// The clients who get the lock are added to 'pending'
+void releaseLock(FSShard_t* shard, FSCacheEntry_t* entry, FSPendingNotifications_t* pending) {
+    FSLockQueue_t* queue = entry->lockQueue;
+    entry->owner = EMPTY_OWNER;
+    if (queue == NULL) return;
+
+    // Readers losing their lease leave all together
+    timerWheelCancel(&shard->leaseTimers, &queue->lease);
+    if (queue->readersCount > 0) {
+        memset(queue->readers, 0, READERS_WORDS * sizeof(uint64_t));
+        queue->readersCount = 0;
+    }
+
+    // First client waiting on lock (if any) gets it, with the readers right behind it
+    while (queue->head != NULL && (entry->owner == EMPTY_OWNER || (entry->owner == SHARED_OWNER && queue->head->shared))) {
+        int shared = queue->head->shared;
+        grantLock(shard, entry, collectWaitingClient(shard, entry, 0, pending), shared);
+    }
+    if (entry->owner == EMPTY_OWNER) LOG_VERB("[#FS] No client found in lock req queue");
+}
+
+// Must be called holding shard's lock (exclusive)
+int collectWaitingClient(FSShard_t* shard, FSCacheEntry_t* entry, int status, FSPendingNotifications_t* pending) {
+    // Take the first client waiting for lock (if any)
+    if (entry->lockQueue == NULL || entry->lockQueue->head == NULL) return EMPTY_OWNER;
+
+    FSLockWaiter_t* waiter = entry->lockQueue->head;
+    int client = (int) (waiter - gLockWaiters);
+    unlinkWaiter(shard, waiter);
+    pushNotification(pending, client, status);
+    LOG_VERB("[#FS] Removed %d from lock req queue", client);
+    return client;
+}
+
+// Must be called holding shard's lock (exclusive)
+void collectWaitingClients(FSShard_t* shard, FSCacheEntry_t* entry, int status, FSPendingNotifications_t* pending) {
+    while (collectWaitingClient(shard, entry, status, pending) != EMPTY_OWNER) { }
+}
+
+// Notify the clients waiting on the lock of an entry taken out of the hashmap.
+// MUST NOT hold shard locks (waits cancelled meanwhile are removed holding them)
+void notifyWaitingClients(FSCacheEntry_t* entry) {
+    // No client can start waiting on it anymore (the queue was created before, if ever)
+    if (entry->lockQueue == NULL) return;
+
+    FSPendingNotifications_t pending = { .count = 0 };
+    FSShard_t* shard = getShard(entry->node.hash);
+    lock_rw_mutex_write(&shard->lock);
+    collectWaitingClients(shard, entry, FS_FILE_NOT_EXISTS, &pending);
+    unlock_rw_mutex(&shard->lock);
+    publishNotifications(&pending);
+}
+
+void pushNotification(FSPendingNotifications_t* pending, int client, int status) {
+    if (pending->items == NULL) {
+        pending->items    = pending->inlineItems;
+        pending->capacity = PENDING_INLINE_COUNT;
+    } else if (pending->count == pending->capacity) {
+        pending->capacity *= 2;
+        if (pending->items == pending->inlineItems) {
+            pending->items = (FSLockNotification_t*) mem_malloc(pending->capacity * sizeof(FSLockNotification_t));
+            memcpy(pending->items, pending->inlineItems, pending->count * sizeof(FSLockNotification_t));
+        } else {
+            pending->items = (FSLockNotification_t*) mem_realloc(pending->items, pending->capacity * sizeof(FSLockNotification_t));
+        }
+    }
+    pending->items[pending->count++] = (FSLockNotification_t) { .fd = client, .status = status };
+}
+
+void publishNotifications(FSPendingNotifications_t* pending) {
+    // MUST NOT hold shard locks (waits while the lock channel is full)
+    notifyPublish(gLockChannel, pending->items, pending->count);
+    if (pending->items != pending->inlineItems) free(pending->items);
+    pending->items    = NULL;
+    pending->count    = 0;
+    pending->capacity = 0;
+}
+
+// Must be called holding gUsageMutex
+int isOverCapacity() {
+    return gCache.bytesUsed > gCache.bytesMax || gCache.slotUsed > gCache.slotMax;
+}
+
+// Must be called holding gUsageMutex
+int isOverShare(FSShard_t* shard) {
+    return (gCache.bytesUsed > gCache.bytesMax && shard->bytesUsed > shard->bytesMax)
+        || (gCache.slotUsed  > gCache.slotMax  && shard->slotUsed  > shard->slotMax);
+}
+
+// Must be called holding shard's lock ('uniqueBytes' counts shared contents once)
+void updateUsage(FSShard_t* shard, long long bytes, long long uniqueBytes, int slots) {
+    lock_mutex(&gUsageMutex);
+    shard->bytesUsed += bytes;
+    shard->slotUsed  += slots;
+    gCache.bytesUsed += uniqueBytes;
+    gCache.slotUsed  += slots;
+    gMaxSlotUsed  = MAX(gMaxSlotUsed,  gCache.slotUsed);
+    gMaxBytesUsed = MAX(gMaxBytesUsed, gCache.bytesUsed);
+    unlock_mutex(&gUsageMutex);
+}
+
+// Must be called holding shard's lock. Returns 0 if there was nothing to eject
+int ejectTail(FSShard_t* shard, FSCacheEntry_t* protect, FSEjectedBuf_t* ejected) {
+    // Ask the policy (skip the entry that triggered the ejection)
+    EvictionNode_t* victim = evictionVictim(shard->policy, (protect != NULL) ? &protect->evict : NULL);
+    if (victim == NULL) return 0;
+    ejectEntry(shard, ENTRY_OF(victim), ejected);
+    return 1;
+}
+
+// Must be called holding shard's lock (the entry is passed to 'ejected', hashmap reference included).
+// Files demoted to the disk tier leave a placeholder in the hashmap (with their lock) until written
+void ejectEntry(FSShard_t* shard, FSCacheEntry_t* item, FSEjectedBuf_t* ejected) {
+    // Remember its size: reads missing it are bytes missed because of the cache size
+    shard->ejectedSizes[item->evict.hash & shard->ejectedMask] = (FSEjectedSize_t) { .hash = item->evict.hash, .size = item->length };
+
+    if (gSpillEnabled) {
+        // Its TTL goes to the disk tier too (the disarmed timer keeps the deadline, 0 if none)
+        TimerTick_t deadline = (item->timer.prev != NULL) ? item->timer.deadline : 0;
+        detachEntry(shard, item);
+        item->timer.deadline = deadline;
+        releaseEntrySpace(shard, item, 1);
+        item->state = ENTRY_DEMOTING;
+        pinEntry(item);
+    } else {
+        unlinkEntry(shard, item, 1);
+    }
+    pushEjected(ejected, item);
+}
+
+// Must be called holding shard's lock (the entry keeps the hashmap reference)
+void unlinkEntry(FSShard_t* shard, FSCacheEntry_t* item, int evicted) {
+    // Update hashmap
+    removeEntry(shard, item);
+    releaseEntrySpace(shard, item, evicted);
+}
+
+// Must be called holding shard's lock (exclusive), once the entry is unlinked from the cache
+void releaseEntrySpace(FSShard_t* shard, FSCacheEntry_t* item, int evicted) {
+    // Log
+    logOperation(shard, PERSIST_OP_REMOVE, &item->file, NULL, 0);
+
+    // Update cache
+    evictionRemove(shard->policy, &item->evict, evicted);
+    long long uniqueBytes = -entryUniqueSize(item);
+    uniqueBytes += dedupRelease(&gDedup, item->dedup);
+    item->dedup  = NULL;
+    updateUsage(shard, -(long long) item->evict.size, uniqueBytes, -1);
+}
+
+void pushEjected(FSEjectedBuf_t* ejected, FSCacheEntry_t* item) {
+    if (ejected->entries == NULL) {
+        ejected->entries  = ejected->inlineEntries;
+        ejected->capacity = EJECTED_INLINE_COUNT;
+    } else if (ejected->size == ejected->capacity) {
+        ejected->capacity *= 2;
+        if (ejected->entries == ejected->inlineEntries) {
+            ejected->entries = (FSCacheEntry_t**) mem_malloc(ejected->capacity * sizeof(FSCacheEntry_t*));
+            memcpy(ejected->entries, ejected->inlineEntries, ejected->size * sizeof(FSCacheEntry_t*));
+        } else {
+            ejected->entries = (FSCacheEntry_t**) mem_realloc(ejected->entries, ejected->capacity * sizeof(FSCacheEntry_t*));
+        }
+    }
+    ejected->entries[ejected->size++] = item;
+}
+
+void updateCacheSize(FSShard_t* shard, FSFile_t* newFile, FSFile_t* oldFile, long long uniqueBytes, FSCacheEntry_t* protect, FSEjectedBuf_t* ejected) {
+    // Update current size (MB)
+    long long bytes = 0;
+    if (newFile != NULL) bytes += +(long long) storedSize(newFile);
+    if (oldFile != NULL) bytes += -(long long) storedSize(oldFile);
+
+    // Update current size (Slot)
+    int slots = 0;
+    if (newFile == NULL) slots--;
+    if (oldFile == NULL) slots++;
+
+    updateUsage(shard, bytes, uniqueBytes, slots);
+    if (ejected != NULL) makeRoom(shard, protect, ejected);
+}
+
+// Must be called holding shard's lock
+void makeRoom(FSShard_t* shard, FSCacheEntry_t* protect, FSEjectedBuf_t* ejected) {
+    // Eject files from this shard while it exceeds its own share
+    // (other shards are handled by enforceGlobalCapacity, after releasing this one)
+    int depth = 0;
+    while (depth++ < DEPTH_LIMIT) {
+        lock_mutex(&gUsageMutex);
+        int shouldEject = isOverShare(shard);
+        unlock_mutex(&gUsageMutex);
+        if (!shouldEject || !ejectTail(shard, protect, ejected)) break;
+    }
+}
+
+// Accesses (outside shard locks) weigh new contents against the ones they would eject
+void recordAccess(HashValue64 hash) {
+    if (gAdmissionEnabled) admissionRecord(&gAdmission, hash);
+}
+
+// Must be called holding shard's lock (exclusive), once the entry is accounted.
+// Declined when the cache is full and the policy's victim is accessed as often (or more).
+// Only new files are judged (files cached already keep their place when written or
+// read back from the disk tier), empty ones are admitted.
+// Choosing the victim moves the policy on (CLOCK's hand, W-TinyLFU's window): once admitted,
+// the victim compared is set into 'victim' (NULL if none) and MUST be the one ejected
+int isDeclined(FSShard_t* shard, FSCacheEntry_t* entry, FSCacheEntry_t** victim) {
+    *victim = NULL;
+    if (!gAdmissionEnabled || entry->length == 0) return 0;
+
+    lock_mutex(&gUsageMutex);
+    int full = isOverCapacity();
+    unlock_mutex(&gUsageMutex);
+    if (!full) return 0;
+
+    EvictionNode_t* node = evictionVictim(shard->policy, &entry->evict);
+    if (node == NULL) return 0;
+    if (admissionAdmit(&gAdmission, entry->node.hash, node->hash)) {
+        *victim = ENTRY_OF(node);
+        return 0;
+    }
+
+    atomic_fetch_add_explicit(&gDeclinedCount, 1, memory_order_relaxed);
+    return 1;
+}
+
+// Must be called holding shard's lock (exclusive).
+// The victim the entry was admitted against goes first, then the shard's share is enforced
+void admitEntry(FSShard_t* shard, FSCacheEntry_t* entry, FSCacheEntry_t* victim, FSEjectedBuf_t* ejected) {
+    if (victim != NULL) ejectEntry(shard, victim, ejected);
+    makeRoom(shard, entry, ejected);
+}
+
+void enforceGlobalCapacity(FSCacheEntry_t* protect, FSEjectedBuf_t* ejected) {
+    // Shards with nothing left to eject (only the protected entry)
+    char skip[MAX_SHARDS_COUNT] = { 0 };
+    int depth = 0;
+    while (depth++ < DEPTH_LIMIT) {
+        // Choose the shard exceeding its share the most
+        FSShard_t* victim = NULL;
+        lock_mutex(&gUsageMutex);
+        if (isOverCapacity()) {
+            long long victimExcess = 0;
+            for (int i = 0; i < gNumShards; ++i) {
+                FSShard_t* shard = &gShards[i];
+                long long excess = (gCache.bytesUsed > gCache.bytesMax)
+                    ? shard->bytesUsed - shard->bytesMax
+                    : shard->slotUsed  - shard->slotMax;
+                if (!skip[i] && shard->slotUsed > 0 && (victim == NULL || excess > victimExcess)) {
+                    victim       = shard;
+                    victimExcess = excess;
+                }
+            }
+        }
+        unlock_mutex(&gUsageMutex);
+        if (victim == NULL) break;
+
+        // Eject from its tail until global capacity is respected
+        struct timespec lockedAt = lockShard(victim);
+        int ejectedSomething = 0;
+        while (depth++ < DEPTH_LIMIT) {
+            lock_mutex(&gUsageMutex);
+            int shouldEject = isOverCapacity();
+            unlock_mutex(&gUsageMutex);
+            if (!shouldEject || !ejectTail(victim, protect, ejected)) break;
+            ejectedSomething = 1;
+        }
+        unlockShard(victim, lockedAt);
+
+        // Nothing left to eject, try with another shard
+        if (!ejectedSomething) skip[victim - gShards] = 1;
     }
+}
+
+void releaseEjected(FSEjectedBuf_t* ejected, FSFile_t** ejectedFiles, int* ejectedFilesCount) {
+    if (ejected->size) {
+        // Bytes ejected
+        long long bytes = 0;
+        for (int i = 0; i < ejected->size; ++i) bytes += ejected->entries[i]->evict.size;
 
-    if (ejectedFilesBufIndex) {
         // Increment capacity misses
-        gCapacityMisses    += ejectedFilesBufIndex;
-        gCapacityMissesMax  = MAX(gCapacityMissesMax, ejectedFilesBufIndex);
+        lock_mutex(&gUsageMutex);
+        gCapacityMisses    += ejected->size;
+        gCapacityMissesMax  = MAX(gCapacityMissesMax, ejected->size);
+        gCapacityMissesBytes    += bytes;
+        gCapacityMissesBytesMax  = MAX(gCapacityMissesBytesMax, bytes);
+        unlock_mutex(&gUsageMutex);
 
         // Save values and release entries memory
-        FSFile_t* files = (FSFile_t*) mem_malloc(ejectedFilesBufIndex * sizeof(FSFile_t));
-        for (int i = 0; i < ejectedFilesBufIndex; ++i) {
-            FSCacheEntry_t* entry = ejectedFilesBuf[i];
-            files[i] = entry->file;
+        FSFile_t* files = (FSFile_t*) mem_malloc(ejected->size * sizeof(FSFile_t));
+        for (int i = 0; i < ejected->size; ++i) {
+            FSCacheEntry_t* entry = ejected->entries[i];
 
-            // Notify all clients waiting for lock
-            CircQueueItemPtr_t item;
-            while (tryPop(entry->waitingLockQueue, &item) == 1) {
-                // Create notification to send
-                FSLockNotification_t* notification = (FSLockNotification_t*) mem_malloc(sizeof(FSLockNotification_t));
-                notification->fd     = (intptr_t) item;
-                notification->status = FS_FILE_NOT_EXISTS; // File has been removed
-                // Push into lock queue
-                while (tryPush(gLockQueue, notification) != 1) {
-                    // Try again fastest possible.
-                    // It blocks the entire server and needs to be done fast
-                }
-                LOG_VERB("[#FS] Removed %d from lock req queue", notification->fd);
-                // Signal queue
-                lock_mutex(gLockMutex);
-                notify_one(gLockCond);
-                unlock_mutex(gLockMutex);
+            // Take the file out (once the pending operations are done, placeholders keep their name)
+            int demoting = entry->state == ENTRY_DEMOTING;
+            latchAcquire(&entry->latch);
+            files[i] = entry->file;
+            if (demoting) copyName(entry->file, &files[i]);
+            else entry->file.name = NULL;
+            entry->file.content    = NULL;
+            entry->file.contentLen = 0;
+            latchRelease(&entry->latch);
+
+            if (demoting) {
+                // Demote (outside shard locks, its lock is kept by the placeholder)
+                long long expiresAt = tickExpiry(entry->timer.deadline);
+                endDemotion(entry, spillPut(&gSpill, entry->node.hash, files[i].name, files[i].nameLen, files[i].content, files[i].contentLen, expiresAt));
+            } else {
+                // Notify all clients waiting for lock (shard locks are already released)
+                notifyWaitingClients(entry);
             }
 
-            // Release memory
-            free(entry->waitingLockQueue->data);
-            free(entry->waitingLockQueue);
-            free(entry);
+            // Release memory (file is passed out)
+            unpinEntry(entry);
         }
 
         // Pass values
-        *ejectedFilesCount = ejectedFilesBufIndex;
+        *ejectedFilesCount = ejected->size;
         *ejectedFiles      = files;
     }
+    if (ejected->entries != ejected->inlineEntries) free(ejected->entries);
 }
 
-void deepCopyFile(FSFile_t file, FSFile_t* outFile) {
-    // Copy name
+void shareFile(FSFile_t file, FSFile_t* outFile) {
+    copyName(file, outFile);
+
+    // Share content
+    outFile->content    = acquireContent(file.content);
+    outFile->contentLen = file.contentLen;
+}
+
+void copyName(FSFile_t file, FSFile_t* outFile) {
     char* name = (char*) mem_malloc(file.nameLen * sizeof(char));
     memcpy(name, file.name, file.nameLen);
     outFile->name    = name;
     outFile->nameLen = file.nameLen;
+}
+
+void compressFile(FSFile_t* file) {
+    if (gConfigs.compression != FS_COMPRESSION_HUFFMAN || file->content == NULL) return;
 
-    // Copy content
-    char* content = NULL;
-    if (file.contentLen) {
-        content = (char*) mem_malloc(file.contentLen * sizeof(char));
-        memcpy(content, file.content, file.contentLen);
+    // Falls back to raw content when the saving is too low
+    file->content = compressContent(file->content, file->contentLen, gConfigs.compressionMinSaving);
+    atomic_fetch_add_explicit(&gCompressTried, 1, memory_order_relaxed);
+
+    size_t size = getContentSize(file->content, file->contentLen);
+    if (size < file->contentLen) {
+        atomic_fetch_add_explicit(&gCompressStored, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gCompressRawBytes, file->contentLen, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gCompressStoredBytes, size, memory_order_relaxed);
     }
-    outFile->content    = content;
-    outFile->contentLen = file.contentLen;
+}
+
+size_t storedSize(const FSFile_t* file) {
+    // Capacity is accounted on stored (maybe compressed) bytes
+    return file->nameLen + getContentSize(file->content, file->contentLen);
+}
+
+long long uniqueSize(const FSFile_t* file, const DedupEntry_t* dedup) {
+    // Shared contents are counted by the dedup index
+    return (dedup != NULL) ? (long long) file->nameLen : (long long) storedSize(file);
+}
+
+// Must be called holding shard's lock (content may be changing, its accounted size is not)
+long long entryUniqueSize(const FSCacheEntry_t* entry) {
+    return (entry->dedup != NULL) ? (long long) entry->file.nameLen : (long long) entry->evict.size;
+}
+
+int isSpilled(HashValue64 hash, FSFile_t file) {
+    return gSpillEnabled && spillContains(&gSpill, hash, file.name, file.nameLen);
+}
+
+int promoteFile(int client, FSFile_t file) {
+    if (!gSpillEnabled) return 0;
+
+    HashValue64 hash     = hash_string_64(file.name, file.nameLen);
+    FSShard_t* shard     = getShard(hash);
+    FSCacheEntry_t* stub = NULL;
+
+    // Publish a placeholder (lookups wait for the files moving meanwhile)
+    while (stub == NULL) {
+        struct timespec lockedAt = lockShard(shard);
+        FSCacheEntry_t* entry = getEntry(shard, hash, file.name, file.nameLen);
+        int state             = (entry != NULL) ? entry->state : ENTRY_SPILLED;
+        unsigned long seq     = transitSeq();
+        if (entry != NULL && state == ENTRY_SPILLED) {
+            // Its lock was kept meanwhile
+            stub = entry;
+            stub->state = ENTRY_PROMOTING;
+        } else if (entry == NULL && isSpilled(hash, file)) {
+            FSFile_t name = { .content = NULL, .contentLen = 0 };
+            copyName(file, &name);
+            stub = createEmptyCacheEntry(shard, name);
+            stub->node.hash  = hash;
+            stub->evict.hash = hash;
+            stub->state      = ENTRY_PROMOTING;
+            hashTableInsert(&shard->hashmap, &stub->node);
+        }
+        unlockShard(shard, lockedAt);
+
+        // In memory (back already) or nowhere: the caller tries again
+        if (stub == NULL && (entry == NULL || state == ENTRY_RESIDENT)) return entry != NULL;
+        if (stub == NULL) waitTransit(seq);
+    }
+
+    // Take it from the disk tier (outside locks)
+    FSFile_t promoted = { .name = stub->file.name, .nameLen = stub->file.nameLen };
+    long long expiresAt = 0;
+    int taken = spillTake(&gSpill, hash, file.name, file.nameLen, &promoted.content, &promoted.contentLen, &expiresAt);
+
+    // Its TTL elapsed while on disk: dropped as if it expired in memory
+    int expired = taken && expiresAt != 0 && expiresAt <= wallClockMs();
+    if (expired) {
+        atomic_fetch_add_explicit(&gExpiredCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gExpiredBytes, (long long) promoted.contentLen, memory_order_relaxed);
+        releaseContent(promoted.content);
+        promoted.content    = NULL;
+        promoted.contentLen = 0;
+        taken = 0;
+    }
+    Content_t* raw = (gPersistEnabled && taken) ? acquireContent(promoted.content) : NULL;
+    compressFile(&promoted);
+    HashValue64 contentHash = dedupHash(promoted.content, promoted.contentLen);
+
+    FSPendingNotifications_t pending = { .count = 0 };
+    FSEjectedBuf_t ejected = { NULL, 0, 0 };
+
+    // Acquire lock
+    struct timespec lockedAt = lockShard(shard);
+
+    if (taken) {
+        // Fill the placeholder (its lock, waiters and lease are kept, admission is not asked again)
+        stub->file       = promoted;
+        stub->length     = promoted.contentLen;
+        stub->evict.size = storedSize(&promoted);
+        stub->state      = ENTRY_RESIDENT;
+        long long dedupBytes = 0;
+        stub->dedup = dedupAcquire(&gDedup, &stub->file.content, promoted.contentLen, contentHash, &dedupBytes);
+        attachEntry(shard, stub);
+        armExpiry(shard, stub, expiresAt);
+
+        // Log (before the ejections it causes)
+        logInsert(shard, &promoted, rawBytes(raw, promoted.contentLen), promoted.contentLen, expiresAt);
+
+        // Update cache
+        evictionInsert(shard->policy, &stub->evict);
+        updateCacheSize(shard, &stub->file, NULL, uniqueSize(&stub->file, stub->dedup) + dedupBytes, stub, &ejected);
+    } else {
+        // Lost meanwhile (overwritten on disk) or expired: so is its lock
+        hashTableRemove(&shard->hashmap, &stub->node);
+        if (stub->lockQueue != NULL) timerWheelCancel(&shard->leaseTimers, &stub->lockQueue->lease);
+        collectWaitingClients(shard, stub, FS_FILE_NOT_EXISTS, &pending);
+    }
+
+#ifdef DEBUG_LOG
+    log_cache_entirely(shard, "promote");
+#endif
+
+    // Release lock
+    unlockShard(shard, lockedAt);
+    releaseContent(raw);
+    endTransit();
+    publishNotifications(&pending);
+
+    if (taken) {
+        // Make room inside other shards (files ejected were demoted: nobody to pass them to)
+        FSFile_t* ejectedFiles = NULL;
+        int ejectedCount       = 0;
+        enforceGlobalCapacity(stub, &ejected);
+        releaseEjected(&ejected, &ejectedFiles, &ejectedCount);
+        releaseFiles(ejectedFiles, ejectedCount);
+    } else {
+        unpinEntry(stub);
+    }
+    return taken;
+}
+
+// Ends the demotion of an entry ejected ('written' tells if it is on the disk tier now).
+// MUST NOT hold shard locks
+void endDemotion(FSCacheEntry_t* entry, int written) {
+    FSPendingNotifications_t pending = { .count = 0 };
+    FSShard_t* shard = getShard(entry->node.hash);
+
+    // Acquire lock
+    lock_rw_mutex_write(&shard->lock);
+
+    if (written) {
+        // Placeholder kept only for its lock
+        entry->state = ENTRY_SPILLED;
+        dropUnusedStub(shard, entry);
+    } else {
+        // Lost: so is its lock
+        hashTableRemove(&shard->hashmap, &entry->node);
+        if (entry->lockQueue != NULL) timerWheelCancel(&shard->leaseTimers, &entry->lockQueue->lease);
+        collectWaitingClients(shard, entry, FS_FILE_NOT_EXISTS, &pending);
+        unpinEntry(entry);
+    }
+
+    // Release lock
+    unlock_rw_mutex(&shard->lock);
+    endTransit();
+    publishNotifications(&pending);
+}
+
+// Must be called holding shard's lock (exclusive). Placeholders of the files on the disk tier
+// are removed once nobody holds or waits on their lock
+void dropUnusedStub(FSShard_t* shard, FSCacheEntry_t* entry) {
+    if (entry->state != ENTRY_SPILLED || entry->owner != EMPTY_OWNER) return;
+    if (entry->lockQueue != NULL && entry->lockQueue->head != NULL) return;
+
+    hashTableRemove(&shard->hashmap, &entry->node);
+    if (entry->lockQueue != NULL) timerWheelCancel(&shard->leaseTimers, &entry->lockQueue->lease);
+    unpinEntry(entry);
+}
+
+// Files moved from or to the disk tier so far (read holding the shard lock of the one moving)
+unsigned long transitSeq() {
+    return atomic_load(&gTransitSeq);
+}
+
+// Wakes up the clients waiting for files to move. MUST NOT hold shard locks
+void endTransit() {
+    lock_mutex(&gTransitMutex);
+    atomic_fetch_add(&gTransitSeq, 1);
+    notify_all(&gTransitCond);
+    unlock_mutex(&gTransitMutex);
+}
+
+// Waits for a move to end after 'seq' was read. MUST NOT hold shard locks
+void waitTransit(unsigned long seq) {
+    lock_mutex(&gTransitMutex);
+    while (atomic_load(&gTransitSeq) == seq) {
+        int res = pthread_cond_wait(&gTransitCond, &gTransitMutex);
+        if (res != 0) {
+            errno = res;
+            LOG_ERRNO("[#FS] Error waiting for a file to move");
+            break;
+        }
+    }
+    unlock_mutex(&gTransitMutex);
+}
+
+// Bytes order (a name is lower than the ones it is a prefix of)
+int compareNames(const char* a, size_t aLen, const char* b, size_t bLen) {
+    int cmp = memcmp(a, b, MIN(aLen, bLen));
+    if (cmp != 0) return cmp;
+    return (aLen < bLen) ? -1 : (aLen > bLen);
+}
+
+// Merge two sorted lists keeping the first 'max' files (names of the others are released)
+int mergeListed(FSFile_t* a, int aCount, FSFile_t* b, int bCount, FSFile_t* out, int max) {
+    int i = 0, j = 0, count = 0;
+    while (count < max && (i < aCount || j < bCount)) {
+        if (j == bCount || (i < aCount && compareNames(a[i].name, a[i].nameLen, b[j].name, b[j].nameLen) < 0))
+            out[count++] = a[i++];
+        else
+            out[count++] = b[j++];
+    }
+    for (; i < aCount; ++i) free((char*) a[i].name);
+    for (; j < bCount; ++j) free((char*) b[j].name);
+    return count;
+}
+
+void releaseFiles(FSFile_t* files, int count) {
+    for (int i = 0; i < count; ++i) {
+        releaseContent(files[i].content);
+        free((char*) files[i].name);
+    }
+    free(files);
+}
+
+const char* rawBytes(Content_t* raw, size_t len) {
+    // Contents received are made by a single segment
+    size_t size = 0;
+    return getContentBytes(raw, len, &size);
+}
+
+// Must be called holding shard's lock (exclusive)
+void logOperation(FSShard_t* shard, int op, const FSFile_t* file, const char* data, size_t len) {
+    if (persistLogAppend(&shard->log, op, file->name, file->nameLen, data, len) == -1)
+        LOG_ERRNO("[#FS] Error writing log of shard #%ld", shard - gShards);
+}
+
+void logInsert(FSShard_t* shard, const FSFile_t* file, const char* data, size_t len, long long expiresAt) {
+    if (persistLogAppendInsert(&shard->log, file->name, file->nameLen, expiresAt, data, len) == -1)
+        LOG_ERRNO("[#FS] Error writing log of shard #%ld", shard - gShards);
+}
+
+void logRange(FSShard_t* shard, const FSFile_t* file, size_t offset) {
+    if (persistLogAppendRange(&shard->log, file->name, file->nameLen, offset, file->data, file->contentLen) == -1)
+        LOG_ERRNO("[#FS] Error writing log of shard #%ld", shard - gShards);
+}
+
+void restoreFileSystem() {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Contents left inside the arena by the last snapshots are kept, every other extent is freed
+    if (gArenaEnabled) {
+        size_t reserved = 0;
+        for (int i = 0; i < MAX_SHARDS_COUNT; ++i) reserved += reservePersistShard(gConfigs.persistDir, i, gNumShards);
+        arenaRebuild(&gArena);
+        if (reserved > 0) LOG_VERB("[#FS] %zu contents found inside arena", reserved);
+    }
+
+    // Shards are replayed in parallel (operations on a file are all inside the files of its shard)
+    FSReplayJob_t* job = (FSReplayJob_t*) mem_calloc(1, sizeof(FSReplayJob_t));
+    atomic_init(&job->next, 0);
+    long cpus   = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = MAX(1, (MIN(gNumShards, 2 * (int) (MAX(1, cpus)))));
+    pthread_t tids[MAX_SHARDS_COUNT];
+    int started = 0;
+    while (started < threads - 1 && pthread_create(&tids[started], NULL, replayThreadFun, job) == 0) ++started;
+    replayThreadFun(job);
+    for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+
+    // Totals
+    int layoutChanged = 0;
+    for (int i = 0; i < MAX_SHARDS_COUNT; ++i) {
+        PersistReplay_t* result = &job->results[i];
+        if (!result->found) continue;
+        gRestoredFiles += result->filesCount;
+        gRestoredOps   += result->opsCount;
+        layoutChanged  |= result->layoutChanged || i >= gNumShards;
+    }
+
+    // Logs go on from the last generation replayed
+    for (int i = 0; i < gNumShards; ++i) {
+        if (openPersistLog(&gShards[i].log, gConfigs.persistDir, i, gNumShards, job->results[i].lastGen) == -1)
+            LOG_ERRNO("[#FS] Error opening log of shard #%d", i);
+    }
+
+    // Files written with another shards count: group them again right now
+    if (layoutChanged) {
+        snapshotFileSystem(0);
+        for (int i = gNumShards; i < MAX_SHARDS_COUNT; ++i)
+            if (job->results[i].found) removePersistShard(gConfigs.persistDir, i, job->results[i].lastGen);
+    }
+    free(job);
+
+    gRestoreMs      = elapsedMs(start);
+    gRestoreThreads = started + 1;
+    LOG_INFO("[#FS] Restored %zu files (%zu logged operations) from '%s' in %.2f ms using %d threads", gRestoredFiles, gRestoredOps, gConfigs.persistDir, gRestoreMs, gRestoreThreads);
+}
+
+void* replayThreadFun(void* arg) {
+    FSReplayJob_t* job = (FSReplayJob_t*) arg;
+    int index = 0;
+    while ((index = atomic_fetch_add(&job->next, 1)) < MAX_SHARDS_COUNT)
+        job->results[index] = replayPersistShard(gConfigs.persistDir, index, gNumShards, replayOperation, NULL);
+    return NULL;
+}
+
+void replayOperation(void* arg, int op, FSFile_t file, size_t offset, long long expiresAt) {
+    // Files ejected to make room are dropped (logs are not opened yet)
+    FSFile_t* ejected = NULL;
+    int ejectedCount  = 0;
+
+    // Files whose TTL elapsed while the server was down are dropped
+    long long ttlMs = (expiresAt != 0) ? expiresAt - wallClockMs() : 0;
+    if (expiresAt != 0 && ttlMs <= 0) {
+        if (fs_exists(EMPTY_OWNER, file) == 0) fs_remove(EMPTY_OWNER, file);
+        atomic_fetch_add_explicit(&gExpiredCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gExpiredBytes, (long long) file.contentLen, memory_order_relaxed);
+        releaseContent(file.content);
+        free((char*) file.name);
+        return;
+    }
+
+    // Nobody owns the files (EMPTY_OWNER is allowed to change them)
+    switch (op) {
+        case PERSIST_OP_INSERT:
+        case PERSIST_OP_MODIFY:
+            if (fs_exists(EMPTY_OWNER, file) == 0) fs_modify(EMPTY_OWNER, file, &ejected, &ejectedCount);
+            else fs_insert(EMPTY_OWNER, file, 0, ttlMs, &ejected, &ejectedCount);
+            break;
+        case PERSIST_OP_APPEND:
+            fs_append(EMPTY_OWNER, file, &ejected, &ejectedCount);
+            break;
+        case PERSIST_OP_WRITE_RANGE:
+            fs_write_range(EMPTY_OWNER, file, offset, &ejected, &ejectedCount);
+            break;
+        case PERSIST_OP_REMOVE:
+            fs_remove(EMPTY_OWNER, file);
+            break;
+    }
+    releaseFiles(ejected, ejectedCount);
+}
+
+int snapshotShard(FSShard_t* shard, int references, size_t* filesCount, double* lockMs) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Acquire lock (shared: logs are appended holding it exclusive)
+    lock_rw_mutex_read(&shard->lock);
+
+    // Contents are shared, not copied: the lock is held only to collect them
+    int count = 0;
+    FSFile_t* files      = (FSFile_t*) mem_malloc((MAX(1, shard->slotUsed)) * sizeof(FSFile_t));
+    long long* expiresAt = (long long*) mem_malloc((MAX(1, shard->slotUsed)) * sizeof(long long));
+    HashTableIter_t iter = { 0 };
+    HashTableNode_t* node = NULL;
+    while ((node = hashTableIterate(&shard->hashmap, &iter)) != NULL) {
+        // Operations logged before the rotation are done first (their tickets come before)
+        FSCacheEntry_t* entry = (FSCacheEntry_t*) node;
+        if (entry->state != ENTRY_RESIDENT) continue;
+        expiresAt[count] = entryExpiry(entry);
+        latchAcquire(&entry->latch);
+        shareFile(entry->file, &files[count++]);
+        latchRelease(&entry->latch);
+    }
+
+    // Following operations go into the next log
+    int rotated = rotatePersistLog(&shard->log) == 0;
+    unsigned long gen = shard->log.gen;
+
+    // Release lock
+    unlock_rw_mutex(&shard->lock);
+    *lockMs = elapsedMs(start);
+
+    // Write it (then remove the logs it includes)
+    int res = 0;
+    if (!rotated) LOG_ERRNO("[#FS] Error rotating log of shard #%ld", shard - gShards);
+    else if (writePersistSnapshot(gConfigs.persistDir, shard - gShards, gNumShards, gen, files, expiresAt, count, references) == -1)
+        LOG_ERRNO("[#FS] Error writing snapshot of shard #%ld", shard - gShards);
+    else {
+        *filesCount += count;
+        res = 1;
+    }
+
+    releaseFiles(files, count);
+    free(expiresAt);
+    return res;
+}
+
+void snapshotFileSystem(int references) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // One shard at a time (the others are never stopped)
+    size_t filesCount = 0;
+    int written = 0;
+    for (int i = 0; i < gNumShards; ++i) {
+        double lockMs = 0;
+        written += snapshotShard(&gShards[i], references, &filesCount, &lockMs);
+        gSnapshotMaxLockMs = MAX(gSnapshotMaxLockMs, lockMs);
+    }
+
+    // No snapshot refers to the contents reattached at startup anymore
+    if (gArenaEnabled && written == gNumShards && !references) arenaUnpin(&gArena);
+
+    gSnapshotsCount += 1;
+    gSnapshotFiles   = filesCount;
+    gSnapshotMs      = elapsedMs(start);
+    LOG_VERB("[#FS] Snapshot of %zu files taken in %.2f ms", filesCount, gSnapshotMs);
+}
+
+void* snapshotThreadFun(void* arg) {
+    lock_mutex(&gSnapshotMutex);
+    while (!gSnapshotStop) {
+        // Wait for the interval (or termination)
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += gConfigs.snapshotInterval;
+        int err = 0;
+        while (!gSnapshotStop && err != ETIMEDOUT) err = pthread_cond_timedwait(&gSnapshotCond, &gSnapshotMutex, &deadline);
+        if (gSnapshotStop) break;
+
+        unlock_mutex(&gSnapshotMutex);
+        snapshotFileSystem(0);
+        lock_mutex(&gSnapshotMutex);
+    }
+    unlock_mutex(&gSnapshotMutex);
+    return NULL;
+}
+
+long long ttlClockMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long ms = (now.tv_sec - gTtlEpoch.tv_sec) * 1000LL + (now.tv_nsec - gTtlEpoch.tv_nsec) / 1000000LL;
+    return MAX(0, ms);
+}
+
+TimerTick_t currentTick() {
+    return (TimerTick_t) (ttlClockMs() / TTL_TICK_MS);
+}
+
+TimerTick_t ticksFor(long ms) {
+    // Never before 'ms' elapsed: the current tick has already begun
+    return (TimerTick_t) ((ms + TTL_TICK_MS - 1) / TTL_TICK_MS + 1);
+}
+
+long long wallClockMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000LL;
+}
+
+long long tickExpiry(TimerTick_t deadline) {
+    // Deadlines leave the process as wall-clock times (0 stays 'none')
+    if (deadline == 0) return 0;
+    long long left = (long long) deadline * TTL_TICK_MS - ttlClockMs();
+    return wallClockMs() + (MAX(0, left));
+}
+
+// Must be called holding shard's lock
+long long entryExpiry(const FSCacheEntry_t* entry) {
+    return (entry->timer.prev != NULL) ? tickExpiry(entry->timer.deadline) : 0;
+}
+
+// Must be called holding shard's lock (exclusive). Deadlines already passed expire with the next tick
+void armExpiry(FSShard_t* shard, FSCacheEntry_t* entry, long long expiresAt) {
+    if (expiresAt == 0) return;
+    TimerTick_t now = currentTick();
+    timerWheelAdd(&shard->timers, &entry->timer, now, now + ticksFor(MAX(0, expiresAt - wallClockMs())));
+}
+
+void expireShard(FSShard_t* shard) {
+    FSEjectedBuf_t expired = { NULL, 0, 0 };
+
+    // Acquire lock
+    lock_rw_mutex_write(&shard->lock);
+
+    // Remove the files whose TTL elapsed (their timers are already disarmed)
+    TimerNode_t* node = timerWheelAdvance(&shard->timers, currentTick());
+    while (node != NULL) {
+        FSCacheEntry_t* entry = (FSCacheEntry_t*) ((char*) node - offsetof(FSCacheEntry_t, timer));
+        node = node->next;
+        unlinkEntry(shard, entry, 0);
+        pushEjected(&expired, entry);
+    }
+
+#ifdef DEBUG_LOG
+    if (expired.size) log_cache_entirely(shard, "expire");
+#endif
+
+    // Release lock
+    unlock_rw_mutex(&shard->lock);
+
+    releaseExpired(&expired);
+}
+
+void expireLocks(FSShard_t* shard) {
+    FSPendingNotifications_t pending = { .count = 0 };
+    long timedOut = 0, leases = 0;
+
+    // Acquire lock
+    lock_rw_mutex_write(&shard->lock);
+    TimerTick_t now = currentTick();
+
+    // Clients waiting too long give up (their timers are already disarmed)
+    TimerNode_t* node = timerWheelAdvance(&shard->waitTimers, now);
+    while (node != NULL) {
+        FSLockWaiter_t* waiter = (FSLockWaiter_t*) ((char*) node - offsetof(FSLockWaiter_t, timer));
+        FSCacheEntry_t* entry  = waiter->entry;
+        node = node->next;
+        unlinkWaiter(shard, waiter);
+        pushNotification(&pending, (int) (waiter - gLockWaiters), FS_LOCK_TIMED_OUT);
+
+        // Its other waiters expiring are still queued (the placeholder is kept for them)
+        dropUnusedStub(shard, entry);
+        timedOut++;
+    }
+
+    // Owners holding the lock too long lose it (the first client waiting gets it)
+    node = timerWheelAdvance(&shard->leaseTimers, now);
+    while (node != NULL) {
+        FSLockQueue_t* queue = (FSLockQueue_t*) ((char*) node - offsetof(FSLockQueue_t, lease));
+        node = node->next;
+        LOG_VERB("[#FS] Lease of %d expired (%d readers)", queue->entry->owner, queue->readersCount);
+        releaseLock(shard, queue->entry, &pending);
+        dropUnusedStub(shard, queue->entry);
+        leases++;
+    }
+
+    // Release lock
+    unlock_rw_mutex(&shard->lock);
+
+    publishNotifications(&pending);
+    atomic_fetch_add_explicit(&gLockTimeoutCount, timedOut, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gLeaseExpiredCount, leases, memory_order_relaxed);
+}
+
+void releaseExpired(FSEjectedBuf_t* expired) {
+    long long bytes = 0;
+    for (int i = 0; i < expired->size; ++i) {
+        FSCacheEntry_t* entry = expired->entries[i];
+        bytes += entry->evict.size;
+
+        // Notify all clients waiting for lock (shard locks are already released)
+        notifyWaitingClients(entry);
+
+        // Release memory (once the pending operations are done)
+        unpinEntry(entry);
+    }
+    atomic_fetch_add_explicit(&gExpiredCount, expired->size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gExpiredBytes, bytes, memory_order_relaxed);
+    if (expired->entries != expired->inlineEntries) free(expired->entries);
+}
+
+void* expiryThreadFun(void* arg) {
+    lock_mutex(&gExpiryMutex);
+    while (!gExpiryStop) {
+        // Wait for the next tick (or termination)
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TTL_TICK_MS * 1000000L;
+        deadline.tv_sec  += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        int err = 0;
+        while (!gExpiryStop && err != ETIMEDOUT) err = pthread_cond_timedwait(&gExpiryCond, &gExpiryMutex, &deadline);
+        if (gExpiryStop) break;
+
+        // Shards are locked only once a deadline is reached (or a wheel has to be spread)
+        unlock_mutex(&gExpiryMutex);
+        TimerTick_t now = currentTick();
+        for (int i = 0; i < gNumShards; ++i) {
+            FSShard_t* shard = &gShards[i];
+            if (atomic_load_explicit(&shard->timers.next, memory_order_relaxed) <= now) expireShard(shard);
+            if (atomic_load_explicit(&shard->waitTimers.next, memory_order_relaxed) <= now
+                || atomic_load_explicit(&shard->leaseTimers.next, memory_order_relaxed) <= now) expireLocks(shard);
+        }
+        lock_mutex(&gExpiryMutex);
+    }
+    unlock_mutex(&gExpiryMutex);
+    return NULL;
+}
+
+uint64_t nextRandom() {
+    // Seed differs for each thread
+    if (tRandomState == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        tRandomState = ((uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec) ^ (uint64_t) (uintptr_t) &tRandomState;
+        tRandomState = (tRandomState == 0) ? 1 : tRandomState;
+    }
+
+    tRandomState ^= tRandomState >> 12;
+    tRandomState ^= tRandomState << 25;
+    tRandomState ^= tRandomState >> 27;
+    return tRandomState * 2685821657736338717ull;
+}
+
+// Floyd's algorithm: n distinct positions between 0 and total with n draws
+int* samplePositions(int n, int total) {
+    int* positions = (int*) mem_malloc(n * sizeof(int));
+
+    // Positions drawn (open addressing, at most half full)
+    int capacity = 1;
+    while (capacity < 2 * n) capacity <<= 1;
+    int* drawn = (int*) mem_malloc(capacity * sizeof(int));
+    for (int i = 0; i < capacity; ++i) drawn[i] = -1;
+
+    // When t was already drawn, j is new for sure (every previous one is lower)
+    for (int k = 0, j = total - n; j < total; ++j, ++k) {
+        int t = (int) (nextRandom() % (uint64_t) (j + 1));
+        if (!insertPosition(drawn, capacity, t)) insertPosition(drawn, capacity, t = j);
+        positions[k] = t;
+    }
+
+    free(drawn);
+    return positions;
+}
+
+int insertPosition(int* drawn, int capacity, int position) {
+    int i = (int) (((uint32_t) position * 2654435761u) & (capacity - 1));
+    while (drawn[i] != -1) {
+        if (drawn[i] == position) return 0;
+        i = (i + 1) & (capacity - 1);
+    }
+    drawn[i] = position;
+    return 1;
+}
+
+// Exclusive shard lock taken by a request (hold time is recorded)
+struct timespec lockShard(FSShard_t* shard) {
+    struct timespec lockedAt;
+    lock_rw_mutex_write(&shard->lock);
+    clock_gettime(CLOCK_MONOTONIC, &lockedAt);
+    return lockedAt;
+}
+
+void unlockShard(FSShard_t* shard, struct timespec lockedAt) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    unlock_rw_mutex(&shard->lock);
+
+    long long ns = (end.tv_sec - lockedAt.tv_sec) * 1000000000LL + (end.tv_nsec - lockedAt.tv_nsec);
+    atomic_fetch_add_explicit(&shard->holdCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->holdNs, ns, memory_order_relaxed);
+    long long max = atomic_load_explicit(&shard->holdMaxNs, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&shard->holdMaxNs, &max, ns, memory_order_relaxed, memory_order_relaxed)) { }
+}
+
+double elapsedMs(struct timespec start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
 }
 
 void summary() {
@@ -834,7 +2839,9 @@ void summary() {
     // Calc stats
     int slotU = gCache.slotUsed , slotM = gCache.slotMax , slotP = gMaxSlotUsed;
     size_t bytesU = gCache.bytesUsed, bytesM = gCache.bytesMax, bytesP = gMaxBytesUsed;
-    int capMisT = gCapacityMisses, capMisA = (gQueryCount == 0) ? 0 : (int)((float) gCapacityMisses / gQueryCount * 100.0f), capMisM = gCapacityMissesMax;
+    int queryCount = 0;
+    for (int i = 0; i < gNumShards; ++i) queryCount += atomic_load(&gShards[i].queryCount);
+    int capMisT = gCapacityMisses, capMisA = (queryCount == 0) ? 0 : (int)((float) gCapacityMisses / queryCount * 100.0f), capMisM = gCapacityMissesMax;
 
     // Separator
     LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
@@ -864,8 +2871,229 @@ void summary() {
     LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
     LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
 
-    // Cache size (Slot)
-    LOG_EMPTY("  %c%-*s%c %*d %c %*d %c %*d %c\n", CV, fCSize, "capacity misses", CV, sCSize-2, capMisT, CV, sCSize-2, capMisA, CV, sCSize-2, capMisM, CV);
+    // Capacity misses
+    char capMisName[64];
+    snprintf(capMisName, sizeof(capMisName), "capacity misses (%s)", evictionPolicyName(gConfigs.evictionPolicy));
+    LOG_EMPTY("  %c%-*s%c %*d %c %*d %c %*d %c\n", CV, fCSize, capMisName, CV, sCSize-2, capMisT, CV, sCSize-2, capMisA, CV, sCSize-2, capMisM, CV);
+
+    // Capacity misses for each policy's queue
+    long long queueMis[EVICTION_MAX_QUEUES] = { 0 };
+    int queues = 0;
+    for (int i = 0; i < gNumShards; ++i) queues = evictionStats(gShards[i].policy, queueMis);
+    for (int i = 0; i < queues && queues > 1; ++i) {
+        char queueName[64];
+        int queueMisA = (queryCount == 0) ? 0 : (int)((float) queueMis[i] / queryCount * 100.0f);
+        snprintf(queueName, sizeof(queueName), "  from %s", evictionQueueName(gConfigs.evictionPolicy, i));
+        LOG_EMPTY("  %c%-*s%c %*lld %c %*d %c %*s %c\n", CV, fCSize, queueName, CV, sCSize-2, queueMis[i], CV, sCSize-2, queueMisA, CV, sCSize-2, "", CV);
+    }
+
+    // Contents declined by the admission filter (counted in capacity misses too)
+    if (gConfigs.admission == FS_ADMISSION_TINYLFU) {
+        int declined  = atomic_load(&gDeclinedCount);
+        int declinedA = (queryCount == 0) ? 0 : (int)((float) declined / queryCount * 100.0f);
+        LOG_EMPTY("  %c%-*s%c %*d %c %*d %c %*s %c\n", CV, fCSize, "  declined (admission)", CV, sCSize-2, declined, CV, sCSize-2, declinedA, CV, sCSize-2, "", CV);
+    }
+
+    // Capacity misses (bytes)
+    size_t capMisBT = gCapacityMissesBytes, capMisBA = (queryCount == 0) ? 0 : gCapacityMissesBytes * 100 / queryCount, capMisBM = gCapacityMissesBytesMax;
+    LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*.2f %s %c\n", CV, fCSize, "capacity misses (bytes)", CV, sCSize-5, BYTES(capMisBT), CV, sCSize-5, BYTES(capMisBA), CV, sCSize-5, BYTES(capMisBM), CV);
+
+    // Files removed once their TTL elapsed
+    int expired  = atomic_load(&gExpiredCount);
+    int expiredA = (queryCount == 0) ? 0 : (int)((float) expired / queryCount * 100.0f);
+    LOG_EMPTY("  %c%-*s%c %*d %c %*d %c %*s %c\n", CV, fCSize, "expired (ttl)", CV, sCSize-2, expired, CV, sCSize-2, expiredA, CV, sCSize-2, "", CV);
+
+    // Lock waits (max: longest queue) and how they ended early
+    long waits = atomic_load(&gLockWaitCount), timedOut = atomic_load(&gLockTimeoutCount), cancelled = atomic_load(&gLockCancelCount);
+    int waitsA = (queryCount == 0) ? 0 : (int)((float) waits / queryCount * 100.0f);
+    LOG_EMPTY("  %c%-*s%c %*ld %c %*d %c %*d %c\n", CV, fCSize, "lock waits", CV, sCSize-2, waits, CV, sCSize-2, waitsA, CV, sCSize-2, atomic_load(&gLockWaitMax), CV);
+    LOG_EMPTY("  %c%-*s%c %*ld %c %*s %c %*s %c\n", CV, fCSize, "  timed out", CV, sCSize-2, timedOut, CV, sCSize-2, "", CV, sCSize-2, "", CV);
+    LOG_EMPTY("  %c%-*s%c %*ld %c %*s %c %*s %c\n", CV, fCSize, "  cancelled (session closed)", CV, sCSize-2, cancelled, CV, sCSize-2, "", CV, sCSize-2, "", CV);
+
+    // Shared locks granted (max: most readers at once)
+    long sharedLocks = atomic_load(&gSharedLockCount);
+    int sharedA = (queryCount == 0) ? 0 : (int)((float) sharedLocks / queryCount * 100.0f);
+    LOG_EMPTY("  %c%-*s%c %*ld %c %*d %c %*d %c\n", CV, fCSize, "shared locks", CV, sCSize-2, sharedLocks, CV, sCSize-2, sharedA, CV, sCSize-2, atomic_load(&gSharedLockMax), CV);
+
+    // Locks taken back once their lease elapsed
+    if (gConfigs.lockLeaseMs > 0) {
+        long leases = atomic_load(&gLeaseExpiredCount);
+        LOG_EMPTY("  %c%-*s%c %*ld %c %*s %c %*s %c\n", CV, fCSize, "lock leases expired", CV, sCSize-2, leases, CV, sCSize-2, "", CV, sCSize-2, "", CV);
+    }
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Header 3
+    LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Hits", CV, sCSize, "Misses", CV, sCSize, "Hit ratio (%)", CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Object hit ratio (reads)
+    int readT = atomic_load(&gReadCount), readH = atomic_load(&gReadHitCount);
+    float readR = (readT == 0) ? 0 : 100.0f * readH / readT;
+    LOG_EMPTY("  %c%-*s%c %*d %c %*d %c %*.2f %c\n", CV, fCSize, "reads (files)", CV, sCSize-2, readH, CV, sCSize-2, readT - readH, CV, sCSize-2, readR, CV);
+
+    // Byte hit ratio (misses: reads of files ejected lately, the only ones whose size is known)
+    size_t readHB = atomic_load(&gReadHitBytes), readMB = atomic_load(&gReadMissBytes);
+    float readBR = (readHB + readMB == 0) ? 0 : 100.0f * readHB / (readHB + readMB);
+    LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*.2f %c\n", CV, fCSize, "reads (bytes)", CV, sCSize-5, BYTES(readHB), CV, sCSize-5, BYTES(readMB), CV, sCSize-2, readBR, CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Compressed writes
+    if (gConfigs.compression == FS_COMPRESSION_HUFFMAN) {
+        // Header 4
+        LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Files (kept/tried)", CV, sCSize, "Raw", CV, sCSize, "Stored", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+        // Compression
+        int compT = atomic_load(&gCompressTried), compS = atomic_load(&gCompressStored);
+        size_t compRB = atomic_load(&gCompressRawBytes), compSB = atomic_load(&gCompressStoredBytes);
+        LOG_EMPTY("  %c%-*s%c %*d / %*d %c %*.2f %s %c %*.2f %s %c\n", CV, fCSize, "compressed (huffman)", CV, (sCSize-5)/2, compS, sCSize-5-(sCSize-5)/2, compT, CV, sCSize-5, BYTES(compRB), CV, sCSize-5, BYTES(compSB), CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+    }
+
+    // Disk tier
+    if (gSpillEnabled) {
+        // Header 5
+        LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Demoted", CV, sCSize, "Promoted", CV, sCSize, "Dropped", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+        // Files moved between memory and disk
+        SpillInfo_t spill = spillInfo(&gSpill);
+        LOG_EMPTY("  %c%-*s%c %*lld %c %*lld %c %*lld %c\n", CV, fCSize, "disk tier (files)", CV, sCSize-2, spill.demotedCount, CV, sCSize-2, spill.promotedCount, CV, sCSize-2, spill.droppedCount, CV);
+        LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*.2f %s %c\n", CV, fCSize, "disk tier (bytes)", CV, sCSize-5, BYTES(spill.bytesDemotedCount), CV, sCSize-5, BYTES(spill.bytesPromotedCount), CV, sCSize-5, BYTES(spill.bytesDroppedCount), CV);
+        LOG_EMPTY("  %c%-*s%c %*d %c %*.2f %s %c %*s %c\n", CV, fCSize, "disk tier (files / bytes left)", CV, sCSize-2, spill.filesCount, CV, sCSize-5, BYTES(spill.bytesUsed), CV, sCSize-2, "", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+    }
+
+    // Persistence
+    if (gPersistEnabled) {
+        // Header 6
+        LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Files", CV, sCSize, "Time (ms)", CV, sCSize, "Max pause (ms)", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+        // Startup (nothing is served meanwhile) & snapshots (shards are paused one at a time)
+        char snapName[64];
+        snprintf(snapName, sizeof(snapName), "last snapshot (%d taken)", gSnapshotsCount);
+        LOG_EMPTY("  %c%-*s%c %*zu %c %*.2f %c %*s %c\n", CV, fCSize, "restored at startup", CV, sCSize-2, gRestoredFiles, CV, sCSize-2, gRestoreMs, CV, sCSize-2, "", CV);
+        LOG_EMPTY("  %c%-*s%c %*zu %c %*.2f %c %*.2f %c\n", CV, fCSize, snapName, CV, sCSize-2, gSnapshotFiles, CV, sCSize-2, gSnapshotMs, CV, sCSize-2, gSnapshotMaxLockMs, CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+    }
+
+    // Contents arena
+    if (gArenaEnabled) {
+        // Header 7
+        LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Used", CV, sCSize, "Free", CV, sCSize, "Reattached", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+        // Extents (free ones are merged, so their count tells the fragmentation)
+        ArenaInfo_t arena = arenaInfo(&gArena);
+        LOG_EMPTY("  %c%-*s%c %*zu %c %*zu %c %*zu %c\n", CV, fCSize, "contents arena (extents)", CV, sCSize-2, arena.extentsUsed, CV, sCSize-2, arena.extentsFree, CV, sCSize-2, arena.extentsReserved, CV);
+        LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*.2f %s %c\n", CV, fCSize, "contents arena (bytes)", CV, sCSize-5, BYTES(arena.bytesUsed), CV, sCSize-5, BYTES(arena.bytesFree), CV, sCSize-5, BYTES(arena.bytesReserved), CV);
+        LOG_EMPTY("  %c%-*s%c %*lld %c %*s %c %*s %c\n", CV, fCSize, "allocated outside (arena full)", CV, sCSize-2, contentsOutsideArena(), CV, sCSize-2, "", CV, sCSize-2, "", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+    }
+
+    // Huge pages
+    if (gConfigs.hugePages != HUGE_PAGES_NONE) {
+        // Header 8
+        LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Explicit", CV, sCSize, "Transparent", CV, sCSize, "Plain (4KB)", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+        // Blocks mapped by kind of pages (transparent ones include the explicit ones missing)
+        HugePagesInfo_t huge = hugePagesInfo();
+        LOG_EMPTY("  %c%-*s%c %*lld %c %*lld %c %*lld %c\n", CV, fCSize, "huge pages (blocks)", CV, sCSize-2, huge.explicitCount, CV, sCSize-2, huge.transparentCount, CV, sCSize-2, huge.plainCount, CV);
+        LOG_EMPTY("  %c%-*s%c %*lld %c %*s %c %*s %c\n", CV, fCSize, "reused (blocks)", CV, sCSize-2, huge.reusedCount, CV, sCSize-2, "", CV, sCSize-2, "", CV);
+        LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*s %c\n", CV, fCSize, "mapped (now / peak)", CV, sCSize-5, BYTES(huge.bytesMapped), CV, sCSize-5, BYTES(huge.bytesMappedPeak), CV, sCSize-2, "", CV);
+
+        // Separator
+        LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+        LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+    }
+
+    // Header 9
+    LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Logical", CV, sCSize, "Unique", CV, sCSize, "Dedup ratio", CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Shared contents
+    DedupInfo_t dedup = dedupInfo(&gDedup);
+    int dedupF = dedup.filesCount, dedupC = dedup.contentsCount;
+    size_t dedupLB = dedup.bytesLogical, dedupUB = dedup.bytesUnique;
+    float dedupFR = (dedupC == 0) ? 1 : (float) dedupF / dedupC;
+    float dedupBR = (dedupUB == 0) ? 1 : (float) dedupLB / dedupUB;
+    LOG_EMPTY("  %c%-*s%c %*d %c %*d %c %*.2f %c\n", CV, fCSize, "shared contents (files)", CV, sCSize-2, dedupF, CV, sCSize-2, dedupC, CV, sCSize-2, dedupFR, CV);
+    LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*.2f %c\n", CV, fCSize, "shared contents (bytes)", CV, sCSize-5, BYTES(dedupLB), CV, sCSize-5, BYTES(dedupUB), CV, sCSize-2, dedupBR, CV);
+
+    // Whole cache (names and files not indexed included)
+    FSInfo_t info = fs_get_infos();
+    LOG_EMPTY("  %c%-*s%c %*.2f %s %c %*.2f %s %c %*.2f %c\n", CV, fCSize, "size (bytes)", CV, sCSize-5, BYTES(info.bytesLogicalCount), CV, sCSize-5, BYTES(info.bytesUsedCount), CV, sCSize-2, info.dedupRatio, CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Header 10
+    LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Allocations", CV, sCSize, "Reserved", CV, sCSize, "B / entry", CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Entries memory
+    FSAllocInfo_t alloc = fs_get_alloc_infos();
+    size_t allocB = alloc.bytesReserved, allocE = (alloc.entriesCount == 0) ? 0 : alloc.bytesReserved / alloc.entriesCount;
+    LOG_EMPTY("  %c%-*s%c %*zu %c %*.2f %s %c %*zu %c\n", CV, fCSize, "entries memory", CV, sCSize-2, alloc.allocCount, CV, sCSize-5, BYTES(allocB), CV, sCSize-2, allocE, CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Header 11
+    LOG_EMPTY("  %c%*s%c%*s%c%*s%c%*s%c\n", CV, fCSize, "", CV, sCSize, "Times", CV, sCSize, "Avg (us)", CV, sCSize, "Max (us)", CV);
+
+    // Separator
+    LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
+    LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c\n", CC);
+
+    // Exclusive shard locks (what other requests on the same shard wait for)
+    LOG_EMPTY("  %c%-*s%c %*lld %c %*.2f %c %*.2f %c\n", CV, fCSize, "shard lock held (exclusive)", CV, sCSize-2, info.lockHoldCount, CV, sCSize-2, info.lockHoldAvgUs, CV, sCSize-2, info.lockHoldMaxUs, CV);
 
     // Separator
     LOG_EMPTY("  %c", CC); TIMES(fCSize, LOG_EMPTY("%c", CH)); LOG_EMPTY("%c", CC); TIMES(sCSize, LOG_EMPTY("%c", CH)); 
@@ -873,16 +3101,17 @@ void summary() {
 
     // Files left
     if (gCache.slotUsed > 0) {
-        int depth = 0;
-        FSCacheEntry_t* item = gCache.head;
-        while (item != NULL && depth < DEPTH_LIMIT) {
-            // File data
-            int bytes = item->file.contentLen;
-            // Log
-            LOG_EMPTY("  %c%-*s%c %*.2f %s %c\n", CV, tTSize-sCSize-3, item->file.name, CV, sCSize-5, BYTES(bytes), CV);
-            // Next
-            item = item->pre;
-            depth++;
+        for (int i = 0; i < gNumShards; ++i) {
+            HashTableIter_t iter = { 0 };
+            HashTableNode_t* node = NULL;
+            while ((node = hashTableIterate(&gShards[i].hashmap, &iter)) != NULL) {
+                FSCacheEntry_t* item = (FSCacheEntry_t*) node;
+                if (item->state != ENTRY_RESIDENT) continue;
+                // File data
+                int bytes = item->file.contentLen;
+                // Log
+                LOG_EMPTY("  %c%-*s%c %*.2f %s %c\n", CV, tTSize-sCSize-3, item->file.name, CV, sCSize-5, BYTES(bytes), CV);
+            }
         }
     } else {
         LOG_EMPTY("  %c                                     No file left in the server                                   %c\n", CV, CV);
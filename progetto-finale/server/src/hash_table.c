@@ -0,0 +1,151 @@
+#include "hash_table.h"
+
+#include <stdlib.h>
+
+#include <logger.h>
+
+#include "huge_pages.h"
+
+#define MIN_CAPACITY 16
+
+// Old buckets moved at each insertion / removal while resizing.
+// Must be >= 1, so that migration ends before the table doubles again
+#define MIGRATE_STEP 4
+
+// =============================================================================================
+
+size_t bucketIndex(size_t, HashValue64);
+void migrateStep(HashTable_t*);
+int unlinkNode(HashTableNode_t**, HashTableNode_t*);
+
+// =============================================================================================
+
+void initHashTable(HashTable_t* table, size_t capacity, HashTableKeyEq_t keyEq) {
+    // Round up to a power of 2
+    size_t cap = MIN_CAPACITY;
+    while (cap < capacity) cap <<= 1;
+
+    table->buckets      = (HashTableNode_t**) hugeAlloc(cap * sizeof(HashTableNode_t*), 1);
+    table->capacity     = cap;
+    table->oldBuckets   = NULL;
+    table->oldCapacity  = 0;
+    table->migrateIndex = 0;
+    table->size         = 0;
+    table->keyEq        = keyEq;
+}
+
+void destroyHashTable(HashTable_t* table) {
+    hugeFree(table->buckets, table->capacity * sizeof(HashTableNode_t*));
+    hugeFree(table->oldBuckets, table->oldCapacity * sizeof(HashTableNode_t*));
+    table->buckets    = NULL;
+    table->oldBuckets = NULL;
+    table->size       = 0;
+}
+
+HashTableNode_t* hashTableFind(const HashTable_t* table, HashValue64 hash, const void* key, size_t keyLen) {
+    // Search in current buckets, then in the ones not migrated yet
+    for (int pass = 0; pass < 2; ++pass) {
+        HashTableNode_t** buckets = (pass == 0) ? table->buckets  : table->oldBuckets;
+        size_t capacity           = (pass == 0) ? table->capacity : table->oldCapacity;
+        if (buckets == NULL) break;
+
+        HashTableNode_t* node = buckets[bucketIndex(capacity, hash)];
+        while (node != NULL) {
+            if (node->hash == hash && (key == NULL || table->keyEq(node, key, keyLen)))
+                return node;
+            node = node->next;
+        }
+    }
+    return NULL;
+}
+
+void hashTableInsert(HashTable_t* table, HashTableNode_t* node) {
+    // Start resizing when load factor exceeds 1
+    if (table->oldBuckets == NULL && table->size >= table->capacity) {
+        table->oldBuckets   = table->buckets;
+        table->oldCapacity  = table->capacity;
+        table->migrateIndex = 0;
+        table->capacity     = table->capacity * 2;
+        table->buckets      = (HashTableNode_t**) hugeAlloc(table->capacity * sizeof(HashTableNode_t*), 1);
+        LOG_VERB("[#HT] Resizing table %p to %zu buckets", table, table->capacity);
+    }
+    migrateStep(table);
+
+    // Push in front of the bucket
+    HashTableNode_t** bucket = &table->buckets[bucketIndex(table->capacity, node->hash)];
+    node->next = *bucket;
+    *bucket    = node;
+    table->size++;
+}
+
+int hashTableRemove(HashTable_t* table, HashTableNode_t* node) {
+    // Node may still be inside an old bucket
+    int removed = unlinkNode(&table->buckets[bucketIndex(table->capacity, node->hash)], node);
+    if (!removed && table->oldBuckets != NULL)
+        removed = unlinkNode(&table->oldBuckets[bucketIndex(table->oldCapacity, node->hash)], node);
+    if (removed) table->size--;
+
+    migrateStep(table);
+    return removed;
+}
+
+HashTableNode_t* hashTableIterate(const HashTable_t* table, HashTableIter_t* iter) {
+    // Find next non empty bucket (current buckets first, then the old ones)
+    while (iter->next == NULL && iter->pass < 2) {
+        HashTableNode_t** buckets = (iter->pass == 0) ? table->buckets  : table->oldBuckets;
+        size_t capacity           = (iter->pass == 0) ? table->capacity : table->oldCapacity;
+        if (buckets == NULL || iter->bucket >= capacity) {
+            iter->pass++;
+            iter->bucket = 0;
+            continue;
+        }
+        iter->next = buckets[iter->bucket++];
+    }
+
+    // Save next before returning (node may be released)
+    HashTableNode_t* node = iter->next;
+    if (node != NULL) iter->next = node->next;
+    return node;
+}
+
+// =============================================================================================
+
+size_t bucketIndex(size_t capacity, HashValue64 hash) {
+    return (size_t) (hash & (capacity - 1));
+}
+
+void migrateStep(HashTable_t* table) {
+    if (table->oldBuckets == NULL) return;
+
+    // Move every node of the next old buckets
+    for (int i = 0; i < MIGRATE_STEP && table->migrateIndex < table->oldCapacity; ++i) {
+        HashTableNode_t* node = table->oldBuckets[table->migrateIndex];
+        while (node != NULL) {
+            HashTableNode_t* next    = node->next;
+            HashTableNode_t** bucket = &table->buckets[bucketIndex(table->capacity, node->hash)];
+            node->next = *bucket;
+            *bucket    = node;
+            node       = next;
+        }
+        table->oldBuckets[table->migrateIndex++] = NULL;
+    }
+
+    // Migration completed
+    if (table->migrateIndex == table->oldCapacity) {
+        hugeFree(table->oldBuckets, table->oldCapacity * sizeof(HashTableNode_t*));
+        table->oldBuckets  = NULL;
+        table->oldCapacity = 0;
+    }
+}
+
+int unlinkNode(HashTableNode_t** bucket, HashTableNode_t* node) {
+    while (*bucket != NULL) {
+        if (*bucket == node) {
+            *bucket    = node->next;
+            node->next = NULL;
+            return 1;
+        }
+        bucket = &(*bucket)->next;
+    }
+    return 0;
+}
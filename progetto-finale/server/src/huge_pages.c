@@ -0,0 +1,198 @@
+#include "huge_pages.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <common.h>
+#include <logger.h>
+
+// Pages backing big blocks (HUGE_PAGES_*)
+static int gMode = HUGE_PAGES_NONE;
+
+static atomic_int gExplicitMissing      = 0; // Warned once
+static atomic_llong gExplicitCount      = 0;
+static atomic_llong gTransparentCount   = 0;
+static atomic_llong gPlainCount         = 0;
+static atomic_llong gReusedCount        = 0;
+static atomic_size_t gBytesMapped       = 0;
+static atomic_size_t gBytesMappedPeak   = 0;
+
+// Mappings kept for reuse
+typedef struct {
+    void* block;
+    size_t len;
+} HugeMapping_t;
+
+static pthread_mutex_t gCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static HugeMapping_t gCached[HUGE_PAGES_CACHED];
+static int gCachedCount     = 0;
+static size_t gCachedBytes  = 0;
+
+// =============================================================================================
+
+int isHugeBlock(size_t);
+size_t mappingSize(size_t);
+void* mapAligned(size_t);
+void* takeCached(size_t);
+int keepCached(void*, size_t);
+void unmapBlock(void*, size_t);
+
+// =============================================================================================
+
+void useHugePages(int mode) {
+    // Kept mappings remember their length (valid whatever the mode)
+    lock_mutex(&gCacheMutex);
+    for (int i = 0; i < gCachedCount; ++i) unmapBlock(gCached[i].block, gCached[i].len);
+    gCachedCount = 0;
+    gCachedBytes = 0;
+    unlock_mutex(&gCacheMutex);
+
+    gMode = mode;
+    atomic_store(&gExplicitMissing, 0);
+    atomic_store(&gExplicitCount, 0);
+    atomic_store(&gTransparentCount, 0);
+    atomic_store(&gPlainCount, 0);
+    atomic_store(&gReusedCount, 0);
+    atomic_store(&gBytesMapped, 0);
+    atomic_store(&gBytesMappedPeak, 0);
+}
+
+void* hugeAlloc(size_t size, int zeroed) {
+    if (!isHugeBlock(size)) return zeroed ? mem_calloc(1, size) : mem_malloc(size);
+
+    // Same size released before: its pages are already there
+    size_t len  = mappingSize(size);
+    void* block = takeCached(len);
+    if (block) {
+        atomic_fetch_add_explicit(&gReusedCount, 1, memory_order_relaxed);
+        if (zeroed) memset(block, 0, size);
+        return block;
+    }
+
+    // Anonymous mappings are already zeroed
+    block = MAP_FAILED;
+    if (gMode == HUGE_PAGES_EXPLICIT) {
+        block = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED) {
+            atomic_fetch_add_explicit(&gExplicitCount, 1, memory_order_relaxed);
+        } else if (atomic_exchange(&gExplicitMissing, 1) == 0) {
+            LOG_WARN("[#HP] No huge pages left (see vm.nr_hugepages), using transparent ones");
+        }
+    }
+    if (block == MAP_FAILED) {
+        // Kernels without transparent huge pages reject the advice: 4KB pages
+        block = mapAligned(len);
+        if (madvise(block, len, MADV_HUGEPAGE) == 0)
+            atomic_fetch_add_explicit(&gTransparentCount, 1, memory_order_relaxed);
+        else
+            atomic_fetch_add_explicit(&gPlainCount, 1, memory_order_relaxed);
+    }
+
+    // Update counters
+    size_t bytes = atomic_fetch_add_explicit(&gBytesMapped, len, memory_order_relaxed) + len;
+    size_t peak  = atomic_load_explicit(&gBytesMappedPeak, memory_order_relaxed);
+    while (bytes > peak && !atomic_compare_exchange_weak(&gBytesMappedPeak, &peak, bytes)) { }
+    return block;
+}
+
+void hugeFree(void* block, size_t size) {
+    if (block == NULL) return;
+    if (!isHugeBlock(size)) {
+        free(block);
+        return;
+    }
+
+    size_t len = mappingSize(size);
+    if (!keepCached(block, len)) unmapBlock(block, len);
+}
+
+HugePagesInfo_t hugePagesInfo() {
+    HugePagesInfo_t result = {
+        .explicitCount    = atomic_load(&gExplicitCount),
+        .transparentCount = atomic_load(&gTransparentCount),
+        .plainCount       = atomic_load(&gPlainCount),
+        .reusedCount      = atomic_load(&gReusedCount),
+        .bytesMapped      = atomic_load(&gBytesMapped),
+        .bytesMappedPeak  = atomic_load(&gBytesMappedPeak)
+    };
+    return result;
+}
+
+const char* hugePagesName(int mode) {
+    switch (mode)
+    {
+        case HUGE_PAGES_TRANSPARENT: return "TRANSPARENT";
+        case HUGE_PAGES_EXPLICIT:    return "EXPLICIT";
+        default:                     return "NONE";
+    }
+}
+
+// =============================================================================================
+
+int isHugeBlock(size_t size) {
+    return gMode != HUGE_PAGES_NONE && size >= HUGE_PAGES_MIN_BLOCK;
+}
+
+size_t mappingSize(size_t size) {
+    // Reserved huge pages are mapped whole (the fallback mapping has the same size,
+    // so the length to unmap depends on the mode only)
+    size_t unit = (gMode == HUGE_PAGES_EXPLICIT) ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+    return (size + unit - 1) / unit * unit;
+}
+
+void* mapAligned(size_t len) {
+    // Map a huge page more, then trim it to start on a huge page boundary
+    char* raw = (char*) mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        // On error, function fails (some bigger problem occurred)
+        LOG_CRIT("Mmap failed trying to allocate %zu bytes", len);
+        exit(EXIT_FAILURE);
+    }
+
+    char* block = (char*) (((uintptr_t) raw + HUGE_PAGE_SIZE - 1) & ~((uintptr_t) HUGE_PAGE_SIZE - 1));
+    size_t head = block - raw;
+    size_t tail = HUGE_PAGE_SIZE - head;
+    if (head > 0) munmap(raw, head);
+    if (tail > 0) munmap(block + len, tail);
+    return block;
+}
+
+void* takeCached(size_t len) {
+    void* block = NULL;
+    lock_mutex(&gCacheMutex);
+    for (int i = 0; i < gCachedCount; ++i) {
+        if (gCached[i].len == len) {
+            block         = gCached[i].block;
+            gCachedBytes -= len;
+            gCached[i]    = gCached[--gCachedCount];
+            break;
+        }
+    }
+    unlock_mutex(&gCacheMutex);
+    return block;
+}
+
+int keepCached(void* block, size_t len) {
+    int kept = 0;
+    lock_mutex(&gCacheMutex);
+    if (gCachedCount < HUGE_PAGES_CACHED && gCachedBytes + len <= HUGE_PAGES_CACHED_BYTES) {
+        gCached[gCachedCount++] = (HugeMapping_t) { .block = block, .len = len };
+        gCachedBytes += len;
+        kept = 1;
+    }
+    unlock_mutex(&gCacheMutex);
+    return kept;
+}
+
+void unmapBlock(void* block, size_t len) {
+    if (munmap(block, len) == -1) {
+        LOG_ERRNO("[#HP] Error unmapping block %p (%zu bytes)", block, len);
+        return;
+    }
+    atomic_fetch_sub_explicit(&gBytesMapped, len, memory_order_relaxed);
+}
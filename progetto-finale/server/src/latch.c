@@ -0,0 +1,82 @@
+#include "latch.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <common.h>
+
+// Latches waiting share these (chosen by address)
+#define LATCH_STRIPES 64
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_int waiters;
+} LatchStripe_t;
+
+static LatchStripe_t gStripes[LATCH_STRIPES];
+static pthread_once_t gStripesOnce = PTHREAD_ONCE_INIT;
+
+// =============================================================================================
+
+void initStripes();
+LatchStripe_t* getLatchStripe(Latch_t*);
+
+// =============================================================================================
+
+void initLatch(Latch_t* latch) {
+    atomic_init(&latch->next, 0);
+    atomic_init(&latch->serving, 0);
+}
+
+unsigned latchTicket(Latch_t* latch) {
+    return atomic_fetch_add(&latch->next, 1);
+}
+
+void latchWait(Latch_t* latch, unsigned ticket) {
+    // Fast path: nobody ahead
+    if (atomic_load(&latch->serving) == ticket) return;
+
+    pthread_once(&gStripesOnce, initStripes);
+    LatchStripe_t* stripe = getLatchStripe(latch);
+
+    // Registered before checking again: latchRelease either sees it or is seen
+    atomic_fetch_add(&stripe->waiters, 1);
+    lock_mutex(&stripe->mutex);
+    while (atomic_load(&latch->serving) != ticket) pthread_cond_wait(&stripe->cond, &stripe->mutex);
+    unlock_mutex(&stripe->mutex);
+    atomic_fetch_sub(&stripe->waiters, 1);
+}
+
+void latchAcquire(Latch_t* latch) {
+    latchWait(latch, latchTicket(latch));
+}
+
+void latchRelease(Latch_t* latch) {
+    atomic_fetch_add(&latch->serving, 1);
+
+    // Wake up who waits on the same stripe (the next ticket is among them)
+    pthread_once(&gStripesOnce, initStripes);
+    LatchStripe_t* stripe = getLatchStripe(latch);
+    if (atomic_load(&stripe->waiters) == 0) return;
+
+    lock_mutex(&stripe->mutex);
+    notify_all(&stripe->cond);
+    unlock_mutex(&stripe->mutex);
+}
+
+// =============================================================================================
+
+void initStripes() {
+    for (int i = 0; i < LATCH_STRIPES; ++i) {
+        pthread_mutex_init(&gStripes[i].mutex, NULL);
+        pthread_cond_init(&gStripes[i].cond, NULL);
+        atomic_init(&gStripes[i].waiters, 0);
+    }
+}
+
+LatchStripe_t* getLatchStripe(Latch_t* latch) {
+    // Latches are inside bigger structures: skip the low bits
+    uintptr_t address = (uintptr_t) latch;
+    return &gStripes[((address >> 6) ^ (address >> 12)) % LATCH_STRIPES];
+}
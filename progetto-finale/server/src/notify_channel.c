@@ -0,0 +1,190 @@
+#include "notify_channel.h"
+
+#include <stdlib.h>
+
+#include <logger.h>
+
+// =============================================================================================
+
+int tryPublish(NotifyChannel_t*, Notification_t);
+int hasNotifications(NotifyChannel_t*);
+int takeNotifications(NotifyChannel_t*, Notification_t*, int);
+void wakeConsumer(NotifyChannel_t*);
+void wakeProducers(NotifyChannel_t*);
+
+// =============================================================================================
+
+void initNotifyChannel(NotifyChannel_t* channel, size_t capacity) {
+    // Slots: power of 2 >= capacity
+    size_t slots = 2;
+    while (slots < capacity) slots <<= 1;
+
+    channel->slots = (NotifySlot_t*) mem_malloc(slots * sizeof(NotifySlot_t));
+    channel->mask  = slots - 1;
+    for (size_t i = 0; i < slots; ++i) atomic_init(&channel->slots[i].seq, i);
+    atomic_init(&channel->head, 0);
+    channel->tail = 0;
+    atomic_init(&channel->sleeping, 0);
+    atomic_init(&channel->producersWaiting, 0);
+    atomic_init(&channel->closed, 0);
+    atomic_init(&channel->publishedCount, 0);
+    atomic_init(&channel->wakeupsCount, 0);
+    atomic_init(&channel->fullCount, 0);
+
+    int res = 0;
+    if ((res = pthread_mutex_init(&channel->mutex, NULL)) != 0 || (res = pthread_cond_init(&channel->cond, NULL)) != 0 ||
+        (res = pthread_cond_init(&channel->notFull, NULL)) != 0) {
+        errno = res;
+        LOG_ERRNO("Server process crashed initializing notification channel");
+        LOG_CRIT("Terminating server...");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void destroyNotifyChannel(NotifyChannel_t* channel) {
+    pthread_mutex_destroy(&channel->mutex);
+    pthread_cond_destroy(&channel->cond);
+    pthread_cond_destroy(&channel->notFull);
+    free(channel->slots);
+    channel->slots = NULL;
+}
+
+void notifyPublish(NotifyChannel_t* channel, const Notification_t* items, int count) {
+    if (count <= 0) return;
+
+    int published = 0;
+    for (int i = 0; i < count; ++i) {
+        if (tryPublish(channel, items[i])) {
+            published++;
+            continue;
+        }
+
+        // Full: let the consumer drain what is already there
+        atomic_fetch_add_explicit(&channel->fullCount, 1, memory_order_relaxed);
+        wakeConsumer(channel);
+
+        // Sleep until it gives some slots back
+        lock_mutex(&channel->mutex);
+        atomic_fetch_add(&channel->producersWaiting, 1);
+        // Pairs with the fence in wakeProducers: either the consumer sees us waiting or we see the slot freed
+        atomic_thread_fence(memory_order_seq_cst);
+        int done = 0;
+        while (!(done = tryPublish(channel, items[i])) && !atomic_load(&channel->closed)) {
+            int res = 0;
+            if ((res = pthread_cond_wait(&channel->notFull, &channel->mutex)) != 0) {
+                errno = res;
+                LOG_ERRNO("Error waiting on notification channel");
+            }
+        }
+        atomic_fetch_sub(&channel->producersWaiting, 1);
+        unlock_mutex(&channel->mutex);
+
+        // Closed: nobody reads them anymore
+        if (!done) break;
+        published++;
+    }
+    atomic_fetch_add_explicit(&channel->publishedCount, published, memory_order_relaxed);
+
+    // One wakeup for the whole batch
+    wakeConsumer(channel);
+}
+
+int notifyWait(NotifyChannel_t* channel, Notification_t* items, int max) {
+    // Fast path: something is already there
+    int count = takeNotifications(channel, items, max);
+    if (count > 0) return count;
+
+    lock_mutex(&channel->mutex);
+    atomic_store(&channel->sleeping, 1);
+    // Pairs with the fence in wakeConsumer: either the producer sees 'sleeping' or we see its slot
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!hasNotifications(channel) && !atomic_load(&channel->closed)) {
+        int res = 0;
+        if ((res = pthread_cond_wait(&channel->cond, &channel->mutex)) != 0) {
+            errno = res;
+            LOG_ERRNO("Error waiting on notification channel");
+        }
+    }
+    atomic_store(&channel->sleeping, 0);
+    unlock_mutex(&channel->mutex);
+
+    return takeNotifications(channel, items, max);
+}
+
+void notifyClose(NotifyChannel_t* channel) {
+    lock_mutex(&channel->mutex);
+    atomic_store(&channel->closed, 1);
+    notify_all(&channel->cond);
+    notify_all(&channel->notFull);
+    unlock_mutex(&channel->mutex);
+}
+
+NotifyInfo_t notifyInfo(NotifyChannel_t* channel) {
+    return (NotifyInfo_t) {
+        .capacity       = channel->mask + 1,
+        .publishedCount = atomic_load(&channel->publishedCount),
+        .wakeupsCount   = atomic_load(&channel->wakeupsCount),
+        .fullCount      = atomic_load(&channel->fullCount)
+    };
+}
+
+int tryPublish(NotifyChannel_t* channel, Notification_t item) {
+    size_t pos = atomic_load_explicit(&channel->head, memory_order_relaxed);
+    while (1) {
+        NotifySlot_t* slot = &channel->slots[pos & channel->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == pos) {
+            // Free: claim it (on failure 'pos' is reloaded)
+            if (atomic_compare_exchange_weak_explicit(&channel->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                slot->value = item;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (seq < pos) {
+            // Still not read by the consumer (a whole lap behind)
+            return 0;
+        } else {
+            // Claimed by another producer meanwhile
+            pos = atomic_load_explicit(&channel->head, memory_order_relaxed);
+        }
+    }
+}
+
+int hasNotifications(NotifyChannel_t* channel) {
+    NotifySlot_t* slot = &channel->slots[channel->tail & channel->mask];
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) == channel->tail + 1;
+}
+
+int takeNotifications(NotifyChannel_t* channel, Notification_t* items, int max) {
+    int count = 0;
+    while (count < max && hasNotifications(channel)) {
+        NotifySlot_t* slot = &channel->slots[channel->tail & channel->mask];
+        items[count++] = slot->value;
+        // Give the slot back to producers for the next lap
+        atomic_store_explicit(&slot->seq, channel->tail + channel->mask + 1, memory_order_release);
+        channel->tail++;
+    }
+    if (count > 0) wakeProducers(channel);
+    return count;
+}
+
+void wakeConsumer(NotifyChannel_t* channel) {
+    // Pairs with the fence in notifyWait
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&channel->sleeping, memory_order_relaxed)) return;
+
+    atomic_fetch_add_explicit(&channel->wakeupsCount, 1, memory_order_relaxed);
+    lock_mutex(&channel->mutex);
+    notify_one(&channel->cond);
+    unlock_mutex(&channel->mutex);
+}
+
+void wakeProducers(NotifyChannel_t* channel) {
+    // Pairs with the fence in notifyPublish
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&channel->producersWaiting, memory_order_relaxed)) return;
+
+    lock_mutex(&channel->mutex);
+    notify_all(&channel->notFull);
+    unlock_mutex(&channel->mutex);
+}
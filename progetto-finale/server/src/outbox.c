@@ -0,0 +1,154 @@
+#include "outbox.h"
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <logger.h>
+#include <common.h>
+
+// ===============================================================================================================
+
+static Outbox_t gOutboxTable[MAX_CLIENT_COUNT];
+static size_t gMaxBytes = 0;
+
+static atomic_long gDeferredCount  = 0;
+static atomic_long gInlineCount    = 0;
+static atomic_long gDeliveredCount = 0;
+static atomic_long gDroppedCount   = 0;
+static atomic_size_t gBytesMaxQueued = 0;
+
+// ===============================================================================================================
+
+size_t outboxFileSize(const FSFile_t*);
+void outboxRelease(Outbox_t*);
+
+// ===============================================================================================================
+
+void initOutboxSystem(size_t maxBytes) {
+    gMaxBytes = maxBytes;
+    for (int i = 0; i < MAX_CLIENT_COUNT; ++i) {
+        Outbox_t* outbox = &gOutboxTable[i];
+        if (pthread_mutex_init(&outbox->mutex, NULL) < 0) {
+            LOG_ERRNO("Error creating mutex");
+        }
+        outbox->files    = NULL;
+        outbox->head     = 0;
+        outbox->count    = 0;
+        outbox->capacity = 0;
+        outbox->bytes    = 0;
+    }
+    atomic_store(&gDeferredCount, 0);
+    atomic_store(&gInlineCount, 0);
+    atomic_store(&gDeliveredCount, 0);
+    atomic_store(&gDroppedCount, 0);
+    atomic_store(&gBytesMaxQueued, 0);
+}
+
+void terminateOutboxSystem() {
+    for (int i = 0; i < MAX_CLIENT_COUNT; ++i) {
+        Outbox_t* outbox = &gOutboxTable[i];
+        outboxRelease(outbox);
+        if (pthread_mutex_destroy(&outbox->mutex) < 0) {
+            LOG_ERRNO("Error destroying mutex");
+        }
+    }
+}
+
+int outboxPush(int client, FSFile_t* files, int count) {
+    Outbox_t* outbox = &gOutboxTable[client];
+    int pushed = 0;
+
+    lock_mutex(&outbox->mutex);
+    while (pushed < count && outbox->bytes + outboxFileSize(&files[pushed]) <= gMaxBytes) {
+        // Grow the ring (queued files are moved to the beginning)
+        if (outbox->count == outbox->capacity) {
+            int capacity    = MAX(16, outbox->capacity * 2);
+            FSFile_t* ring  = (FSFile_t*) mem_malloc(capacity * sizeof(FSFile_t));
+            for (int i = 0; i < outbox->count; ++i)
+                ring[i] = outbox->files[(outbox->head + i) % outbox->capacity];
+            free(outbox->files);
+            outbox->files    = ring;
+            outbox->head     = 0;
+            outbox->capacity = capacity;
+        }
+
+        outbox->bytes += outboxFileSize(&files[pushed]);
+        outbox->files[(outbox->head + outbox->count) % outbox->capacity] = files[pushed];
+        outbox->count++;
+        pushed++;
+    }
+    size_t bytes = outbox->bytes;
+    unlock_mutex(&outbox->mutex);
+
+    // Files left go first
+    for (int i = pushed; i < count; ++i) files[i - pushed] = files[i];
+
+    // Update counters
+    size_t bytesMax = atomic_load_explicit(&gBytesMaxQueued, memory_order_relaxed);
+    while (bytes > bytesMax && !atomic_compare_exchange_weak(&gBytesMaxQueued, &bytesMax, bytes)) { }
+    atomic_fetch_add_explicit(&gDeferredCount, pushed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&gInlineCount, count - pushed, memory_order_relaxed);
+    return pushed;
+}
+
+void outboxPop(int client, int max, FSFile_t** files, int* count) {
+    Outbox_t* outbox = &gOutboxTable[client];
+    *files = NULL;
+    *count = 0;
+
+    lock_mutex(&outbox->mutex);
+    int n = (max <= 0) ? outbox->count : MIN(max, outbox->count);
+    if (n > 0) {
+        *files = (FSFile_t*) mem_malloc(n * sizeof(FSFile_t));
+        for (int i = 0; i < n; ++i) {
+            (*files)[i]    = outbox->files[outbox->head];
+            outbox->bytes -= outboxFileSize(&(*files)[i]);
+            outbox->head   = (outbox->head + 1) % outbox->capacity;
+        }
+        outbox->count -= n;
+        *count = n;
+    }
+    unlock_mutex(&outbox->mutex);
+
+    atomic_fetch_add_explicit(&gDeliveredCount, n, memory_order_relaxed);
+}
+
+void outboxClear(int client) {
+    Outbox_t* outbox = &gOutboxTable[client];
+    lock_mutex(&outbox->mutex);
+    atomic_fetch_add_explicit(&gDroppedCount, outbox->count, memory_order_relaxed);
+    outboxRelease(outbox);
+    unlock_mutex(&outbox->mutex);
+}
+
+OutboxInfo_t outboxInfo() {
+    OutboxInfo_t result = {
+        .deferredCount  = atomic_load(&gDeferredCount),
+        .inlineCount    = atomic_load(&gInlineCount),
+        .deliveredCount = atomic_load(&gDeliveredCount),
+        .droppedCount   = atomic_load(&gDroppedCount),
+        .bytesMaxQueued = atomic_load(&gBytesMaxQueued)
+    };
+    return result;
+}
+
+// ===============================================================================================================
+
+size_t outboxFileSize(const FSFile_t* file) {
+    return file->nameLen + file->contentLen;
+}
+
+// Must be called holding outbox's mutex (or once no worker uses it)
+void outboxRelease(Outbox_t* outbox) {
+    for (int i = 0; i < outbox->count; ++i) {
+        FSFile_t* file = &outbox->files[(outbox->head + i) % outbox->capacity];
+        releaseContent(file->content);
+        free((char*) file->name);
+    }
+    free(outbox->files);
+    outbox->files    = NULL;
+    outbox->head     = 0;
+    outbox->count    = 0;
+    outbox->capacity = 0;
+    outbox->bytes    = 0;
+}
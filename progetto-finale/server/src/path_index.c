@@ -0,0 +1,245 @@
+#include "path_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <logger.h>
+
+// Listing state (key of the node being visited included)
+typedef struct {
+    char* key;
+    size_t keyLen, keyCap;
+    const char* after;
+    size_t afterLen;
+    void** items;
+    int max, count;
+} PathIndexCursor_t;
+
+// =============================================================================================
+
+PathIndexNode_t* pathNodeCreate(const char*, size_t, void*);
+void pathNodeFree(PathIndexNode_t*);
+int pathNodeFind(const PathIndexNode_t*, unsigned char, int*);
+void pathNodeLink(PathIndexNode_t*, PathIndexNode_t*, int);
+void pathNodeMerge(PathIndex_t*, PathIndexNode_t*);
+void pathNodeCollect(const PathIndexNode_t*, PathIndexCursor_t*, int);
+void pathCursorPush(PathIndexCursor_t*, const char*, size_t);
+size_t commonPrefixLen(const char*, const char*, size_t);
+
+// =============================================================================================
+
+void initPathIndex(PathIndex_t* index) {
+    memset(&index->root, 0, sizeof(PathIndexNode_t));
+    index->size       = 0;
+    index->nodesCount = 0;
+}
+
+void destroyPathIndex(PathIndex_t* index) {
+    for (int i = 0; i < index->root.childCount; ++i)
+        pathNodeFree(index->root.children[i]);
+    free(index->root.children);
+    initPathIndex(index);
+}
+
+void pathIndexInsert(PathIndex_t* index, const char* key, size_t keyLen, void* value) {
+    PathIndexNode_t* node = &index->root;
+    size_t pos = 0;
+    while (pos < keyLen) {
+        int at = 0;
+        if (!pathNodeFind(node, (unsigned char) key[pos], &at)) {
+            // No edge starts with the next byte: the rest of the key is a new leaf
+            pathNodeLink(node, pathNodeCreate(key + pos, keyLen - pos, value), at);
+            index->nodesCount++;
+            index->size++;
+            return;
+        }
+
+        PathIndexNode_t* child = node->children[at];
+        size_t common = commonPrefixLen(child->label, key + pos, MIN(child->labelLen, keyLen - pos));
+        if (common < child->labelLen) {
+            // Split the edge where the key leaves it
+            PathIndexNode_t* middle = pathNodeCreate(child->label, common, NULL);
+            memmove(child->label, child->label + common, child->labelLen - common);
+            child->labelLen -= common;
+            node->children[at] = middle;
+            pathNodeLink(middle, child, 0);
+            index->nodesCount++;
+            child = middle;
+        }
+        node = child;
+        pos += common;
+    }
+
+    // Key ends on an existing node
+    node->value = value;
+    index->size++;
+}
+
+void* pathIndexRemove(PathIndex_t* index, const char* key, size_t keyLen) {
+    PathIndexNode_t* parent = NULL;
+    PathIndexNode_t* node   = &index->root;
+    int at = 0;
+    size_t pos = 0;
+    while (pos < keyLen) {
+        if (!pathNodeFind(node, (unsigned char) key[pos], &at)) return NULL;
+        PathIndexNode_t* child = node->children[at];
+        if (child->labelLen > keyLen - pos || memcmp(child->label, key + pos, child->labelLen) != 0) return NULL;
+        parent = node;
+        node   = child;
+        pos   += child->labelLen;
+    }
+
+    void* value = node->value;
+    if (value == NULL) return NULL;
+    node->value = NULL;
+    index->size--;
+    if (parent == NULL) return value;
+
+    if (node->childCount == 0) {
+        // Drop the leaf, its parent may be left with a single edge
+        memmove(&parent->children[at], &parent->children[at + 1], (parent->childCount - at - 1) * sizeof(PathIndexNode_t*));
+        parent->childCount--;
+        pathNodeFree(node);
+        index->nodesCount--;
+        if (parent != &index->root && parent->value == NULL && parent->childCount == 1)
+            pathNodeMerge(index, parent);
+    } else if (node->childCount == 1) {
+        pathNodeMerge(index, node);
+    }
+    return value;
+}
+
+int pathIndexList(const PathIndex_t* index, const char* prefix, size_t prefixLen, const char* after, size_t afterLen, void** items, int max) {
+    if (max <= 0) return 0;
+
+    PathIndexCursor_t cursor = {
+        .key = NULL, .keyLen = 0, .keyCap = 0,
+        .after = after, .afterLen = afterLen,
+        .items = items, .max = max, .count = 0
+    };
+
+    // Walk the prefix: the node reached (or the one whose edge goes past it) holds every key
+    const PathIndexNode_t* node = &index->root;
+    while (cursor.keyLen < prefixLen) {
+        int at = 0;
+        if (!pathNodeFind(node, (unsigned char) prefix[cursor.keyLen], &at)) break;
+        const PathIndexNode_t* child = node->children[at];
+        size_t left = MIN(child->labelLen, prefixLen - cursor.keyLen);
+        if (commonPrefixLen(child->label, prefix + cursor.keyLen, left) < left) break;
+        pathCursorPush(&cursor, child->label, child->labelLen);
+        node = child;
+    }
+    if (cursor.keyLen >= prefixLen)
+        pathNodeCollect(node, &cursor, after != NULL);
+
+    free(cursor.key);
+    return cursor.count;
+}
+
+// =============================================================================================
+
+PathIndexNode_t* pathNodeCreate(const char* label, size_t labelLen, void* value) {
+    PathIndexNode_t* node = (PathIndexNode_t*) mem_malloc(sizeof(PathIndexNode_t));
+    node->label      = (char*) mem_malloc((MAX(1, labelLen)) * sizeof(char));
+    node->labelLen   = labelLen;
+    node->value      = value;
+    node->children   = NULL;
+    node->childCount = 0;
+    node->childCap   = 0;
+    memcpy(node->label, label, labelLen);
+    return node;
+}
+
+void pathNodeFree(PathIndexNode_t* node) {
+    for (int i = 0; i < node->childCount; ++i)
+        pathNodeFree(node->children[i]);
+    free(node->children);
+    free(node->label);
+    free(node);
+}
+
+int pathNodeFind(const PathIndexNode_t* node, unsigned char byte, int* at) {
+    // Binary search on the first byte of the edges
+    int lo = 0, hi = node->childCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        unsigned char first = (unsigned char) node->children[mid]->label[0];
+        if (first == byte) {
+            *at = mid;
+            return 1;
+        }
+        if (first < byte) lo = mid + 1;
+        else              hi = mid;
+    }
+    *at = lo;
+    return 0;
+}
+
+void pathNodeLink(PathIndexNode_t* node, PathIndexNode_t* child, int at) {
+    if (node->childCount == node->childCap) {
+        node->childCap = MAX(2, node->childCap * 2);
+        node->children = (PathIndexNode_t**) mem_realloc(node->children, node->childCap * sizeof(PathIndexNode_t*));
+    }
+    memmove(&node->children[at + 1], &node->children[at], (node->childCount - at) * sizeof(PathIndexNode_t*));
+    node->children[at] = child;
+    node->childCount++;
+}
+
+// Node without an item and a single edge: takes its child's place
+void pathNodeMerge(PathIndex_t* index, PathIndexNode_t* node) {
+    PathIndexNode_t* child = node->children[0];
+    node->label = (char*) mem_realloc(node->label, node->labelLen + child->labelLen);
+    memcpy(node->label + node->labelLen, child->label, child->labelLen);
+    node->labelLen += child->labelLen;
+    node->value     = child->value;
+
+    free(node->children);
+    node->children   = child->children;
+    node->childCount = child->childCount;
+    node->childCap   = child->childCap;
+
+    free(child->label);
+    free(child);
+    index->nodesCount--;
+}
+
+// 'bounded': keys of the subtree may still be lower than (or equal to) the cursor
+void pathNodeCollect(const PathIndexNode_t* node, PathIndexCursor_t* cursor, int bounded) {
+    int skipValue = 0;
+    if (bounded) {
+        size_t len = MIN(cursor->keyLen, cursor->afterLen);
+        int cmp    = (len == 0) ? 0 : memcmp(cursor->key, cursor->after, len);
+        if (cmp < 0) return;                                  // Every key is lower
+        if (cmp > 0 || cursor->keyLen > cursor->afterLen) {   // Every key is greater
+            bounded = 0;
+        } else {                                              // Node's key is a prefix of the cursor
+            skipValue = 1;
+        }
+    }
+
+    if (node->value != NULL && !skipValue)
+        cursor->items[cursor->count++] = node->value;
+
+    for (int i = 0; i < node->childCount && cursor->count < cursor->max; ++i) {
+        const PathIndexNode_t* child = node->children[i];
+        size_t keyLen = cursor->keyLen;
+        pathCursorPush(cursor, child->label, child->labelLen);
+        pathNodeCollect(child, cursor, bounded);
+        cursor->keyLen = keyLen;
+    }
+}
+
+void pathCursorPush(PathIndexCursor_t* cursor, const char* bytes, size_t len) {
+    if (cursor->keyLen + len > cursor->keyCap) {
+        cursor->keyCap = MAX(256, 2 * (cursor->keyLen + len));
+        cursor->key    = (char*) mem_realloc(cursor->key, cursor->keyCap);
+    }
+    memcpy(cursor->key + cursor->keyLen, bytes, len);
+    cursor->keyLen += len;
+}
+
+size_t commonPrefixLen(const char* a, const char* b, size_t len) {
+    size_t i = 0;
+    while (i < len && a[i] == b[i]) ++i;
+    return i;
+}
@@ -0,0 +1,410 @@
+#include "persist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <common.h>
+#include <logger.h>
+
+#define MAX_PERSIST_PATH_LEN 512
+
+#define WAL_MAGIC      "FSWAL02"
+#define SNAPSHOT_MAGIC "FSSNAP2"
+
+// Snapshot only: content left inside the arena (data is a PersistArenaRef_t)
+#define PERSIST_OP_ATTACH 5
+
+// At the beginning of each file
+typedef struct {
+    char magic[8];
+    uint32_t numShards;
+    uint32_t shard;
+    uint64_t gen;
+} PersistFileHeader_t;
+
+// Record layout: header + name + data (snapshots hold INSERT / ATTACH records).
+// INSERT data starts with the TTL deadline, WRITE_RANGE data with the offset
+typedef struct {
+    uint32_t op;
+    uint32_t nameLen;
+    uint64_t dataLen;
+} PersistRecordHeader_t;
+
+typedef struct {
+    ArenaRef_t ref;
+    uint64_t contentLen;
+    int64_t expiresAt;
+} PersistArenaRef_t;
+
+// =============================================================================================
+
+void walPath(char*, const char*, int, unsigned long);
+void snapshotPath(char*, const char*, int, const char*);
+int writeFully(int, struct iovec*, int);
+int appendPrefixed(PersistLog_t*, int, const char*, size_t, uint64_t, const char*, size_t);
+int readHeader(FILE*, const char*, int, PersistReplay_t*, unsigned long*);
+size_t replayRecords(FILE*, PersistReplayFun_t, void*, int);
+int replayAttach(FILE*, PersistReplayFun_t, void*, FSFile_t, int*);
+void removeLogsBefore(const char*, int, unsigned long);
+
+// =============================================================================================
+
+void initPersistLog(PersistLog_t* log) {
+    log->fd        = -1;
+    log->gen       = 0;
+    log->shard     = 0;
+    log->numShards = 0;
+    log->dir       = NULL;
+}
+
+int openPersistLog(PersistLog_t* log, const char* dir, int shard, int numShards, unsigned long gen) {
+    char path[MAX_PERSIST_PATH_LEN];
+    walPath(path, dir, shard, gen);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd == -1) return -1;
+
+    // New file: header first
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        PersistFileHeader_t header = { WAL_MAGIC, numShards, shard, gen };
+        struct iovec iov = { &header, sizeof(PersistFileHeader_t) };
+        if (writeFully(fd, &iov, 1) == -1) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    log->fd        = fd;
+    log->gen       = gen;
+    log->shard     = shard;
+    log->numShards = numShards;
+    log->dir       = dir;
+    return 0;
+}
+
+void closePersistLog(PersistLog_t* log) {
+    if (log->fd != -1) close(log->fd);
+    log->fd = -1;
+}
+
+int persistLogAppend(PersistLog_t* log, int op, const char* name, size_t nameLen, const char* data, size_t dataLen) {
+    if (log->fd == -1) return 0;
+
+    // Header + name + data (a single write)
+    PersistRecordHeader_t header = { op, nameLen, dataLen };
+    struct iovec iov[3] = {
+        { &header, sizeof(PersistRecordHeader_t) },
+        { (void*) name, nameLen },
+        { (void*) data, dataLen }
+    };
+    return writeFully(log->fd, iov, (dataLen > 0) ? 3 : 2);
+}
+
+int persistLogAppendInsert(PersistLog_t* log, const char* name, size_t nameLen, long long expiresAt, const char* data, size_t dataLen) {
+    return appendPrefixed(log, PERSIST_OP_INSERT, name, nameLen, (uint64_t) expiresAt, data, dataLen);
+}
+
+int persistLogAppendRange(PersistLog_t* log, const char* name, size_t nameLen, size_t offset, const char* data, size_t dataLen) {
+    return appendPrefixed(log, PERSIST_OP_WRITE_RANGE, name, nameLen, offset, data, dataLen);
+}
+
+int rotatePersistLog(PersistLog_t* log) {
+    PersistLog_t next;
+    initPersistLog(&next);
+    if (openPersistLog(&next, log->dir, log->shard, log->numShards, log->gen + 1) == -1) return -1;
+
+    closePersistLog(log);
+    *log = next;
+    return 0;
+}
+
+int writePersistSnapshot(const char* dir, int shard, int numShards, unsigned long gen, const FSFile_t* files, const long long* expiresAt, int count, int references) {
+    char tmpPath[MAX_PERSIST_PATH_LEN], path[MAX_PERSIST_PATH_LEN];
+    snapshotPath(tmpPath, dir, shard, "tmp");
+    snapshotPath(path, dir, shard, "bin");
+
+    FILE* stream = fopen(tmpPath, "w");
+    if (stream == NULL) return -1;
+
+    // Header
+    PersistFileHeader_t header = { SNAPSHOT_MAGIC, numShards, shard, gen };
+    int err = fwrite(&header, sizeof(PersistFileHeader_t), 1, stream) != 1;
+
+    // Files (contents are decoded, or referenced if left inside the arena)
+    for (int i = 0; i < count && !err; ++i) {
+        int64_t deadline = expiresAt[i];
+        PersistArenaRef_t arenaRef = { .contentLen = files[i].contentLen, .expiresAt = deadline };
+        if (references && getContentArenaRef(files[i].content, &arenaRef.ref)) {
+            PersistRecordHeader_t record = { PERSIST_OP_ATTACH, files[i].nameLen, sizeof(PersistArenaRef_t) };
+            err |= fwrite(&record, sizeof(PersistRecordHeader_t), 1, stream) != 1;
+            err |= fwrite(files[i].name, 1, files[i].nameLen, stream) != files[i].nameLen;
+            err |= fwrite(&arenaRef, sizeof(PersistArenaRef_t), 1, stream) != 1;
+            continue;
+        }
+
+        PersistRecordHeader_t record = { PERSIST_OP_INSERT, files[i].nameLen, sizeof(int64_t) + files[i].contentLen };
+        err |= fwrite(&record, sizeof(PersistRecordHeader_t), 1, stream) != 1;
+        err |= fwrite(files[i].name, 1, files[i].nameLen, stream) != files[i].nameLen;
+        err |= fwrite(&deadline, sizeof(int64_t), 1, stream) != 1;
+
+        int segments = 0;
+        const struct iovec* view = createContentView(acquireContent(files[i].content), files[i].contentLen, &segments);
+        for (int j = 0; j < segments && !err; ++j)
+            err |= fwrite(view[j].iov_base, 1, view[j].iov_len, stream) != view[j].iov_len;
+        releaseContentView(view);
+    }
+
+    // Sync before replacing the old one
+    err |= fflush(stream) != 0;
+    err |= fsync(fileno(stream)) != 0;
+    err |= fclose(stream) != 0;
+    if (err || rename(tmpPath, path) == -1) {
+        int errnoSaved = errno;
+        unlink(tmpPath);
+        errno = errnoSaved;
+        return -1;
+    }
+
+    // Logs included in the snapshot
+    removeLogsBefore(dir, shard, gen);
+    return 0;
+}
+
+size_t reservePersistShard(const char* dir, int shard, int numShards) {
+    char path[MAX_PERSIST_PATH_LEN];
+    snapshotPath(path, dir, shard, "bin");
+    FILE* stream = fopen(path, "r");
+    if (stream == NULL) return 0;
+
+    // Only references (every other record is skipped)
+    size_t count = 0;
+    unsigned long gen = 0;
+    PersistReplay_t result = { 0 };
+    PersistRecordHeader_t header;
+    PersistArenaRef_t arenaRef;
+    if (readHeader(stream, SNAPSHOT_MAGIC, numShards, &result, &gen) == 0) {
+        while (fread(&header, sizeof(PersistRecordHeader_t), 1, stream) == 1) {
+            if (header.op != PERSIST_OP_ATTACH) {
+                if (fseeko(stream, (off_t) header.nameLen + header.dataLen, SEEK_CUR) == -1) break;
+                continue;
+            }
+            if (fseeko(stream, header.nameLen, SEEK_CUR) == -1 || fread(&arenaRef, sizeof(PersistArenaRef_t), 1, stream) != 1) break;
+            count += reserveContent(arenaRef.ref);
+        }
+    }
+    fclose(stream);
+    return count;
+}
+
+PersistReplay_t replayPersistShard(const char* dir, int shard, int numShards, PersistReplayFun_t fun, void* arg) {
+    PersistReplay_t result = { 0, 0, 0, 0, 0, 0 };
+    char path[MAX_PERSIST_PATH_LEN];
+
+    // Snapshot (its generation tells the first log to replay)
+    unsigned long gen = 0;
+    snapshotPath(path, dir, shard, "bin");
+    FILE* stream = fopen(path, "r");
+    if (stream != NULL) {
+        result.found = 1;
+        if (readHeader(stream, SNAPSHOT_MAGIC, numShards, &result, &gen) == 0)
+            result.filesCount = replayRecords(stream, fun, arg, 0);
+        else
+            LOG_ERRO("[#PS] Invalid snapshot '%s' (skipped)", path);
+        fclose(stream);
+    }
+    result.firstGen = gen;
+    result.lastGen  = gen;
+
+    // Logs (in order, until a missing generation)
+    for (;; ++gen) {
+        walPath(path, dir, shard, gen);
+        if ((stream = fopen(path, "r+")) == NULL) break;
+
+        unsigned long fileGen = 0;
+        result.found   = 1;
+        result.lastGen = gen;
+        if (readHeader(stream, WAL_MAGIC, numShards, &result, &fileGen) == 0 && fileGen == gen)
+            result.opsCount += replayRecords(stream, fun, arg, 1);
+        else
+            LOG_ERRO("[#PS] Invalid log '%s' (skipped)", path);
+        fclose(stream);
+    }
+
+    // Left by a snapshot interrupted before removing it
+    if (result.firstGen > 0) removeLogsBefore(dir, shard, result.firstGen);
+    return result;
+}
+
+void removePersistShard(const char* dir, int shard, unsigned long lastGen) {
+    char path[MAX_PERSIST_PATH_LEN];
+    snapshotPath(path, dir, shard, "bin");
+    unlink(path);
+    snapshotPath(path, dir, shard, "tmp");
+    unlink(path);
+    removeLogsBefore(dir, shard, lastGen + 1);
+}
+
+// =============================================================================================
+
+void walPath(char* path, const char* dir, int shard, unsigned long gen) {
+    snprintf(path, MAX_PERSIST_PATH_LEN, "%s/wal-%d-%lu.log", dir, shard, gen);
+}
+
+void snapshotPath(char* path, const char* dir, int shard, const char* ext) {
+    snprintf(path, MAX_PERSIST_PATH_LEN, "%s/snapshot-%d.%s", dir, shard, ext);
+}
+
+int writeFully(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        // Skip what was written
+        while (count > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base  = (char*) iov->iov_base + n;
+            iov->iov_len  -= n;
+        }
+    }
+    return 0;
+}
+
+int readHeader(FILE* stream, const char* magic, int numShards, PersistReplay_t* result, unsigned long* gen) {
+    PersistFileHeader_t header;
+    if (fread(&header, sizeof(PersistFileHeader_t), 1, stream) != 1) return -1;
+    if (memcmp(header.magic, magic, sizeof(header.magic)) != 0) return -1;
+
+    // Files are assigned to shards by name: another layout means another grouping
+    if ((int) header.numShards != numShards) result->layoutChanged = 1;
+    *gen = header.gen;
+    return 0;
+}
+
+size_t replayRecords(FILE* stream, PersistReplayFun_t fun, void* arg, int cutTorn) {
+    struct stat st;
+    if (fstat(fileno(stream), &st) == -1) return 0;
+
+    size_t count = 0;
+    off_t good   = ftello(stream);
+    PersistRecordHeader_t header;
+    while (fread(&header, sizeof(PersistRecordHeader_t), 1, stream) == 1) {
+        // Torn (or corrupted) record
+        off_t end = good + sizeof(PersistRecordHeader_t) + header.nameLen + header.dataLen;
+        if (header.op < PERSIST_OP_INSERT || header.op > PERSIST_OP_WRITE_RANGE || end > st.st_size) break;
+        if ((header.op == PERSIST_OP_WRITE_RANGE || header.op == PERSIST_OP_INSERT) && header.dataLen < sizeof(uint64_t)) break;
+
+        FSFile_t file = { .nameLen = header.nameLen, .contentLen = header.dataLen, .content = NULL, .data = NULL };
+        char* name = (char*) mem_malloc(header.nameLen * sizeof(char));
+        int err    = fread(name, 1, header.nameLen, stream) != header.nameLen;
+        file.name  = name;
+
+        if (header.op == PERSIST_OP_ATTACH) {
+            // Name is passed to the callee only with the content
+            if (err || replayAttach(stream, fun, arg, file, &err) == 0) free(name);
+            if (err) break;
+        } else if (header.op == PERSIST_OP_INSERT || header.op == PERSIST_OP_MODIFY) {
+            // Inserts start with their TTL deadline
+            int64_t expiresAt = 0;
+            if (header.op == PERSIST_OP_INSERT) {
+                err |= fread(&expiresAt, sizeof(int64_t), 1, stream) != 1;
+                file.contentLen = header.dataLen - sizeof(int64_t);
+            }
+
+            // Fresh content: its single segment is written in place
+            size_t size = 0;
+            file.content = createContent(NULL, file.contentLen);
+            if (file.content) err |= fread((char*) getContentBytes(file.content, file.contentLen, &size), 1, file.contentLen, stream) != file.contentLen;
+            if (err) {
+                releaseContent(file.content);
+                free(name);
+                break;
+            }
+            fun(arg, header.op, file, 0, expiresAt);
+        } else {
+            char* data = (header.dataLen > 0) ? (char*) mem_malloc(header.dataLen) : NULL;
+            if (data) err |= fread(data, 1, header.dataLen, stream) != header.dataLen;
+            file.data = data;
+
+            // Ranges start with their offset
+            uint64_t offset = 0;
+            if (header.op == PERSIST_OP_WRITE_RANGE) {
+                memcpy(&offset, data, sizeof(uint64_t));
+                file.data       = data + sizeof(uint64_t);
+                file.contentLen = header.dataLen - sizeof(uint64_t);
+            }
+            if (!err) fun(arg, header.op, file, offset, 0);
+            free(data);
+            free(name);
+            if (err) break;
+        }
+
+        good = end;
+        count++;
+    }
+
+    // Cut what was left by a crash (new operations are appended after it)
+    if (cutTorn && good < st.st_size) {
+        LOG_WARN("[#PS] Log truncated at %lld bytes (of %lld)", (long long) good, (long long) st.st_size);
+        if (ftruncate(fileno(stream), good) == -1) LOG_ERRNO("[#PS] Error truncating log");
+    }
+    return count;
+}
+
+int replayAttach(FILE* stream, PersistReplayFun_t fun, void* arg, FSFile_t file, int* err) {
+    PersistArenaRef_t arenaRef;
+    if ((*err = fread(&arenaRef, sizeof(PersistArenaRef_t), 1, stream) != 1)) return 0;
+
+    // Content is still inside the arena (nothing to read)
+    Content_t* content = attachContent(arenaRef.ref);
+    if (content == NULL) {
+        LOG_ERRO("[#PS] Content of '%.*s' is not inside the arena anymore (file lost)", (int) file.nameLen, file.name);
+        return 0;
+    }
+
+    file.content    = content;
+    file.contentLen = arenaRef.contentLen;
+    fun(arg, PERSIST_OP_INSERT, file, 0, arenaRef.expiresAt);
+    return 1;
+}
+
+int appendPrefixed(PersistLog_t* log, int op, const char* name, size_t nameLen, uint64_t prefix, const char* data, size_t dataLen) {
+    if (log->fd == -1) return 0;
+
+    // Header + name + prefix + data (a single write)
+    PersistRecordHeader_t header = { op, nameLen, sizeof(uint64_t) + dataLen };
+    struct iovec iov[4] = {
+        { &header, sizeof(PersistRecordHeader_t) },
+        { (void*) name, nameLen },
+        { &prefix, sizeof(uint64_t) },
+        { (void*) data, dataLen }
+    };
+    return writeFully(log->fd, iov, (dataLen > 0) ? 4 : 3);
+}
+
+void removeLogsBefore(const char* dir, int shard, unsigned long gen) {
+    // Generations are contiguous: stop at the first missing one
+    char path[MAX_PERSIST_PATH_LEN];
+    while (gen > 0) {
+        walPath(path, dir, shard, --gen);
+        if (unlink(path) == -1) break;
+    }
+}
@@ -17,16 +17,18 @@
 #include "circ_queue.h"
 #include "file_system.h"
 #include "session.h"
+#include "outbox.h"
 
 #define PIPE_READ_END  0
 #define PIPE_WRITE_END 1
 
 #define RING_BUFFER_SIZE 64
 #define LOCK_QUEUE_SIZE 256
+#define LOCK_BATCH_SIZE 32
 
 #define EXIT_REQUESTED 1000 // Main => Select   : request to stop reading
 #define NEW_CONNECTION 1001 // Main => Select   : client connected
-#define SET_CONNECTION 1002 // Worker => Select : readd client
+#define SET_CONNECTION 1002 // Worker => Select : readd client (or watch it while waiting on lock)
 #define REM_CONNECTION 1003 // Worker => Select : client disconnected
 
 #define MAX_FILE_SIZE 32
@@ -62,6 +64,10 @@ SockMessage_t handleWork(int, int, SockMessage_t);
 void handleError(int, SockMessage_t*);
 FSFile_t copyRequestIntoFile(SockMessage_t);
 FSFile_t deepCopyRequestIntoFile(SockMessage_t);
+void releaseResponseContents(SockMessage_t*);
+int isDeferrable(const SockMessage_t*);
+long lockTimeout(const SockMessage_t*);
+void endLockWait(int);
 void log_into_file(SockMessage_t*, SockMessage_t*, long long, size_t, size_t, int, int);
 
 // ======================================= DEFINITIONS: Global vars =================================================
@@ -93,9 +99,13 @@ static int mainToSelectPipe[2]         = { -1, -1 };
 static CircQueue_t* gWorkQueue         = NULL;
 static pthread_mutex_t gWorkMutex      = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t gWorkCond        = PTHREAD_COND_INITIALIZER;
-static CircQueue_t* gLockQueue         = NULL;
-static pthread_mutex_t gLockMutex      = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t gLockCond        = PTHREAD_COND_INITIALIZER;
+static NotifyChannel_t gLockChannel;
+
+// Responses the lock thread still has to send to each client (clients waiting on lock).
+// Waiting clients are watched by select, so that a disconnection cancels the wait
+static int gLockResponses[MAX_CLIENT_COUNT];
+static pthread_mutex_t gLockResponsesMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gLockResponsesCond   = PTHREAD_COND_INITIALIZER;
 
 // ======================================= DEFINITIONS: client.h functions ==========================================
 
@@ -123,11 +133,12 @@ int initializeServer(ServerConfig_t configs) {
 
     // Msg queue & Lock queue
     gWorkQueue = createQueue(RING_BUFFER_SIZE);
-    gLockQueue = createQueue(LOCK_QUEUE_SIZE);
+    initNotifyChannel(&gLockChannel, LOCK_QUEUE_SIZE);
 
     // Initialize Sessions & FS
     initSessionSystem();
-    initializeFileSystem(gConfigs.fsConfigs, gLockQueue, &gLockCond, &gLockMutex);
+    initOutboxSystem((size_t) gConfigs.ejectedQueueMB * 1024 * 1024);
+    initializeFileSystem(gConfigs.fsConfigs, &gLockChannel);
 
     // Pipe MainThread -> SelectThread
     if (pipe(mainToSelectPipe) < 0) {
@@ -199,9 +210,7 @@ int terminateSever() {
     gShouldStopWorking = 1;
     
     // Signal lock thread
-    lock_mutex(&gLockMutex);
-    notify_one(&gLockCond);
-    unlock_mutex(&gLockMutex);
+    notifyClose(&gLockChannel);
     
     // Wait lock thread
     LOG_VERB("[#MN] Waiting lock thread...");
@@ -233,9 +242,15 @@ int terminateSever() {
     free(gWorkQueue->data);
     free(gWorkQueue);
 
-    // Free lock queue
-    free(gLockQueue->data);
-    free(gLockQueue);
+    // Free lock channel
+    NotifyInfo_t lockInfo = notifyInfo(&gLockChannel);
+    LOG_VERB("[#MN] Lock notifications: %ld published, %ld wakeups, %ld times full", lockInfo.publishedCount, lockInfo.wakeupsCount, lockInfo.fullCount);
+    destroyNotifyChannel(&gLockChannel);
+
+    // Free outboxes
+    OutboxInfo_t outInfo = outboxInfo();
+    LOG_VERB("[#MN] Ejected files: %ld deferred, %ld inline (queue full), %ld delivered, %ld dropped, %zu bytes queued at most", outInfo.deferredCount, outInfo.inlineCount, outInfo.deliveredCount, outInfo.droppedCount, outInfo.bytesMaxQueued);
+    terminateOutboxSystem();
 
     // Close Sessions & FS (Log execution summary)
     terminateSessionSystem();
@@ -420,9 +435,12 @@ void* workerThreadFun(void* args) {
             // Handle disconnection
             ClientSession_t* session = NULL;
             if (getRawSession(client, &session) == 0) {
+                // Stop waiting on lock (the descriptor is closed next)
+                endLockWait(client);
                 // Clean FS using its session
                 fs_clean(client, session);
-                // Clean session
+                // Clean session (files not read yet are released)
+                outboxClear(client);
                 destroySession(client);
             }
             LOG_VERB("[#SE] Client on FD#%02d disconnected !", client);
@@ -436,9 +454,15 @@ void* workerThreadFun(void* args) {
 
         // Handle message
         SockMessage_t responseMsg = handleWork(threadID, client, requestMsg);
-        if ((requestMsg.type == MSG_REQ_LOCK_FILE || (requestMsg.type == MSG_REQ_OPEN_FILE && (requestMsg.request.flags == FLAG_LOCK))) && responseMsg.type == MSG_NONE) {
+        if ((requestMsg.type == MSG_REQ_LOCK_FILE || requestMsg.type == MSG_REQ_OPEN_FILE) && responseMsg.type == MSG_NONE) {
             // Unable to lock.
-            // Already pushed into side queue for future handling
+            // Already pushed into side queue for future handling (the lock thread responds).
+            // Watch the descriptor meanwhile: a disconnection cancels the wait
+            lock_mutex(&gLockResponsesMutex);
+            gLockResponses[client]++;
+            unlock_mutex(&gLockResponsesMutex);
+            int messageToSend[2] = { SET_CONNECTION, client };
+            writeN(mainToSelectPipe[PIPE_WRITE_END], (char*) &messageToSend, 2 * sizeof(int));
         } else {
             LOG_VERB("[#%.2d] work completed. Sending response...", threadID);
             // Write response to client
@@ -452,7 +476,8 @@ void* workerThreadFun(void* args) {
         // Log request
         log_into_file(&requestMsg, &responseMsg, ELAPSED_MICR_S(end, begin), bytesRead, bytesWritten, threadID, client);
        
-        // Release resources
+        // Release resources (files content is shared with the file system)
+        releaseResponseContents(&responseMsg);
         freeMessageContent(&requestMsg , 1);
         freeMessageContent(&responseMsg, 1);
     }
@@ -593,65 +618,55 @@ void* lockThreadFun(void* args) {
     // vars
     size_t innerBufferSize = 1024;
     char* _inn_buff = (char*) mem_malloc(innerBufferSize * sizeof(char)); // Can be fixed because responses are always the same
-    int res = 0;
+    FSLockNotification_t notifications[LOCK_BATCH_SIZE];
     SockMessage_t msg;
 
     // Stop working when SIGINT / SIGQUIT received
     while (!gSigIntReceived && !gSigQuitReceived && !gShouldStopWorking) {
-        // Reset item
-        CircQueueItemPtr_t item = NULL;
-        long long bytesWritten = 0;
-
-        // Lock mutex and wait on cond (if queue is empty)
-        lock_mutex(&gLockMutex);
-        while (!gSigIntReceived && !gSigQuitReceived && !gShouldStopWorking && (tryPop(gLockQueue, &item) == 0)) {
-            LOG_VERB("[#LK] waiting for notifications...");
-            // Wait for cond
-            if ((res = pthread_cond_wait(&gLockCond, &gLockMutex)) != 0) {
-                errno = res;
-                LOG_ERRNO("[#LK] Error waiting on cond var inside lock thread func");
-            }
-        }
-        unlock_mutex(&gLockMutex);
+        // Wait for notifications (taken in batches)
+        LOG_VERB("[#LK] waiting for notifications...");
+        int count = notifyWait(&gLockChannel, notifications, LOCK_BATCH_SIZE);
 
         // Check if exited for signal
-        if (item == NULL) {
-            LOG_VERB("[#LK] Queue empty");
+        if (count == 0) {
+            LOG_VERB("[#LK] Channel closed");
             continue;
         }
 
-        // Someone unlocked a file that was locked by this client
-        // and the file_system automatically locked it for him, notifying
-        // the queue this thread is waiting for to send response to client.
-        FSLockNotification_t notification = *((FSLockNotification_t*) item);
-
-        // Empty response
-        msg = (SockMessage_t) {
-            .uid  = UUID_new(),
-            .type = MSG_RESP_SIMPLE,
-            .response = {
-                .status = RESP_STATUS_OK
-            }
-        };
+        for (int i = 0; i < count; ++i) {
+            // Someone unlocked a file that was locked by this client
+            // and the file_system automatically locked it for him, notifying
+            // the channel this thread is waiting on to send response to client.
+            FSLockNotification_t notification = notifications[i];
+            long long bytesWritten = 0;
+
+            // Empty response
+            msg = (SockMessage_t) {
+                .uid  = UUID_new(),
+                .type = MSG_RESP_SIMPLE,
+                .response = {
+                    .status = RESP_STATUS_OK
+                }
+            };
 
-        // Handle error (if any)
-        handleError(notification.status, &msg);
+            // Handle error (if any)
+            handleError(notification.status, &msg);
 
-        // Write response to client
-        LOG_VERB("[#LK] Notification arrived. Sending %d to %d...", msg.response.status, notification.fd);
-        if ((bytesWritten = writeMessage(notification.fd, &_inn_buff, &innerBufferSize, &msg)) == -1)
-            LOG_ERRNO("Error sending response");
+            // Write response to client (its descriptor is already watched by select)
+            LOG_VERB("[#LK] Notification arrived. Sending %d to %d...", msg.response.status, notification.fd);
+            if ((bytesWritten = writeMessage(notification.fd, &_inn_buff, &innerBufferSize, &msg)) == -1)
+                LOG_ERRNO("Error sending response");
 
-        // Readd descriptor to set
-        int messageToSend[2] = { SET_CONNECTION, notification.fd };
-        writeN(mainToSelectPipe[PIPE_WRITE_END], (char*) &messageToSend, 2 * sizeof(int));
+            // Wake up who is closing the client waiting for this response
+            lock_mutex(&gLockResponsesMutex);
+            gLockResponses[notification.fd]--;
+            notify_all(&gLockResponsesCond);
+            unlock_mutex(&gLockResponsesMutex);
 
-        // Release memory
-        free(item);
-        
-        // Log request
-        SockMessage_t tmp = { .type = MSG_REQ_LOCK_FILE, .uid = EMPTY_UUID };
-        log_into_file(&tmp, &msg, 0LL, 0LL, bytesWritten, LOCK_THREAD_ID, notification.fd);
+            // Log request
+            SockMessage_t tmp = { .type = MSG_REQ_LOCK_FILE, .uid = EMPTY_UUID };
+            log_into_file(&tmp, &msg, 0LL, 0LL, bytesWritten, LOCK_THREAD_ID, notification.fd);
+        }
     }
     free(_inn_buff);
     return NULL;
@@ -718,9 +733,12 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
             // Handle disconnection
             ClientSession_t* session = NULL;
             if (getRawSession(client, &session) == 0) {
+                // Stop waiting on lock
+                endLockWait(client);
                 // Clean FS using its session
                 fs_clean(client, session);
-                // Clean session
+                // Clean session (files not read yet are released)
+                outboxClear(client);
                 destroySession(client);
             } else  {
                 LOG_ERRO("[#%.2d] Error destroying session for client #%.2d", workingThreadID, client);
@@ -743,8 +761,8 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
                 break;
             }
 
-            // Check file was not opened
-            const int flags    = msg.request.flags;
+            // Check file was not opened (TTL, deferral, timeout and sharing are not opening modes)
+            const int flags    = msg.request.flags & ~(FLAG_TTL | FLAG_DEFER | FLAG_TIMEOUT | FLAG_LOCK_SHARED);
             SessionFile_t file = {
                 .name = msg.request.file.filename.abs.ptr,
                 .len  = msg.request.file.filename.len,
@@ -758,9 +776,10 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
             // Open file
             int isLockRequested = flags & FLAG_LOCK;
             if (flags & FLAG_CREATE) {
-                // Create file
+                // Create file (removed once its TTL elapsed, if any)
+                long ttlMs       = (msg.request.flags & FLAG_TTL) ? (long) msg.request.length : 0;
                 FSFile_t fs_file = deepCopyRequestIntoFile(msg);
-                if ((res = fs_insert(client, fs_file, isLockRequested, &outFiles, &outFilesCount)) != 0) {
+                if ((res = fs_insert(client, fs_file, isLockRequested, ttlMs, &outFiles, &outFilesCount)) != 0) {
                     LOG_ERRO("[#%.2d] Error creating file '%s' for client #%.2d", workingThreadID, file.name, client);
                     handleError(res, &response);
                     break;
@@ -768,7 +787,7 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
             } else if(isLockRequested) {
                 // Lock file
                 FSFile_t fs_file = copyRequestIntoFile(msg);
-                if ((res = fs_trylock(client, fs_file)) != 0) {
+                if ((res = fs_trylock(client, fs_file, (msg.request.flags & FLAG_LOCK_SHARED) != 0, lockTimeout(&msg))) != 0) {
                     // Save response as 'none' or 'empty'
                     if (res == FS_CLIENT_WAITING_ON_LOCK) {
                         response.type = MSG_NONE;
@@ -854,12 +873,69 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
             break;
         }
 
+        case MSG_REQ_READ_EJECTED:
+        {
+            // Retrieve session
+            int session;
+            if ((res = getSession(client, &session)) != 0) {
+                LOG_ERRO("[#%.2d] Error retrieving session for client #%.2d", workingThreadID, client);
+                handleError(res, &response);
+                break;
+            }
+
+            // Take queued files (the oldest first)
+            const int n = msg.request.flags;
+            outboxPop(client, n, &outFiles, &outFilesCount);
+
+            // LOG
+            LOG_VERB("[#%.2d] %d ejected file read for client #%.2d", workingThreadID, outFilesCount, client);
+            break;
+        }
+
+        case MSG_REQ_LIST:
+        {
+            // Prefix without terminator, cursor with it (names are listed with it)
+            const char* prefix = msg.request.file.filename.abs.ptr;
+            size_t prefixLen   = msg.request.file.filename.len;
+            if (prefixLen > 0 && prefix[prefixLen - 1] == '\0') --prefixLen;
+            const int max = (int) (MIN(msg.request.length, FS_LIST_MAX));
+
+            // List files
+            int more = 0, listedCount = 0;
+            FSFile_t* listed = NULL;
+            if ((res = fs_list(client, prefix, prefixLen, msg.request.file.content.ptr, msg.request.file.contentLen, max, &listed, &listedCount, &more)) != 0) {
+                LOG_ERRO("[#%.2d] Error listing files for client #%.2d", workingThreadID, client);
+                handleError(res, &response);
+                break;
+            }
+
+            // Names are moved into the response
+            MsgFile_t* files = (MsgFile_t*) mem_calloc(MAX(1, listedCount), sizeof(MsgFile_t));
+            for (int i = 0; i < listedCount; ++i) {
+                files[i].contentLen       = listed[i].contentLen; // Size only
+                files[i].content.ptr      = NULL;
+                files[i].filename.len     = listed[i].nameLen;
+                files[i].filename.abs.ptr = listed[i].name;
+            }
+            free(listed);
+            response.type              = MSG_RESP_LIST;
+            response.response.files    = files;
+            response.response.numFiles = listedCount;
+            response.response.more     = more;
+
+            // LOG
+            LOG_VERB("[#%.2d] %d file listed for client #%.2d", workingThreadID, listedCount, client);
+            break;
+        }
+
         case MSG_REQ_WRITE_FILE:
         case MSG_REQ_READ_FILE:
         case MSG_REQ_LOCK_FILE:
         case MSG_REQ_UNLOCK_FILE:
         case MSG_REQ_REMOVE_FILE:
         case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
         {
             // Retrieve session
             int session;
@@ -899,8 +975,6 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
                     if ((res = fs_modify(client, fs_file, &outFiles, &outFilesCount)) != 0) {
                         LOG_ERRO("[#%.2d] Error writing file '%s' for client #%.2d", workingThreadID, file.name, client);
                         handleError(res, &response);
-                        if (fs_file.content) free((char*) fs_file.content);
-                        free((char*) fs_file.name);
                         break;
                     }
                     break;
@@ -927,7 +1001,7 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
                 {
                     // Lock file
                     FSFile_t fs_file = copyRequestIntoFile(msg);
-                    if ((res = fs_trylock(client, fs_file)) != 0) {
+                    if ((res = fs_trylock(client, fs_file, (msg.request.flags & FLAG_LOCK_SHARED) != 0, lockTimeout(&msg))) != 0) {
                         // Save response as 'none' or 'empty'
                         if (res == FS_CLIENT_WAITING_ON_LOCK) {
                             response.type = MSG_NONE;
@@ -974,6 +1048,35 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
                     }
                     break;
                 }
+
+                case MSG_REQ_READ_RANGE:
+                {
+                    // Read bytes of file
+                    FSFile_t outFile;
+                    FSFile_t fs_file = copyRequestIntoFile(msg);
+                    if ((res = fs_read_range(client, fs_file, msg.request.offset, msg.request.length, &outFile)) != 0) {
+                        LOG_ERRO("[#%.2d] Error reading range of file '%s' for client #%.2d", workingThreadID, file.name, client);
+                        handleError(res, &response);
+                        break;
+                    }
+                    // Add file to outFiles
+                    outFiles      = (FSFile_t*) mem_malloc(sizeof(FSFile_t));
+                    outFilesCount = 1;
+                    outFiles[0]   = outFile;
+                    break;
+                }
+
+                case MSG_REQ_WRITE_RANGE:
+                {
+                    // Write bytes of file
+                    FSFile_t fs_file = copyRequestIntoFile(msg);
+                    if ((res = fs_write_range(client, fs_file, msg.request.offset, &outFiles, &outFilesCount)) != 0) {
+                        LOG_ERRO("[#%.2d] Error writing range of file '%s' for client #%.2d", workingThreadID, file.name, client);
+                        handleError(res, &response);
+                        break;
+                    }
+                    break;
+                }
     
                 default:
                     // Should never happend
@@ -997,6 +1100,7 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
         case MSG_NONE:
         case MSG_RESP_SIMPLE:
         case MSG_RESP_WITH_FILES:
+        case MSG_RESP_LIST:
         default:
         {
             // LOG
@@ -1006,6 +1110,13 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
         }
     }
 
+    // Files ejected by a write can be queued (the client reads them later)
+    if (outFilesCount > 0 && isDeferrable(&msg)) {
+        int deferred = outboxPush(client, outFiles, outFilesCount);
+        outFilesCount -= deferred;
+        LOG_VERB("[#%.2d] %d ejected file queued for client #%.2d", workingThreadID, deferred, client);
+    }
+
     // Add outFiles to response
     if (outFilesCount > 0) {
         // Update response type
@@ -1014,16 +1125,18 @@ SockMessage_t handleWork(int workingThreadID, int client, SockMessage_t msg) {
         MsgFile_t* files = mem_malloc(outFilesCount * sizeof(MsgFile_t));
         for (int i = 0; i < outFilesCount; ++i) {
             files[i].contentLen       = outFiles[i].contentLen; // 
-            files[i].content.ptr      = outFiles[i].content;    // Pass ptr
+            files[i].content.ptr      = NULL;                   // Content is scattered
+            files[i].segments         = createContentView(outFiles[i].content, outFiles[i].contentLen, &files[i].numSegments);
             files[i].filename.len     = outFiles[i].nameLen;    // 
             files[i].filename.abs.ptr = outFiles[i].name;       // Pass ptr
         }
         response.response.files    = files;         // Add files to response
         response.response.numFiles = outFilesCount; // Add files len to response
-        // Release memory
-        free(outFiles);
     }
 
+    // Release memory (read n files returns an empty array when there is nothing to read)
+    free(outFiles);
+
     // Return response
     return response;
 }
@@ -1035,6 +1148,7 @@ void handleError(int status, SockMessage_t* response) {
         case FS_FILE_ALREADY_EXISTS:
         case FS_FILE_NOT_EXISTS:
         case FS_FILE_TOO_BIG:
+        case FS_INVALID_RANGE:
         case SESSION_FILE_ALREADY_OPENED:
         {
             response->response.status = RESP_STATUS_INVALID_ARG;
@@ -1053,6 +1167,12 @@ void handleError(int status, SockMessage_t* response) {
             break;
         }
 
+        case FS_LOCK_TIMED_OUT:
+        {
+            response->response.status = RESP_STATUS_TIMED_OUT;
+            break;
+        }
+
         case FS_CLIENT_NOT_ALLOWED:
         case SESSION_ALREADY_EXIST:
         case SESSION_NOT_EXIST:
@@ -1071,7 +1191,8 @@ void handleError(int status, SockMessage_t* response) {
 
 FSFile_t copyRequestIntoFile(SockMessage_t msg) {
     FSFile_t fs_file = {
-        .content    = msg.request.file.content.ptr,
+        .content    = NULL,
+        .data       = msg.request.file.content.ptr,
         .contentLen = msg.request.file.contentLen,
         .name       = msg.request.file.filename.abs.ptr,
         .nameLen    = msg.request.file.filename.len,
@@ -1088,8 +1209,7 @@ FSFile_t deepCopyRequestIntoFile(SockMessage_t msg) {
     // Copy content (if any)
     size_t cLen = msg.request.file.contentLen;
     // LOG_WARN("%64s => nLen %10ld cLen %10ld", filename, nLen, cLen);
-    char* content  = (cLen) ? (char*) mem_malloc(cLen * sizeof(char)) : NULL;
-    if (cLen) memcpy(content, msg.request.file.content.ptr, cLen * sizeof(char));
+    Content_t* content = createContent(msg.request.file.content.ptr, cLen);
 
     // Copy data
     FSFile_t fs_file = {
@@ -1101,10 +1221,61 @@ FSFile_t deepCopyRequestIntoFile(SockMessage_t msg) {
     return fs_file;
 }
 
+void releaseResponseContents(SockMessage_t* msg) {
+    if (msg->type != MSG_RESP_WITH_FILES) return;
+
+    // Drop the reference taken by the file system (held by the views)
+    for (int i = 0; i < msg->response.numFiles; ++i) {
+        releaseContentView(msg->response.files[i].segments);
+        msg->response.files[i].segments = NULL;
+    }
+}
+
+int isDeferrable(const SockMessage_t* msg) {
+    // Only the files ejected to make room for a write
+    switch (msg->type)
+    {
+        case MSG_REQ_OPEN_FILE:
+            return (msg->request.flags & FLAG_DEFER) && (msg->request.flags & FLAG_CREATE);
+        case MSG_REQ_WRITE_FILE:
+        case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_WRITE_RANGE:
+            return (msg->request.flags & FLAG_DEFER) != 0;
+        default:
+            return 0;
+    }
+}
+
+long lockTimeout(const SockMessage_t* msg) {
+    // Asked by the client, otherwise the server one (if any)
+    if (msg->request.flags & FLAG_TIMEOUT) return (long) msg->request.length;
+    return (gConfigs.lockTimeoutMs > 0) ? gConfigs.lockTimeoutMs : -1;
+}
+
+void endLockWait(int client) {
+    // Still queued: no response follows
+    int cancelled = fs_cancel_wait(client);
+
+    lock_mutex(&gLockResponsesMutex);
+    if (cancelled) {
+        gLockResponses[client]--;
+    } else {
+        // Wait for the response being sent (the lock granted is released with the session)
+        while (gLockResponses[client] > 0) {
+            int res = 0;
+            if ((res = pthread_cond_wait(&gLockResponsesCond, &gLockResponsesMutex)) != 0) {
+                errno = res;
+                LOG_ERRNO("Error waiting lock response");
+            }
+        }
+    }
+    unlock_mutex(&gLockResponsesMutex);
+}
+
 void log_into_file(SockMessage_t* msg, SockMessage_t* resp, long long msec, size_t bytesRead, size_t bytesWritten, int workingThreadID, int client) {
     SockMessageType_t type = msg->type;
     if (type == MSG_REQ_OPEN_FILE) {
-        type = 50 | msg->request.flags;
+        type = 50 | (msg->request.flags & ~(FLAG_TTL | FLAG_DEFER | FLAG_TIMEOUT | FLAG_LOCK_SHARED));
     }
 
     // Table for codes
@@ -1112,10 +1283,12 @@ void log_into_file(SockMessage_t* msg, SockMessage_t* resp, long long msec, size
         [MSG_NONE]               = "--",
         [MSG_RESP_SIMPLE]        = "??",
         [MSG_RESP_WITH_FILES]    = "??",
+        [MSG_RESP_LIST]          = "??",
         [MSG_REQ_APPEND_TO_FILE] = "AF",
         [MSG_REQ_CLOSE_FILE]     = "CF",
         [MSG_REQ_CLOSE_SESSION]  = "CS",
         [MSG_REQ_LOCK_FILE]      = "LF",
+        [MSG_REQ_LIST]           = "LS",
         [OPT_OPEN_CREATE]        = "OC",
         [OPT_OPEN_EMPTY]         = "OE",
         [MSG_REQ_OPEN_FILE]      = "OF",
@@ -1124,9 +1297,12 @@ void log_into_file(SockMessage_t* msg, SockMessage_t* resp, long long msec, size
         [OPT_OPEN_WRITE]         = "OW",
         [MSG_REQ_READ_FILE]      = "RF",
         [MSG_REQ_REMOVE_FILE]    = "RM",
+        [MSG_REQ_READ_EJECTED]   = "RE",
         [MSG_REQ_READ_N_FILES]   = "RN",
+        [MSG_REQ_READ_RANGE]     = "RR",
         [MSG_REQ_UNLOCK_FILE]    = "UF",
         [MSG_REQ_WRITE_FILE]     = "WF",
+        [MSG_REQ_WRITE_RANGE]    = "WR",
     };
 
     // Calc timestamp
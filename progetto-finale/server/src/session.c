@@ -121,7 +121,7 @@ int destroySession(int client) {
     return res;
 }
 
-int _intHasOpenedFile(ClientSession_t* session, HashValue file) {
+int _intHasOpenedFile(ClientSession_t* session, HashValue64 file) {
     if (!session->isValid)
         return SESSION_NOT_EXIST;
 
@@ -141,7 +141,7 @@ int hasOpenedFile(int session, SessionFile_t file) {
     ClientSession_t* _inn_session = &gSessionTable[session];
     lock_mutex(&_inn_session->mutex);
     
-    HashValue key = hash_string(file.name, file.len);
+    HashValue64 key = hash_string_64(file.name, file.len);
     res = _intHasOpenedFile(_inn_session, key);
 
     _intUpdateSession(_inn_session);
@@ -160,7 +160,7 @@ int addFileOpened(int session, SessionFile_t file, int flags) {
 
     if (res != SESSION_NOT_EXIST) {
         // Ensure file was not opened before
-        HashValue key = hash_string(file.name, file.len);
+        HashValue64 key = hash_string_64(file.name, file.len);
         res = _intHasOpenedFile(_inn_session, key);
         if (res == SESSION_FILE_NEVER_OPENED)
             res = 0;
@@ -171,7 +171,7 @@ int addFileOpened(int session, SessionFile_t file, int flags) {
 
         if (res != SESSION_FILE_ALREADY_OPENED && res != SESSION_OUT_OF_MEMORY) {
             // Add file
-            HashValue key   = hash_string(file.name, file.len);
+            HashValue64 key = hash_string_64(file.name, file.len);
             const int index = _inn_session->numFileOpened;
             _inn_session->filenames[index] = key;
             _inn_session->flags[index]     = flags;
@@ -196,7 +196,7 @@ int remFileOpened(int session, SessionFile_t file) {
     
     if (res != SESSION_NOT_EXIST) {
         // Rem file
-        HashValue key = hash_string(file.name, file.len);
+        HashValue64 key = hash_string_64(file.name, file.len);
         res = SESSION_FILE_NEVER_OPENED;
         for (int i = 0; i < _inn_session->numFileOpened; ++i) {
             // Search for file
@@ -233,7 +233,7 @@ int canWriteIntoFile(int session, SessionFile_t file) {
     
     if (res != SESSION_NOT_EXIST) {
         // Ensure file was opened RIGHT before
-        HashValue key = hash_string(file.name, file.len);
+        HashValue64 key = hash_string_64(file.name, file.len);
         res = SESSION_FILE_NEVER_OPENED;
         for (int i = 0; i < _inn_session->numFileOpened; ++i)
             if (_inn_session->filenames[i] == key)
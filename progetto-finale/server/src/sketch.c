@@ -0,0 +1,71 @@
+#include "sketch.h"
+
+#include <stdlib.h>
+
+#define MIN_WIDTH_BITS 4
+
+// Different seed for each row
+static const HashValue64 gRowSeeds[SKETCH_DEPTH] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+};
+
+// =============================================================================================
+
+size_t counterIndex(FreqSketch_t*, int, HashValue64);
+
+// =============================================================================================
+
+void initSketch(FreqSketch_t* sketch, size_t capacity) {
+    // Width: power of 2 >= capacity
+    int bits = MIN_WIDTH_BITS;
+    while (((size_t) 1 << bits) < capacity) bits++;
+
+    sketch->width      = (size_t) 1 << bits;
+    sketch->widthBits  = bits;
+    sketch->counters   = (atomic_uchar*) mem_calloc(SKETCH_DEPTH * sketch->width, sizeof(atomic_uchar));
+    sketch->sampleSize = 10 * sketch->width;
+    atomic_init(&sketch->additions, 0);
+}
+
+void destroySketch(FreqSketch_t* sketch) {
+    free(sketch->counters);
+    sketch->counters = NULL;
+}
+
+void sketchIncrement(FreqSketch_t* sketch, HashValue64 hash) {
+    for (int i = 0; i < SKETCH_DEPTH; ++i) {
+        atomic_uchar* counter = &sketch->counters[counterIndex(sketch, i, hash)];
+        unsigned char value   = atomic_load_explicit(counter, memory_order_relaxed);
+        // Saturate (a failed exchange means someone else incremented it)
+        if (value < SKETCH_MAX_COUNT)
+            atomic_compare_exchange_weak_explicit(counter, &value, value + 1, memory_order_relaxed, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&sketch->additions, 1, memory_order_relaxed);
+}
+
+int sketchEstimate(FreqSketch_t* sketch, HashValue64 hash) {
+    int result = SKETCH_MAX_COUNT;
+    for (int i = 0; i < SKETCH_DEPTH; ++i) {
+        int value = atomic_load_explicit(&sketch->counters[counterIndex(sketch, i, hash)], memory_order_relaxed);
+        result    = MIN(result, value);
+    }
+    return result;
+}
+
+void sketchAge(FreqSketch_t* sketch) {
+    if (atomic_load_explicit(&sketch->additions, memory_order_relaxed) < sketch->sampleSize) return;
+
+    for (size_t i = 0; i < SKETCH_DEPTH * sketch->width; ++i) {
+        unsigned char value = atomic_load_explicit(&sketch->counters[i], memory_order_relaxed);
+        atomic_store_explicit(&sketch->counters[i], value / 2, memory_order_relaxed);
+    }
+    atomic_store_explicit(&sketch->additions, 0, memory_order_relaxed);
+}
+
+// =============================================================================================
+
+size_t counterIndex(FreqSketch_t* sketch, int row, HashValue64 hash) {
+    // Multiplicative hashing, high bits are the best mixed ones
+    HashValue64 h = (hash ^ gRowSeeds[row]) * 0x9e3779b97f4a7c15ULL;
+    return row * sketch->width + (size_t) (h >> (64 - sketch->widthBits));
+}
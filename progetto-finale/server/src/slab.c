@@ -0,0 +1,86 @@
+#include "slab.h"
+
+#include <stdlib.h>
+#include <stdalign.h>
+
+#include <logger.h>
+
+// Chunk header, keeps objects aligned
+typedef struct {
+    alignas(max_align_t) void* next;
+} SlabChunk_t;
+
+#define ALIGN_UP(n, a) (((n) + (a) - 1) / (a) * (a))
+
+// =============================================================================================
+
+void initSlab(Slab_t* slab, size_t objSize, int objsPerChunk) {
+    int res = 0;
+    if ((res = pthread_mutex_init(&slab->mutex, NULL)) != 0) {
+        errno = res;
+        LOG_ERRNO("Server process crashed initializing mutex for slab");
+        LOG_CRIT("Terminating server...");
+        exit(EXIT_FAILURE);
+    }
+
+    // Free objects store the free list link inside
+    slab->objSize       = ALIGN_UP(MAX(objSize, sizeof(void*)), alignof(max_align_t));
+    slab->objsPerChunk  = MAX(1, objsPerChunk);
+    slab->freeList      = NULL;
+    slab->chunks        = NULL;
+    slab->allocCount    = 0;
+    slab->bytesReserved = 0;
+    slab->inUse         = 0;
+}
+
+void destroySlab(Slab_t* slab) {
+    SlabChunk_t* chunk = (SlabChunk_t*) slab->chunks;
+    while (chunk != NULL) {
+        SlabChunk_t* next = (SlabChunk_t*) chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    slab->chunks   = NULL;
+    slab->freeList = NULL;
+    pthread_mutex_destroy(&slab->mutex);
+}
+
+void* slabAlloc(Slab_t* slab) {
+    lock_mutex(&slab->mutex);
+
+    // Carve a new chunk when empty
+    if (slab->freeList == NULL) {
+        size_t bytes       = sizeof(SlabChunk_t) + slab->objSize * slab->objsPerChunk;
+        SlabChunk_t* chunk = (SlabChunk_t*) mem_malloc(bytes);
+        chunk->next        = slab->chunks;
+        slab->chunks       = chunk;
+        slab->allocCount++;
+        slab->bytesReserved += bytes;
+
+        // Push objects into free list (first object on top)
+        char* objs = (char*) (chunk + 1);
+        for (int i = slab->objsPerChunk - 1; i >= 0; --i) {
+            void* obj        = objs + i * slab->objSize;
+            *((void**) obj)  = slab->freeList;
+            slab->freeList   = obj;
+        }
+    }
+
+    // Pop
+    void* obj      = slab->freeList;
+    slab->freeList = *((void**) obj);
+    slab->inUse++;
+
+    unlock_mutex(&slab->mutex);
+    return obj;
+}
+
+void slabFree(Slab_t* slab, void* obj) {
+    if (obj == NULL) return;
+
+    lock_mutex(&slab->mutex);
+    *((void**) obj) = slab->freeList;
+    slab->freeList  = obj;
+    slab->inUse--;
+    unlock_mutex(&slab->mutex);
+}
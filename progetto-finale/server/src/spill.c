@@ -0,0 +1,343 @@
+#include "spill.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <logger.h>
+
+#define ENTRIES_PER_SLAB 256
+
+struct SpillEntry_t {
+    HashTableNode_t node;              // Hashmap node (MUST be the first field)
+    struct SpillEntry_t *pre, *nex;    // Write order
+    char* name;                        // File name (copy)
+    size_t nameLen;
+    size_t contentLen;
+    long long expiresAt;               // Kept for the caller (never written to disk)
+    off_t offset;                      // Record offset inside the segment file
+    size_t size;                       // Record bytes
+    int busy;                          // Record being written or read (its region is not reused meanwhile)
+};
+
+// Record layout: header + name + content
+typedef struct {
+    uint64_t nameLen;
+    uint64_t contentLen;
+} SpillRecordHeader_t;
+
+// =============================================================================================
+
+int recordHasName(const HashTableNode_t*, const void*, size_t);
+void dropRecord(SpillTier_t*, SpillEntry_t*, int);
+int makeRoomForRecord(SpillTier_t*, size_t);
+SpillEntry_t* findIdleRecord(SpillTier_t*, HashValue64, const char*, size_t);
+void waitRecords(SpillTier_t*);
+int writeRecord(int, struct iovec*, int, off_t);
+int readRecord(int, char*, size_t, off_t);
+
+// =============================================================================================
+
+int initSpillTier(SpillTier_t* tier, const char* filename, size_t maxSize, size_t capacity) {
+    // Segment file (previous contents are not reused)
+    if ((tier->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0600)) == -1) return -1;
+
+    int err = 0;
+    if ((err = pthread_mutex_init(&tier->mutex, NULL)) != 0) {
+        close(tier->fd);
+        errno = err;
+        return -1;
+    }
+    if ((err = pthread_cond_init(&tier->cond, NULL)) != 0) {
+        pthread_mutex_destroy(&tier->mutex);
+        close(tier->fd);
+        errno = err;
+        return -1;
+    }
+    initHashTable(&tier->index, capacity, recordHasName);
+    initSlab(&tier->entries, sizeof(SpillEntry_t), ENTRIES_PER_SLAB);
+    tier->oldest     = NULL;
+    tier->newest     = NULL;
+    tier->tail       = 0;
+    tier->maxSize    = (off_t) maxSize;
+    tier->filesCount = 0;
+    tier->bytesUsed  = 0;
+    tier->demotedCount  = 0; tier->bytesDemotedCount  = 0;
+    tier->promotedCount = 0; tier->bytesPromotedCount = 0;
+    tier->droppedCount  = 0; tier->bytesDroppedCount  = 0;
+    return 0;
+}
+
+void destroySpillTier(SpillTier_t* tier) {
+    // Names (entries memory is released with the pool)
+    SpillEntry_t* entry = tier->oldest;
+    while (entry) {
+        free(entry->name);
+        entry = entry->nex;
+    }
+
+    destroyHashTable(&tier->index);
+    destroySlab(&tier->entries);
+    pthread_cond_destroy(&tier->cond);
+    pthread_mutex_destroy(&tier->mutex);
+    close(tier->fd);
+}
+
+int spillPut(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen, Content_t* content, size_t contentLen, long long expiresAt) {
+    // Record bytes
+    SpillRecordHeader_t header = { nameLen, contentLen };
+    size_t size = sizeof(SpillRecordHeader_t) + nameLen + contentLen;
+    if ((off_t) size > tier->maxSize) return 0;
+
+    // Header + name + content segments (decoded if compressed)
+    int count = 0;
+    const struct iovec* view = createContentView(acquireContent(content), contentLen, &count);
+    struct iovec* iov = (struct iovec*) mem_malloc((count + 2) * sizeof(struct iovec));
+    iov[0].iov_base = &header;
+    iov[0].iov_len  = sizeof(SpillRecordHeader_t);
+    iov[1].iov_base = (void*) name;
+    iov[1].iov_len  = nameLen;
+    if (count > 0) memcpy(iov + 2, view, count * sizeof(struct iovec));
+
+    lock_mutex(&tier->mutex);
+
+    // Older copy is replaced, then the oldest records are overwritten
+    // (both wait for the records being read or written: the mutex is released meanwhile)
+    SpillEntry_t* entry = NULL;
+    do {
+        if ((entry = findIdleRecord(tier, hash, name, nameLen)) != NULL) dropRecord(tier, entry, 0);
+    } while (!makeRoomForRecord(tier, size));
+
+    // Reserve the region (its record is busy until written)
+    entry = (SpillEntry_t*) slabAlloc(&tier->entries);
+    entry->node.next  = NULL;
+    entry->node.hash  = hash;
+    entry->name       = (char*) mem_malloc(nameLen);
+    entry->nameLen    = nameLen;
+    entry->contentLen = contentLen;
+    entry->expiresAt  = expiresAt;
+    entry->offset     = tier->tail;
+    entry->size       = size;
+    entry->busy       = 1;
+    memcpy(entry->name, name, nameLen);
+    hashTableInsert(&tier->index, &entry->node);
+
+    // Newest record
+    entry->nex = NULL;
+    entry->pre = tier->newest;
+    if (tier->newest) tier->newest->nex = entry;
+    else tier->oldest = entry;
+    tier->newest = entry;
+
+    tier->tail       += size;
+    tier->filesCount += 1;
+    tier->bytesUsed  += size;
+
+    unlock_mutex(&tier->mutex);
+
+    // Write it (no lock held)
+    int res = writeRecord(tier->fd, iov, count + 2, entry->offset) == 0;
+    if (!res) LOG_ERRNO("[#SP] Error writing '%.*s' to disk tier", (int) nameLen, name);
+
+    lock_mutex(&tier->mutex);
+    entry->busy = 0;
+    if (res) {
+        tier->demotedCount      += 1;
+        tier->bytesDemotedCount += contentLen;
+    } else {
+        dropRecord(tier, entry, 1);
+    }
+    notify_all(&tier->cond);
+    unlock_mutex(&tier->mutex);
+
+    free(iov);
+    releaseContentView(view);
+    return res;
+}
+
+int spillTake(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen, Content_t** content, size_t* contentLen, long long* expiresAt) {
+    *content    = NULL;
+    *contentLen = 0;
+    *expiresAt  = 0;
+
+    lock_mutex(&tier->mutex);
+
+    // Check if file exist (waiting for it to be written)
+    SpillEntry_t* entry = findIdleRecord(tier, hash, name, nameLen);
+    if (entry == NULL) {
+        unlock_mutex(&tier->mutex);
+        return 0;
+    }
+
+    // Its region is kept until read
+    entry->busy = 1;
+    size_t len  = entry->contentLen;
+    off_t offset = entry->offset + sizeof(SpillRecordHeader_t) + entry->nameLen;
+    unlock_mutex(&tier->mutex);
+
+    // Read content (right after header and name, no lock held)
+    int res = 1;
+    Content_t* result = createContent(NULL, len);
+    if (result != NULL) {
+        // Fresh content: its single segment is written in place
+        char* dst = (char*) getContentBytes(result, len, contentLen);
+        if (readRecord(tier->fd, dst, len, offset) != 0) {
+            LOG_ERRNO("[#SP] Error reading '%.*s' from disk tier", (int) nameLen, name);
+            releaseContent(result);
+            result = NULL;
+            res    = 0;
+        }
+    }
+
+    lock_mutex(&tier->mutex);
+
+    // File leaves the tier (its record becomes free space)
+    entry->busy = 0;
+    if (res) {
+        tier->promotedCount      += 1;
+        tier->bytesPromotedCount += len;
+        *content    = result;
+        *contentLen = len;
+        *expiresAt  = entry->expiresAt;
+    }
+    dropRecord(tier, entry, !res);
+    notify_all(&tier->cond);
+
+    unlock_mutex(&tier->mutex);
+    return res;
+}
+
+int spillContains(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen) {
+    lock_mutex(&tier->mutex);
+    int res = hashTableFind(&tier->index, hash, name, nameLen) != NULL;
+    unlock_mutex(&tier->mutex);
+    return res;
+}
+
+SpillInfo_t spillInfo(SpillTier_t* tier) {
+    lock_mutex(&tier->mutex);
+    SpillInfo_t result = {
+        .filesCount         = tier->filesCount,
+        .bytesUsed          = tier->bytesUsed,
+        .demotedCount       = tier->demotedCount,
+        .bytesDemotedCount  = tier->bytesDemotedCount,
+        .promotedCount      = tier->promotedCount,
+        .bytesPromotedCount = tier->bytesPromotedCount,
+        .droppedCount       = tier->droppedCount,
+        .bytesDroppedCount  = tier->bytesDroppedCount
+    };
+    unlock_mutex(&tier->mutex);
+    return result;
+}
+
+// =============================================================================================
+
+int recordHasName(const HashTableNode_t* node, const void* name, size_t nameLen) {
+    const SpillEntry_t* entry = (const SpillEntry_t*) node;
+    return entry->nameLen == nameLen && memcmp(entry->name, name, nameLen) == 0;
+}
+
+// Must be called holding tier's mutex
+void dropRecord(SpillTier_t* tier, SpillEntry_t* entry, int lost) {
+    hashTableRemove(&tier->index, &entry->node);
+
+    // Unlink
+    if (entry->pre) entry->pre->nex = entry->nex;
+    else tier->oldest = entry->nex;
+    if (entry->nex) entry->nex->pre = entry->pre;
+    else tier->newest = entry->pre;
+
+    tier->filesCount -= 1;
+    tier->bytesUsed  -= entry->size;
+    if (lost) {
+        tier->droppedCount      += 1;
+        tier->bytesDroppedCount += entry->contentLen;
+    }
+
+    free(entry->name);
+    slabFree(&tier->entries, entry);
+}
+
+// Must be called holding tier's mutex. Returns 0 if it waited for a busy record (to be called again)
+int makeRoomForRecord(SpillTier_t* tier, size_t size) {
+    // Records after the tail are older than the ones before it
+    if (tier->tail + (off_t) size > tier->maxSize) {
+        // Wrap around: the end of the previous lap is lost
+        while (tier->oldest && tier->oldest->offset >= tier->tail) {
+            if (tier->oldest->busy) {
+                waitRecords(tier);
+                return 0;
+            }
+            dropRecord(tier, tier->oldest, 1);
+        }
+        tier->tail = 0;
+    }
+
+    // Drop the records overlapping the new one
+    while (tier->oldest && tier->oldest->offset >= tier->tail && tier->oldest->offset < tier->tail + (off_t) size) {
+        if (tier->oldest->busy) {
+            waitRecords(tier);
+            return 0;
+        }
+        dropRecord(tier, tier->oldest, 1);
+    }
+    return 1;
+}
+
+// Must be called holding tier's mutex. Waits for the record of a file to be written or read (NULL if none)
+SpillEntry_t* findIdleRecord(SpillTier_t* tier, HashValue64 hash, const char* name, size_t nameLen) {
+    SpillEntry_t* entry = NULL;
+    while ((entry = (SpillEntry_t*) hashTableFind(&tier->index, hash, name, nameLen)) != NULL && entry->busy) waitRecords(tier);
+    return entry;
+}
+
+// Must be called holding tier's mutex (released while waiting)
+void waitRecords(SpillTier_t* tier) {
+    int err = 0;
+    if ((err = pthread_cond_wait(&tier->cond, &tier->mutex)) != 0) {
+        errno = err;
+        LOG_ERRNO("[#SP] Error waiting on disk tier");
+    }
+}
+
+int writeRecord(int fd, struct iovec* iov, int count, off_t offset) {
+    while (count > 0) {
+        ssize_t n = pwritev(fd, iov, (MIN(count, IOV_MAX)), offset);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        offset += n;
+
+        // Skip what was written
+        while (count > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base  = (char*) iov->iov_base + n;
+            iov->iov_len  -= n;
+        }
+    }
+    return 0;
+}
+
+int readRecord(int fd, char* dst, size_t len, off_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, dst, len, offset);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n == 0) errno = EIO;
+            return -1;
+        }
+        dst    += n;
+        len    -= n;
+        offset += n;
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_MASK ((TimerTick_t) TIMER_WHEEL_SLOTS - 1)
+
+// =============================================================================================
+
+TimerNode_t* timerSlot(TimerWheel_t*, TimerTick_t);
+void timerLink(TimerNode_t*, TimerNode_t*);
+void timerCascade(TimerWheel_t*, int, int);
+void timerUpdateNext(TimerWheel_t*);
+
+// =============================================================================================
+
+void initTimerWheel(TimerWheel_t* wheel, TimerTick_t now) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (int i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+            wheel->slots[level][i].prev = &wheel->slots[level][i];
+            wheel->slots[level][i].next = &wheel->slots[level][i];
+        }
+    }
+    wheel->now = now;
+    atomic_init(&wheel->count, 0);
+    atomic_init(&wheel->next, TIMER_TICK_NEVER);
+}
+
+void timerWheelAdd(TimerWheel_t* wheel, TimerNode_t* node, TimerTick_t now, TimerTick_t deadline) {
+    // An empty wheel skips the ticks it was not advanced through
+    if (atomic_load_explicit(&wheel->count, memory_order_relaxed) == 0 && now > wheel->now) wheel->now = now;
+
+    node->deadline = deadline;
+    timerLink(timerSlot(wheel, deadline), node);
+    atomic_fetch_add_explicit(&wheel->count, 1, memory_order_relaxed);
+    if (deadline < atomic_load_explicit(&wheel->next, memory_order_relaxed))
+        atomic_store_explicit(&wheel->next, deadline, memory_order_relaxed);
+}
+
+void timerWheelCancel(TimerWheel_t* wheel, TimerNode_t* node) {
+    if (node->prev == NULL) return;
+
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    initTimerNode(node);
+    atomic_fetch_sub_explicit(&wheel->count, 1, memory_order_relaxed);
+}
+
+TimerNode_t* timerWheelAdvance(TimerWheel_t* wheel, TimerTick_t now) {
+    TimerNode_t* expired = NULL;
+    while (wheel->now <= now) {
+        // Nothing can expire: jump to the end
+        if (atomic_load_explicit(&wheel->count, memory_order_relaxed) == 0) {
+            wheel->now = now + 1;
+            break;
+        }
+
+        // Level 0 wrapped around: spread the next slot of the upper levels
+        // (the upper one only when the lower one wrapped too)
+        if ((wheel->now & TIMER_WHEEL_MASK) == 0) {
+            for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+                int index = (int) ((wheel->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+                timerCascade(wheel, level, index);
+                if (index != 0) break;
+            }
+        }
+
+        // Every timer of the tick's slot expires
+        TimerNode_t* head = &wheel->slots[0][wheel->now & TIMER_WHEEL_MASK];
+        TimerNode_t* node = head->next;
+        head->prev = head->next = head;
+        while (node != head) {
+            TimerNode_t* next = node->next;
+            node->prev = NULL;
+            node->next = expired;
+            expired    = node;
+            atomic_fetch_sub_explicit(&wheel->count, 1, memory_order_relaxed);
+            node = next;
+        }
+        wheel->now++;
+    }
+    timerUpdateNext(wheel);
+    return expired;
+}
+
+void initTimerNode(TimerNode_t* node) {
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+// =============================================================================================
+
+TimerNode_t* timerSlot(TimerWheel_t* wheel, TimerTick_t deadline) {
+    // Deadlines passed expire with the next tick
+    if (deadline < wheel->now) deadline = wheel->now;
+
+    // Lowest level whose slots still cover the distance
+    TimerTick_t delta = deadline - wheel->now;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (delta < ((TimerTick_t) 1 << (TIMER_WHEEL_BITS * (level + 1))))
+            return &wheel->slots[level][(deadline >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+    }
+
+    // Too far: last slot of the last level (it is spread again once reached)
+    TimerTick_t last = wheel->now + ((TimerTick_t) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    return &wheel->slots[TIMER_WHEEL_LEVELS - 1][(last >> (TIMER_WHEEL_BITS * (TIMER_WHEEL_LEVELS - 1))) & TIMER_WHEEL_MASK];
+}
+
+void timerLink(TimerNode_t* head, TimerNode_t* node) {
+    node->prev       = head->prev;
+    node->next       = head;
+    head->prev->next = node;
+    head->prev       = node;
+}
+
+void timerUpdateNext(TimerWheel_t* wheel) {
+    TimerTick_t next = TIMER_TICK_NEVER;
+    if (atomic_load_explicit(&wheel->count, memory_order_relaxed) > 0) {
+        // Upper levels are spread only when level 0 wraps around: their timers never expire before
+        TimerTick_t wrap = (wheel->now + TIMER_WHEEL_MASK) & ~TIMER_WHEEL_MASK;
+        next = wrap;
+
+        // Level 0 has a slot for each tick: the first one not empty
+        for (TimerTick_t tick = wheel->now; tick < wrap; ++tick) {
+            TimerNode_t* head = &wheel->slots[0][tick & TIMER_WHEEL_MASK];
+            if (head->next != head) {
+                next = tick;
+                break;
+            }
+        }
+    }
+    atomic_store_explicit(&wheel->next, next, memory_order_relaxed);
+}
+
+void timerCascade(TimerWheel_t* wheel, int level, int index) {
+    // Detach the slot, then place its timers again (closer to 'now', lower levels)
+    TimerNode_t* head = &wheel->slots[level][index];
+    TimerNode_t* node = head->next;
+    head->prev = head->next = head;
+    while (node != head) {
+        TimerNode_t* next = node->next;
+        timerLink(timerSlot(wheel, node->deadline), node);
+        node = next;
+    }
+}
@@ -12,6 +12,12 @@
 
 typedef struct { int bytesW, bytesR; } ApiBytesInfo_t;
 
+// File listed by listFiles
+typedef struct {
+    char* pathname; // File name
+    size_t size;    // File size (bytes)
+} ApiListEntry_t;
+
 /**
  * Open connection with an AF_UNIX socket.
  * The connection process repeats every 'msec' for at least 'abstime' (until connection
@@ -42,7 +48,8 @@ int closeConnection(const char* sockname);
  * Cannot open same file multiple times.
  * 
  * \param pathname: file to open
- * \param flags   : opening mode: FLAG_EMPY, FLAG_CREATE, FLAG_LOCK. Can be composed using |
+ * \param flags   : opening mode: FLAG_EMPY, FLAG_CREATE, FLAG_LOCK (FLAG_LOCK_SHARED too for a shared lock,
+ *                  see lockFileShared). Can be composed using |
  * 
  * \retval  0: on success
  * \retval -1: on error (errno set)
@@ -61,6 +68,20 @@ int openFile(const char* pathname, int flags);
  */
 int openFileWithDir(const char* pathname, int flags, const char* dirname);
 
+/**
+ * Send a request for creating a file removed by the server once its TTL elapsed.
+ * (same as openFileWithDir, the TTL is ignored without FLAG_CREATE)
+ * 
+ * \param pathname: file to open
+ * \param flags   : opening mode: FLAG_EMPY, FLAG_CREATE, FLAG_LOCK. Can be composed using |
+ * \param ttlMs   : time to live (ms), 0 to keep it until removed
+ * \param dirname : where to save returned files. NULL to reject them
+ * 
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int openFileWithTTL(const char* pathname, int flags, long ttlMs, const char* dirname);
+
 /**
  * Send a request for  reading a file.
  * 
@@ -85,6 +106,41 @@ int readFile(const char* pathname, void** buf, size_t* size);
  */
 int readNFiles(int N, const char* dirname);
 
+/**
+ * Choose how the files ejected by the next writes (create, write, append,
+ * write range) are delivered. Deferred files are queued by the server (the
+ * write returns at once) and read with readEjectedFiles. Files not fitting
+ * the queue are still returned by the write.
+ * 
+ * \param enable: 1 to defer them, 0 to return them with the write (default)
+ * 
+ * \retval prev: previous setting
+ */
+int deferEjectedFiles(int enable);
+
+/**
+ * Choose how long the next lock requests (lockFile, openFile with FLAG_LOCK
+ * and without FLAG_CREATE) wait for a lock owned by someone else. When it
+ * elapses the request fails with ETIMEDOUT.
+ * 
+ * \param msec: time to wait at most (ms), 0 to never wait, -1 for the server default (default)
+ * 
+ * \retval prev: previous setting
+ */
+long setLockTimeout(long msec);
+
+/**
+ * Send a request for reading the files ejected by deferred writes (the oldest first).
+ * Passing a dirname will save them locally.
+ * 
+ * \param N      : numer of files to read. (0) to read all
+ * \param dirname: where to save returned files. NULL to reject them
+ * 
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int readEjectedFiles(int N, const char* dirname);
+
 /**
  * Send a request for writing a file.
  * The file must be opened in FLAG_CREATE | FLAG_LOCK mode and must be the
@@ -120,10 +176,63 @@ int writeFile(const char* pathname, const char* dirname);
  */
 int appendToFile(const char* pathname, void* buf, size_t size, const char* dirname);
 
+/**
+ * Send a request for reading bytes of a file (only those bytes are transferred).
+ * The file must be opened. Reading past the end returns the bytes up to it.
+ * 
+ * \param pathname: file to read
+ * \param offset  : first byte to read
+ * \param length  : bytes to read
+ * \param buf     : destination buffer
+ * \param size    : bytes returned
+ * 
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int readFileRange(const char* pathname, size_t offset, size_t length, void** buf, size_t* size);
+
+/**
+ * Send a request for writing bytes of a file, from 'offset' on.
+ * The file must be opened and 'offset' cannot be past its end (it grows if
+ * the bytes go past it). Same locking rules of appendToFile.
+ * 
+ * When server is full, it returns files to clear memory.
+ * Passing a dirname will store them.
+ * 
+ * \param pathname: file to modify
+ * \param offset  : first byte to write
+ * \param buf     : bytes to send
+ * \param size    : buffer size
+ * \param dirname : where to save returned files. NULL to reject them
+ * 
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int writeFileRange(const char* pathname, size_t offset, const void* buf, size_t size, const char* dirname);
+
+/**
+ * Send a request for listing the files whose name starts with a prefix (only names
+ * and sizes are transferred). Files are sorted by name: passing the last one as
+ * 'after' returns the next page.
+ * 
+ * \param prefix : names prefix ("" for every file)
+ * \param after  : last name got (NULL to start from the first)
+ * \param max    : files to list at most (0 for the server maximum)
+ * \param entries: listed files (free each pathname, then the array)
+ * \param count  : listed files count
+ * \param more   : set to 1 if other files follow the last one, 0 otherwise
+ * 
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int listFiles(const char* prefix, const char* after, int max, ApiListEntry_t** entries, int* count, int* more);
+
 /**
  * Send a request for locking a file.
- * The call is blocking and the client can continues only after aquiring the lock.
- * If the file was already locked, it succed.
+ * The call is blocking and the client can continues only after aquiring the lock
+ * (or once the timeout elapsed, see setLockTimeout).
+ * If the file was already locked, it succed (renewing the lease, if the server has one).
+ * A lease elapsed lets the server give the lock to someone else: unlocking then fails with EPERM.
  * 
  * \param pathname: file to lock
  * 
@@ -133,7 +242,21 @@ int appendToFile(const char* pathname, void* buf, size_t size, const char* dirna
 int lockFile(const char* pathname);
 
 /**
- * Send a request for unlocking a file.
+ * Send a request for locking a file shared: readers hold it at the same time, while
+ * nobody can modify the file. Blocking as lockFile: it waits for an exclusive owner,
+ * and for the clients already waiting (writers are not starved by new readers).
+ * Locking it again renews the lease. The only reader can then take it exclusive with lockFile
+ * (EPERM while other readers hold it).
+ * 
+ * \param pathname: file to lock
+ * 
+ * \retval  0: on success
+ * \retval -1: on error (errno set)
+ */
+int lockFileShared(const char* pathname);
+
+/**
+ * Send a request for unlocking a file (shared locks included).
  * 
  * \param pathname: file to unlock
  * 
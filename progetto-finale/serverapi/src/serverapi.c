@@ -17,8 +17,12 @@ static size_t gBufferSize = 0;
 static size_t bytesRead    = 0;
 static size_t bytesWritten = 0;
 
+static int gDeferEjected = 0; // FLAG_DEFER on writes
+static long gLockTimeout = -1; // FLAG_TIMEOUT on lock requests (when >= 0)
+
 int waitServerResponse(const char*);
 int handleServerStatus(RespStatus_t);
+int requestLock(const char*, int);
 
 int openConnection(const char* sockname, int msec, const struct timespec abstime) {
     // 0. Create socket
@@ -98,7 +102,20 @@ int openFile(const char* pathname, int flags) {
 }
 
 int openFileWithDir(const char* pathname, int flags, const char* dirname) {
+    return openFileWithTTL(pathname, flags, 0, dirname);
+}
+
+int openFileWithTTL(const char* pathname, int flags, long ttlMs, const char* dirname) {
     size_t filenameLen = strlen(pathname) + 1;
+    if (ttlMs < 0) {
+        errno = EINVAL;
+        return SERVER_API_FAILURE;
+    }
+
+    // TTL is sent only when a file is created, the lock timeout only when it is not
+    if (ttlMs > 0 && (flags & FLAG_CREATE)) flags |= FLAG_TTL;
+    if (gDeferEjected && (flags & FLAG_CREATE)) flags |= FLAG_DEFER;
+    if (gLockTimeout >= 0 && (flags & FLAG_LOCK) && !(flags & FLAG_CREATE)) flags |= FLAG_TIMEOUT;
 
     // 1. Send 'MSG_REQ_OPEN_FILE' message
     SockMessage_t msg = {
@@ -113,7 +130,8 @@ int openFileWithDir(const char* pathname, int flags, const char* dirname) {
                 },
                 .content = { .ptr = NULL },
                 .contentLen = 0
-            }
+            },
+            .length = (flags & FLAG_TTL) ? (size_t) ttlMs : (flags & FLAG_TIMEOUT) ? (size_t) gLockTimeout : 0
         }
     };
     size_t bytes = 0;
@@ -217,6 +235,39 @@ int readNFiles(int N, const char* dirname) {
     return waitServerResponse(dirname);
 }
 
+int deferEjectedFiles(int enable) {
+    int prev      = gDeferEjected;
+    gDeferEjected = (enable != 0);
+    return prev;
+}
+
+long setLockTimeout(long msec) {
+    long prev    = gLockTimeout;
+    gLockTimeout = (msec < 0) ? -1 : msec;
+    return prev;
+}
+
+int readEjectedFiles(int N, const char* dirname) {
+    // 1. Send 'MSG_REQ_READ_EJECTED' message
+    SockMessage_t msg = {
+        .uid = UUID_new(),
+        .type = MSG_REQ_READ_EJECTED,
+        .request = {
+            .flags = N
+        }
+    };
+    size_t bytes = 0;
+    if ((bytes = writeMessage(gSocketFd, &gBuffer, &gBufferSize, &msg)) <= 0) {
+        freeMessageContent(&msg, 0);
+        return SERVER_API_FAILURE;
+    }
+    bytesWritten += bytes;
+    
+    // 2. Wait for server response
+    freeMessageContent(&msg, 0);
+    return waitServerResponse(dirname);
+}
+
 int writeFile(const char* pathname, const char* dirname) {
     size_t filenameLen = strlen(pathname) + 1;
 
@@ -231,7 +282,7 @@ int writeFile(const char* pathname, const char* dirname) {
         .uid = UUID_new(),
         .type = MSG_REQ_WRITE_FILE,
         .request = {
-            .flags = FLAG_EMPTY,
+            .flags = gDeferEjected ? FLAG_DEFER : FLAG_EMPTY,
             .file = {
                 .filename = {
                     .len = filenameLen,
@@ -264,7 +315,7 @@ int appendToFile(const char* pathname, void* buf, size_t size, const char* dirna
         .uid = UUID_new(),
         .type = MSG_REQ_APPEND_TO_FILE,
         .request = {
-            .flags = FLAG_EMPTY,
+            .flags = gDeferEjected ? FLAG_DEFER : FLAG_EMPTY,
             .file = {
                 .filename = {
                     .len = filenameLen,
@@ -289,7 +340,180 @@ int appendToFile(const char* pathname, void* buf, size_t size, const char* dirna
     return waitServerResponse(dirname);
 }
 
+int readFileRange(const char* pathname, size_t offset, size_t length, void** buf, size_t* size) {
+    size_t filenameLen = strlen(pathname) + 1;
+    
+    // 1. Send 'MSG_REQ_READ_RANGE' message
+    SockMessage_t msg = {
+        .uid = UUID_new(),
+        .type = MSG_REQ_READ_RANGE,
+        .request = {
+            .flags = FLAG_EMPTY,
+            .file = {
+                .filename = {
+                    .len = filenameLen,
+                    .abs = { .ptr = pathname }
+                },
+                .content = { .ptr = NULL },
+                .contentLen = 0
+            },
+            .offset = offset,
+            .length = length
+        }
+    };
+    size_t bytes = 0;
+    if ((bytes = writeMessage(gSocketFd, &gBuffer, &gBufferSize, &msg)) <= 0) {
+        freeMessageContent(&msg, 0);
+        return SERVER_API_FAILURE;
+    }
+    bytesWritten += bytes;
+    
+    // 2. Wait for server response
+    freeMessageContent(&msg, 0);
+
+    // 3. Wait message from server
+    bytes = 0;
+    if ((bytes = readMessage(gSocketFd, &gBuffer, &gBufferSize, &msg)) <= 0) {
+        errno = ECANCELED;
+        return SERVER_API_FAILURE;
+    }
+    bytesRead += bytes;
+
+    // 4. Read content
+    int status = SERVER_API_SUCCESS;
+    if (msg.type == MSG_RESP_WITH_FILES && msg.response.numFiles == 1) {
+        // Process data (an empty range has no content)
+        size_t len = msg.response.files[0].contentLen;
+        char* buffer = (char*) mem_malloc((MAX(1, len)) * sizeof(char));
+        if (len > 0) memcpy(buffer, msg.response.files[0].content.ptr, len * sizeof(char));
+        // Pass values
+        *buf  = buffer;
+        *size = len;
+    } else if (msg.type == MSG_RESP_WITH_FILES || msg.type == MSG_RESP_SIMPLE) {
+        // Server-side error
+        handleServerStatus(msg.response.status);
+        status = SERVER_API_FAILURE;
+    } else {
+        // Should never happend
+        LOG_WARN("Invalid message type from server.");
+        status = SERVER_API_FAILURE;
+    }
+
+    freeMessageContent(&msg, 0);
+    return status;
+}
+
+int writeFileRange(const char* pathname, size_t offset, const void* buf, size_t size, const char* dirname) {
+    size_t filenameLen = strlen(pathname) + 1;
+
+    // 1. Send 'MSG_REQ_WRITE_RANGE' message
+    SockMessage_t msg = {
+        .uid = UUID_new(),
+        .type = MSG_REQ_WRITE_RANGE,
+        .request = {
+            .flags = gDeferEjected ? FLAG_DEFER : FLAG_EMPTY,
+            .file = {
+                .filename = {
+                    .len = filenameLen,
+                    .abs = { .ptr = pathname }
+                },
+                .contentLen = size,
+                .content = { .ptr = buf }
+            },
+            .offset = offset,
+            .length = size
+        }
+    };
+    size_t bytes = 0;
+    if ((bytes = writeMessage(gSocketFd, &gBuffer, &gBufferSize, &msg)) <= 0) {
+        freeMessageContent(&msg, 0);
+        return SERVER_API_FAILURE;
+    }
+    bytesWritten += bytes;
+    
+    // 2. Wait for server response
+    freeMessageContent(&msg, 0);
+    return waitServerResponse(dirname);
+}
+
+int listFiles(const char* prefix, const char* after, int max, ApiListEntry_t** entries, int* count, int* more) {
+    // Cursor is sent with its terminator (names are listed with it)
+    size_t afterLen = (after == NULL) ? 0 : strlen(after) + 1;
+
+    // 1. Send 'MSG_REQ_LIST' message
+    SockMessage_t msg = {
+        .uid = UUID_new(),
+        .type = MSG_REQ_LIST,
+        .request = {
+            .flags = FLAG_EMPTY,
+            .file = {
+                .filename = {
+                    .len = strlen(prefix) + 1,
+                    .abs = { .ptr = prefix }
+                },
+                .content = { .ptr = after },
+                .contentLen = afterLen
+            },
+            .offset = 0,
+            .length = MAX(0, max)
+        }
+    };
+    size_t bytes = 0;
+    if ((bytes = writeMessage(gSocketFd, &gBuffer, &gBufferSize, &msg)) <= 0) {
+        freeMessageContent(&msg, 0);
+        return SERVER_API_FAILURE;
+    }
+    bytesWritten += bytes;
+    
+    // 2. Wait for server response
+    freeMessageContent(&msg, 0);
+
+    // 3. Wait message from server
+    bytes = 0;
+    if ((bytes = readMessage(gSocketFd, &gBuffer, &gBufferSize, &msg)) <= 0) {
+        errno = ECANCELED;
+        return SERVER_API_FAILURE;
+    }
+    bytesRead += bytes;
+
+    // 4. Read names
+    int status = SERVER_API_SUCCESS;
+    if (msg.type == MSG_RESP_LIST && msg.response.status == RESP_STATUS_OK) {
+        const int numFiles = msg.response.numFiles;
+        ApiListEntry_t* list = (ApiListEntry_t*) mem_malloc((MAX(1, numFiles)) * sizeof(ApiListEntry_t));
+        for (int i = 0; i < numFiles; ++i) {
+            size_t len = msg.response.files[i].filename.len;
+            list[i].pathname = (char*) mem_malloc(len * sizeof(char));
+            list[i].size     = msg.response.files[i].contentLen;
+            memcpy(list[i].pathname, msg.response.files[i].filename.abs.ptr, len * sizeof(char));
+        }
+        // Pass values
+        *entries = list;
+        *count   = numFiles;
+        *more    = msg.response.more;
+    } else if (msg.type == MSG_RESP_LIST || msg.type == MSG_RESP_SIMPLE) {
+        // Server-side error
+        handleServerStatus(msg.response.status);
+        status = SERVER_API_FAILURE;
+    } else {
+        // Should never happend
+        LOG_WARN("Invalid message type from server.");
+        status = SERVER_API_FAILURE;
+    }
+
+    freeMessageContent(&msg, 0);
+    return status;
+}
+
 int lockFile(const char* pathname) {
+    return requestLock(pathname, FLAG_EMPTY);
+}
+
+int lockFileShared(const char* pathname) {
+    return requestLock(pathname, FLAG_LOCK_SHARED);
+}
+
+int requestLock(const char* pathname, int flags) {
     size_t filenameLen = strlen(pathname) + 1;
 
     // 1. Send 'MSG_REQ_LOCK_FILE' message
@@ -297,7 +521,7 @@ int lockFile(const char* pathname) {
         .uid = UUID_new(),
         .type = MSG_REQ_LOCK_FILE,
         .request = {
-            .flags = FLAG_EMPTY,
+            .flags = flags | ((gLockTimeout >= 0) ? FLAG_TIMEOUT : FLAG_EMPTY),
             .file = {
                 .filename = {
                     .len = filenameLen,
@@ -305,7 +529,8 @@ int lockFile(const char* pathname) {
                 },
                 .content = { .ptr = NULL },
                 .contentLen = 0
-            }
+            },
+            .length = (gLockTimeout >= 0) ? (size_t) gLockTimeout : 0
         }
     };
     size_t bytes = 0;
@@ -435,8 +660,13 @@ int waitServerResponse(const char* dirname) {
         case MSG_REQ_UNLOCK_FILE:
         case MSG_REQ_REMOVE_FILE:
         case MSG_REQ_READ_N_FILES:
+        case MSG_REQ_READ_EJECTED:
         case MSG_REQ_WRITE_FILE:
         case MSG_REQ_APPEND_TO_FILE:
+        case MSG_REQ_READ_RANGE:
+        case MSG_REQ_WRITE_RANGE:
+        case MSG_REQ_LIST:
+        case MSG_RESP_LIST:
         {
             LOG_WARN("Invalid message type from server.");
             break;
@@ -499,6 +729,10 @@ int handleServerStatus(RespStatus_t status) {
             errno = ENOENT;
             return SERVER_API_FAILURE;
 
+        case RESP_STATUS_TIMED_OUT:
+            errno = ETIMEDOUT;
+            return SERVER_API_FAILURE;
+
         case RESP_STATUS_NONE:
             LOG_WARN("Server response status empty...");
         case RESP_STATUS_OK: